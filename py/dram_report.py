@@ -0,0 +1,119 @@
+"""
+Report where the objects of a module end up in the ESP32 memory map.
+
+Reads the GNU ld map file of the firmware (PlatformIO: .pio/build/esp32dev/firmware.map,
+idf.py: build/bb.map) and sums the input sections of the selected objects per
+memory region. Given two map files it prints a before/after comparison.
+
+    python py/dram_report.py firmware.map
+    python py/dram_report.py before.map after.map --obj line_data --obj led
+"""
+import argparse
+import re
+from collections import defaultdict
+from typing import Dict, List, Tuple
+
+# output sections of the esp32 linker script and the memory they occupy
+REGIONS = {
+    ".dram0.data": "DRAM",
+    ".dram0.bss": "DRAM",
+    ".noinit": "DRAM",
+    ".iram0.text": "IRAM",
+    ".iram0.data": "IRAM",
+    ".flash.rodata": "FLASH",
+    ".flash.appdesc": "FLASH",
+    ".flash.text": "FLASH",
+    ".rtc.data": "RTC",
+    ".rtc.bss": "RTC",
+    ".rtc_noinit": "RTC",
+    ".ext_ram.bss": "PSRAM",
+}
+
+ENTRY = re.compile(r"^ (\.[^\s]+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(.+)$")
+
+
+def parse_map(path: str, objs: List[str]) -> Dict[Tuple[str, str], int]:
+    """Returns {(output section, input section): bytes} for the matching objects."""
+    sizes: Dict[Tuple[str, str], int] = defaultdict(int)
+    out_section = None
+    pending = None
+    in_memory_map = False
+
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_memory_map = True
+                continue
+            if not in_memory_map:
+                continue
+
+            # output section header starts in column 0
+            if line.startswith("."):
+                out_section = line.split()[0]
+                pending = None
+                continue
+
+            # long input section names are wrapped onto the next line
+            if re.match(r"^ \.[^\s]+$", line):
+                pending = line.strip()
+                continue
+
+            m = ENTRY.match(line)
+            if not m:
+                pending = None
+                continue
+
+            name = m.group(1) or pending
+            pending = None
+            size = int(m.group(3), 16)
+            obj = m.group(4)
+            if name is None or size == 0 or out_section not in REGIONS:
+                continue
+            if not any(o in obj for o in objs):
+                continue
+            sizes[(out_section, name)] += size
+    return sizes
+
+
+def by_region(sizes: Dict[Tuple[str, str], int]) -> Dict[str, int]:
+    total: Dict[str, int] = defaultdict(int)
+    for (out_section, _), size in sizes.items():
+        total[REGIONS[out_section]] += size
+    return total
+
+
+def print_single(path: str, sizes: Dict[Tuple[str, str], int]):
+    print(f"{path}")
+    for (out_section, name), size in sorted(sizes.items()):
+        print(f"  {REGIONS[out_section]:6} {out_section:16} {name:48} {size:7d}")
+    for region, size in sorted(by_region(sizes).items()):
+        print(f"  total {region:6} {size:7d} bytes")
+
+
+def print_compare(before: Dict[Tuple[str, str], int], after: Dict[Tuple[str, str], int]):
+    rb = by_region(before)
+    ra = by_region(after)
+    print(f"{'region':8} {'before':>8} {'after':>8} {'delta':>8}")
+    for region in sorted(set(rb) | set(ra)):
+        b = rb.get(region, 0)
+        a = ra.get(region, 0)
+        print(f"{region:8} {b:8d} {a:8d} {a - b:+8d}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="DRAM/flash footprint of firmware objects from a linker map")
+    parser.add_argument("maps", nargs="+", help="one map file, or before and after")
+    parser.add_argument("--obj", action="append", default=None,
+                        help="object name filter, can be repeated (default: line_data)")
+    args = parser.parse_args()
+    objs = args.obj or ["line_data"]
+
+    if len(args.maps) == 1:
+        print_single(args.maps[0], parse_map(args.maps[0], objs))
+    else:
+        before = parse_map(args.maps[0], objs)
+        after = parse_map(args.maps[1], objs)
+        print_single(args.maps[0], before)
+        print_single(args.maps[1], after)
+        print_compare(before, after)
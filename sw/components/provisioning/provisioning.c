@@ -8,6 +8,7 @@
 */
 
 #include <stdio.h>
+#include <inttypes.h>
 #include <string.h>
 
 #include <freertos/FreeRTOS.h>
@@ -15,6 +16,7 @@
 #include <freertos/event_groups.h>
 
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <esp_wifi.h>
 #include <esp_event.h>
 #include <nvs_flash.h>
@@ -22,6 +24,8 @@
 #include <network_provisioning/manager.h>
 
 #include "esp32_softap_ota.h"
+#include "provisioning.h"
+#include "wifi_cache.h"
 
 #ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_BLE
 #include <network_provisioning/scheme_ble.h>
@@ -106,6 +110,97 @@ static esp_err_t example_get_sec2_verifier(const char **verifier, uint16_t *veri
 const int WIFI_CONNECTED_EVENT = BIT0;
 static EventGroupHandle_t wifi_event_group;
 
+#define WIFI_CACHE_MAX_FAILS 2   // failed associations with the cached ap before a full scan
+
+static esp_netif_t *sta_netif = NULL;
+static bool     s_cached = false;         // station runs on the cached bssid and channel
+static bool     s_static_ip = false;      // and on the cached lease instead of dhcp
+static uint32_t s_cache_fails = 0;
+static int64_t  s_connect_start_us = 0;
+static int64_t  s_sta_start_us = 0;
+static int64_t  s_got_ip_us = 0;
+static uint32_t s_connect_ms = 0;
+static bool     s_fast_connect = false;
+static esp_netif_ip_info_t s_lease;
+
+// wifi config changes for the cache are not persisted, only credentials are
+static void set_sta_config_ram(wifi_config_t *cfg)
+{
+    esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, cfg);
+    esp_wifi_set_storage(WIFI_STORAGE_FLASH);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "set_config failed: %s", esp_err_to_name(err));
+    }
+}
+
+// associate with the last good ap on its channel instead of scanning
+static void use_cache(void)
+{
+    wifi_config_t cfg = {0};
+    wifi_cache_t c;
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK || !wifi_cache_load(&c, cfg.sta.ssid)) {
+        ESP_LOGI(TAG, "no cached access point, scanning");
+        return;
+    }
+    memcpy(cfg.sta.bssid, c.bssid, sizeof(cfg.sta.bssid));
+    cfg.sta.bssid_set = true;
+    cfg.sta.channel = c.channel;
+    cfg.sta.scan_method = WIFI_FAST_SCAN;
+    set_sta_config_ram(&cfg);
+    s_cached = true;
+    ESP_LOGI(TAG, "connecting to cached access point " MACSTR " on channel %u", MAC2STR(c.bssid), c.channel);
+
+#if CONFIG_PROV_REUSE_DHCP_LEASE
+    if (c.ip.ip.addr != 0 && esp_netif_dhcpc_stop(sta_netif) == ESP_OK) {
+        esp_netif_set_ip_info(sta_netif, &c.ip);
+        esp_netif_dns_info_t dns = { .ip.u_addr.ip4 = c.dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns);
+        s_static_ip = true;
+        ESP_LOGI(TAG, "reusing lease " IPSTR, IP2STR(&c.ip.ip));
+    }
+#endif
+}
+
+// back to a full scan and dhcp, called from the event loop
+static void drop_cache(void)
+{
+    ESP_LOGW(TAG, "cached access point not reachable, scanning all channels");
+    wifi_config_t cfg = {0};
+    if (esp_wifi_get_config(WIFI_IF_STA, &cfg) == ESP_OK) {
+        cfg.sta.bssid_set = false;
+        cfg.sta.channel = 0;
+        cfg.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+        set_sta_config_ram(&cfg);
+    }
+    if (s_static_ip) {
+        esp_netif_dhcpc_start(sta_netif);
+        s_static_ip = false;
+    }
+    s_cached = false;
+    s_cache_fails = 0;
+}
+
+// remembers the ap and lease of the connection that just came up
+static void learn_cache(void)
+{
+    wifi_ap_record_t ap;
+    wifi_config_t cfg = {0};
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK || esp_wifi_get_config(WIFI_IF_STA, &cfg) != ESP_OK) return;
+
+    wifi_cache_t c = {0};
+    c.version = WIFI_CACHE_VERSION;
+    c.channel = ap.primary;
+    memcpy(c.bssid, ap.bssid, sizeof(c.bssid));
+    memcpy(c.ssid, cfg.sta.ssid, sizeof(c.ssid));
+    c.ip = s_lease;
+    esp_netif_dns_info_t dns;
+    if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns) == ESP_OK) {
+        c.dns = dns.ip.u_addr.ip4;
+    }
+    wifi_cache_store(&c);
+}
+
 #define PROV_QR_VERSION         "v1"
 #define PROV_TRANSPORT_SOFTAP   "softap"
 #define PROV_TRANSPORT_BLE      "ble"
@@ -166,6 +261,10 @@ static void event_handler(void *arg, esp_event_base_t event_base,
             break;
         case WIFI_EVENT_STA_DISCONNECTED:
             ESP_LOGI(TAG, "Disconnected. Connecting to the AP again...");
+            if (s_cached && ++s_cache_fails >= WIFI_CACHE_MAX_FAILS) {
+                drop_cache();
+            }
+            s_connect_start_us = esp_timer_get_time();
             esp_wifi_connect();
             break;
 #ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_SOFTAP
@@ -182,6 +281,15 @@ static void event_handler(void *arg, esp_event_base_t event_base,
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *) event_data;
         ESP_LOGI(TAG, "Connected with IP Address:" IPSTR, IP2STR(&event->ip_info.ip));
+        int64_t now = esp_timer_get_time();
+        if (s_connect_start_us) {
+            s_connect_ms = (uint32_t)((now - s_connect_start_us) / 1000);
+            ESP_LOGI(TAG, "connected in %" PRIu32 " ms, %s", s_connect_ms, s_cached ? "cached access point" : "scan");
+        }
+        if (s_got_ip_us == 0) s_got_ip_us = now;
+        s_fast_connect = s_cached;
+        s_cache_fails = 0;
+        s_lease = event->ip_info;
         /* Signal main application to continue execution */
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_EVENT);
 #ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_BLE
@@ -218,6 +326,10 @@ static void wifi_init_sta(void)
 {
     /* Start Wi-Fi in station mode */
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+#if CONFIG_PROV_FAST_RECONNECT
+    use_cache();
+#endif
+    s_sta_start_us = s_connect_start_us = esp_timer_get_time();
     ESP_ERROR_CHECK(esp_wifi_start());
 }
 
@@ -312,42 +424,12 @@ const wifi_prov_event_handler_t wifi_prov_event_handler = {
 };
 #endif /* EXAMPLE_PROV_ENABLE_APP_CALLBACK */
 
-void provisioning(bool reset)
-{
-    /* Initialize NVS partition */
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        /* NVS partition was truncated
-         * and needs to be erased */
-        ESP_ERROR_CHECK(nvs_flash_erase());
-
-        /* Retry nvs_flash_init */
-        ESP_ERROR_CHECK(nvs_flash_init());
-    }
-
-    /* Initialize TCP/IP */
-    ESP_ERROR_CHECK(esp_netif_init());
-
-    /* Initialize the event loop */
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    wifi_event_group = xEventGroupCreate();
-
-    /* Register our event handler for Wi-Fi, IP and Provisioning related events */
-    ESP_ERROR_CHECK(esp_event_handler_register(NETWORK_PROV_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
-#ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_BLE
-    ESP_ERROR_CHECK(esp_event_handler_register(PROTOCOMM_TRANSPORT_BLE_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
-#endif
-    ESP_ERROR_CHECK(esp_event_handler_register(PROTOCOMM_SECURITY_SESSION_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
-    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
-
-    /* Initialize Wi-Fi including netif with default config */
-    esp_netif_create_default_wifi_sta();
-#ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_SOFTAP
-    esp_netif_create_default_wifi_ap();
-#endif /* CONFIG_EXAMPLE_PROV_TRANSPORT_SOFTAP */
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+static bool prepared = false;
+static bool provisioned = false;
+static bool sta_started = false;
 
+static void prov_mgr_init(void)
+{
     /* Configuration for the provisioning manager */
     network_prov_mgr_config_t config = {
 #ifdef CONFIG_EXAMPLE_RESET_PROV_MGR_ON_FAILURE
@@ -386,22 +468,95 @@ void provisioning(bool reset)
     /* Initialize provisioning manager with the
      * configuration parameters set above */
     ESP_ERROR_CHECK(network_prov_mgr_init(config));
+}
 
-    bool provisioned = false;
-    // reset argument is used to reset provisioning.
-    // does not interfer with program flow
-    if(reset == true) {
-        network_prov_mgr_reset_wifi_provisioning();
+void provisioning_prepare(void)
+{
+    if (prepared) return;
+
+    /* Initialize NVS partition */
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        /* NVS partition was truncated
+         * and needs to be erased */
+        ESP_ERROR_CHECK(nvs_flash_erase());
+
+        /* Retry nvs_flash_init */
+        ESP_ERROR_CHECK(nvs_flash_init());
     }
 
-    #ifdef CONFIG_EXAMPLE_RESET_PROVISIONED
-    network_prov_mgr_reset_wifi_provisioning();
-    #else
+    /* Initialize TCP/IP */
+    ESP_ERROR_CHECK(esp_netif_init());
+
+    /* Initialize the event loop */
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    wifi_event_group = xEventGroupCreate();
 
+    /* Register our event handler for Wi-Fi, IP and Provisioning related events */
+    ESP_ERROR_CHECK(esp_event_handler_register(NETWORK_PROV_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
+#ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_BLE
+    ESP_ERROR_CHECK(esp_event_handler_register(PROTOCOMM_TRANSPORT_BLE_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
+#endif
+    ESP_ERROR_CHECK(esp_event_handler_register(PROTOCOMM_SECURITY_SESSION_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL));
+
+    /* Initialize Wi-Fi including netif with default config */
+    sta_netif = esp_netif_create_default_wifi_sta();
+#ifdef CONFIG_EXAMPLE_PROV_TRANSPORT_SOFTAP
+    esp_netif_create_default_wifi_ap();
+#endif /* CONFIG_EXAMPLE_PROV_TRANSPORT_SOFTAP */
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
+
+    prov_mgr_init();
+
+#ifdef CONFIG_EXAMPLE_RESET_PROVISIONED
+    network_prov_mgr_reset_wifi_provisioning();
+#else
     /* Let's find out if the device is provisioned */
     ESP_ERROR_CHECK(network_prov_mgr_is_wifi_provisioned(&provisioned));
-
 #endif
+
+    // with stored credentials the station connects right away, it is
+    // stopped again in provisioning() if the user asks for a reset
+    if (provisioned) {
+        ESP_LOGI(TAG, "Already provisioned, starting Wi-Fi STA");
+
+        /* We don't need the manager as device is already provisioned,
+         * so let's release it's resources */
+        ESP_ERROR_CHECK(network_prov_mgr_deinit());
+
+        ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
+        /* Start Wi-Fi station */
+        wifi_init_sta();
+        sta_started = true;
+    }
+    prepared = true;
+}
+
+void provisioning(bool reset)
+{
+    provisioning_prepare();
+
+    // reset argument is used to reset provisioning.
+    // does not interfer with program flow
+    if(reset == true) {
+        if (sta_started) {
+            // drop the early connection made with the old credentials
+            ESP_ERROR_CHECK(esp_event_handler_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler));
+            ESP_ERROR_CHECK(esp_wifi_stop());
+            xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_EVENT);
+            if (s_static_ip) esp_netif_dhcpc_start(sta_netif);
+            s_cached = s_static_ip = false;
+            s_sta_start_us = s_got_ip_us = s_connect_start_us = 0;
+            sta_started = false;
+            prov_mgr_init();
+        }
+        wifi_cache_clear();
+        network_prov_mgr_reset_wifi_provisioning();
+        provisioned = false;
+    }
+
     /* If device is not yet provisioned start provisioning service */
     if (!provisioned) {
         ESP_LOGI(TAG, "Starting provisioning");
@@ -532,18 +687,33 @@ void provisioning(bool reset)
 
         esp32_softap_ota();
 #endif /* CONFIG_EXAMPLE_PROV_TRANSPORT_BLE */
-    } else {
-        ESP_LOGI(TAG, "Already provisioned, starting Wi-Fi STA");
-
-        /* We don't need the manager as device is already provisioned,
-         * so let's release it's resources */
-        ESP_ERROR_CHECK(network_prov_mgr_deinit());
-
-        ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL));
-        /* Start Wi-Fi station */
-        wifi_init_sta();
     }
 
     /* Wait for Wi-Fi connection */
     xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_EVENT, true, true, portMAX_DELAY);
+
+    // here and not in the event handler, nvs needs more stack than the event task has
+#if CONFIG_PROV_FAST_RECONNECT
+    learn_cache();
+#endif
+}
+
+int64_t provisioning_sta_start_us(void)
+{
+    return s_sta_start_us;
+}
+
+int64_t provisioning_got_ip_us(void)
+{
+    return s_got_ip_us;
+}
+
+uint32_t provisioning_connect_ms(void)
+{
+    return s_connect_ms;
+}
+
+bool provisioning_fast_connect(void)
+{
+    return s_fast_connect;
 }
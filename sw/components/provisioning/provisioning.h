@@ -1,6 +1,27 @@
 #ifndef __PROVISIONING_H_
 #define __PROVISIONING_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Brings up nvs, netif, the event loop and the wifi driver. If credentials
+ * are stored the station starts connecting in the background. Optional,
+ * provisioning() calls it if it has not run yet.
+ */
+void provisioning_prepare(void);
+
+/** Resets the credentials if asked to, provisions if needed and blocks until an ip is assigned. */
 void provisioning(bool reset);
 
+/** esp_timer time at which the station was started and first got an ip, 0 if not (yet). */
+int64_t provisioning_sta_start_us(void);
+int64_t provisioning_got_ip_us(void);
+
+/** Duration of the last connect from start or disconnect to ip, in ms. */
+uint32_t provisioning_connect_ms(void);
+
+/** True if the last connect went to the cached access point without a scan. */
+bool provisioning_fast_connect(void);
+
 #endif //__PROVISIONING_H_
\ No newline at end of file
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "nvs.h"
+#include "wifi_cache.h"
+
+static const char *TAG = "WIFI_CACHE";
+
+#define WIFI_CACHE_KEY "ap"
+
+
+bool wifi_cache_load(wifi_cache_t *out, const uint8_t *ssid)
+{
+    nvs_handle_t h;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+
+    size_t len = sizeof(*out);
+    esp_err_t err = nvs_get_blob(h, WIFI_CACHE_KEY, out, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK || len != sizeof(*out) || out->version != WIFI_CACHE_VERSION) return false;
+    if (strncmp((const char *)out->ssid, (const char *)ssid, sizeof(out->ssid)) != 0) {
+        ESP_LOGI(TAG, "cached access point belongs to another ssid");
+        return false;
+    }
+    if (out->channel == 0 || out->channel > 14) return false;
+    return true;
+}
+
+void wifi_cache_store(const wifi_cache_t *c)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "nvs_open failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    wifi_cache_t old;
+    size_t len = sizeof(old);
+    if (nvs_get_blob(h, WIFI_CACHE_KEY, &old, &len) == ESP_OK && len == sizeof(old) && memcmp(&old, c, sizeof(old)) == 0) {
+        nvs_close(h);
+        return;
+    }
+
+    err = nvs_set_blob(h, WIFI_CACHE_KEY, c, sizeof(*c));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "store failed: %s", esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGI(TAG, "stored access point " MACSTR " on channel %u", MAC2STR(c->bssid), c->channel);
+}
+
+void wifi_cache_clear(void)
+{
+    nvs_handle_t h;
+    if (nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    nvs_erase_key(h, WIFI_CACHE_KEY);
+    nvs_commit(h);
+    nvs_close(h);
+}
@@ -0,0 +1,34 @@
+#ifndef __WIFI_CACHE_H_
+#define __WIFI_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_netif.h"
+
+/*
+ * Last good access point and ip configuration, kept in nvs so the station
+ * can associate on one channel without a scan and, if enabled, skip dhcp.
+ * Bound to the ssid it was learned with, other credentials ignore it.
+ */
+
+#define WIFI_CACHE_NAMESPACE  "wifi_cache"
+#define WIFI_CACHE_VERSION    1
+
+typedef struct {
+    uint8_t  version;
+    uint8_t  channel;
+    uint8_t  bssid[6];
+    uint8_t  ssid[32];
+    esp_netif_ip_info_t ip;     // last dhcp lease
+    esp_ip4_addr_t dns;
+} wifi_cache_t;
+
+/** True if a cache entry for this ssid exists. */
+bool wifi_cache_load(wifi_cache_t *out, const uint8_t *ssid);
+
+/** Writes the entry, flash is only touched if it differs from the stored one. */
+void wifi_cache_store(const wifi_cache_t *c);
+
+void wifi_cache_clear(void);
+
+#endif //__WIFI_CACHE_H_
@@ -6,7 +6,9 @@
    software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
    CONDITIONS OF ANY KIND, either express or implied.
 */
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <time.h>
 #include <sys/time.h>
 #include "esp_system.h"
@@ -17,6 +19,9 @@
 #include "esp_netif_sntp.h"
 #include "lwip/ip_addr.h"
 #include "esp_sntp.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "time_server.h"
 
 static const char *TAG = "TIME_SERVER";
@@ -38,35 +43,195 @@ static void print_servers(void)
     }
 }
 
-uint32_t time_server(void)
+static const char *const source_names[] = {
+    [TIME_SOURCE_NONE]     = "none",
+    [TIME_SOURCE_SNAPSHOT] = "snapshot",
+    [TIME_SOURCE_HTTP]     = "http",
+    [TIME_SOURCE_SNTP]     = "sntp",
+};
+
+#define TIME_SYNCED_BIT BIT0   // set once http or sntp has set the clock
+
+static EventGroupHandle_t s_events = NULL;
+static SemaphoreHandle_t  s_mutex = NULL;
+static time_source_t s_source = TIME_SOURCE_NONE;
+static int32_t  s_offset_ms = 0;     // reference - local clock at the last correction
+static int64_t  s_last_sync = 0;     // unix time of the last correction from http or sntp
+static uint32_t s_corrections = 0;
+
+
+static int64_t now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// days since 1970-01-01 of a civil date, proleptic gregorian
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+// call with s_mutex held
+static void book(time_source_t source, int64_t delta_us, int64_t ref_s, bool step)
+{
+    ESP_LOGI(TAG, "%s: clock off by %lld ms, %s", source_names[source], (long long)(delta_us / 1000), step ? "stepped" : "slewing");
+    int64_t ms = delta_us / 1000;
+    s_offset_ms = ms > INT32_MAX ? INT32_MAX : ms < INT32_MIN ? INT32_MIN : (int32_t)ms;
+    s_source = source;
+    s_last_sync = ref_s;
+    s_corrections++;
+    xEventGroupSetBits(s_events, TIME_SYNCED_BIT);
+}
+
+static bool needs_step(int64_t delta_us)
+{
+    // a guessed clock may be off by hours, adjtime() would take days for that
+    return s_source < TIME_SOURCE_HTTP || delta_us > TIME_SLEW_MAX_S * 1000000LL || delta_us < -TIME_SLEW_MAX_S * 1000000LL;
+}
+
+/*
+ * Sets the clock to ref_us. A large error, or a clock that never had a real
+ * reference, is stepped, anything else is slewed with adjtime() so the
+ * renderer never sees time jump. Call with s_mutex held.
+ */
+static void correct(time_source_t source, int64_t ref_us)
+{
+    int64_t delta = ref_us - now_us();
+    bool step = needs_step(delta);
+    if (step) {
+        struct timeval tv = { .tv_sec = (time_t)(ref_us / 1000000), .tv_usec = (suseconds_t)(ref_us % 1000000) };
+        settimeofday(&tv, NULL);
+    } else {
+        struct timeval tv = { .tv_sec = (time_t)(delta / 1000000), .tv_usec = (suseconds_t)(delta % 1000000) };
+        adjtime(&tv, NULL);
+    }
+    book(source, delta, ref_us / 1000000, step);
+}
+
+/*
+ * Runs in the lwip task after every sntp answer. In smooth mode sntp has just
+ * handed the whole error to adjtime(), or stepped the clock itself if the
+ * error was beyond what adjtime() accepts. Same rule as correct() on top.
+ */
+static void on_sntp_sync(struct timeval *tv)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    int64_t delta = (int64_t)time_server_slew_remaining_ms() * 1000;
+    bool step = needs_step(delta);
+    if (step && delta != 0) settimeofday(tv, NULL);
+    book(TIME_SOURCE_SNTP, delta, tv->tv_sec, step || delta == 0);
+    xSemaphoreGive(s_mutex);
+}
+
+
+void time_server_init(void)
+{
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+
+    if (s_events == NULL) s_events = xEventGroupCreate();
+    if (s_mutex == NULL) s_mutex = xSemaphoreCreateMutex();
+    configASSERT(s_events != NULL);
+    configASSERT(s_mutex != NULL);
+}
+
+void time_server_start(void)
 {
     esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(CONFIG_SNTP_TIME_SERVER);
+#if CONFIG_SNTP_TIME_SYNC_METHOD_SMOOTH
+    // slew instead of step, on_sntp_sync() steps what is too far off
+    config.smooth_sync = true;
+#endif
+    config.sync_cb = on_sntp_sync;
+    // keeps running after the first sync, the clock is corrected every period
+    sntp_set_sync_interval(TIME_SNTP_PERIOD_MS);
     esp_netif_sntp_init(&config);
-    esp_netif_sntp_start();
-    
+
     print_servers();
-    
-    int retry = 0;
-    const int retry_count = 15;
-    while (esp_netif_sntp_sync_wait(2000 / portTICK_PERIOD_MS) == ESP_ERR_TIMEOUT && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
+}
+
+bool time_server_wait_synced(TickType_t timeout)
+{
+    return (xEventGroupWaitBits(s_events, TIME_SYNCED_BIT, pdFALSE, pdTRUE, timeout) & TIME_SYNCED_BIT) != 0;
+}
+
+void time_server_seed(int64_t unix_s, time_source_t source)
+{
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    if (s_source == TIME_SOURCE_NONE && get_unix_seconds() < TIME_VALID_AFTER) {
+        struct timeval tv = { .tv_sec = (time_t)unix_s, .tv_usec = 0 };
+        settimeofday(&tv, NULL);
+        s_source = source;
+        ESP_LOGW(TAG, "clock not set, seeded with %s time %lld", source_names[source], (long long)unix_s);
     }
-    if(retry == retry_count) {
-        ESP_LOGE(TAG, "possibly no network connection as time server is not reached");
-        return 1;
+    xSemaphoreGive(s_mutex);
+}
+
+bool time_server_http_date(const char *date)
+{
+    // IMF-fixdate as required by RFC 9110: "Sun, 06 Nov 1994 08:49:37 GMT"
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4] = {0};
+    unsigned d, y, hh, mm, ss;
+    if (date == NULL || sscanf(date, "%*3s, %2u %3s %4u %2u:%2u:%2u GMT", &d, mon, &y, &hh, &mm, &ss) != 6) return false;
+    const char *m = strstr(months, mon);
+    if (m == NULL || (m - months) % 3 || d < 1 || d > 31 || hh > 23 || mm > 59 || ss > 60) return false;
+
+    int64_t unix_s = days_from_civil(y, (unsigned)(m - months) / 3 + 1, d) * 86400 + hh * 3600 + mm * 60 + ss;
+    if (unix_s < TIME_VALID_AFTER) return false;
+    // the server truncates to whole seconds, half of one is the best guess
+    int64_t ref_us = unix_s * 1000000 + 500000;
+
+    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    // only until sntp answers, after that the header is too coarse, and only
+    // if the clock is off by more than the header resolution
+    if (s_source < TIME_SOURCE_SNTP) {
+        int64_t delta = ref_us - now_us();
+        if (s_source < TIME_SOURCE_HTTP || delta > TIME_HTTP_TOLERANCE_MS * 1000LL || delta < -TIME_HTTP_TOLERANCE_MS * 1000LL) {
+            correct(TIME_SOURCE_HTTP, ref_us);
+        }
     }
+    xSemaphoreGive(s_mutex);
+    return true;
+}
 
-    struct tm t = {0};
-    int64_t now = -1;
-    time(&now);
-    localtime_r(&now, &t);
-    
-    esp_netif_sntp_deinit();
+time_source_t time_server_source(void)
+{
+    return s_source;
+}
 
-    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
-    tzset();
+const char *time_server_source_name(time_source_t source)
+{
+    return source <= TIME_SOURCE_SNTP ? source_names[source] : "?";
+}
+
+int32_t time_server_offset_ms(void)
+{
+    return s_offset_ms;
+}
 
-    return 0;
+int32_t time_server_slew_remaining_ms(void)
+{
+    struct timeval left = {0};
+    if (adjtime(NULL, &left) != 0) return 0;
+    return (int32_t)((int64_t)left.tv_sec * 1000 + left.tv_usec / 1000);
+}
+
+int64_t time_server_last_sync(void)
+{
+    return s_last_sync;
+}
+
+uint32_t time_server_corrections(void)
+{
+    return s_corrections;
 }
 
 void print_time(void)
@@ -77,7 +242,7 @@ void print_time(void)
         ESP_LOGE(TAG, "print time failed in unix_time_to_string");
     }
     ESP_LOGI(TAG, "time now = %s", buf);
-    ESP_LOGI(TAG, "unix seconds: %lld", now);
+    ESP_LOGI(TAG, "unix seconds: %lld", (long long)now);
 }
 
 int64_t get_unix_seconds(void)
@@ -156,8 +321,8 @@ const char *unix_time_to_string(int64_t ts, char *buf, uint32_t buf_size)
 {
     // Needs 20 bytes: "YYYY-MM-DD HH:MM:SS" + NUL
     if (buf == NULL || buf_size < 20) {
-        ESP_LOGE(TAG, "unix_time_to_string argument error, buff = %u, buffsize = %u",
-                 (uint32_t)buf, buf_size);
+        ESP_LOGE(TAG, "unix_time_to_string argument error, buff = %p, buffsize = %u",
+                 (void *)buf, (unsigned)buf_size);
         return NULL;
     }
 
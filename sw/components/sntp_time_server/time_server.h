@@ -1,7 +1,58 @@
 #ifndef __TIME_SERVER_H_
 #define __TIME_SERVER_H_
 
-uint32_t time_server(void);
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Wall clock service. The clock is seeded from the snapshot of a warm reset,
+ * then from the Date header of the first api response, and kept right by
+ * sntp running in the background. Once a real reference has set the clock, corrections are
+ * slewed with adjtime() instead of stepped, so trains do not jump between
+ * stations.
+ */
+
+#define TIME_VALID_AFTER        1600000000   // clock counts as set after 2020-09
+#define TIME_SNTP_PERIOD_MS     (60 * 60 * 1000)
+#define TIME_SLEW_MAX_S         60           // larger errors of an http date are stepped
+#define TIME_HTTP_TOLERANCE_MS  1500         // Date has whole seconds, smaller errors are ignored
+
+typedef enum {
+    TIME_SOURCE_NONE = 0,
+    TIME_SOURCE_SNAPSHOT,   // time of the restored snapshot, a guess
+    TIME_SOURCE_HTTP,       // Date header of an api response, +-1 s
+    TIME_SOURCE_SNTP,
+} time_source_t;
+
+/** Sets the time zone and creates the locks. Call first, api times are decoded as local time. */
+void time_server_init(void);
+
+/** Starts sntp in the background, it keeps correcting the clock every TIME_SNTP_PERIOD_MS. */
+void time_server_start(void);
+
+/** Blocks until http or sntp has set the clock, true if that happened within timeout. */
+bool time_server_wait_synced(TickType_t timeout);
+
+/** Sets the clock from a guess if nothing has set it yet. */
+void time_server_seed(int64_t unix_s, time_source_t source);
+
+/** Feeds the value of a Date response header, false if it could not be parsed. */
+bool time_server_http_date(const char *date);
+
+time_source_t time_server_source(void);
+const char *time_server_source_name(time_source_t source);
+
+/** Reference minus local clock at the last correction, in ms. */
+int32_t time_server_offset_ms(void);
+
+/** Part of the last correction adjtime() still has to apply, in ms. */
+int32_t time_server_slew_remaining_ms(void);
+
+/** Unix time of the last correction from http or sntp, 0 if none yet. */
+int64_t time_server_last_sync(void);
+uint32_t time_server_corrections(void);
+
 void print_time(void);
 int64_t parse_iso8601_to_unix(const char *timestamp_str);
 int64_t get_unix_seconds(void);
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "trace.h"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t count;     // events written since boot
+    uint16_t rec_size;
+    uint16_t n_recs;    // records following the header
+    uint32_t first;     // sequence number of the first record
+} trace_hdr_t;
+
+#if CONFIG_TRACE_ENABLE
+
+#define TRACE_MASK (CONFIG_TRACE_EVENTS - 1)
+_Static_assert((CONFIG_TRACE_EVENTS & TRACE_MASK) == 0, "CONFIG_TRACE_EVENTS must be a power of two");
+
+static trace_rec_t ring[CONFIG_TRACE_EVENTS];
+// total number of reserved slots, the slot of seq is seq & TRACE_MASK
+static uint32_t head = 0;
+
+void trace_put(uint16_t id, uint16_t a, uint32_t b, uint32_t c)
+{
+    // writers on both cores reserve distinct slots, no lock needed
+    uint32_t seq = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    trace_rec_t *r = &ring[seq & TRACE_MASK];
+    r->ts_us = (uint32_t)esp_timer_get_time();
+    r->id = id;
+    r->a = a;
+    r->b = b;
+    r->c = c;
+}
+
+uint32_t trace_count(void)
+{
+    return __atomic_load_n(&head, __ATOMIC_RELAXED);
+}
+
+bool trace_get(uint32_t seq, trace_rec_t *out)
+{
+    uint32_t h = trace_count();
+    if (seq >= h || h - seq > CONFIG_TRACE_EVENTS) return false;
+    *out = ring[seq & TRACE_MASK];
+    // a writer may have lapped us while copying
+    return trace_count() - seq <= CONFIG_TRACE_EVENTS;
+}
+
+bool trace_read(bool (*emit)(const void *data, uint32_t len, void *ctx), void *ctx)
+{
+    uint32_t h = trace_count();
+    uint32_t first = h > CONFIG_TRACE_EVENTS ? h - CONFIG_TRACE_EVENTS : 0;
+
+    trace_hdr_t hdr = {
+        .magic = TRACE_MAGIC,
+        .count = h,
+        .rec_size = sizeof(trace_rec_t),
+        .n_recs = (uint16_t)(h - first),
+        .first = first,
+    };
+    if (!emit(&hdr, sizeof(hdr), ctx)) return false;
+
+    trace_rec_t chunk[16];
+    uint32_t n = 0;
+    for (uint32_t seq = first; seq < h; seq++) {
+        // overwritten records keep their place but read as NONE
+        if (!trace_get(seq, &chunk[n])) memset(&chunk[n], 0, sizeof(chunk[n]));
+        if (++n == sizeof(chunk) / sizeof(chunk[0])) {
+            if (!emit(chunk, sizeof(chunk), ctx)) return false;
+            n = 0;
+        }
+    }
+    return n == 0 || emit(chunk, n * sizeof(trace_rec_t), ctx);
+}
+
+#else
+
+// tracing compiled out, a dump is a header without records
+uint32_t trace_count(void) { return 0; }
+bool trace_get(uint32_t seq, trace_rec_t *out) { return false; }
+bool trace_read(bool (*emit)(const void *data, uint32_t len, void *ctx), void *ctx)
+{
+    trace_hdr_t hdr = { .magic = TRACE_MAGIC, .rec_size = sizeof(trace_rec_t) };
+    return emit(&hdr, sizeof(hdr), ctx);
+}
+
+#endif
+
+static bool print_hex(const void *data, uint32_t len, void *ctx)
+{
+    const uint8_t *p = data;
+    for (uint32_t off = 0; off < len; off += 16) {
+        printf("TRC ");
+        for (uint32_t i = off; i < len && i < off + 16; i++) printf("%02x", p[i]);
+        printf("\n");
+    }
+    return true;
+}
+
+void trace_dump(void)
+{
+    (void)trace_read(print_hex, NULL);
+}
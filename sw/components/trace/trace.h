@@ -0,0 +1,78 @@
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+/*
+ * Binary event trace. A record is an event id, one 16 bit and two 32 bit
+ * arguments and a microsecond timestamp, written into a RAM ring without
+ * formatting or locking. The ring is read out raw (trace_read) or as hex
+ * lines on the console (trace_dump) and decoded by tools/trace_decode.py.
+ *
+ * Every subsystem has its own macro and Kconfig switch. A disabled macro
+ * does not evaluate its arguments and compiles to nothing.
+ */
+
+typedef enum {
+#define TRACE_EVENT(name, fmt) TRACE_EV_##name,
+#include "trace_events.h"
+#undef TRACE_EVENT
+    TRACE_EV_NUM
+} trace_event_t;
+
+typedef struct {
+    uint32_t ts_us;     // low 32 bits of esp_timer_get_time()
+    uint16_t id;
+    uint16_t a;
+    uint32_t b;
+    uint32_t c;
+} trace_rec_t;
+
+_Static_assert(sizeof(trace_rec_t) == 16, "trace_rec_t is part of the dump format");
+
+#define TRACE_MAGIC  0x31435254   // "TRC1", header of trace_read() dumps
+
+#if CONFIG_TRACE_ENABLE
+void trace_put(uint16_t id, uint16_t a, uint32_t b, uint32_t c);
+#define TRACE_IF(on, ev, a, b, c) \
+    do { if (on) trace_put(TRACE_EV_##ev, (uint16_t)(a), (uint32_t)(b), (uint32_t)(c)); } while (0)
+#else
+#define TRACE_IF(on, ev, a, b, c) do { } while (0)
+#endif
+
+#ifdef CONFIG_TRACE_TRIPRING
+#define TRACE_TRIPRING(ev, a, b, c) TRACE_IF(1, ev, a, b, c)
+#else
+#define TRACE_TRIPRING(ev, a, b, c) do { } while (0)
+#endif
+
+#ifdef CONFIG_TRACE_FETCHER
+#define TRACE_FETCHER(ev, a, b, c) TRACE_IF(1, ev, a, b, c)
+#else
+#define TRACE_FETCHER(ev, a, b, c) do { } while (0)
+#endif
+
+#ifdef CONFIG_TRACE_LED
+#define TRACE_LED(ev, a, b, c) TRACE_IF(1, ev, a, b, c)
+#else
+#define TRACE_LED(ev, a, b, c) do { } while (0)
+#endif
+
+/** Number of events written since boot, the newest one has sequence number - 1. */
+uint32_t trace_count(void);
+
+/** Copies record seq, false if it was never written or is already overwritten. */
+bool trace_get(uint32_t seq, trace_rec_t *out);
+
+/**
+ * Writes a dump (header + oldest to newest records) in pieces through emit.
+ * Returns false if emit failed.
+ */
+bool trace_read(bool (*emit)(const void *data, uint32_t len, void *ctx), void *ctx);
+
+/** Prints the ring as "TRC <hex>" lines on the console. */
+void trace_dump(void);
+
+#endif //__TRACE_H_
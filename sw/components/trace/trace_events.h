@@ -0,0 +1,21 @@
+/*
+ * Event catalogue of the binary trace. One line per event:
+ *
+ *     TRACE_EVENT(name, "format")
+ *
+ * The format is only used off-device by tools/trace_decode.py, which reads
+ * this file. %a is the 16 bit argument, %b and %c the 32 bit ones, %A %B %C
+ * print them signed. Append new events at the end, ids are positions.
+ */
+TRACE_EVENT(NONE,             "-")
+TRACE_EVENT(TR_PUT,           "tr_put trips=%a heap_free=%b largest=%c")
+TRACE_EVENT(TR_PUT_FAIL,      "tr_put alloc failed bytes=%a heap_free=%b largest=%c")
+TRACE_EVENT(TR_PUT_FULL,      "tr_put ring full trips=%a")
+TRACE_EVENT(TR_EXPIRE,        "tr_free_old expired index=%a arr_ts=%B now=%C")
+TRACE_EVENT(TR_CLEAR,         "tr_clear_all removed=%a heap_free=%b largest=%c")
+TRACE_EVENT(FETCH_LINE,       "fetch line=%a")
+TRACE_EVENT(TRIP_DECODED,     "trip decoded line=%a origin=%b dest=%c")
+TRACE_EVENT(TRIP_STOPS,       "trip direction=%A stops=%b dep_ts=%C")
+TRACE_EVENT(HEAP,             "heap min_free_kb=%a free=%b largest=%c")
+TRACE_EVENT(LED_NO_STATION,   "no nearest stop line=%a stops=%b origin=%c")
+TRACE_EVENT(LED_NO_LED,       "station without led line=%a station=%b")
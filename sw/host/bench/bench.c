@@ -0,0 +1,394 @@
+/*
+ * Replays recorded transport.rest answers through the firmware's data path
+ * and measures every stage on the host:
+ *
+ *   list      trip_decode_list() of the /trips?lineName=... answer
+ *   decode    trip_decode() of every /trips/:id answer
+ *   tripring  tr_put() + tr_free_old(), as BVG_run() does per trip
+ *   frame     led_compose(), what led_stripe_run() draws per frame
+ *
+ * A fixture is a directory with list.json, trip_*.json and meta.json, the
+ * layout tools/record_trips.py writes. The clock is set to the recording
+ * time, so the same trips are on the map as when they were recorded. Every
+ * fixture starts with a touch of its line, so the label animation is drawn
+ * over the first frames as after a selection on the board.
+ *
+ * With -u the answers come over http from a server instead, normally
+ * tools/mock_api.py, and a fetch stage is measured as well. The arguments are
+ * api line names then, the clock follows the Date headers as on the target.
+ * Failed fetches are counted but do not fail the run, the mock injects them.
+ *
+ * With -r the frames also go into a frame_rec.h log, the same bytes for the
+ * same fixtures and options; tools/render_frames.py draws it or compares two.
+ *
+ *   bvg_bench [-n passes] [-f frames] [-r frames.bin] [-v] fixture_dir...
+ *   bvg_bench -u http://127.0.0.1:8080 [-n passes] [-f frames] [-r frames.bin] [-v] line...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include "esp_log.h"
+#include "tripring.h"
+#include "mem_tier.h"
+#include "time_server.h"
+#include "line_data.h"
+#include "trip_decode.h"
+#include "led_compose.h"
+#include "led_out.h"
+#include "frame_rec.h"
+#include "esp_timer.h"
+#include "api_url.h"
+#include "http_client.h"
+#include "metrics.h"
+#include "host_clock.h"
+#include "host_mem.h"
+#include "fixture.h"
+
+#define FRAME_PERIOD_US   100000   // led_stripe_run() period
+#define RESPONSE_SIZE     (32768+16384)   // HTTP_RESPONSE_BUFFER_SIZE of requests.c
+#define URL_SIZE          399             // HTTP_URL_BUFFER_SIZE of requests.c
+
+typedef enum {
+    STAGE_FETCH = 0,
+    STAGE_LIST,
+    STAGE_DECODE,
+    STAGE_TRIPRING,
+    STAGE_FRAME,
+    STAGE_NUM
+} stage_t;
+
+static const char *const stage_names[] = {
+    [STAGE_FETCH]    = "fetch",
+    [STAGE_LIST]     = "list",
+    [STAGE_DECODE]   = "decode",
+    [STAGE_TRIPRING] = "tripring",
+    [STAGE_FRAME]    = "frame",
+};
+
+typedef struct {
+    uint32_t *ns;          // one latency per operation
+    uint32_t  n;
+    uint32_t  cap;
+    uint64_t  total_ns;
+    uint64_t  bytes;       // json bytes fetched or consumed
+    size_t    peak_heap;   // most heap one operation held on top of what was there
+    uint32_t  failed;
+} stage_stats_t;
+
+static stage_stats_t stats[STAGE_NUM];
+static size_t trip_buf[(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+static char trip_ids[FIXTURE_MAX_TRIPS][MAX_TRIP_ID_LEN];
+static led_compose_t compose;
+static line_state_t touch;     // pressed for one frame at the start of a fixture
+static frame_t frame;
+static frame_rec_t rec;
+static bool rec_failed;
+static char response[RESPONSE_SIZE + 1];
+static char url[URL_SIZE + 1];
+
+
+// start and stop of one measured operation
+typedef struct {
+    int64_t t0;
+    size_t  heap0;
+} probe_t;
+
+static void probe_start(probe_t *p)
+{
+    host_mem_reset_peak();
+    p->heap0 = host_mem_in_use();
+    p->t0 = host_clock_real_ns();
+}
+
+static void probe_stop(const probe_t *p, stage_t stage, size_t bytes, bool ok)
+{
+    int64_t ns = host_clock_real_ns() - p->t0;
+    size_t heap = host_mem_peak() - p->heap0;
+    stage_stats_t *s = &stats[stage];
+    if (s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 1024;
+        s->ns = realloc(s->ns, s->cap * sizeof(s->ns[0]));
+    }
+    s->ns[s->n++] = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+    s->total_ns += ns;
+    s->bytes += bytes;
+    if (heap > s->peak_heap) s->peak_heap = heap;
+    if (!ok) s->failed++;
+}
+
+
+// decode, store and draw one trip answer, frames_per_trip frames of 100 ms
+static uint32_t process_trip(const char *json, size_t len, uint32_t frames_per_trip)
+{
+    Trip *trip = (Trip *)trip_buf;
+    probe_t p;
+    uint32_t lit = 0;
+
+    probe_start(&p);
+    bool ok = trip_decode(json, trip);
+    probe_stop(&p, STAGE_DECODE, len, ok);
+    if (!ok) return 0;
+
+    probe_start(&p);
+    tr_take();
+    tr_put(trip);
+    tr_free_old(get_unix_seconds());
+    tr_release();
+    probe_stop(&p, STAGE_TRIPRING, 0, true);
+
+    for (uint32_t k = 0; k < frames_per_trip; k++) {
+        probe_start(&p);
+        bool any = led_compose(&compose, &frame, anim_now_ms(), get_unix_seconds(), &touch);
+        probe_stop(&p, STAGE_FRAME, 0, true);
+        touch.pressed = false;
+        led_out_flush(&frame, esp_timer_get_time());
+        if (any) lit++;
+        host_clock_advance_us(FRAME_PERIOD_US);
+    }
+    return lit;
+}
+
+
+static bool rec_write(const void *data, uint32_t len, void *ctx)
+{
+    return fwrite(data, 1, len, (FILE *)ctx) == len;
+}
+
+// led_out sink of -r
+static void rec_sink(const frame_t *f, int64_t t_us, void *ctx)
+{
+    if (!frame_rec_add(&rec, f, t_us)) rec_failed = true;
+}
+
+// the selection of a line by its name, nothing pressed for unknown names
+static void touch_line(const char *name)
+{
+    touch.pressed = false;
+    for (uint32_t i = 0; i < line_data_number_of_lines(); i++) {
+        if (strcmp(leds[i].name, name) == 0) {
+            touch.line = (int8_t)i;
+            touch.pressed = true;
+            return;
+        }
+    }
+}
+
+
+// one pass over a fixture: what BVG_run() does per line, plus frames in between
+static uint32_t replay(const fixture_t *fx, uint32_t frames_per_trip)
+{
+    probe_t p;
+    uint32_t lit = 0;
+
+    host_clock_set_us(fx->now * 1000000);
+
+    probe_start(&p);
+    int n_ids = trip_decode_list(fx->list.data, trip_ids, FIXTURE_MAX_TRIPS);
+    probe_stop(&p, STAGE_LIST, fx->list.len, n_ids > 0);
+
+    for (uint32_t i = 0; i < fx->n_trips; i++) {
+        lit += process_trip(fx->trips[i].data, fx->trips[i].len, frames_per_trip);
+    }
+    return lit;
+}
+
+
+static const char *operator_of(const char *line)
+{
+    return line[0] == 'S' ? "S-Bahn Berlin GmbH" : "Berliner Verkehrsbetriebe";
+}
+
+static bool fetch_probed(void)
+{
+    probe_t p;
+    probe_start(&p);
+    bool ok = fetch_data(url, response, RESPONSE_SIZE);
+    probe_stop(&p, STAGE_FETCH, ok ? strlen(response) : 0, ok);
+    return ok;
+}
+
+// one pass over a line served over http, the same order as BVG_run()
+static uint32_t replay_http(const char *line, uint32_t frames_per_trip)
+{
+    probe_t p;
+    uint32_t lit = 0;
+
+    api_line_url(line, operator_of(line), url, sizeof(url));
+    if (!fetch_probed()) return 0;
+
+    probe_start(&p);
+    int n_ids = trip_decode_list(response, trip_ids, FIXTURE_MAX_TRIPS);
+    probe_stop(&p, STAGE_LIST, strlen(response), n_ids >= 0);
+
+    for (int i = 0; i < n_ids; i++) {
+        api_trip_url(trip_ids[i], url, sizeof(url));
+        if (!fetch_probed()) continue;
+        lit += process_trip(response, strlen(response), frames_per_trip);
+    }
+    return lit;
+}
+
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct_us(const stage_stats_t *s, uint32_t pct)
+{
+    if (s->n == 0) return 0;
+    uint32_t i = (uint32_t)(((uint64_t)s->n * pct + 99) / 100);
+    if (i > 0) i--;
+    return s->ns[i] / 1000.0;
+}
+
+static void report(void)
+{
+    printf("%-9s %8s %6s %10s %8s %8s %8s %8s %8s %9s\n",
+           "stage", "ops", "fail", "ops/s", "MB/s", "p50 us", "p90 us", "p99 us", "max us", "heap");
+    for (int i = 0; i < STAGE_NUM; i++) {
+        stage_stats_t *s = &stats[i];
+        if (s->n == 0) continue;
+        qsort(s->ns, s->n, sizeof(s->ns[0]), cmp_u32);
+        double secs = s->total_ns / 1e9;
+        char mbs[16] = "-";
+        if (s->bytes && secs > 0) snprintf(mbs, sizeof(mbs), "%.2f", s->bytes / secs / 1e6);
+        printf("%-9s %8u %6u %10.0f %8s %8.1f %8.1f %8.1f %8.1f %9zu\n",
+               stage_names[i], s->n, s->failed, secs > 0 ? s->n / secs : 0, mbs,
+               pct_us(s, 50), pct_us(s, 90), pct_us(s, 99), s->ns[s->n - 1] / 1000.0,
+               s->peak_heap);
+    }
+    printf("tripring: %u trips, private heap %u bytes free at least, %u allocations on the host heap\n",
+           tr_get_size(), metric_get(METRIC_TR_HEAP_MIN_FREE), (unsigned)host_mem_allocs());
+}
+
+
+static int bench_http(const char *base, char **lines, uint32_t n_lines, uint32_t passes, uint32_t frames)
+{
+    if (!api_set_base_url(base)) {
+        fprintf(stderr, "base url too long: %s\n", base);
+        return 2;
+    }
+    mem_tier_init();
+    time_server_init();
+    line_data_init();
+    tr_init();
+
+    uint32_t lit = 0;
+    for (uint32_t i = 0; i < n_lines; i++) {
+        tr_take();
+        tr_clear_all();
+        tr_release();
+        touch_line(lines[i]);
+        uint32_t lit_line = 0;
+        for (uint32_t k = 0; k < passes; k++) lit_line += replay_http(lines[i], frames);
+        printf("%s: %u frames with a train\n", lines[i], lit_line);
+        lit += lit_line;
+    }
+    report();
+
+    // the fetch stage may fail, the mock injects faults; what arrived must decode
+    uint32_t failed = stats[STAGE_LIST].failed + stats[STAGE_DECODE].failed;
+    if (failed || stats[STAGE_FETCH].n == stats[STAGE_FETCH].failed || (frames && lit == 0)) {
+        fprintf(stderr, "%u failed decodes, %u of %u fetches failed, %u frames with a train\n",
+                failed, stats[STAGE_FETCH].failed, stats[STAGE_FETCH].n, lit);
+        return 1;
+    }
+    return 0;
+}
+
+
+static int bench_fixtures(char **dirs, uint32_t n_fx, uint32_t passes, uint32_t frames)
+{
+    fixture_t *fx = calloc(n_fx, sizeof(fixture_t));
+    for (uint32_t i = 0; i < n_fx; i++) {
+        if (!load_fixture(dirs[i], &fx[i])) return 1;
+    }
+
+    mem_tier_init();
+    time_server_init();
+    line_data_init();
+    tr_init();
+
+    // every fixture is a line selection of its own, as after a touch
+    uint32_t lit = 0;
+    for (uint32_t i = 0; i < n_fx; i++) {
+        tr_take();
+        tr_clear_all();
+        tr_release();
+        touch_line(fx[i].line);
+        uint32_t lit_fx = 0;
+        for (uint32_t k = 0; k < passes; k++) lit_fx += replay(&fx[i], frames);
+        printf("%s: %u trips, %u of %u frames with a train\n", fx[i].path, fx[i].n_trips, lit_fx, passes * fx[i].n_trips * frames);
+        lit += lit_fx;
+    }
+    report();
+
+    // usable as a smoke test: everything decodes and something is drawn
+    uint32_t failed = 0;
+    for (int i = 0; i < STAGE_NUM; i++) failed += stats[i].failed;
+    if (failed || (frames && lit == 0)) {
+        fprintf(stderr, "%u failed operations, %u frames with a train\n", failed, lit);
+        return 1;
+    }
+    return 0;
+}
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-n passes] [-f frames per trip] [-r frames.bin] [-v] fixture_dir...\n"
+                    "       %s -u base_url [-n passes] [-f frames per trip] [-r frames.bin] [-v] line...\n", prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t passes = 20;
+    uint32_t frames = 10;
+    const char *base = NULL;
+    const char *rec_path = NULL;
+    int opt;
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    while ((opt = getopt(argc, argv, "n:f:u:r:v")) != -1) {
+        switch (opt) {
+        case 'u': base = optarg; break;
+        case 'n': passes = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'f': frames = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': rec_path = optarg; break;
+        case 'v': esp_log_level_set("*", ESP_LOG_INFO); break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || passes == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    led_compose_init(&compose);
+    FILE *rec_file = NULL;
+    if (rec_path) {
+        rec_file = fopen(rec_path, "wb");
+        if (rec_file == NULL) {
+            perror(rec_path);
+            return 1;
+        }
+        frame_rec_init(&rec, rec_write, rec_file);
+        led_out_add(rec_sink, NULL);
+    }
+
+    int ret = base ? bench_http(base, argv + optind, argc - optind, passes, frames)
+                   : bench_fixtures(argv + optind, argc - optind, passes, frames);
+
+    if (rec_file) {
+        if (fclose(rec_file) != 0 || rec_failed) {
+            fprintf(stderr, "%s: frames not written\n", rec_path);
+            return 1;
+        }
+        printf("%u frames recorded into %s\n", rec.frames, rec_path);
+    }
+    return ret;
+}
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include "json_parser.h"
+#include "time_server.h"
+#include "fixture.h"
+
+
+static bool read_file(const char *path, blob_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return false;
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out->data = malloc(len + 1);
+    out->len = fread(out->data, 1, len, f);
+    out->data[out->len] = 0;
+    fclose(f);
+    return out->len == (size_t)len;
+}
+
+static int by_name(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+bool load_fixture(const char *dir, fixture_t *fx)
+{
+    char path[1024];
+    memset(fx, 0, sizeof(*fx));
+    snprintf(fx->path, sizeof(fx->path), "%s", dir);
+
+    snprintf(path, sizeof(path), "%s/list.json", dir);
+    if (!read_file(path, &fx->list)) {
+        fprintf(stderr, "%s: no list.json\n", dir);
+        return false;
+    }
+
+    blob_t meta;
+    snprintf(path, sizeof(path), "%s/meta.json", dir);
+    if (!read_file(path, &meta)) {
+        fprintf(stderr, "%s: no meta.json\n", dir);
+        return false;
+    }
+    jparse_ctx_t jctx;
+    int64_t now = 0;
+    if (json_parse_start(&jctx, meta.data, meta.len) == 0) {
+        (void)json_obj_get_int64(&jctx, "now", &now);
+        (void)json_obj_get_string(&jctx, "line", fx->line, sizeof(fx->line));
+        json_parse_end(&jctx);
+    }
+    free(meta.data);
+    if (now < TIME_VALID_AFTER) {
+        fprintf(stderr, "%s: meta.json without a valid \"now\"\n", dir);
+        return false;
+    }
+    fx->now = now;
+
+    DIR *d = opendir(dir);
+    if (d == NULL) return false;
+    char *names[FIXTURE_MAX_TRIPS];
+    uint32_t n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL && n < FIXTURE_MAX_TRIPS) {
+        if (strncmp(e->d_name, "trip_", 5) == 0 && strstr(e->d_name, ".json")) names[n++] = strdup(e->d_name);
+    }
+    closedir(d);
+    qsort(names, n, sizeof(names[0]), by_name);
+
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+        if (read_file(path, &fx->trips[fx->n_trips])) fx->n_trips++;
+        free(names[i]);
+    }
+    return fx->n_trips > 0;
+}
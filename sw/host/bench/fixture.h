@@ -0,0 +1,32 @@
+#ifndef __FIXTURE_H_
+#define __FIXTURE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A recorded line as tools/record_trips.py writes it: list.json, the
+ * trip_NN.json answers in list order and meta.json with the recording time.
+ */
+
+#define FIXTURE_MAX_TRIPS 64
+
+typedef struct {
+    char  *data;
+    size_t len;
+} blob_t;
+
+typedef struct {
+    char     path[512];
+    blob_t   list;
+    blob_t   trips[FIXTURE_MAX_TRIPS];
+    uint32_t n_trips;
+    int64_t  now;          // recording time, unix seconds
+    char     line[8];      // line name, "" in fixtures without one
+} fixture_t;
+
+/** Loads all files of dir into fx, false with a message if one is missing. */
+bool load_fixture(const char *dir, fixture_t *fx);
+
+#endif //__FIXTURE_H_
@@ -0,0 +1,515 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "esp_log.h"
+#include "tripring.h"
+#include "trip_decode.h"
+#include "line_data.h"
+#include "api_url.h"
+#include "api_backend.h"
+#include "http_client.h"
+#include "time_server.h"
+#include "host_clock.h"
+#include "trip_wire.h"
+#include "feed.h"
+
+#define FEED_RESPONSE_SIZE  (256 * 1024)   // busy lines list more than the 48 KB a board takes
+#define FEED_URL_SIZE       399            // HTTP_URL_BUFFER_SIZE of requests.c
+#define FEED_API_LINES_MAX  64
+#define FEED_LINE_TOKENS    4
+
+static const char *TAG = "FEED";
+
+typedef struct {
+    char     name[8];          // "S41"
+    uint16_t map_line;         // first map line with it, for the operator
+    int64_t  listed;           // unix s of the last list, 0 never
+    int64_t  wanted;           // unix s a board last asked for a map line with it
+} api_line_t;
+
+typedef struct {
+    uint8_t n;
+    uint8_t api[FEED_LINE_TOKENS];
+} map_line_t;
+
+typedef struct {
+    char     id[MAX_TRIP_ID_LEN];
+    Trip    *trip;             // last answer, NULL until the first
+    uint8_t  api_line;
+    uint32_t seen_pass;        // last pass whose list had it
+    int64_t  fetched;          // unix s of the last answer, 0 never
+    uint32_t version;          // seq at which the answer last changed
+} feed_trip_t;
+
+// a trip boards may have that is gone, for the deltas
+typedef struct {
+    char     id[MAX_TRIP_ID_LEN];
+    uint8_t  api_line;
+    uint32_t seq;
+} tombstone_t;
+
+static feed_config_t config;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static api_line_t api_lines[FEED_API_LINES_MAX];
+static uint32_t n_api_lines;
+static map_line_t *map_lines;
+static uint32_t n_map_lines;
+
+// only the poller changes the table, it reads without the lock and writes with it
+static feed_trip_t *table;
+static uint32_t n_table;
+static uint32_t pass;
+static feed_stats_t stats;
+
+// every change of the table counts up seq; a delta since a seq before
+// tomb_floor cannot be told any more, its removals were overwritten
+static uint32_t epoch;
+static uint32_t seq;
+static tombstone_t tombs[FEED_TOMBSTONES];
+static uint32_t n_tombs;       // written so far, the ring index is n_tombs % FEED_TOMBSTONES
+static uint32_t tomb_floor;
+
+static char *response;
+static char url[FEED_URL_SIZE + 1];
+static char (*ids)[MAX_TRIP_ID_LEN];
+static size_t trip_buf[(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+static int64_t next_request_us;
+
+
+static int api_line_index(const char *name, int len, uint16_t map_line)
+{
+    for (uint32_t i = 0; i < n_api_lines; i++) {
+        if ((int)strlen(api_lines[i].name) == len && strncmp(api_lines[i].name, name, len) == 0) return (int)i;
+    }
+    if (n_api_lines >= FEED_API_LINES_MAX || len >= (int)sizeof(api_lines[0].name)) return -1;
+    api_line_t *a = &api_lines[n_api_lines];
+    memcpy(a->name, name, len);
+    a->name[len] = 0;
+    a->map_line = map_line;
+    return (int)n_api_lines++;
+}
+
+void feed_init(const feed_config_t *cfg)
+{
+    config = *cfg;
+    if (config.requests_per_min == 0) config.requests_per_min = 1;
+    // deltas of an earlier run of the proxy do not apply
+    epoch = (uint32_t)get_unix_seconds();
+
+    n_map_lines = line_data_number_of_lines();
+    map_lines = calloc(n_map_lines, sizeof(map_lines[0]));
+    table = calloc(FEED_MAX_TRIPS, sizeof(table[0]));
+    ids = calloc(FEED_LIST_MAX, sizeof(ids[0]));
+    response = malloc(FEED_RESPONSE_SIZE + 1);
+    if (map_lines == NULL || table == NULL || ids == NULL || response == NULL) abort();
+
+    // the api lines of a map line, split as fetching_line_name() in requests.c does
+    for (uint32_t l = 0; l < n_map_lines; l++) {
+        const char *name = leds[l].name;
+        size_t name_len = strnlen(name, sizeof(leds[l].name));
+        for (size_t p = 0; p < name_len && map_lines[l].n < FEED_LINE_TOKENS;) {
+            size_t start = p++;
+            while (p < name_len && isdigit((unsigned char)name[p])) p++;
+            int a = api_line_index(name + start, (int)(p - start), (uint16_t)l);
+            if (a < 0) {
+                ESP_LOGW(TAG, "no room for the api lines of %.7s", name);
+                break;
+            }
+            map_lines[l].api[map_lines[l].n++] = (uint8_t)a;
+        }
+    }
+    ESP_LOGI(TAG, "%u map lines, %u api lines", (unsigned)n_map_lines, (unsigned)n_api_lines);
+}
+
+
+// fetch_data() within the request budget
+static bool fetch_paced(const char *u)
+{
+    int64_t interval = 60000000LL / config.requests_per_min;
+    int64_t now = host_clock_uptime_us();
+    if (now < next_request_us) {
+        usleep((useconds_t)(next_request_us - now));
+        now = next_request_us;
+    }
+    next_request_us = now + interval;
+
+    bool ok = fetch_data(u, response, FEED_RESPONSE_SIZE);
+    api_backend_report(ok, (uint32_t)(host_clock_uptime_us() - now));
+    pthread_mutex_lock(&lock);
+    stats.requests++;
+    if (!ok) stats.failures++;
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
+
+static feed_trip_t *find_trip(const char *id)
+{
+    for (uint32_t i = 0; i < n_table; i++) {
+        if (strcmp(table[i].id, id) == 0) return &table[i];
+    }
+    return NULL;
+}
+
+// under the lock; the last entry takes the place of the removed one
+static void drop_trip(uint32_t i)
+{
+    if (table[i].trip) {
+        stats.trips--;
+        tombstone_t *tomb = &tombs[n_tombs % FEED_TOMBSTONES];
+        if (n_tombs >= FEED_TOMBSTONES) tomb_floor = tomb->seq;
+        memcpy(tomb->id, table[i].id, MAX_TRIP_ID_LEN);
+        tomb->api_line = table[i].api_line;
+        tomb->seq = ++seq;
+        n_tombs++;
+    }
+    free(table[i].trip);
+    table[i] = table[--n_table];
+    memset(&table[n_table], 0, sizeof(table[0]));
+}
+
+static void list_api_line(uint32_t a)
+{
+    api_line_t *al = &api_lines[a];
+    api_line_url(al->name, line_data_operator(al->map_line), url, sizeof(url));
+    if (!fetch_paced(url)) return;
+    int n = trip_decode_list(response, ids, FEED_LIST_MAX);
+
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < n; i++) {
+        feed_trip_t *t = find_trip(ids[i]);
+        if (t == NULL) {
+            if (n_table >= FEED_MAX_TRIPS) {
+                stats.dropped++;
+                continue;
+            }
+            t = &table[n_table++];
+            memcpy(t->id, ids[i], MAX_TRIP_ID_LEN);
+            t->api_line = (uint8_t)a;
+        }
+        t->seen_pass = pass;
+    }
+    // what the list no longer has has ended or was cancelled
+    for (uint32_t i = 0; i < n_table;) {
+        if (table[i].api_line == a && table[i].seen_pass != pass) drop_trip(i);
+        else i++;
+    }
+    al->listed = get_unix_seconds();
+    pthread_mutex_unlock(&lock);
+}
+
+
+// trips of watched lines first, among them those never fetched, then the oldest answers
+static int64_t sort_now;
+
+static int due_rank(const feed_trip_t *t)
+{
+    bool watched = sort_now - api_lines[t->api_line].wanted < FEED_WANTED_S;
+    return (watched ? 0 : 2) + (t->trip ? 1 : 0);
+}
+
+static int cmp_due(const void *a, const void *b)
+{
+    const feed_trip_t *x = &table[*(const uint16_t *)a];
+    const feed_trip_t *y = &table[*(const uint16_t *)b];
+    int rx = due_rank(x), ry = due_rank(y);
+    if (rx != ry) return rx - ry;
+    return x->fetched < y->fetched ? -1 : x->fetched > y->fetched;
+}
+
+// field by field, Trip and Stopover have padding
+static bool same_trip(const Trip *a, const Trip *b)
+{
+    if (strncmp(a->trip_id, b->trip_id, sizeof(a->trip_id)) != 0 ||
+        a->origin_station_id != b->origin_station_id || a->dest_station_id != b->dest_station_id ||
+        a->direction != b->direction || a->dep_ts != b->dep_ts || a->arr_ts != b->arr_ts ||
+        a->line_code != b->line_code || a->num_stops != b->num_stops || a->flags != b->flags) {
+        return false;
+    }
+    for (uint16_t i = 0; i < a->num_stops; i++) {
+        if (a->stops[i].station_id != b->stops[i].station_id || a->stops[i].arr_ts != b->stops[i].arr_ts ||
+            a->stops[i].dep_ts != b->stops[i].dep_ts) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void fetch_trip(feed_trip_t *t)
+{
+    Trip *trip = (Trip *)trip_buf;
+    api_trip_url(t->id, url, sizeof(url));
+    if (!fetch_paced(url)) return;
+
+    bool ok = trip_decode(response, trip);
+    Trip *copy = NULL;
+    if (ok) {
+        size_t size = sizeof(Trip) + trip->num_stops * sizeof(Stopover);
+        copy = malloc(size);
+        if (copy) memcpy(copy, trip, size);
+    }
+
+    pthread_mutex_lock(&lock);
+    // a failed decode waits for the next refresh like an answer would
+    t->fetched = get_unix_seconds();
+    if (copy) {
+        if (t->trip == NULL) stats.trips++;
+        if (t->trip == NULL || !same_trip(t->trip, copy)) t->version = ++seq;
+        free(t->trip);
+        t->trip = copy;
+    } else {
+        stats.decode_failures++;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void feed_pass(void)
+{
+    pass++;
+    // a due probe lists one line and is thrown away, the pass goes to one upstream
+    if (n_api_lines && api_backend_probe()) {
+        api_line_url(api_lines[0].name, line_data_operator(api_lines[0].map_line), url, sizeof(url));
+        fetch_paced(url);
+    }
+    api_backend_pick();
+    for (uint32_t a = 0; a < n_api_lines; a++) list_api_line(a);
+
+    static uint16_t due[FEED_MAX_TRIPS];
+    uint32_t n_due = 0;
+    int64_t now = get_unix_seconds();
+    pthread_mutex_lock(&lock);
+    for (uint32_t i = 0; i < n_table; i++) {
+        // the ids of a list that failed may be another upstream's, they wait for the next list
+        if (table[i].seen_pass != pass) continue;
+        if (table[i].fetched == 0 || now - table[i].fetched >= (int64_t)config.refresh_s) due[n_due++] = (uint16_t)i;
+    }
+    sort_now = now;
+    qsort(due, n_due, sizeof(due[0]), cmp_due);
+    pthread_mutex_unlock(&lock);
+
+    // at most a minute of the budget, so the lists are fresh again after it
+    uint32_t n_fetch = n_due < config.requests_per_min ? n_due : config.requests_per_min;
+    for (uint32_t i = 0; i < n_fetch; i++) fetch_trip(&table[due[i]]);
+
+    now = get_unix_seconds();
+    pthread_mutex_lock(&lock);
+    for (uint32_t i = 0; i < n_table;) {
+        const Trip *t = table[i].trip;
+        if (t && t->arr_ts && t->arr_ts < now - FEED_GRACE_S) drop_trip(i);
+        else i++;
+    }
+    stats.listed = n_table;
+    stats.passes++;
+    pthread_mutex_unlock(&lock);
+    ESP_LOGI(TAG, "pass %u: %u trips listed, %u fetched of %u due", (unsigned)pass, (unsigned)n_table,
+             (unsigned)n_fetch, (unsigned)n_due);
+}
+
+
+// under the lock: does the view of line l have trip t
+static bool in_view(const map_line_t *ml, const feed_trip_t *t, int64_t now)
+{
+    if (t->trip == NULL) return false;
+    if (t->trip->arr_ts && t->trip->arr_ts < now - FEED_GRACE_S) return false;
+    for (int k = 0; k < ml->n; k++) {
+        if (ml->api[k] == t->api_line) return true;
+    }
+    return false;
+}
+
+// under the lock: false while one of the api lines of l was never listed
+static bool line_ready(const map_line_t *ml)
+{
+    for (int k = 0; k < ml->n; k++) {
+        if (api_lines[ml->api[k]].listed == 0) return false;
+    }
+    return ml->n > 0;
+}
+
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t len;
+    bool   full;
+} out_t;
+
+static void out(out_t *o, const char *fmt, ...)
+{
+    if (o->full) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->buf + o->len, o->size - o->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= o->size - o->len) o->full = true;
+    else o->len += n;
+}
+
+// trip ids are "1|64231|42|86|21092025", quotes and backslashes are escaped anyway
+static void out_string(out_t *o, const char *s)
+{
+    out(o, "\"");
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') out(o, "\\%c", *s);
+        else if ((unsigned char)*s >= 0x20) out(o, "%c", *s);
+    }
+    out(o, "\"");
+}
+
+static void out_trip(out_t *o, const feed_trip_t *ft, int64_t now)
+{
+    const Trip *t = ft->trip;
+    // the last stop passed, the nearest stop of led_map_build() is never before it
+    uint16_t first = 0;
+    for (uint16_t i = 0; i < t->num_stops; i++) {
+        int64_t st = t->stops[i].arr_ts ? t->stops[i].arr_ts : t->stops[i].dep_ts;
+        if (st && st <= now) first = i;
+    }
+
+    out(o, "{\"id\":");
+    out_string(o, ft->id);
+    out(o, ",\"line\":\"%s\",\"dir\":%d,\"from\":%u,\"to\":%u,\"dep\":%lld,\"arr\":%lld,\"stops\":[",
+        api_lines[ft->api_line].name, (int)t->direction, (unsigned)t->origin_station_id,
+        (unsigned)t->dest_station_id, (long long)t->dep_ts, (long long)t->arr_ts);
+    for (uint16_t i = first; i < t->num_stops; i++) {
+        const Stopover *s = &t->stops[i];
+        out(o, "%s[%u,%lld,%lld]", i > first ? "," : "", (unsigned)s->station_id,
+            (long long)s->arr_ts, (long long)s->dep_ts);
+    }
+    out(o, "]}");
+}
+
+int feed_view_json(int line, uint32_t max_trips, char *buf, size_t size)
+{
+    if (line < 0 || (uint32_t)line >= n_map_lines || size == 0) return -1;
+    const map_line_t *ml = &map_lines[line];
+    int64_t now = get_unix_seconds();
+    out_t o = { .buf = buf, .size = size };
+
+    pthread_mutex_lock(&lock);
+    for (int k = 0; k < ml->n; k++) api_lines[ml->api[k]].wanted = now;
+    if (!line_ready(ml)) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    stats.views++;
+    out(&o, "{\"line\":\"%.7s\",\"now\":%lld,\"trips\":[", leds[line].name, (long long)now);
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < n_table && n < max_trips; i++) {
+        if (!in_view(ml, &table[i], now)) continue;
+        if (n++) out(&o, ",");
+        out_trip(&o, &table[i], now);
+    }
+    out(&o, "]}");
+    pthread_mutex_unlock(&lock);
+    return o.full ? -1 : (int)o.len;
+}
+
+uint32_t feed_view_trips(int line)
+{
+    if (line < 0 || (uint32_t)line >= n_map_lines) return 0;
+    int64_t now = get_unix_seconds();
+    uint32_t n = 0;
+    pthread_mutex_lock(&lock);
+    for (uint32_t i = 0; i < n_table; i++) n += in_view(&map_lines[line], &table[i], now);
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+uint32_t feed_seq(void)
+{
+    pthread_mutex_lock(&lock);
+    uint32_t s = seq;
+    pthread_mutex_unlock(&lock);
+    return s;
+}
+
+void feed_get_stats(feed_stats_t *o)
+{
+    pthread_mutex_lock(&lock);
+    *o = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+
+// under the lock: can a delta since `since` of `e` be told
+static bool delta_possible(uint32_t e, uint32_t since)
+{
+    return e == epoch && since > 0 && since >= tomb_floor && since <= seq;
+}
+
+int feed_view_wire(int line, uint32_t max_trips, uint32_t e, uint32_t since, uint8_t *buf, size_t size)
+{
+    if (line < 0 || (uint32_t)line >= n_map_lines) return -1;
+    const map_line_t *ml = &map_lines[line];
+    int64_t now = get_unix_seconds();
+    trip_wire_writer_t w;
+
+    pthread_mutex_lock(&lock);
+    for (int k = 0; k < ml->n; k++) api_lines[ml->api[k]].wanted = now;
+    if (!line_ready(ml)) {
+        pthread_mutex_unlock(&lock);
+        return 0;
+    }
+    stats.views++;
+
+    bool delta = delta_possible(e, since);
+    if (delta) {
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < n_table; i++) {
+            changed += in_view(ml, &table[i], now) && table[i].version > since;
+        }
+        delta = changed <= max_trips;
+    }
+
+    uint32_t n = 0;
+    bool capped = false;
+    if (delta) {
+        trip_wire_begin(&w, buf, size, TRIP_WIRE_DELTA, epoch, since, seq, now);
+        uint32_t kept = n_tombs < FEED_TOMBSTONES ? n_tombs : FEED_TOMBSTONES;
+        for (uint32_t k = 0; k < kept; k++) {
+            const tombstone_t *tomb = &tombs[k];
+            if (tomb->seq <= since) continue;
+            for (int a = 0; a < ml->n; a++) {
+                if (ml->api[a] == tomb->api_line) trip_wire_del(&w, tomb->id);
+            }
+        }
+    } else {
+        trip_wire_begin(&w, buf, size, TRIP_WIRE_SNAPSHOT, epoch, 0, seq, now);
+    }
+    for (uint32_t i = 0; i < n_table; i++) {
+        if (!in_view(ml, &table[i], now) || (delta && table[i].version <= since)) continue;
+        if (n == max_trips) {
+            capped = true;
+            break;
+        }
+        if (trip_wire_put(&w, table[i].trip)) n++;
+        else if (w.full) break;
+    }
+    bool full = w.full;
+    pthread_mutex_unlock(&lock);
+
+    if (full) return -1;
+    size_t len = trip_wire_end(&w);
+    // a board with part of the line asks for a snapshot again next time
+    if (capped) {
+        trip_wire_hdr_t h;
+        memcpy(&h, buf, sizeof(h));
+        h.seq = 0;
+        memcpy(buf, &h, sizeof(h));
+    }
+    return (int)len;
+}
+
+bool feed_has_trip(const Trip *t)
+{
+    bool same = false;
+    pthread_mutex_lock(&lock);
+    const feed_trip_t *ft = find_trip(t->trip_id);
+    if (ft && ft->trip) same = same_trip(ft->trip, t);
+    pthread_mutex_unlock(&lock);
+    return same;
+}
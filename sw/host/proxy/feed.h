@@ -0,0 +1,90 @@
+#ifndef __FEED_H_
+#define __FEED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "tripring.h"
+
+/*
+ * Full-network trip state of bvg_proxy. One poller sends the requests of
+ * BVG_run() for every line of the topology, the running trips of a line and
+ * then every trip, but once for all boards instead of once per board. It
+ * keeps to a request budget and fetches a trip again only when its answer
+ * is older than refresh_s; trips of lines that boards asked for within
+ * FEED_WANTED_S go first.
+ *
+ * The boards get a reduced view of a map line, see feed_view_json(). Map
+ * lines standing for several api lines ("S41S42") are served from the
+ * trips of each, which are fetched once even if several map lines show them.
+ */
+
+#define FEED_MAX_TRIPS     2048   // trips of the whole network
+#define FEED_LIST_MAX      256    // ids taken from one line list
+#define FEED_WANTED_S      300    // a line counts as watched this long after a board asked for it
+#define FEED_GRACE_S       60     // trips stay in the view this long after their last arrival
+#define FEED_TOMBSTONES    1024   // removed trips remembered for the deltas of the binary view
+
+typedef struct {
+    uint32_t requests_per_min;  // upstream budget
+    uint32_t refresh_s;         // age at which a trip is fetched again
+} feed_config_t;
+
+typedef struct {
+    uint32_t passes;            // complete passes over all lines
+    uint32_t requests;
+    uint32_t failures;          // failed upstream requests
+    uint32_t decode_failures;
+    uint32_t dropped;           // listed trips not taken, the table was full
+    uint32_t trips;             // trips with an answer
+    uint32_t listed;            // trips known from the line lists
+    uint32_t views;             // views served
+} feed_stats_t;
+
+/** Sets up the tables for the topology line_data_init() loaded. */
+void feed_init(const feed_config_t *cfg);
+
+/**
+ * One pass: the list of every api line, then the trips due for a fetch,
+ * at most one minute of the budget. Blocks while it keeps to the budget.
+ */
+void feed_pass(void);
+
+/**
+ * View of map line `line` for a board, at most max_trips trips:
+ *
+ *   {"line":"S41S42","now":1792405800,"trips":[{"id":"1|...","line":"S41",
+ *    "dir":1,"from":900058101,"to":900058101,"dep":1792403400,
+ *    "arr":1792407600,"stops":[[900058100,1792405740,1792405800],...]}]}
+ *
+ * Stops are [VBB station id, arrival, departure] in unix seconds, 0 where
+ * the api has none. Stops before the last one passed are left out, they
+ * can no longer be the nearest stop of led_map_build(). Marks the line as
+ * watched. Returns the length, 0 if the line has not been listed yet, -1
+ * if the view does not fit into size.
+ */
+int feed_view_json(int line, uint32_t max_trips, char *buf, size_t size);
+
+/**
+ * Binary view of map line `line` (trip_wire.h): a delta against the state
+ * `since` of `epoch` if the feed still knows what changed since then, else
+ * a snapshot. Trips go whole, not cut at the last stop passed as in the json
+ * view, so one changes only when its answer does. A snapshot cut at
+ * max_trips has seq 0, the board asks for a snapshot again with it. Marks
+ * the line as watched. Returns the length, 0 if the line has not been
+ * listed yet, -1 if the view does not fit into size.
+ */
+int feed_view_wire(int line, uint32_t max_trips, uint32_t epoch, uint32_t since, uint8_t *buf, size_t size);
+
+/** State number of the binary views, it counts up with every change of a trip. */
+uint32_t feed_seq(void);
+
+/** Trips the view of a line has now, for bvg_proxy --check. */
+uint32_t feed_view_trips(int line);
+
+/** True if the feed has a trip like t, all fields and stops the same; for --check. */
+bool feed_has_trip(const Trip *t);
+
+void feed_get_stats(feed_stats_t *out);
+
+#endif //__FEED_H_
@@ -0,0 +1,619 @@
+/*
+ * bvg_proxy: polls transport.rest once for a fleet of boards and serves each
+ * a reduced view of its line (see feed.h), built from the firmware's
+ * decoder, url builder and http client on the host shims. Boards built with
+ * CONFIG_BVG_DATA_SOURCE_PROXY ask it with one request per pass:
+ *
+ *   GET /v1/lines/<map line>?max=N   json view of a line, 503 until it was listed
+ *   GET /v2/lines/<map line>?max=N&epoch=E&since=S
+ *                                    binary view (trip_wire.h), a delta onto
+ *                                    the state S of epoch E if it can be told
+ *   GET /v2/stream/<map line>?max=N&epoch=E&since=S
+ *                                    WebSocket, the same view and then a delta
+ *                                    whenever the line changes (push.h)
+ *   GET /metrics                     counters of the poller, Prometheus text
+ *
+ * The clock runs with the real one; Date headers of the upstream still
+ * correct it and the answers carry a Date header of their own, which the
+ * boards set their clock from as they do from the api's.
+ *
+ * With -c the proxy checks itself instead of serving: it polls until the
+ * given lines are listed, fetches their views over http and decodes the
+ * json with trip_decode_view(). Then it applies a binary snapshot and, after
+ * another pass, a delta to the tripring, and once more with the deltas
+ * pushed to a live_push.c subscription. It exits with 0 if every line has
+ * trips and the ring ends up with exactly what the feed has each time. The
+ * host tests run that against tools/mock_api.py.
+ *
+ * Each -u adds an upstream; the poller asks the fastest one that answers
+ * and fails over to the next when it goes down (api_backend.h).
+ *
+ *   bvg_proxy [-u upstream]... [-a address] [-p port] [-r requests/min] [-R refresh s] [-v]
+ *   bvg_proxy -u http://127.0.0.1:8080 -p 0 -c U8,S41S42
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "mem_tier.h"
+#include "time_server.h"
+#include "line_data.h"
+#include "tripring.h"
+#include "trip_decode.h"
+#include "trip_wire.h"
+#include "api_url.h"
+#include "api_backend.h"
+#include "http_client.h"
+#include "live_push.h"
+#include "host_clock.h"
+#include "feed.h"
+#include "push.h"
+
+#define PROXY_DEFAULT_UPSTREAM  "https://v6.bvg.transport.rest"
+#define PROXY_DEFAULT_PORT      8090
+#define PROXY_VIEW_SIZE         (256 * 1024)
+#define PROXY_VIEW_MAX_DEFAULT  32       // MAX_NR_TRIP_IDS of requests.c
+#define PROXY_REQUEST_LEN       2048
+#define PROXY_CLIENT_TIMEOUT_S  2
+#define PROXY_CHECK_PASSES      3
+#define PROXY_CHECK_PUSH_S      10       // a pushed delta is there within this
+
+static const char *TAG = "PROXY";
+
+static char view[PROXY_VIEW_SIZE];
+static int check_port;
+static size_t trip_buf[(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+
+
+static void send_all(int fd, const char *data, size_t len)
+{
+    while (len) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        data += n;
+        len -= n;
+    }
+}
+
+static void respond(int fd, int status, const char *reason, const char *type, const char *body, size_t len)
+{
+    char date[40];
+    time_t now = (time_t)get_unix_seconds();
+    struct tm tm;
+    gmtime_r(&now, &tm);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %d %s\r\nDate: %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n", status, reason, date, type, len);
+    send_all(fd, head, n);
+    send_all(fd, body, len);
+}
+
+static void respond_text(int fd, int status, const char *reason)
+{
+    char body[64];
+    int n = snprintf(body, sizeof(body), "%s\n", reason);
+    respond(fd, status, reason, "text/plain", body, n);
+}
+
+// value of key in a query string, def if it has none
+static uint32_t query_u32(const char *query, const char *key, uint32_t def)
+{
+    size_t klen = strlen(key);
+    for (const char *p = query; p && *p; p = strchr(p, '&') ? strchr(p, '&') + 1 : NULL) {
+        if (strncmp(p, key, klen) == 0 && p[klen] == '=') return (uint32_t)strtoul(p + klen + 1, NULL, 10);
+    }
+    return def;
+}
+
+static void serve_view(int fd, const char *name, const char *query)
+{
+    uint32_t max_trips = query_u32(query, "max", PROXY_VIEW_MAX_DEFAULT);
+    if (max_trips == 0 || max_trips > FEED_MAX_TRIPS) max_trips = FEED_MAX_TRIPS;
+
+    int line = line_data_find_line(name);
+    if (line < 0) {
+        respond_text(fd, 404, "Not Found");
+        return;
+    }
+    int len = feed_view_json(line, max_trips, view, sizeof(view));
+    if (len == 0) {
+        // the board keeps its timetable until the line was listed
+        respond_text(fd, 503, "Service Unavailable");
+        return;
+    }
+    if (len < 0) {
+        ESP_LOGW(TAG, "view of %s does not fit into %u bytes", name, (unsigned)sizeof(view));
+        respond_text(fd, 500, "Internal Server Error");
+        return;
+    }
+    respond(fd, 200, "OK", "application/json", view, len);
+}
+
+static void serve_wire(int fd, const char *name, const char *query)
+{
+    uint32_t max_trips = query_u32(query, "max", PROXY_VIEW_MAX_DEFAULT);
+    if (max_trips == 0 || max_trips > FEED_MAX_TRIPS) max_trips = FEED_MAX_TRIPS;
+
+    int line = line_data_find_line(name);
+    if (line < 0) {
+        respond_text(fd, 404, "Not Found");
+        return;
+    }
+    int len = feed_view_wire(line, max_trips, query_u32(query, "epoch", 0), query_u32(query, "since", 0),
+                             (uint8_t *)view, sizeof(view));
+    if (len == 0) {
+        respond_text(fd, 503, "Service Unavailable");
+        return;
+    }
+    if (len < 0) {
+        ESP_LOGW(TAG, "binary view of %s does not fit into %u bytes", name, (unsigned)sizeof(view));
+        respond_text(fd, 500, "Internal Server Error");
+        return;
+    }
+    respond(fd, 200, "OK", "application/octet-stream", view, len);
+}
+
+// true if the connection went to the push thread
+static bool serve_stream(int fd, const char *name, const char *query, const char *request)
+{
+    uint32_t max_trips = query_u32(query, "max", PROXY_VIEW_MAX_DEFAULT);
+    if (max_trips == 0 || max_trips > FEED_MAX_TRIPS) max_trips = FEED_MAX_TRIPS;
+
+    int line = line_data_find_line(name);
+    if (line < 0) {
+        respond_text(fd, 404, "Not Found");
+        return false;
+    }
+    switch (push_subscribe(fd, request, line, max_trips, query_u32(query, "epoch", 0), query_u32(query, "since", 0))) {
+    case PUSH_OK:
+        return true;
+    case PUSH_BAD_REQUEST:
+        respond_text(fd, 400, "Bad Request");
+        return false;
+    default:
+        respond_text(fd, 503, "Service Unavailable");
+        return false;
+    }
+}
+
+static void serve_metrics(int fd)
+{
+    feed_stats_t s;
+    push_stats_t p;
+    feed_get_stats(&s);
+    push_get_stats(&p);
+    int n = snprintf(view, sizeof(view),
+        "# HELP proxy_passes_total Complete passes over all lines.\n# TYPE proxy_passes_total counter\nproxy_passes_total %u\n"
+        "# HELP proxy_upstream_requests_total Requests sent upstream.\n# TYPE proxy_upstream_requests_total counter\nproxy_upstream_requests_total %u\n"
+        "# HELP proxy_upstream_failures_total Upstream requests that failed.\n# TYPE proxy_upstream_failures_total counter\nproxy_upstream_failures_total %u\n"
+        "# HELP proxy_decode_failures_total Trip answers that did not decode.\n# TYPE proxy_decode_failures_total counter\nproxy_decode_failures_total %u\n"
+        "# HELP proxy_dropped_total Listed trips not taken, the table was full.\n# TYPE proxy_dropped_total counter\nproxy_dropped_total %u\n"
+        "# HELP proxy_views_total Line views served.\n# TYPE proxy_views_total counter\nproxy_views_total %u\n"
+        "# HELP proxy_trips_listed Trips known from the line lists.\n# TYPE proxy_trips_listed gauge\nproxy_trips_listed %u\n"
+        "# HELP proxy_trips Trips with an answer.\n# TYPE proxy_trips gauge\nproxy_trips %u\n"
+        "# HELP proxy_push_subscribers Boards with a stream open.\n# TYPE proxy_push_subscribers gauge\nproxy_push_subscribers %u\n"
+        "# HELP proxy_push_messages_total Views pushed to streams.\n# TYPE proxy_push_messages_total counter\nproxy_push_messages_total %u\n"
+        "# HELP proxy_push_bytes_total Bytes of the views pushed.\n# TYPE proxy_push_bytes_total counter\nproxy_push_bytes_total %llu\n"
+        "# HELP proxy_push_dropped_total Streams ended by the proxy, the board took no frame.\n# TYPE proxy_push_dropped_total counter\nproxy_push_dropped_total %u\n",
+        s.passes, s.requests, s.failures, s.decode_failures, s.dropped, s.views, s.listed, s.trips,
+        p.subscribers, p.messages, (unsigned long long)p.bytes, p.dropped);
+
+    // the upstreams of -u, the poller's requests go to the fastest that answers
+    api_backend_stats_t b;
+    n += snprintf(view + n, sizeof(view) - n, "# HELP proxy_backend_latency_us Moving average of an upstream's requests.\n"
+                  "# TYPE proxy_backend_latency_us gauge\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        n += snprintf(view + n, sizeof(view) - n, "proxy_backend_latency_us{backend=\"%s\"} %u\n", b.base, b.latency_us);
+    }
+    n += snprintf(view + n, sizeof(view) - n, "# HELP proxy_backend_requests_total Requests by upstream and result.\n"
+                  "# TYPE proxy_backend_requests_total counter\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        n += snprintf(view + n, sizeof(view) - n, "proxy_backend_requests_total{backend=\"%s\",result=\"ok\"} %u\n"
+                      "proxy_backend_requests_total{backend=\"%s\",result=\"fail\"} %u\n",
+                      b.base, b.requests - b.failures, b.base, b.failures);
+    }
+    n += snprintf(view + n, sizeof(view) - n, "# HELP proxy_backend_up 1 while an upstream takes requests.\n"
+                  "# TYPE proxy_backend_up gauge\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        n += snprintf(view + n, sizeof(view) - n, "proxy_backend_up{backend=\"%s\"} %d\n", b.base, b.up);
+    }
+    respond(fd, 200, "OK", "text/plain; version=0.0.4", view, n);
+}
+
+// true if the connection stays open, as a stream
+static bool serve_client(int fd)
+{
+    struct timeval tv = { .tv_sec = PROXY_CLIENT_TIMEOUT_S };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    // the request line is all that is needed, the headers only for a stream
+    char req[PROXY_REQUEST_LEN];
+    size_t len = 0;
+    while (len < sizeof(req) - 1) {
+        ssize_t n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+        if (n <= 0) break;
+        len += n;
+        req[len] = 0;
+        if (strstr(req, "\r\n\r\n")) break;
+    }
+    req[len] = 0;
+
+    char method[8], target[256];
+    if (sscanf(req, "%7s %255s HTTP/", method, target) != 2) {
+        respond_text(fd, 400, "Bad Request");
+        return false;
+    }
+    if (strcmp(method, "GET") != 0) {
+        respond_text(fd, 405, "Method Not Allowed");
+        return false;
+    }
+    char *query = strchr(target, '?');
+    if (query) *query++ = 0;
+
+    if (strncmp(target, "/v1/lines/", 10) == 0) serve_view(fd, target + 10, query);
+    else if (strncmp(target, "/v2/lines/", 10) == 0) serve_wire(fd, target + 10, query);
+    else if (strncmp(target, "/v2/stream/", 11) == 0) return serve_stream(fd, target + 11, query, req);
+    else if (strcmp(target, "/metrics") == 0) serve_metrics(fd);
+    else respond_text(fd, 404, "Not Found");
+    return false;
+}
+
+// one board at a time, an answer is a copy out of memory; streams go on in the push thread
+static void *serve(void *arg)
+{
+    int listen_fd = *(int *)arg;
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        if (!serve_client(fd)) close(fd);
+    }
+    return NULL;
+}
+
+static int listen_on(const char *address, int *port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons((uint16_t)*port) };
+    if (inet_pton(AF_INET, address, &sa.sin_addr) != 1 ||
+        bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    socklen_t sl = sizeof(sa);
+    getsockname(fd, (struct sockaddr *)&sa, &sl);
+    *port = ntohs(sa.sin_port);
+    return fd;
+}
+
+
+static void count_trip(Trip *trip, void *ctx)
+{
+    (void)trip;
+    (*(uint32_t *)ctx)++;
+}
+
+// the json view of a line, as a board would fetch and decode it
+static bool check_json(int line, const char *name, int port, size_t *bytes)
+{
+    static char body[PROXY_VIEW_SIZE];
+    char url[128];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/v1/lines/%s?max=%d", port, name, FEED_MAX_TRIPS);
+    uint32_t expected = feed_view_trips(line);
+    uint32_t decoded = 0;
+    int n = fetch_data(url, body, sizeof(body) - 1) ? trip_decode_view(body, (Trip *)trip_buf, count_trip, &decoded) : -1;
+    *bytes = n >= 0 ? strlen(body) : 0;
+    return n >= 0 && expected > 0 && decoded == expected;
+}
+
+// the ring holds what the feed has for the line
+static bool ring_matches(int line)
+{
+    bool ok = tr_get_size() == feed_view_trips(line);
+    for (uint32_t i = 0; ok && i < tr_get_size(); i++) ok = feed_has_trip(tr_get_trip(i));
+    return ok;
+}
+
+// one binary view applied to the ring as a board does, since 0 for a snapshot
+static int fetch_wire(const char *name, int port, trip_wire_info_t *info, uint32_t epoch, uint32_t since)
+{
+    static char body[PROXY_VIEW_SIZE];
+    char url[160];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/v2/lines/%s?max=%d&epoch=%u&since=%u",
+             port, name, FEED_MAX_TRIPS, (unsigned)epoch, (unsigned)since);
+    int len = fetch_data_len(url, body, sizeof(body) - 1);
+    if (len < 0) return -1;
+    tr_take();
+    bool ok = trip_wire_apply((const uint8_t *)body, len, info);
+    tr_release();
+    return ok ? len : -1;
+}
+
+// the binary view of a line: a snapshot, then after another pass a delta onto it
+static bool check_wire(int line, const char *name, int port)
+{
+    trip_wire_info_t snap, delta;
+    int snap_len = fetch_wire(name, port, &snap, 0, 0);
+    tr_take();
+    bool ok = snap_len > 0 && snap.kind == TRIP_WIRE_SNAPSHOT && snap.skipped == 0 && ring_matches(line);
+    tr_release();
+    if (!ok) {
+        printf("%-7s binary snapshot  FAIL\n", name);
+        return false;
+    }
+
+    feed_pass();
+    int delta_len = fetch_wire(name, port, &delta, snap.epoch, snap.seq);
+    tr_take();
+    ok = delta_len > 0 && delta.kind == TRIP_WIRE_DELTA && delta.base_seq == snap.seq && delta.skipped == 0 &&
+         ring_matches(line);
+    tr_release();
+    printf("%-7s binary snapshot of %u trips in %d bytes, delta +%u -%u in %d bytes%s\n", name, snap.put, snap_len,
+           delta.put, delta.del, delta_len, ok ? "" : "  FAIL");
+    return ok;
+}
+
+typedef struct {
+    uint32_t epoch;
+    uint32_t seq;
+    uint32_t put;
+    uint32_t del;
+    bool     gap;
+} push_check_t;
+
+// what requests.c does with a pushed view: a delta only onto the state the ring has
+static bool apply_pushed(const uint8_t *msg, size_t len, void *ctx)
+{
+    push_check_t *pc = ctx;
+    trip_wire_info_t info;
+    if (!trip_wire_header(msg, len, &info)) return false;
+    if (info.kind == TRIP_WIRE_DELTA && (info.epoch != pc->epoch || info.base_seq != pc->seq)) {
+        pc->gap = true;
+        return false;
+    }
+    tr_take();
+    bool ok = trip_wire_apply(msg, len, &info);
+    tr_release();
+    if (!ok) return false;
+    pc->epoch = info.epoch;
+    pc->seq = info.seq;
+    pc->put += info.put;
+    pc->del += info.del;
+    return true;
+}
+
+static bool wait_pushed(uint32_t messages, int line)
+{
+    for (int i = 0; i < PROXY_CHECK_PUSH_S * 10; i++) {
+        if (!live_push_wait(0)) return false;
+        tr_take();
+        bool done = live_push_messages() >= messages && (line < 0 || ring_matches(line));
+        tr_release();
+        if (done) return true;
+        usleep(100 * 1000);
+    }
+    return false;
+}
+
+// a subscription to the stream of a line: the snapshot, then after another pass what it changed
+static bool check_push(int line, const char *name, int port, bool *pushed)
+{
+    static uint8_t buf[PROXY_VIEW_SIZE];
+    char url[160];
+    snprintf(url, sizeof(url), "ws://127.0.0.1:%d/v2/stream/%s?max=%d", port, name, FEED_MAX_TRIPS);
+    push_check_t pc = {0};
+    bool ok = live_push_start(url, buf, sizeof(buf), apply_pushed, &pc) && wait_pushed(1, line);
+    uint32_t first_put = pc.put;
+    if (ok) {
+        feed_pass();
+        // nothing may have changed on the line, then only the ring is compared
+        ok = wait_pushed(2, line) || (live_push_wait(0) && wait_pushed(1, line));
+    }
+    uint32_t messages = live_push_messages();
+    live_push_stop();
+    ok &= !pc.gap;
+    *pushed |= messages > 1;
+    printf("%-7s stream of %u messages: snapshot of %u trips, then +%u -%u%s\n", name, messages, first_put,
+           pc.put - first_put, pc.del, ok ? "" : "  FAIL");
+    return ok;
+}
+
+// every line listed and its json view complete, false while a list is missing
+static bool check_lines(char *lines)
+{
+    bool ok = true;
+    for (char *save = NULL, *name = strtok_r(lines, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int line = line_data_find_line(name);
+        size_t bytes = 0;
+        bool line_ok = line >= 0 && check_json(line, name, check_port, &bytes);
+        printf("%-7s %u trips in the json view of %u bytes%s\n", name, line >= 0 ? feed_view_trips(line) : 0,
+               (unsigned)bytes, line_ok ? "" : "  FAIL");
+        ok &= line_ok;
+    }
+    return ok;
+}
+
+static bool check_deltas(char *lines)
+{
+    bool ok = true;
+    for (char *save = NULL, *name = strtok_r(lines, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        ok &= check_wire(line_data_find_line(name), name, check_port);
+    }
+    return ok;
+}
+
+// a stream whose board stops within a frame: the upgrade, then a ping cut off in its mask
+static int open_stalled(const char *name, int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    struct timeval tv = { .tv_sec = PROXY_CHECK_PUSH_S };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    char req[256];
+    int n = snprintf(req, sizeof(req), "GET /v2/stream/%s HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\n"
+                     "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                     "Sec-WebSocket-Version: 13\r\n\r\n", name);
+    static const uint8_t cut[] = { 0x89, 0x8A, 0x01, 0x02 };
+    char answer[64] = {0};
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || send(fd, req, n, MSG_NOSIGNAL) != n ||
+        recv(fd, answer, sizeof(answer) - 1, 0) <= 0 || strncmp(answer, "HTTP/1.1 101", 12) != 0 ||
+        send(fd, cut, sizeof(cut), MSG_NOSIGNAL) != (ssize_t)sizeof(cut)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// true once the proxy closed the stalled stream, what it pushed before is skipped
+static bool stalled_closed(int fd)
+{
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) {}
+    close(fd);
+    return n == 0;
+}
+
+static bool check_streams(char *lines)
+{
+    bool ok = true, pushed = false;
+    int stalled = -1;
+    for (char *save = NULL, *name = strtok_r(lines, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        // the other streams go on while one board hangs in a frame
+        if (stalled < 0) {
+            stalled = open_stalled(name, check_port);
+            if (stalled < 0) printf("%-7s stalled stream not opened  FAIL\n", name);
+            ok &= stalled >= 0;
+        }
+        ok &= check_push(line_data_find_line(name), name, check_port, &pushed);
+    }
+    if (!pushed) printf("no delta was pushed  FAIL\n");
+    if (stalled >= 0) {
+        bool closed = stalled_closed(stalled);
+        printf("stalled stream %s\n", closed ? "closed by the proxy" : "still open  FAIL");
+        ok &= closed;
+    }
+    return ok && pushed;
+}
+
+// where the requests of the check went
+static bool print_backends(void)
+{
+    api_backend_stats_t b;
+    bool ok = false;
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        printf("upstream %s: %u requests, %u failed, %u ms on average%s%s\n", b.base, b.requests, b.failures,
+               b.latency_us / 1000, b.up ? "" : ", down", b.current ? ", current" : "");
+        ok |= b.up && b.current;
+    }
+    return ok;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-u upstream]... [-a address] [-p port] [-r requests/min] [-R refresh s] [-v]\n"
+                    "       %s [-u upstream]... [-p port] [-r requests/min] -c line[,line...]\n", prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *upstreams[API_BACKENDS_MAX] = { PROXY_DEFAULT_UPSTREAM };
+    int n_upstreams = 0;
+    const char *address = "0.0.0.0";
+    const char *check = NULL;
+    int port = PROXY_DEFAULT_PORT;
+    feed_config_t cfg = { .requests_per_min = 60, .refresh_s = 60 };
+    int opt;
+    esp_log_level_set("*", ESP_LOG_WARN);
+    while ((opt = getopt(argc, argv, "u:a:p:r:R:c:v")) != -1) {
+        switch (opt) {
+        case 'u':
+            if (n_upstreams == API_BACKENDS_MAX) {
+                fprintf(stderr, "at most %d upstreams\n", API_BACKENDS_MAX);
+                return 2;
+            }
+            upstreams[n_upstreams++] = optarg;
+            break;
+        case 'a': address = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'r': cfg.requests_per_min = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'R': cfg.refresh_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'c': check = optarg; break;
+        case 'v': esp_log_level_set("*", ESP_LOG_INFO); break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc || cfg.requests_per_min == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    host_clock_run_real();
+    mem_tier_init();
+    time_server_init();
+    line_data_init();
+    tr_init();
+    if (n_upstreams == 0) n_upstreams = 1;
+    for (int i = 0; i < n_upstreams; i++) {
+        if (!(i == 0 ? api_set_base_url(upstreams[i]) : api_backend_add(upstreams[i]))) {
+            fprintf(stderr, "upstream url too long: %s\n", upstreams[i]);
+            return 2;
+        }
+    }
+    feed_init(&cfg);
+
+    int listen_fd = listen_on(check ? "127.0.0.1" : address, &port);
+    if (listen_fd < 0) {
+        perror("listen");
+        return 1;
+    }
+    pthread_t server;
+    pthread_create(&server, NULL, serve, &listen_fd);
+    push_start();
+    printf("serving line views on http://%s:%d/v1/lines/, upstream %s%s\n", check ? "127.0.0.1" : address, port,
+           upstreams[0], n_upstreams > 1 ? " and fallbacks" : "");
+    fflush(stdout);
+
+    if (check) {
+        // a failed list leaves its line unlisted, the next pass tries again
+        check_port = port;
+        char *lines = strdup(check);
+        bool ok = false;
+        for (int p = 1; p <= PROXY_CHECK_PASSES && !ok; p++) {
+            feed_pass();
+            strcpy(lines, check);
+            ok = check_lines(lines);
+        }
+        if (ok) {
+            strcpy(lines, check);
+            ok = check_deltas(lines);
+        }
+        if (ok) {
+            strcpy(lines, check);
+            ok = check_streams(lines);
+        }
+        // with fallbacks the requests end up at one that answers
+        ok = print_backends() && ok;
+        free(lines);
+        return ok ? 0 : 1;
+    }
+
+    while (1) feed_pass();
+}
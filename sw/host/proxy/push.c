@@ -0,0 +1,329 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "esp_log.h"
+#include "host_clock.h"
+#include "trip_wire.h"
+#include "feed.h"
+#include "push.h"
+
+#define PUSH_VIEW_SIZE      (256 * 1024)
+#define PUSH_CONTROL_MAX    125          // longest control frame of RFC 6455
+#define PUSH_FRAME_TIMEOUT_MS 500        // a frame of the board arrives within this once it started
+#define PUSH_WS_GUID        "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+enum {
+    WS_OP_TEXT   = 0x1,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE  = 0x8,
+    WS_OP_PING   = 0x9,
+    WS_OP_PONG   = 0xA,
+};
+
+static const char *TAG = "PUSH";
+
+typedef struct {
+    int      fd;
+    int      line;
+    uint32_t max_trips;
+    uint32_t epoch;
+    uint32_t seq;               // state the board has, 0 after a snapshot cut at max_trips
+    uint32_t checked;           // feed_seq() the last view was built at
+} subscriber_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static subscriber_t subs[PUSH_MAX_SUBSCRIBERS];
+static uint32_t n_subs;
+static push_stats_t stats;
+static uint8_t view[PUSH_VIEW_SIZE];
+
+
+// --- handshake ---------------------------------------------------------------
+
+static uint32_t rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1 of FIPS 180-1, only for Sec-WebSocket-Accept
+static void sha1(const uint8_t *msg, size_t len, uint8_t out[20])
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    size_t total = ((len + 8) / 64 + 1) * 64;
+    for (size_t off = 0; off < total; off += 64) {
+        uint8_t block[64];
+        for (size_t i = 0; i < 64; i++) {
+            size_t k = off + i;
+            if (k < len) block[i] = msg[k];
+            else if (k == len) block[i] = 0x80;
+            else if (k >= total - 8) block[i] = (uint8_t)((uint64_t)len * 8 >> (8 * (total - 1 - k)));
+            else block[i] = 0;
+        }
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 | (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) out[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static void base64(const uint8_t *in, size_t len, char *out)
+{
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0) | (i + 2 < len ? in[i + 2] : 0);
+        *out++ = abc[v >> 18 & 63];
+        *out++ = abc[v >> 12 & 63];
+        *out++ = i + 1 < len ? abc[v >> 6 & 63] : '=';
+        *out++ = i + 2 < len ? abc[v & 63] : '=';
+    }
+    *out = 0;
+}
+
+// value of header `name` in request, without surrounding blanks
+static bool header_value(const char *request, const char *name, char *out, size_t size)
+{
+    size_t nlen = strlen(name);
+    for (const char *p = strstr(request, "\r\n"); p; p = strstr(p, "\r\n")) {
+        p += 2;
+        if (strncasecmp(p, name, nlen) != 0 || p[nlen] != ':') continue;
+        p += nlen + 1;
+        while (*p == ' ' || *p == '\t') p++;
+        size_t len = strcspn(p, "\r\n");
+        while (len && (p[len - 1] == ' ' || p[len - 1] == '\t')) len--;
+        if (len >= size) return false;
+        memcpy(out, p, len);
+        out[len] = 0;
+        return true;
+    }
+    return false;
+}
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// frames of the server go unmasked
+static bool send_frame(int fd, uint8_t op, const uint8_t *data, size_t len)
+{
+    uint8_t head[10];
+    size_t n = 0;
+    head[n++] = 0x80 | op;
+    if (len < 126) {
+        head[n++] = (uint8_t)len;
+    } else if (len <= UINT16_MAX) {
+        head[n++] = 126;
+        head[n++] = (uint8_t)(len >> 8);
+        head[n++] = (uint8_t)len;
+    } else {
+        head[n++] = 127;
+        for (int i = 7; i >= 0; i--) head[n++] = (uint8_t)((uint64_t)len >> (8 * i));
+    }
+    return send_all(fd, head, n) && send_all(fd, data, len);
+}
+
+// len bytes before the uptime deadline_us, false on a timeout or a closed connection
+static bool recv_until(int fd, uint8_t *buf, size_t len, int64_t deadline_us)
+{
+    while (len) {
+        int64_t left_ms = (deadline_us - host_clock_uptime_us()) / 1000;
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        if (left_ms <= 0 || poll(&p, 1, (int)left_ms) <= 0) return false;
+        ssize_t n = recv(fd, buf, len, MSG_DONTWAIT);
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+
+// --- subscriptions -------------------------------------------------------------
+
+// under the lock: sends the view of len bytes in view to s, an empty delta only as the first message
+static bool send_view(subscriber_t *s, int len, bool first)
+{
+    trip_wire_info_t info;
+    trip_wire_hdr_t h;
+    if (!trip_wire_header(view, len, &info)) return false;
+    memcpy(&h, view, sizeof(h));
+    if (!first && info.kind == TRIP_WIRE_DELTA && h.count == 0) return true;
+
+    if (!send_frame(s->fd, WS_OP_BINARY, view, len)) return false;
+    s->epoch = info.epoch;
+    s->seq = info.seq;
+    stats.messages++;
+    stats.bytes += len;
+    ESP_LOGD(TAG, "%s %u -> %u of line %d to fd %d, %d bytes", info.kind == TRIP_WIRE_SNAPSHOT ? "snapshot" : "delta",
+             (unsigned)info.base_seq, (unsigned)info.seq, s->line, s->fd, len);
+    return true;
+}
+
+// under the lock: what changed on the line of s since its last view
+static bool push_view(subscriber_t *s)
+{
+    s->checked = feed_seq();
+    int len = feed_view_wire(s->line, s->max_trips, s->epoch, s->seq, view, sizeof(view));
+    if (len < 0) ESP_LOGW(TAG, "view of line %d does not fit into %u bytes", s->line, (unsigned)sizeof(view));
+    return len > 0 && send_view(s, len, false);
+}
+
+// under the lock; the last subscriber takes the place of the removed one
+static void drop_subscriber(uint32_t i, bool by_proxy)
+{
+    ESP_LOGI(TAG, "subscription of line %d on fd %d ends", subs[i].line, subs[i].fd);
+    close(subs[i].fd);
+    subs[i] = subs[--n_subs];
+    stats.subscribers = n_subs;
+    if (by_proxy) stats.dropped++;
+}
+
+push_result_t push_subscribe(int fd, const char *request, int line, uint32_t max_trips, uint32_t epoch, uint32_t since)
+{
+    char upgrade[32], key[64];
+    if (!header_value(request, "Upgrade", upgrade, sizeof(upgrade)) || strcasecmp(upgrade, "websocket") != 0 ||
+        !header_value(request, "Sec-WebSocket-Key", key, sizeof(key))) {
+        return PUSH_BAD_REQUEST;
+    }
+
+    pthread_mutex_lock(&lock);
+    if (n_subs == PUSH_MAX_SUBSCRIBERS) {
+        pthread_mutex_unlock(&lock);
+        return PUSH_FULL;
+    }
+    // the view first, the upgrade is answered only if there is one
+    subscriber_t *s = &subs[n_subs];
+    *s = (subscriber_t){ .fd = fd, .line = line, .max_trips = max_trips, .epoch = epoch, .seq = since, .checked = feed_seq() };
+    int len = feed_view_wire(line, max_trips, epoch, since, view, sizeof(view));
+    if (len <= 0) {
+        pthread_mutex_unlock(&lock);
+        return len == 0 ? PUSH_NOT_READY : PUSH_FULL;
+    }
+
+    char concat[64 + sizeof(PUSH_WS_GUID)], accept[32];
+    uint8_t digest[20];
+    snprintf(concat, sizeof(concat), "%s%s", key, PUSH_WS_GUID);
+    sha1((const uint8_t *)concat, strlen(concat), digest);
+    base64(digest, sizeof(digest), accept);
+    char head[160];
+    int n = snprintf(head, sizeof(head), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                     "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+    bool ok = send_all(fd, head, n) && send_view(s, len, true);
+    if (ok) {
+        n_subs++;
+        stats.subscribers = n_subs;
+        ESP_LOGI(TAG, "line %d subscribed on fd %d since %u", line, fd, (unsigned)since);
+    }
+    pthread_mutex_unlock(&lock);
+    // the upgrade was answered, the connection is closed here if the view did not go out
+    if (!ok) close(fd);
+    return PUSH_OK;
+}
+
+// one frame of the board, false when the subscription ends; without the lock,
+// a board that stops within a frame holds up this thread for PUSH_FRAME_TIMEOUT_MS at most
+static bool read_frame(int fd)
+{
+    int64_t deadline_us = host_clock_uptime_us() + PUSH_FRAME_TIMEOUT_MS * 1000LL;
+    uint8_t head[2];
+    if (!recv_until(fd, head, 2, deadline_us)) return false;
+    uint8_t op = head[0] & 0x0F;
+    uint64_t len = head[1] & 0x7F;
+    if (len == 126 || len == 127) {
+        // boards send nothing that long, a ping has at most 125 bytes
+        return false;
+    }
+    uint8_t mask[4] = {0}, payload[PUSH_CONTROL_MAX];
+    if ((head[1] & 0x80) && !recv_until(fd, mask, 4, deadline_us)) return false;
+    if (!recv_until(fd, payload, len, deadline_us)) return false;
+    for (uint64_t i = 0; i < len; i++) payload[i] ^= mask[i % 4];
+
+    switch (op) {
+    case WS_OP_PING:
+        return send_frame(fd, WS_OP_PONG, payload, len);
+    case WS_OP_CLOSE:
+        send_frame(fd, WS_OP_CLOSE, payload, len < 2 ? len : 2);
+        return false;
+    default:
+        // pongs, and text or binary the board has no reason to send
+        return true;
+    }
+}
+
+static void *push_task(void *arg)
+{
+    (void)arg;
+    struct pollfd fds[PUSH_MAX_SUBSCRIBERS];
+    bool ended[PUSH_MAX_SUBSCRIBERS];
+    int64_t next_push_us = 0;
+    while (1) {
+        pthread_mutex_lock(&lock);
+        uint32_t n = n_subs;
+        for (uint32_t i = 0; i < n; i++) fds[i] = (struct pollfd){ .fd = subs[i].fd, .events = POLLIN };
+        pthread_mutex_unlock(&lock);
+
+        if (n == 0) {
+            usleep(PUSH_PERIOD_MS * 1000);
+            continue;
+        }
+        poll(fds, n, PUSH_PERIOD_MS);
+        // only this thread removes subscribers, the first n stay where they are
+        // while push_subscribe() adds at the end
+        for (uint32_t i = 0; i < n; i++) ended[i] = fds[i].revents && !read_frame(fds[i].fd);
+
+        pthread_mutex_lock(&lock);
+        for (uint32_t i = n; i-- > 0;) {
+            if (ended[i]) drop_subscriber(i, false);
+        }
+        int64_t now_us = host_clock_uptime_us();
+        if (now_us >= next_push_us) {
+            next_push_us = now_us + PUSH_PERIOD_MS * 1000;
+            uint32_t seq = feed_seq();
+            for (uint32_t i = n_subs; i-- > 0;) {
+                if (subs[i].checked != seq && !push_view(&subs[i])) drop_subscriber(i, true);
+            }
+        }
+        pthread_mutex_unlock(&lock);
+    }
+    return NULL;
+}
+
+void push_start(void)
+{
+    pthread_t task;
+    pthread_create(&task, NULL, push_task, NULL);
+    pthread_detach(task);
+}
+
+void push_get_stats(push_stats_t *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
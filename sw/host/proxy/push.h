@@ -0,0 +1,46 @@
+#ifndef __PUSH_H_
+#define __PUSH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Push side of bvg_proxy. A board that opens a WebSocket on
+ * /v2/stream/<map line> gets the binary view of its line (trip_wire.h) at
+ * once, a delta onto the state it asked with or a snapshot, and from then on
+ * a delta in a binary frame whenever trips of the line change, at most one
+ * every PUSH_PERIOD_MS. Nothing is sent while the line stays the same, the
+ * pings of the client are answered.
+ */
+
+#define PUSH_MAX_SUBSCRIBERS  32
+#define PUSH_PERIOD_MS        1000
+
+typedef enum {
+    PUSH_OK,
+    PUSH_BAD_REQUEST,    // no WebSocket upgrade
+    PUSH_NOT_READY,      // the line was not listed yet
+    PUSH_FULL,           // PUSH_MAX_SUBSCRIBERS reached, or the view does not fit
+} push_result_t;
+
+typedef struct {
+    uint32_t subscribers;
+    uint32_t messages;          // views pushed, the first one of a subscription included
+    uint64_t bytes;
+    uint32_t dropped;           // subscriptions ended by the proxy, the board did not take a frame
+} push_stats_t;
+
+/** Starts the thread that serves the subscriptions. */
+void push_start(void);
+
+/**
+ * Takes over the connection fd of a board asking for a stream of map line
+ * `line` with `request`, its request line and headers: answers the upgrade
+ * and sends the first view. The connection belongs to the push thread if
+ * PUSH_OK is returned, else nothing was sent on it.
+ */
+push_result_t push_subscribe(int fd, const char *request, int line, uint32_t max_trips, uint32_t epoch, uint32_t since);
+
+void push_get_stats(push_stats_t *out);
+
+#endif //__PUSH_H_
@@ -0,0 +1,5 @@
+#include <stdint.h>
+#include "metrics.h"
+
+// what status_server.c defines on the target, the host build has no server
+uint32_t metrics[METRIC_NUM];
@@ -0,0 +1,179 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "host_clock.h"
+
+// a fixed start, so runs without host_clock_set_us() are repeatable too
+#define HOST_CLOCK_START_US (1760000000LL * 1000000)
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t uptime_us = 0;
+static int64_t wall_offset_us = HOST_CLOCK_START_US;   // wall - uptime
+static int64_t adj_left_us = 0;                        // slew still to apply
+static bool run_real = false;                          // host_clock_run_real()
+static int64_t real_last_ns = 0;                       // monotonic time uptime_us was last moved to
+
+
+void host_clock_set_us(int64_t unix_us)
+{
+    pthread_mutex_lock(&lock);
+    wall_offset_us = unix_us - uptime_us;
+    adj_left_us = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void advance_locked(int64_t us)
+{
+    uptime_us += us;
+    if (adj_left_us != 0) {
+        int64_t step = us >> HOST_CLOCK_SLEW_SHIFT;
+        if (step == 0) step = 1;
+        if (adj_left_us > 0) {
+            if (step > adj_left_us) step = adj_left_us;
+        } else {
+            step = -step;
+            if (step < adj_left_us) step = adj_left_us;
+        }
+        wall_offset_us += step;
+        adj_left_us -= step;
+    }
+}
+
+// in real time mode every read first catches up with the monotonic clock
+static void follow_real_locked(void)
+{
+    if (!run_real) return;
+    int64_t us = (host_clock_real_ns() - real_last_ns) / 1000;
+    if (us <= 0) return;
+    advance_locked(us);
+    real_last_ns += us * 1000;
+}
+
+void host_clock_advance_us(int64_t us)
+{
+    if (us <= 0) return;
+    pthread_mutex_lock(&lock);
+    advance_locked(us);
+    pthread_mutex_unlock(&lock);
+}
+
+void host_clock_run_real(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    pthread_mutex_lock(&lock);
+    wall_offset_us = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000 - uptime_us;
+    adj_left_us = 0;
+    real_last_ns = host_clock_real_ns();
+    run_real = true;
+    pthread_mutex_unlock(&lock);
+}
+
+int64_t host_clock_now_us(void)
+{
+    pthread_mutex_lock(&lock);
+    follow_real_locked();
+    int64_t now = uptime_us + wall_offset_us;
+    pthread_mutex_unlock(&lock);
+    return now;
+}
+
+int64_t host_clock_uptime_us(void)
+{
+    pthread_mutex_lock(&lock);
+    follow_real_locked();
+    int64_t up = uptime_us;
+    pthread_mutex_unlock(&lock);
+    return up;
+}
+
+int64_t host_clock_real_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// the libc functions the firmware sources call, see -Wl,--wrap in CMakeLists.txt
+
+time_t __wrap_time(time_t *out)
+{
+    time_t t = (time_t)(host_clock_now_us() / 1000000);
+    if (out) *out = t;
+    return t;
+}
+
+int __wrap_gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    int64_t now = host_clock_now_us();
+    tv->tv_sec = (time_t)(now / 1000000);
+    tv->tv_usec = (suseconds_t)(now % 1000000);
+    return 0;
+}
+
+int __wrap_settimeofday(const struct timeval *tv, const void *tz)
+{
+    (void)tz;
+    if (tv == NULL) return 0;
+    host_clock_set_us((int64_t)tv->tv_sec * 1000000 + tv->tv_usec);
+    return 0;
+}
+
+int __wrap_adjtime(const struct timeval *delta, struct timeval *old)
+{
+    int64_t d = 0;
+    if (delta) {
+        d = (int64_t)delta->tv_sec * 1000000 + delta->tv_usec;
+        if (d > HOST_CLOCK_ADJ_MAX_S * 1000000LL || d < -HOST_CLOCK_ADJ_MAX_S * 1000000LL) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    pthread_mutex_lock(&lock);
+    if (old) {
+        old->tv_sec = (time_t)(adj_left_us / 1000000);
+        old->tv_usec = (suseconds_t)(adj_left_us % 1000000);
+    }
+    if (delta) adj_left_us = d;
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+
+int64_t esp_timer_get_time(void)
+{
+    return host_clock_uptime_us();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(host_clock_uptime_us() / (portTICK_PERIOD_MS * 1000));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t us = (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+    if (run_real) {
+        struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+        return;
+    }
+    host_clock_advance_us(us);
+}
+
+void vTaskDelayUntil(TickType_t *prev, TickType_t period)
+{
+    TickType_t wake = *prev + period;
+    TickType_t now = xTaskGetTickCount();
+    if ((int32_t)(wake - now) > 0) vTaskDelay(wake - now);
+    *prev = wake;
+}
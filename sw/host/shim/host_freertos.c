@@ -0,0 +1,100 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+
+/*
+ * Mutexes and event groups on pthreads. The virtual clock only moves when
+ * a task advances it, so a bounded wait that is not satisfied at once lets
+ * the whole timeout pass and returns, portMAX_DELAY blocks for real.
+ */
+
+struct host_sem {
+    pthread_mutex_t mutex;
+};
+
+struct host_events {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    EventBits_t     bits;
+};
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    struct host_sem *s = calloc(1, sizeof(*s));
+    if (s == NULL) return NULL;
+    pthread_mutex_init(&s->mutex, NULL);
+    return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) return pthread_mutex_lock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+    if (pthread_mutex_trylock(&sem->mutex) == 0) return pdTRUE;
+    vTaskDelay(ticks);
+    return pthread_mutex_trylock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pthread_mutex_unlock(&sem->mutex) == 0 ? pdTRUE : pdFALSE;
+}
+
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_events *g = calloc(1, sizeof(*g));
+    if (g == NULL) return NULL;
+    pthread_mutex_init(&g->mutex, NULL);
+    pthread_cond_init(&g->cond, NULL);
+    return g;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    pthread_cond_broadcast(&group->cond);
+    pthread_mutex_unlock(&group->mutex);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->mutex);
+    EventBits_t now = group->bits;
+    pthread_mutex_unlock(&group->mutex);
+    return now;
+}
+
+static bool satisfied(EventBits_t have, EventBits_t want, BaseType_t all)
+{
+    return all ? (have & want) == want : (have & want) != 0;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t ticks)
+{
+    pthread_mutex_lock(&group->mutex);
+    while (ticks == portMAX_DELAY && !satisfied(group->bits, bits, all)) {
+        pthread_cond_wait(&group->cond, &group->mutex);
+    }
+    EventBits_t now = group->bits;
+    bool ok = satisfied(now, bits, all);
+    if (clear && ok) group->bits &= ~bits;
+    pthread_mutex_unlock(&group->mutex);
+    if (!ok) vTaskDelay(ticks);
+    return now;
+}
@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "http_client.h"
+#include "time_server.h"
+#if HOST_HTTP_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+/*
+ * fetch_data() of http_client.c over a plain socket, for runs against
+ * tools/mock_api.py. HTTP/1.1 with Content-Length or chunked bodies, https
+ * if the host build found OpenSSL (HOST_HTTP_TLS), with the system's CA
+ * store as the firmware uses its bundle. Fails where the firmware fails:
+ * open errors, a body larger than the buffer, a status other than 200, and
+ * additionally on a body that ends early, which esp_http_client reports as
+ * a short read.
+ */
+
+#define HOST_HTTP_TIMEOUT_MS  15000   // as the firmware's client
+#define HOST_HTTP_LINE_LEN    1024
+
+static const char *TAG = "HTTP_CLIENT ";
+
+typedef struct {
+    int    fd;
+    void  *ssl;    // SSL *, NULL for plain http
+} conn_t;
+
+static ssize_t conn_recv(const conn_t *c, void *buf, size_t len)
+{
+#if HOST_HTTP_TLS
+    if (c->ssl) {
+        int n = SSL_read(c->ssl, buf, (int)len);
+        if (n > 0) return n;
+        return SSL_get_error(c->ssl, n) == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+#endif
+    return recv(c->fd, buf, len, 0);
+}
+
+static ssize_t conn_send(const conn_t *c, const void *buf, size_t len)
+{
+#if HOST_HTTP_TLS
+    if (c->ssl) {
+        int n = SSL_write(c->ssl, buf, (int)len);
+        return n > 0 ? n : -1;
+    }
+#endif
+    return send(c->fd, buf, len, MSG_NOSIGNAL);
+}
+
+typedef struct {
+    const conn_t *conn;
+    char   buf[4096];
+    size_t pos;
+    size_t len;
+} reader_t;
+
+static int rd_fill(reader_t *r)
+{
+    if (r->pos < r->len) return 1;
+    ssize_t n = conn_recv(r->conn, r->buf, sizeof(r->buf));
+    if (n <= 0) return (int)n;
+    r->pos = 0;
+    r->len = (size_t)n;
+    return 1;
+}
+
+// one header or chunk size line without the line break, false on eof or overlong lines
+static bool rd_line(reader_t *r, char *line, size_t size)
+{
+    size_t n = 0;
+    while (rd_fill(r) > 0) {
+        char c = r->buf[r->pos++];
+        if (c == '\n') {
+            if (n && line[n - 1] == '\r') n--;
+            line[n] = 0;
+            return true;
+        }
+        if (n + 1 >= size) return false;
+        line[n++] = c;
+    }
+    return false;
+}
+
+// exactly len bytes, or up to eof if len is negative; the count read or -1
+static long rd_body(reader_t *r, char *out, long len, long room)
+{
+    long total = 0;
+    while (len < 0 || total < len) {
+        int f = rd_fill(r);
+        if (f < 0) return -1;
+        if (f == 0) return len < 0 ? total : -1;
+        size_t take = r->len - r->pos;
+        if (len >= 0 && (long)take > len - total) take = len - total;
+        if ((long)take > room - total) return -1;
+        memcpy(out + total, r->buf + r->pos, take);
+        r->pos += take;
+        total += take;
+    }
+    return total;
+}
+
+static int connect_to(const char *host, const char *port)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *a = res; a; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        struct timeval tv = { .tv_sec = HOST_HTTP_TIMEOUT_MS / 1000, .tv_usec = (HOST_HTTP_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static bool send_all(const conn_t *c, const char *data, size_t len)
+{
+    while (len) {
+        ssize_t n = conn_send(c, data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// the length of the body, -1 on failure
+static long fetch(const conn_t *c, const char *host, const char *path, char *buffer, int buff_size)
+{
+    char line[HOST_HTTP_LINE_LEN];
+    int n = snprintf(line, sizeof(line),
+                     "GET %s HTTP/1.1\r\nHost: %s\r\nAccept: application/json\r\n"
+                     "Accept-Encoding: identity\r\nConnection: close\r\n\r\n", path, host);
+    if (n < 0 || n >= (int)sizeof(line) || !send_all(c, line, n)) {
+        ESP_LOGE(TAG, "open failed: request not sent");
+        return -1;
+    }
+
+    reader_t *r = malloc(sizeof(reader_t));
+    r->conn = c;
+    r->pos = r->len = 0;
+    long body_len = -1;
+
+    int status = 0;
+    if (!rd_line(r, line, sizeof(line)) || sscanf(line, "HTTP/%*d.%*d %d", &status) != 1) {
+        ESP_LOGE(TAG, "open failed: no status line");
+        goto done;
+    }
+
+    long content_length = -1;
+    bool chunked = false;
+    while (1) {
+        if (!rd_line(r, line, sizeof(line))) {
+            ESP_LOGE(TAG, "headers cut off");
+            goto done;
+        }
+        if (line[0] == 0) break;
+        char *value = strchr(line, ':');
+        if (value == NULL) continue;
+        *value++ = 0;
+        while (*value == ' ') value++;
+        if (strcasecmp(line, "Content-Length") == 0) content_length = strtol(value, NULL, 10);
+        else if (strcasecmp(line, "Transfer-Encoding") == 0 && strcasestr(value, "chunked")) chunked = true;
+        else if (strcasecmp(line, "Date") == 0) time_server_http_date(value);
+    }
+
+    if (content_length > buff_size) {
+        ESP_LOGE(TAG, "fetching buffer too small content_length = %ld", content_length);
+        goto done;
+    }
+
+    long total = 0;
+    if (chunked) {
+        while (1) {
+            if (!rd_line(r, line, sizeof(line))) {
+                ESP_LOGE(TAG, "chunk header cut off");
+                goto done;
+            }
+            long size = strtol(line, NULL, 16);
+            if (size == 0) break;
+            if (total + size > buff_size) {
+                ESP_LOGE(TAG, "fetching buffer still too small");
+                goto done;
+            }
+            if (rd_body(r, buffer + total, size, buff_size - total) != size || !rd_line(r, line, sizeof(line))) {
+                ESP_LOGE(TAG, "chunk cut off");
+                goto done;
+            }
+            total += size;
+        }
+    } else {
+        total = rd_body(r, buffer, content_length, buff_size);
+        if (total < 0) {
+            ESP_LOGE(TAG, content_length < 0 ? "fetching buffer still too small" : "body cut off");
+            goto done;
+        }
+    }
+    buffer[total] = '\0';
+
+    if (status != 200) {
+        ESP_LOGE(TAG, "error with status %d, for path = %s", status, path);
+        goto done;
+    }
+    body_len = total;
+
+done:
+    free(r);
+    return body_len;
+}
+
+
+#if HOST_HTTP_TLS
+// one context for the process, verifying against the system's CA store
+static SSL_CTX *tls_ctx;
+static pthread_once_t tls_once = PTHREAD_ONCE_INIT;
+
+static void tls_init(void)
+{
+    tls_ctx = SSL_CTX_new(TLS_client_method());
+    if (tls_ctx == NULL) return;
+    SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_default_verify_paths(tls_ctx);
+}
+
+static void *tls_open(int fd, const char *host)
+{
+    pthread_once(&tls_once, tls_init);
+    SSL *ssl = tls_ctx ? SSL_new(tls_ctx) : NULL;
+    if (ssl == NULL) return NULL;
+    SSL_set_fd(ssl, fd);
+    SSL_set_tlsext_host_name(ssl, host);
+    SSL_set1_host(ssl, host);
+    if (SSL_connect(ssl) != 1) {
+        ESP_LOGE(TAG, "tls handshake with %s failed: %s", host, ERR_reason_error_string(ERR_get_error()));
+        SSL_free(ssl);
+        return NULL;
+    }
+    return ssl;
+}
+#endif
+
+
+int fetch_data_len(const char *url, char *buffer, int buff_size)
+{
+    bool tls = strncmp(url, "https://", 8) == 0;
+#if !HOST_HTTP_TLS
+    if (tls) {
+        ESP_LOGE(TAG, "host build without OpenSSL speaks plain http only: %s", url);
+        return -1;
+    }
+#endif
+    if (!tls && strncmp(url, "http://", 7) != 0) {
+        ESP_LOGE(TAG, "not an http url: %s", url);
+        return -1;
+    }
+
+    // http[s]://host[:port]/path, no ipv6 literals
+    char host[256];
+    char port[8];
+    snprintf(port, sizeof(port), "%s", tls ? "443" : "80");
+    const char *h = url + (tls ? 8 : 7);
+    const char *slash = strchr(h, '/');
+    const char *path = slash ? slash : "/";
+    size_t hlen = slash ? (size_t)(slash - h) : strlen(h);
+    if (hlen == 0 || hlen >= sizeof(host)) return -1;
+    memcpy(host, h, hlen);
+    host[hlen] = 0;
+
+    char host_hdr[sizeof(host)];
+    memcpy(host_hdr, host, hlen + 1);
+    char *colon = strchr(host, ':');
+    if (colon) {
+        snprintf(port, sizeof(port), "%s", colon + 1);
+        *colon = 0;
+    }
+
+    conn_t c = { .fd = connect_to(host, port), .ssl = NULL };
+    if (c.fd < 0) {
+        ESP_LOGE(TAG, "open failed: cannot connect to %s", host_hdr);
+        return -1;
+    }
+#if HOST_HTTP_TLS
+    if (tls && (c.ssl = tls_open(c.fd, host)) == NULL) {
+        close(c.fd);
+        return -1;
+    }
+#endif
+    long len = fetch(&c, host_hdr, path, buffer, buff_size);
+#if HOST_HTTP_TLS
+    if (c.ssl) {
+        SSL_shutdown(c.ssl);
+        SSL_free(c.ssl);
+    }
+#endif
+    close(c.fd);
+    return (int)len;
+}
+
+bool fetch_data(const char *url, char *buffer, int buff_size)
+{
+    return fetch_data_len(url, buffer, buff_size) >= 0;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_sntp.h"
+#include "esp_netif_sntp.h"
+#include "host_clock.h"
+
+// the rest of the ESP-IDF api the pipeline modules link against
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    host_log_level = level;
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    static const char letter[] = "NEWIDV";
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "%c (%lld) %s: ", letter[level], (long long)(host_clock_uptime_us() / 1000), tag);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err) {
+    case ESP_OK:                return "ESP_OK";
+    case ESP_FAIL:              return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    default:                    return "UNKNOWN ERROR";
+    }
+}
+
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    (void)type;
+    (void)subtype;
+    (void)label;
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t offset, void *dst, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t offset, const void *src, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *part, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr, esp_partition_mmap_handle_t *out_handle)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
+
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+
+static esp_sntp_config_t sntp_config;
+static bool sntp_running = false;
+
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config)
+{
+    sntp_config = *config;
+    sntp_running = true;
+    return ESP_OK;
+}
+
+void esp_netif_sntp_deinit(void)
+{
+    sntp_running = false;
+}
+
+void sntp_set_sync_interval(uint32_t interval_ms)
+{
+    (void)interval_ms;
+}
+
+const char *esp_sntp_getservername(uint8_t idx)
+{
+    return idx < sntp_config.num_of_servers ? sntp_config.servers[idx] : NULL;
+}
+
+const ip_addr_t *esp_sntp_getserver(uint8_t idx)
+{
+    static const ip_addr_t none = {0};
+    return &none;
+}
+
+char *ipaddr_ntoa_r(const ip_addr_t *addr, char *buf, int buflen)
+{
+    uint32_t a = addr->addr;
+    snprintf(buf, buflen, "%u.%u.%u.%u", (unsigned)(a & 0xFF), (unsigned)((a >> 8) & 0xFF),
+             (unsigned)((a >> 16) & 0xFF), (unsigned)(a >> 24));
+    return buf;
+}
+
+bool host_sntp_answer(int64_t unix_us)
+{
+    if (!sntp_running) return false;
+
+    // what lwip's sntp_sync_time() does with an answer
+    struct timeval tv = { .tv_sec = (time_t)(unix_us / 1000000), .tv_usec = (suseconds_t)(unix_us % 1000000) };
+    if (sntp_config.smooth_sync) {
+        int64_t d = unix_us - host_clock_now_us();
+        struct timeval delta = { .tv_sec = (time_t)(d / 1000000), .tv_usec = (suseconds_t)(d % 1000000) };
+        if (adjtime(&delta, NULL) == -1) settimeofday(&tv, NULL);
+    } else {
+        settimeofday(&tv, NULL);
+    }
+    if (sntp_config.sync_cb) sntp_config.sync_cb(&tv);
+    return true;
+}
@@ -0,0 +1,97 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include "esp_heap_caps.h"
+#include "host_mem.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void __real_free(void *p);
+
+static size_t in_use = 0;
+static size_t peak = 0;
+static size_t allocs = 0;
+
+// usable size instead of a header of our own, free() needs nothing stored
+static void *account(void *p)
+{
+    if (p == NULL) return NULL;
+    size_t n = __atomic_add_fetch(&in_use, malloc_usable_size(p), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    size_t old = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+    while (n > old && !__atomic_compare_exchange_n(&peak, &old, n, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return p;
+}
+
+static void release(void *p)
+{
+    if (p) __atomic_sub_fetch(&in_use, malloc_usable_size(p), __ATOMIC_RELAXED);
+}
+
+
+void *__wrap_malloc(size_t size)
+{
+    return account(__real_malloc(size));
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    return account(__real_calloc(n, size));
+}
+
+void *__wrap_realloc(void *p, size_t size)
+{
+    size_t before = p ? malloc_usable_size(p) : 0;
+    void *q = __real_realloc(p, size);
+    // on failure p is left alone and still counted
+    if (q == NULL && size != 0) return NULL;
+    __atomic_sub_fetch(&in_use, before, __ATOMIC_RELAXED);
+    return account(q);
+}
+
+void __wrap_free(void *p)
+{
+    release(p);
+    __real_free(p);
+}
+
+
+size_t host_mem_in_use(void)
+{
+    return __atomic_load_n(&in_use, __ATOMIC_RELAXED);
+}
+
+size_t host_mem_peak(void)
+{
+    return __atomic_load_n(&peak, __ATOMIC_RELAXED);
+}
+
+void host_mem_reset_peak(void)
+{
+    __atomic_store_n(&peak, host_mem_in_use(), __ATOMIC_RELAXED);
+}
+
+size_t host_mem_allocs(void)
+{
+    return __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+}
+
+
+// esp_heap_caps.h, only internal RAM and of unknown size
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    return (caps & MALLOC_CAP_SPIRAM) ? NULL : calloc(n, size);
+}
+
+size_t heap_caps_get_total_size(uint32_t caps)
+{
+    return 0;
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    return 0;
+}
@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_websocket_client.h"
+
+#define HOST_WS_LINE_LEN      512
+#define HOST_WS_TIMEOUT_MS    10000
+
+static const char *TAG = "WEBSOCKET_CLIENT";
+
+esp_event_base_t const WEBSOCKET_EVENTS = "WEBSOCKET_EVENTS";
+
+struct esp_websocket_client {
+    char     host[128];
+    char     port[8];
+    char     path[HOST_WS_LINE_LEN];
+    int      buffer_size;
+    int      timeout_ms;
+    void    *user_context;
+    esp_event_handler_t handler;
+    void    *handler_arg;
+    int      fd;
+    bool     connected;
+    bool     stopping;
+    bool     running;
+    pthread_t thread;
+    char    *buf;
+};
+
+
+static void emit(esp_websocket_client_handle_t c, esp_websocket_event_id_t id, esp_websocket_event_data_t *d)
+{
+    esp_websocket_event_data_t none = {0};
+    if (d == NULL) d = &none;
+    d->client = c;
+    d->user_context = c->user_context;
+    if (c->handler) c->handler(c->handler_arg, WEBSOCKET_EVENTS, id, d);
+}
+
+static bool recv_all(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool send_all(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+// frames of the client are masked, RFC 6455 5.3
+static bool send_frame(int fd, uint8_t op, const uint8_t *data, size_t len)
+{
+    uint8_t frame[2 + 4 + 125];
+    if (len > 125) return false;
+    frame[0] = 0x80 | op;
+    frame[1] = 0x80 | (uint8_t)len;
+    for (int i = 0; i < 4; i++) frame[2 + i] = (uint8_t)rand();
+    for (size_t i = 0; i < len; i++) frame[6 + i] = data[i] ^ frame[2 + i % 4];
+    return send_all(fd, frame, 6 + len);
+}
+
+static int connect_to(const char *host, const char *port, int timeout_ms)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *res;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *a = res; a; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        struct timeval tv = { .tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// the upgrade; the answer is read byte by byte so no frame is taken with it
+static bool handshake(esp_websocket_client_handle_t c)
+{
+    static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char key[25];
+    for (int i = 0; i < 22; i++) key[i] = abc[rand() % 64];
+    strcpy(key + 22, "==");
+
+    char req[HOST_WS_LINE_LEN + 256];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n", c->path, c->host, c->port, key);
+    if (n < 0 || n >= (int)sizeof(req) || !send_all(c->fd, req, n)) return false;
+
+    size_t len = 0;
+    while (len < sizeof(req) - 1) {
+        if (!recv_all(c->fd, req + len, 1)) return false;
+        req[++len] = 0;
+        if (len >= 4 && strcmp(req + len - 4, "\r\n\r\n") == 0) break;
+    }
+    int status = 0;
+    if (sscanf(req, "HTTP/%*d.%*d %d", &status) != 1 || status != 101) {
+        ESP_LOGE(TAG, "upgrade refused with status %d", status);
+        return false;
+    }
+    return true;
+}
+
+// one frame of the server, data frames go out in chunks of buffer_size;
+// 1 read, 0 the server closed, -1 the connection broke
+static int read_frame(esp_websocket_client_handle_t c)
+{
+    uint8_t head[2];
+    if (!recv_all(c->fd, head, 2)) return -1;
+    esp_websocket_event_data_t d = { .fin = (head[0] & 0x80) != 0, .op_code = head[0] & 0x0F };
+    uint64_t len = head[1] & 0x7F;
+    if (len == 126 || len == 127) {
+        uint8_t ext[8];
+        int n = len == 126 ? 2 : 8;
+        if (!recv_all(c->fd, ext, n)) return -1;
+        len = 0;
+        for (int i = 0; i < n; i++) len = len << 8 | ext[i];
+    }
+    if (head[1] & 0x80 || len > INT32_MAX) return -1;   // a server does not mask
+
+    d.payload_len = (int)len;
+    do {
+        int chunk = len - d.payload_offset < (uint64_t)c->buffer_size ? (int)(len - d.payload_offset) : c->buffer_size;
+        if (!recv_all(c->fd, c->buf, chunk)) return -1;
+        d.data_ptr = c->buf;
+        d.data_len = chunk;
+        if (d.op_code == 0x9) {
+            send_frame(c->fd, 0xA, (uint8_t *)c->buf, chunk);
+        } else if (d.op_code == 0x8) {
+            send_frame(c->fd, 0x8, (uint8_t *)c->buf, chunk < 2 ? chunk : 2);
+        }
+        emit(c, WEBSOCKET_EVENT_DATA, &d);
+        d.payload_offset += chunk;
+    } while (d.payload_offset < d.payload_len);
+    return d.op_code == 0x8 ? 0 : 1;
+}
+
+static void *client_task(void *arg)
+{
+    esp_websocket_client_handle_t c = arg;
+    emit(c, WEBSOCKET_EVENT_BEFORE_CONNECT, NULL);
+    c->fd = connect_to(c->host, c->port, c->timeout_ms);
+    if (c->fd < 0 || !handshake(c)) {
+        ESP_LOGE(TAG, "cannot connect to %s:%s%s", c->host, c->port, c->path);
+        emit(c, WEBSOCKET_EVENT_ERROR, NULL);
+        emit(c, WEBSOCKET_EVENT_DISCONNECTED, NULL);
+        return NULL;
+    }
+    c->connected = true;
+    emit(c, WEBSOCKET_EVENT_CONNECTED, NULL);
+    int r = 1;
+    while (r > 0 && !c->stopping) r = read_frame(c);
+    c->connected = false;
+    if (!c->stopping) emit(c, r == 0 ? WEBSOCKET_EVENT_CLOSED : WEBSOCKET_EVENT_DISCONNECTED, NULL);
+    return NULL;
+}
+
+
+esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config)
+{
+    // ws://host[:port]/path, no ipv6 literals
+    if (config->uri == NULL || strncmp(config->uri, "ws://", 5) != 0) {
+        ESP_LOGE(TAG, "host build speaks ws:// only");
+        return NULL;
+    }
+    esp_websocket_client_handle_t c = calloc(1, sizeof(*c));
+    if (c == NULL) return NULL;
+    const char *h = config->uri + 5;
+    const char *slash = strchr(h, '/');
+    size_t hlen = slash ? (size_t)(slash - h) : strlen(h);
+    if (hlen == 0 || hlen >= sizeof(c->host) || snprintf(c->path, sizeof(c->path), "%s", slash ? slash : "/") >= (int)sizeof(c->path)) {
+        free(c);
+        return NULL;
+    }
+    memcpy(c->host, h, hlen);
+    char *colon = strchr(c->host, ':');
+    snprintf(c->port, sizeof(c->port), "%s", colon ? colon + 1 : "80");
+    if (colon) *colon = 0;
+    c->buffer_size = config->buffer_size > 0 ? config->buffer_size : 1024;
+    c->timeout_ms = config->network_timeout_ms > 0 ? config->network_timeout_ms : HOST_WS_TIMEOUT_MS;
+    c->user_context = config->user_context;
+    c->fd = -1;
+    c->buf = malloc(c->buffer_size);
+    if (c->buf == NULL) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t c, esp_websocket_event_id_t event,
+                                        esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    if (event != WEBSOCKET_EVENT_ANY) return ESP_ERR_NOT_SUPPORTED;
+    c->handler = event_handler;
+    c->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t c)
+{
+    if (c->running) return ESP_FAIL;
+    c->stopping = false;
+    if (pthread_create(&c->thread, NULL, client_task, c) != 0) return ESP_FAIL;
+    c->running = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_stop(esp_websocket_client_handle_t c)
+{
+    if (!c->running) return ESP_FAIL;
+    c->stopping = true;
+    if (c->fd >= 0) {
+        if (c->connected) send_frame(c->fd, 0x8, (const uint8_t *)"\x03\xe8", 2);
+        shutdown(c->fd, SHUT_RDWR);
+    }
+    pthread_join(c->thread, NULL);
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->running = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t c)
+{
+    if (c == NULL) return ESP_ERR_INVALID_ARG;
+    if (c->running) esp_websocket_client_stop(c);
+    free(c->buf);
+    free(c);
+    return ESP_OK;
+}
+
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t c)
+{
+    return c->connected;
+}
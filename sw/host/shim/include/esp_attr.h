@@ -0,0 +1,10 @@
+#ifndef __HOST_ESP_ATTR_H_
+#define __HOST_ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define EXT_RAM_BSS_ATTR
+
+#endif //__HOST_ESP_ATTR_H_
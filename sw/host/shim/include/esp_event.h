@@ -0,0 +1,13 @@
+#ifndef __HOST_ESP_EVENT_H_
+#define __HOST_ESP_EVENT_H_
+
+#include <stdint.h>
+
+/* The types of the event loop api that esp_websocket_client.h takes. */
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *event_handler_arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+
+#endif //__HOST_ESP_EVENT_H_
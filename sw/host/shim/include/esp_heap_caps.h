@@ -0,0 +1,19 @@
+#ifndef __HOST_ESP_HEAP_CAPS_H_
+#define __HOST_ESP_HEAP_CAPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* one heap without SPIRAM, every capability is served by calloc() */
+
+#define MALLOC_CAP_8BIT      (1 << 2)
+#define MALLOC_CAP_DMA       (1 << 3)
+#define MALLOC_CAP_SPIRAM    (1 << 10)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+#define MALLOC_CAP_DEFAULT   (1 << 12)
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+size_t heap_caps_get_total_size(uint32_t caps);
+size_t heap_caps_get_free_size(uint32_t caps);
+
+#endif //__HOST_ESP_HEAP_CAPS_H_
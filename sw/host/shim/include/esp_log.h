@@ -0,0 +1,34 @@
+#ifndef __HOST_ESP_LOG_H_
+#define __HOST_ESP_LOG_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE = 0,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+/*
+ * One global level instead of per tag, default warnings. Debug lines are
+ * still compiled, so their format strings are checked like on the target.
+ */
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void host_log(esp_log_level_t level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+extern esp_log_level_t host_log_level;
+
+#define HOST_LOG(level, tag, fmt, ...) do {                                        \
+        if ((level) <= host_log_level) host_log(level, tag, fmt, ##__VA_ARGS__);   \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG(ESP_LOG_ERROR,   tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG(ESP_LOG_WARN,    tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG(ESP_LOG_INFO,    tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG(ESP_LOG_DEBUG,   tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG(ESP_LOG_VERBOSE, tag, fmt, ##__VA_ARGS__)
+
+#endif //__HOST_ESP_LOG_H_
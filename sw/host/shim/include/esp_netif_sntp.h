@@ -0,0 +1,43 @@
+#ifndef __HOST_ESP_NETIF_SNTP_H_
+#define __HOST_ESP_NETIF_SNTP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include "esp_err.h"
+
+/*
+ * No network on the host. esp_netif_sntp_init() only keeps the config,
+ * host_sntp_answer() plays one server answer into it.
+ */
+
+typedef void (*esp_sntp_time_cb_t)(struct timeval *tv);
+
+typedef struct {
+    bool smooth_sync;
+    bool server_from_dhcp;
+    bool wait_for_sync;
+    bool start;
+    esp_sntp_time_cb_t sync_cb;
+    size_t num_of_servers;
+    const char *servers[1];
+} esp_sntp_config_t;
+
+#define ESP_NETIF_SNTP_DEFAULT_CONFIG(server) {   \
+        .smooth_sync = false,                     \
+        .server_from_dhcp = false,                \
+        .wait_for_sync = true,                    \
+        .start = true,                            \
+        .sync_cb = NULL,                          \
+        .num_of_servers = 1,                      \
+        .servers = { server },                    \
+    }
+
+esp_err_t esp_netif_sntp_init(const esp_sntp_config_t *config);
+void esp_netif_sntp_deinit(void);
+
+/** Delivers an answer of unix_us, the way lwip sntp applies it. False before init. */
+bool host_sntp_answer(int64_t unix_us);
+
+#endif //__HOST_ESP_NETIF_SNTP_H_
@@ -0,0 +1,9 @@
+#ifndef __HOST_ESP_ROM_CRC_H_
+#define __HOST_ESP_ROM_CRC_H_
+
+#include <stdint.h>
+
+/** Same crc as the rom function and zlib.crc32 in the image tools. */
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif //__HOST_ESP_ROM_CRC_H_
@@ -0,0 +1,4 @@
+#ifndef __HOST_ESP_SLEEP_H_
+#define __HOST_ESP_SLEEP_H_
+
+#endif //__HOST_ESP_SLEEP_H_
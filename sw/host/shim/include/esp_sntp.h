@@ -0,0 +1,14 @@
+#ifndef __HOST_ESP_SNTP_H_
+#define __HOST_ESP_SNTP_H_
+
+#include <stdint.h>
+#include <sys/time.h>
+#include "lwip/ip_addr.h"
+
+#define SNTP_MAX_SERVERS 1
+
+const char *esp_sntp_getservername(uint8_t idx);
+const ip_addr_t *esp_sntp_getserver(uint8_t idx);
+void sntp_set_sync_interval(uint32_t interval_ms);
+
+#endif //__HOST_ESP_SNTP_H_
@@ -0,0 +1,7 @@
+#ifndef __HOST_ESP_SYSTEM_H_
+#define __HOST_ESP_SYSTEM_H_
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#endif //__HOST_ESP_SYSTEM_H_
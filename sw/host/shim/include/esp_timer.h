@@ -0,0 +1,9 @@
+#ifndef __HOST_ESP_TIMER_H_
+#define __HOST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+/** Microseconds of the virtual clock since the host "boot". */
+int64_t esp_timer_get_time(void);
+
+#endif //__HOST_ESP_TIMER_H_
@@ -0,0 +1,62 @@
+#ifndef __HOST_ESP_WEBSOCKET_CLIENT_H_
+#define __HOST_ESP_WEBSOCKET_CLIENT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "freertos/FreeRTOS.h"
+
+/*
+ * The part of espressif/esp_websocket_client that live_push.c uses, on a
+ * plain socket and a pthread: ws:// only, no automatic reconnect, no pings.
+ * Messages arrive in DATA events of at most buffer_size bytes with
+ * payload_len and payload_offset set as the component does.
+ */
+
+ESP_EVENT_DECLARE_BASE(WEBSOCKET_EVENTS);
+
+typedef enum {
+    WEBSOCKET_EVENT_ANY = -1,
+    WEBSOCKET_EVENT_ERROR = 0,
+    WEBSOCKET_EVENT_CONNECTED,
+    WEBSOCKET_EVENT_DISCONNECTED,
+    WEBSOCKET_EVENT_DATA,
+    WEBSOCKET_EVENT_CLOSED,
+    WEBSOCKET_EVENT_BEFORE_CONNECT,
+    WEBSOCKET_EVENT_MAX
+} esp_websocket_event_id_t;
+
+typedef struct esp_websocket_client *esp_websocket_client_handle_t;
+
+typedef struct {
+    const char *data_ptr;
+    int data_len;
+    bool fin;
+    uint8_t op_code;
+    esp_websocket_client_handle_t client;
+    void *user_context;
+    int payload_len;
+    int payload_offset;
+} esp_websocket_event_data_t;
+
+typedef struct {
+    const char *uri;
+    int buffer_size;
+    int network_timeout_ms;
+    int ping_interval_sec;
+    bool disable_auto_reconnect;
+    void *user_context;
+} esp_websocket_client_config_t;
+
+esp_websocket_client_handle_t esp_websocket_client_init(const esp_websocket_client_config_t *config);
+esp_err_t esp_websocket_register_events(esp_websocket_client_handle_t client, esp_websocket_event_id_t event,
+                                        esp_event_handler_t event_handler, void *event_handler_arg);
+esp_err_t esp_websocket_client_start(esp_websocket_client_handle_t client);
+/** Closes the connection and joins the client's thread, not from an event handler. */
+esp_err_t esp_websocket_client_stop(esp_websocket_client_handle_t client);
+esp_err_t esp_websocket_client_destroy(esp_websocket_client_handle_t client);
+bool esp_websocket_client_is_connected(esp_websocket_client_handle_t client);
+
+#endif //__HOST_ESP_WEBSOCKET_CLIENT_H_
@@ -0,0 +1,30 @@
+#ifndef __HOST_FREERTOS_H_
+#define __HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+/*
+ * The part of the FreeRTOS api the pipeline modules use, on pthreads.
+ * Ticks run at the firmware's 100 Hz on the virtual clock of host_clock.h.
+ */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define pdFAIL              pdFALSE
+#define portMAX_DELAY       ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ  100
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define configASSERT(x)     assert(x)
+
+#endif //__HOST_FREERTOS_H_
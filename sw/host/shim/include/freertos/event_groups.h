@@ -0,0 +1,20 @@
+#ifndef __HOST_EVENT_GROUPS_H_
+#define __HOST_EVENT_GROUPS_H_
+
+#include "freertos/FreeRTOS.h"
+
+#define BIT0 0x00000001
+#define BIT1 0x00000002
+#define BIT2 0x00000004
+#define BIT3 0x00000008
+
+typedef uint32_t EventBits_t;
+typedef struct host_events *EventGroupHandle_t;
+
+EventGroupHandle_t xEventGroupCreate(void);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t ticks);
+
+#endif //__HOST_EVENT_GROUPS_H_
@@ -0,0 +1,12 @@
+#ifndef __HOST_SEMPHR_H_
+#define __HOST_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_sem *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif //__HOST_SEMPHR_H_
@@ -0,0 +1,13 @@
+#ifndef __HOST_TASK_H_
+#define __HOST_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+/** Ticks of the virtual clock. */
+TickType_t xTaskGetTickCount(void);
+
+/** Advances the virtual clock, the host runs one task at a time. */
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *prev, TickType_t period);
+
+#endif //__HOST_TASK_H_
@@ -0,0 +1,41 @@
+#ifndef __HOST_CLOCK_H_
+#define __HOST_CLOCK_H_
+
+#include <stdint.h>
+
+/*
+ * Virtual clock for the host build. time(), gettimeofday(), settimeofday()
+ * and adjtime() of the firmware sources are linked to it (-Wl,--wrap), as
+ * are esp_timer_get_time() and the tick count. It only moves when told to,
+ * so a replay or soak run is repeatable and needs no real waiting.
+ *
+ * adjtime() slews like newlib on the target: 1/64 of the elapsed time goes
+ * into the correction, so a 1 s error is gone after 64 s.
+ */
+
+#define HOST_CLOCK_SLEW_SHIFT   6       // correction rate 2^-6
+#define HOST_CLOCK_ADJ_MAX_S    (35 * 60)   // adjtime() refuses more, as on the target
+
+/** Sets the wall clock, drops a running slew. */
+void host_clock_set_us(int64_t unix_us);
+
+/** Moves time forward, wall clock and esp_timer alike. */
+void host_clock_advance_us(int64_t us);
+
+/**
+ * From now on the clock runs with the real one, starting at the real wall
+ * time, and vTaskDelay() sleeps. For services like bvg_proxy; Date headers
+ * still slew it through adjtime() as on the target.
+ */
+void host_clock_run_real(void);
+
+/** Wall clock in us since the epoch. */
+int64_t host_clock_now_us(void);
+
+/** us since the host "boot", what esp_timer_get_time() returns. */
+int64_t host_clock_uptime_us(void);
+
+/** Real monotonic time in ns, for measuring the host itself. */
+int64_t host_clock_real_ns(void);
+
+#endif //__HOST_CLOCK_H_
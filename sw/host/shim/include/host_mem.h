@@ -0,0 +1,22 @@
+#ifndef __HOST_MEM_H_
+#define __HOST_MEM_H_
+
+#include <stddef.h>
+
+/*
+ * Heap accounting for the host build. malloc(), calloc(), realloc() and
+ * free() of everything linked into the pipeline are wrapped (-Wl,--wrap),
+ * so the bytes the decoder allocates per response show up here.
+ */
+
+/** Bytes currently allocated through the wrapped functions. */
+size_t host_mem_in_use(void);
+
+/** Highest host_mem_in_use() since the last host_mem_reset_peak(). */
+size_t host_mem_peak(void);
+void host_mem_reset_peak(void);
+
+/** Allocations since start. */
+size_t host_mem_allocs(void);
+
+#endif //__HOST_MEM_H_
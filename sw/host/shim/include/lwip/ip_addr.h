@@ -0,0 +1,12 @@
+#ifndef __HOST_IP_ADDR_H_
+#define __HOST_IP_ADDR_H_
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t addr;
+} ip_addr_t;
+
+char *ipaddr_ntoa_r(const ip_addr_t *addr, char *buf, int buflen);
+
+#endif //__HOST_IP_ADDR_H_
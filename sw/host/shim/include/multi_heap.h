@@ -0,0 +1,31 @@
+#ifndef __HOST_MULTI_HEAP_H_
+#define __HOST_MULTI_HEAP_H_
+
+#include <stddef.h>
+
+/*
+ * First fit heap inside the caller's buffer, so a private heap such as the
+ * tripring's fills up and fragments like on the target. Not the TLSF of
+ * ESP-IDF, block overhead and placement differ a little.
+ */
+
+typedef struct multi_heap_info *multi_heap_handle_t;
+
+typedef struct {
+    size_t total_free_bytes;
+    size_t total_allocated_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;
+    size_t allocated_blocks;
+    size_t free_blocks;
+    size_t total_blocks;
+} multi_heap_info_t;
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size);
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size);
+void multi_heap_free(multi_heap_handle_t heap, void *p);
+size_t multi_heap_free_size(multi_heap_handle_t heap);
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap);
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info);
+
+#endif //__HOST_MULTI_HEAP_H_
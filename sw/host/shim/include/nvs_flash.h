@@ -0,0 +1,6 @@
+#ifndef __HOST_NVS_FLASH_H_
+#define __HOST_NVS_FLASH_H_
+
+#include "esp_err.h"
+
+#endif //__HOST_NVS_FLASH_H_
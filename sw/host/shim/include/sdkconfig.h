@@ -0,0 +1,9 @@
+#ifndef __HOST_SDKCONFIG_H_
+#define __HOST_SDKCONFIG_H_
+
+/* the options of sdkconfig.esp32dev the pipeline modules look at, traces off */
+#define CONFIG_SNTP_TIME_SERVER "pool.ntp.org"
+#define CONFIG_SNTP_TIME_SYNC_METHOD_SMOOTH 1
+#define CONFIG_FREERTOS_HZ 100
+
+#endif //__HOST_SDKCONFIG_H_
@@ -0,0 +1,120 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "multi_heap.h"
+
+/*
+ * The heap state sits at the start of the buffer, followed by the blocks.
+ * Every block has an 8 byte header, blocks are 8 byte aligned and follow
+ * each other without gaps, so walking the sizes visits all of them.
+ */
+
+typedef struct {
+    uint32_t size;      // whole block incl. header
+    uint32_t used;
+} block_t;
+
+struct multi_heap_info {
+    uint8_t *start;
+    uint8_t *end;
+    size_t   free_bytes;
+    size_t   min_free_bytes;
+};
+
+#define ALIGN(x)   (((x) + 7u) & ~(size_t)7u)
+#define HDR        sizeof(block_t)
+#define MIN_SPLIT  (HDR + 8)
+
+static block_t *next_block(multi_heap_handle_t heap, block_t *b)
+{
+    uint8_t *n = (uint8_t *)b + b->size;
+    return n < heap->end ? (block_t *)n : NULL;
+}
+
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size)
+{
+    uint8_t *base = (uint8_t *)ALIGN((uintptr_t)start);
+    size_t skip = (size_t)(base - (uint8_t *)start) + ALIGN(sizeof(struct multi_heap_info));
+    if (size < skip + MIN_SPLIT) return NULL;
+
+    multi_heap_handle_t heap = (multi_heap_handle_t)base;
+    heap->start = base + ALIGN(sizeof(struct multi_heap_info));
+    heap->end = heap->start + ((size - skip) & ~(size_t)7u);
+
+    block_t *b = (block_t *)heap->start;
+    b->size = (uint32_t)(heap->end - heap->start);
+    b->used = 0;
+    heap->free_bytes = b->size - HDR;
+    heap->min_free_bytes = heap->free_bytes;
+    return heap;
+}
+
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
+{
+    if (heap == NULL || size == 0) return NULL;
+    size_t need = ALIGN(size) + HDR;
+
+    for (block_t *b = (block_t *)heap->start; b; b = next_block(heap, b)) {
+        if (b->used || b->size < need) continue;
+        if (b->size - need >= MIN_SPLIT) {
+            block_t *rest = (block_t *)((uint8_t *)b + need);
+            rest->size = b->size - (uint32_t)need;
+            rest->used = 0;
+            b->size = (uint32_t)need;
+            heap->free_bytes -= need;
+        } else {
+            heap->free_bytes -= b->size - HDR;
+        }
+        b->used = 1;
+        if (heap->free_bytes < heap->min_free_bytes) heap->min_free_bytes = heap->free_bytes;
+        return (uint8_t *)b + HDR;
+    }
+    return NULL;
+}
+
+void multi_heap_free(multi_heap_handle_t heap, void *p)
+{
+    if (heap == NULL || p == NULL) return;
+    block_t *b = (block_t *)((uint8_t *)p - HDR);
+    b->used = 0;
+    heap->free_bytes += b->size - HDR;
+
+    // merge every run of free blocks, a free header becomes payload
+    for (block_t *c = (block_t *)heap->start; c; c = next_block(heap, c)) {
+        if (c->used) continue;
+        block_t *n;
+        while ((n = next_block(heap, c)) != NULL && !n->used) {
+            c->size += n->size;
+            heap->free_bytes += HDR;
+        }
+    }
+}
+
+size_t multi_heap_free_size(multi_heap_handle_t heap)
+{
+    return heap ? heap->free_bytes : 0;
+}
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
+{
+    return heap ? heap->min_free_bytes : 0;
+}
+
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (heap == NULL) return;
+    for (block_t *b = (block_t *)heap->start; b; b = next_block(heap, b)) {
+        info->total_blocks++;
+        if (b->used) {
+            info->allocated_blocks++;
+            info->total_allocated_bytes += b->size - HDR;
+        } else {
+            info->free_blocks++;
+            if (b->size - HDR > info->largest_free_block) info->largest_free_block = b->size - HDR;
+        }
+    }
+    info->total_free_bytes = heap->free_bytes;
+    info->minimum_free_bytes = heap->min_free_bytes;
+}
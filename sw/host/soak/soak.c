@@ -0,0 +1,371 @@
+/*
+ * Runs the fetcher's data path for days of virtual time and watches the heap:
+ * the system heap (decoder, json parser) and the private heap of the
+ * tripring, which both churn on every pass. Fails if one of them gets worse
+ * window after window, the signature of a leak or of fragmentation.
+ *
+ * The traffic is the recorded fixtures, replayed in the order BVG_run() uses:
+ * one list, then every trip with 100 ms in between, one pass every -p seconds.
+ * Every -r minutes the recording is served again with its times moved forward
+ * and its trip ids renamed, so trips enter and expire like on a real line.
+ * Every -t hours another fixture is selected and the ring cleared, as after a
+ * touch. The clock is the virtual one of the host build, a day takes seconds.
+ *
+ *   bvg_soak [-d days] [-p pass s] [-r replay min] [-t touch h] [-s sample min]
+ *            [-w windows] [-k leak bytes] [-o samples.csv] [-v] fixture_dir...
+ *
+ * tools/soak_chart.py draws the csv. -k leaks on purpose, to see the check fire.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <getopt.h>
+#include "esp_log.h"
+#include "tripring.h"
+#include "mem_tier.h"
+#include "time_server.h"
+#include "line_data.h"
+#include "trip_decode.h"
+#include "metrics.h"
+#include "host_clock.h"
+#include "host_mem.h"
+#include "fixture.h"
+
+#define RESPONSE_SIZE   (32768+16384)   // HTTP_RESPONSE_BUFFER_SIZE of requests.c
+#define FETCH_GAP_US    100000          // vTaskDelay() before every fetch in BVG_run()
+#define WARMUP_PERCENT  10              // samples left out of the check
+
+typedef struct {
+    int64_t  t;              // virtual seconds since start
+    size_t   sys_in_use;     // system heap, bytes
+    uint32_t tr_free;        // tripring heap, bytes
+    uint32_t tr_largest;
+    uint32_t tr_trips;
+    uint32_t fetches;
+} sample_t;
+
+typedef enum {
+    SERIES_SYS = 0,
+    SERIES_TR_FREE,
+    SERIES_TR_LARGEST,
+    SERIES_TR_TRIPS,
+    SERIES_NUM
+} series_t;
+
+static const struct {
+    const char *name;
+    bool        rising_is_bad;   // worst value of a window is its max, else its min
+} series[] = {
+    [SERIES_SYS]        = { "system heap in use", true },
+    [SERIES_TR_FREE]    = { "tripring heap free", false },
+    [SERIES_TR_LARGEST] = { "tripring largest block", false },
+    [SERIES_TR_TRIPS]   = { "tripring trips", true },
+};
+
+// one fixture and the ids of its list, to find the trip answer to an id
+typedef struct {
+    fixture_t fx;
+    char      ids[FIXTURE_MAX_TRIPS][MAX_TRIP_ID_LEN];
+    int       n_ids;
+} line_t;
+
+static size_t trip_buf[(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+static char trip_ids[FIXTURE_MAX_TRIPS][MAX_TRIP_ID_LEN];
+static char response[RESPONSE_SIZE + 1];
+static uint32_t fetches, fetch_fail, decode_fail;
+static void *leaked;   // -k, kept reachable so the allocations stay
+
+
+static int64_t now_s(void)
+{
+    return host_clock_now_us() / 1000000;
+}
+
+static bool is_digits(const char *p, int n)
+{
+    for (int i = 0; i < n; i++) if (p[i] < '0' || p[i] > '9') return false;
+    return true;
+}
+
+// moves every "YYYY-MM-DDTHH:MM:SS" by shift seconds in place, the utc offset behind it stays
+static void shift_times(char *buf, size_t len, int64_t shift)
+{
+    for (char *t = memchr(buf, 'T', len); t; t = memchr(t + 1, 'T', buf + len - t - 1)) {
+        char *p = t - 10;
+        if (p < buf || t + 9 > buf + len) continue;
+        if (p[4] != '-' || p[7] != '-' || p[13] != ':' || p[16] != ':') continue;
+        if (!is_digits(p, 4) || !is_digits(p + 5, 2) || !is_digits(p + 8, 2) ||
+            !is_digits(p + 11, 2) || !is_digits(p + 14, 2) || !is_digits(p + 17, 2)) continue;
+        struct tm tm = {0};
+        tm.tm_year = atoi(p) - 1900;
+        tm.tm_mon  = atoi(p + 5) - 1;
+        tm.tm_mday = atoi(p + 8);
+        tm.tm_hour = atoi(p + 11);
+        tm.tm_min  = atoi(p + 14);
+        tm.tm_sec  = atoi(p + 17);
+        time_t moved = timegm(&tm) + shift;
+        gmtime_r(&moved, &tm);
+        char out[32];
+        if (strftime(out, sizeof(out), "%Y-%m-%dT%H:%M:%S", &tm) == 19) memcpy(p, out, 19);
+    }
+}
+
+// the last '|' field of a trip id is its service day, it becomes the replay epoch
+static void rename_ids(char *buf, const line_t *l, uint32_t epoch)
+{
+    for (int k = 0; k < l->n_ids; k++) {
+        const char *id = l->ids[k];
+        const char *bar = strrchr(id, '|');
+        if (bar == NULL) continue;
+        int prefix = (int)(bar + 1 - id);
+        int width = (int)strlen(bar + 1);
+        if (width < 4 || width > 9 || !is_digits(bar + 1, width)) continue;
+        uint32_t mod = 1;
+        for (int i = 0; i < width; i++) mod *= 10;
+        char day[12];
+        snprintf(day, sizeof(day), "%0*u", width, epoch % mod);
+        for (char *p = strstr(buf, id); p; p = strstr(p + 1, id)) memcpy(p + prefix, day, width);
+    }
+}
+
+// the api as the soak sees it: the answer of the fixture, moved to the current epoch
+static bool soak_fetch(const line_t *l, int trip, int64_t shift, uint32_t epoch)
+{
+    const blob_t *b = trip < 0 ? &l->fx.list : (trip < (int)l->fx.n_trips ? &l->fx.trips[trip] : NULL);
+    fetches++;
+    if (b == NULL || b->len > RESPONSE_SIZE) {
+        fetch_fail++;
+        return false;
+    }
+    memcpy(response, b->data, b->len + 1);
+    shift_times(response, b->len, shift);
+    rename_ids(response, l, epoch);
+    return true;
+}
+
+// position of a renamed id in the fixture's list, -1 if unknown
+static int find_trip(const line_t *l, const char *id)
+{
+    const char *bar = strrchr(id, '|');
+    size_t prefix = bar ? (size_t)(bar - id) : strlen(id);
+    for (int k = 0; k < l->n_ids; k++) {
+        if (strncmp(l->ids[k], id, prefix) == 0 && (l->ids[k][prefix] == '|' || l->ids[k][prefix] == 0)) return k;
+    }
+    return -1;
+}
+
+// one pass of BVG_run() over the selected line
+static void pass(const line_t *l, int64_t shift, uint32_t epoch, size_t leak)
+{
+    Trip *trip = (Trip *)trip_buf;
+
+    host_clock_advance_us(FETCH_GAP_US);
+    if (!soak_fetch(l, -1, shift, epoch)) return;
+    int n = trip_decode_list(response, trip_ids, FIXTURE_MAX_TRIPS);
+
+    for (int y = 0; y < n; y++) {
+        host_clock_advance_us(FETCH_GAP_US);
+        if (!soak_fetch(l, find_trip(l, trip_ids[y]), shift, epoch)) continue;
+        if (!trip_decode(response, trip)) {
+            decode_fail++;
+            continue;
+        }
+        tr_take();
+        tr_put(trip);
+        tr_free_old(get_unix_seconds());
+        tr_release();
+    }
+    if (leak) {
+        void **p = malloc(leak < sizeof(void *) ? sizeof(void *) : leak);
+        *p = leaked;
+        leaked = p;
+    }
+}
+
+static void take_sample(sample_t *s, int64_t t)
+{
+    s->t = t;
+    s->sys_in_use = host_mem_in_use();
+    s->tr_free = metric_get(METRIC_TR_HEAP_FREE);
+    s->tr_largest = metric_get(METRIC_TR_HEAP_LARGEST);
+    s->tr_trips = metric_get(METRIC_TR_SIZE);
+    s->fetches = fetches;
+}
+
+static double value(const sample_t *s, series_t k)
+{
+    switch (k) {
+    case SERIES_SYS:        return (double)s->sys_in_use;
+    case SERIES_TR_FREE:    return s->tr_free;
+    case SERIES_TR_LARGEST: return s->tr_largest;
+    default:                return s->tr_trips;
+    }
+}
+
+
+/*
+ * After the warm-up the samples are cut into windows and the worst value of
+ * every window is taken. A series that gets strictly worse from each window
+ * to the next one degrades monotonically; a healthy run levels off, so some
+ * window repeats or beats the one before.
+ */
+static bool check(const sample_t *s, uint32_t n, uint32_t windows)
+{
+    uint32_t first = n * WARMUP_PERCENT / 100;
+    uint32_t per = windows ? (n - first) / windows : 0;
+    if (windows < 2 || per == 0) {
+        printf("too few samples for %u windows, no check\n", windows);
+        return true;
+    }
+
+    bool ok = true;
+    printf("%-24s", "worst per window");
+    for (uint32_t w = 0; w < windows; w++) printf(" %9u", w);
+    printf("\n");
+    for (int k = 0; k < SERIES_NUM; k++) {
+        double prev = 0;
+        uint32_t worse = 0;
+        printf("%-24s", series[k].name);
+        for (uint32_t w = 0; w < windows; w++) {
+            const sample_t *ws = s + first + w * per;
+            double worst = value(&ws[0], k);
+            for (uint32_t i = 1; i < per; i++) {
+                double v = value(&ws[i], k);
+                if (series[k].rising_is_bad ? v > worst : v < worst) worst = v;
+            }
+            if (w > 0 && (series[k].rising_is_bad ? worst > prev : worst < prev)) worse++;
+            prev = worst;
+            printf(" %9.0f", worst);
+        }
+        bool degrading = worse == windows - 1;
+        printf("%s\n", degrading ? "  DEGRADING" : "");
+        if (degrading) ok = false;
+    }
+    return ok;
+}
+
+static bool write_csv(const char *path, const sample_t *s, uint32_t n)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+    fprintf(f, "t_s,sys_in_use,tr_free,tr_largest,tr_trips,fetches\n");
+    for (uint32_t i = 0; i < n; i++) {
+        fprintf(f, "%lld,%zu,%u,%u,%u,%u\n", (long long)s[i].t, s[i].sys_in_use,
+                s[i].tr_free, s[i].tr_largest, s[i].tr_trips, s[i].fetches);
+    }
+    fclose(f);
+    return true;
+}
+
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-d days] [-p pass s] [-r replay min] [-t touch h] [-s sample min]\n"
+                    "       [-w windows] [-k leak bytes] [-o samples.csv] [-v] fixture_dir...\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    double days = 3;
+    uint32_t pass_s = 30;         // TIMETABLE_PASS_PERIOD_S
+    uint32_t replay_min = 20;
+    double touch_h = 4;
+    uint32_t sample_min = 5;
+    uint32_t windows = 6;
+    size_t leak = 0;
+    const char *csv = NULL;
+    int opt;
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    while ((opt = getopt(argc, argv, "d:p:r:t:s:w:k:o:v")) != -1) {
+        switch (opt) {
+        case 'd': days = strtod(optarg, NULL); break;
+        case 'p': pass_s = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'r': replay_min = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 't': touch_h = strtod(optarg, NULL); break;
+        case 's': sample_min = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'w': windows = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'k': leak = strtoul(optarg, NULL, 0); break;
+        case 'o': csv = optarg; break;
+        case 'v': esp_log_level_set("*", ESP_LOG_INFO); break;
+        default:  usage(argv[0]); return 2;
+        }
+    }
+    if (optind >= argc || days <= 0 || pass_s == 0 || replay_min == 0 || sample_min == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    uint32_t n_lines = argc - optind;
+    line_t *lines = calloc(n_lines, sizeof(line_t));
+    for (uint32_t i = 0; i < n_lines; i++) {
+        if (!load_fixture(argv[optind + i], &lines[i].fx)) return 1;
+        lines[i].n_ids = trip_decode_list(lines[i].fx.list.data, lines[i].ids, FIXTURE_MAX_TRIPS);
+    }
+
+    mem_tier_init();
+    time_server_init();
+    line_data_init();
+    tr_init();
+
+    const int64_t t0 = lines[0].fx.now;
+    const int64_t end = t0 + (int64_t)(days * 86400);
+    const int64_t replay_s = replay_min * 60;
+    const int64_t touch_s = touch_h > 0 ? (int64_t)(touch_h * 3600) : INT64_MAX;
+    host_clock_set_us(t0 * 1000000);
+
+    uint32_t cap = (uint32_t)((end - t0) / (sample_min * 60)) + 2;
+    sample_t *samples = calloc(cap, sizeof(sample_t));
+    uint32_t n_samples = 0;
+    int64_t next_sample = t0;
+    uint32_t selected = 0;
+    int64_t next_touch = t0 + touch_s;
+
+    for (int64_t t = t0; t < end; t = now_s()) {
+        if (t >= next_touch) {
+            selected = (selected + 1) % n_lines;
+            tr_take();
+            tr_clear_all();
+            tr_release();
+            next_touch += touch_s;
+        }
+
+        const line_t *l = &lines[selected];
+        uint32_t epoch = (uint32_t)((t - t0) / replay_s);
+        int64_t shift = t0 - l->fx.now + (int64_t)epoch * replay_s;
+        int64_t start_us = host_clock_now_us();
+        pass(l, shift, epoch, leak);
+
+        // the rest of the pass period, as with a valid timetable
+        int64_t spent_us = host_clock_now_us() - start_us;
+        if (spent_us < (int64_t)pass_s * 1000000) host_clock_advance_us((int64_t)pass_s * 1000000 - spent_us);
+
+        if (now_s() >= next_sample && n_samples < cap) {
+            take_sample(&samples[n_samples++], now_s() - t0);
+            next_sample += sample_min * 60;
+        }
+    }
+
+    printf("%.1f virtual days, %u samples, %u fetches (%u failed), %u decode failures, %u trips put, %u expired\n",
+           days, n_samples, fetches, fetch_fail, decode_fail,
+           metric_get(METRIC_TRIPS_PUT), metric_get(METRIC_TRIPS_EXPIRED));
+    printf("tripring heap free at least %u bytes, system heap %zu bytes in use at the end\n",
+           metric_get(METRIC_TR_HEAP_MIN_FREE), host_mem_in_use());
+
+    bool ok = check(samples, n_samples, windows);
+    if (csv && !write_csv(csv, samples, n_samples)) return 1;
+    if (decode_fail) {
+        fprintf(stderr, "%u answers did not decode\n", decode_fail);
+        return 1;
+    }
+    if (!ok) {
+        fprintf(stderr, "monotonic degradation\n");
+        return 1;
+    }
+    return 0;
+}
@@ -7,18 +7,23 @@
 #include "cap_touch.h"
 #include "led.h"
 #include "line_state.h"
+#include "line_data.h"
 #include "time_server.h"
 #include "tripring.h"
+#include "mem_tier.h"
 #include "requests.h"
 #include "provisioning.h"
+#include "prof.h"
+#include "status_server.h"
+#include "snapshot.h"
+#include "timetable.h"
+#include "api_backend.h"
 
 //static const char * TAG = "APP_INIT";
 
 static void cap_touch_task(void *pvParameters)
 {
-    // the first one runs until the init sequence is completed
-    // enables to possibility to restart provisioning
-    cap_touch_check();
+    // touches during the reset provisioning window only arm the reset
     cap_touch_run();
 }
 static void led_task(void *pvParameters)
@@ -37,32 +42,69 @@ static void http_request_task(void *pvParameters)
 void app_main() 
 {
     esp_log_level_set("esp-x509-crt-bundle", ESP_LOG_ERROR);
-    esp_log_level_set("BVG_FETCHER", ESP_LOG_VERBOSE);
     
+    // before anything takes a large buffer
+    mem_tier_init();
+    prof_init();
+    // api times are decoded as local time, the first fetch may come before sntp
+    time_server_init();
+    line_data_init();
+    // read by the fetcher and the status server, filled before either starts
+    api_backend_init();
     line_state_init();
     line_state_set_init_mode();
+    line_state_set_calibration_mode();
+    line_state_set_network_mode();
     led_stripe_init();
     cap_touch_init();
+
     tr_init();
+    timetable_init();
+    // trains from before the reset are shown while wifi and sntp come up,
+    // the ring is filled before the led task draws from it
+    snapshot_restore();
 
     // got into the check if provisioning can be reset mode
     line_state_set_reset_provisioning_mode();
+    // touch calibrates in its own task while the rest comes up
     xTaskCreatePinnedToCore(cap_touch_task, "cap_touch_task", 4096, NULL, 5, NULL, 1);
+    xTaskCreatePinnedToCore(led_task, "led_task", 4096, NULL, 5, NULL, 1);
 
-    xTaskCreatePinnedToCore(cap_touch_task, "cap_touch_task", 4096, NULL, 5, NULL, 1);
+    // blocks until there is an ip
     xTaskCreatePinnedToCore(http_request_task, "http_request_task", 8192, NULL, 5, NULL, 0);
-    xTaskCreatePinnedToCore(led_task, "led_task", 4096, NULL, 5, NULL, 1);
+    prof_start();
+
+    // wifi driver up, with stored credentials already connecting
+    provisioning_prepare();
+    prof_boot_mark(PROF_BOOT_INIT);
 
-    // wait init sequence
+    // wait for 3 seconds while displaying key pattern to indicate that credentials can be deleted,
+    // touches are only seen once the baseline is known
+    line_state_wait_calibration_mode(portMAX_DELAY);
     vTaskDelay(pdMS_TO_TICKS(3000));
     line_state_release_reset_provisioning_mode();
+    prof_boot_mark(PROF_BOOT_RESET_WINDOW);
 
-    // wait for 3 seconds while displaying key pattern to indicate that credentials can be deleted
     bool reset = cap_touch_check_is_pressed();
     provisioning(reset);
-    
-    time_server();
+    // the station may have connected during the reset window
+    if (provisioning_sta_start_us()) prof_boot_mark_at(PROF_BOOT_WIFI_START, provisioning_sta_start_us());
+    if (provisioning_got_ip_us()) prof_boot_mark_at(PROF_BOOT_WIFI_UP, provisioning_got_ip_us());
+    else prof_boot_mark(PROF_BOOT_WIFI_UP);
+    line_state_release_network_mode();
+    status_server_start();
+
+    // a clock seeded from the rtc snapshot of a warm reset is close enough to draw with
+    if (get_unix_seconds() >= TIME_VALID_AFTER) {
+        line_state_release_init_mode();
+        prof_boot_mark(PROF_BOOT_RENDER);
+    }
+
+    // sntp keeps running, the Date header of the first api answer may be faster
+    time_server_start();
+    if (time_server_wait_synced(pdMS_TO_TICKS(30000))) prof_boot_mark(PROF_BOOT_TIME_SYNCED);
     print_time();
 
     line_state_release_init_mode();
-}
\ No newline at end of file
+    prof_boot_mark(PROF_BOOT_RENDER);
+}
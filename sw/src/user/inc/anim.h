@@ -0,0 +1,57 @@
+#ifndef __ANIM_H_
+#define __ANIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Keyframe timeline for the map overlays (line labels, station highlights).
+ * Nothing in here blocks: a timeline is started once and then rendered every
+ * frame from the elapsed time, so the LED task keeps its fixed frame rate.
+ */
+
+#define ANIM_MAX_LAYERS    4
+#define ANIM_TRACE_STOP_MS 25     // label trace, about half a second for a line of 20 stops
+
+typedef enum {
+    ANIM_LAYER_TEXT = 0,   // 7 segment string, one glyph per slot
+    ANIM_LAYER_LINE,       // all stations of one line
+    ANIM_LAYER_TRACE,      // one line drawn stop by stop from its first stop
+} anim_layer_type_t;
+
+typedef struct {
+    anim_layer_type_t type;
+    uint32_t start_ms;     // offset from timeline start
+    uint32_t duration_ms;  // visible time of the layer
+    uint32_t on_ms;        // text: glyph time, line: blink on time (0 = steady), trace: time per stop
+    uint32_t off_ms;       // text: gap between glyphs, line: blink off time
+    uint32_t fade_in_ms;   // linear ramp at the start of the layer
+    uint32_t fade_out_ms;  // linear ramp at the end of the layer
+    uint8_t  r, g, b;
+    const char *text;      // ANIM_LAYER_TEXT
+    uint8_t  line_nr;      // ANIM_LAYER_LINE, ANIM_LAYER_TRACE
+} anim_layer_t;
+
+typedef struct {
+    anim_layer_t layers[ANIM_MAX_LAYERS];
+    uint8_t  n_layers;
+    uint32_t length_ms;    // end of the last layer
+    int64_t  start_ms;     // < 0 while stopped
+} anim_timeline_t;
+
+void anim_timeline_clear(anim_timeline_t *tl);
+anim_layer_t *anim_timeline_add(anim_timeline_t *tl, const anim_layer_t *layer);
+void anim_timeline_start(anim_timeline_t *tl, int64_t now_ms);
+void anim_timeline_stop(anim_timeline_t *tl);
+bool anim_timeline_active(const anim_timeline_t *tl, int64_t now_ms);
+
+/** Composite all visible layers into f. Returns false once the timeline is over. */
+bool anim_timeline_render(const anim_timeline_t *tl, int64_t now_ms, frame_t *f);
+
+/** Line name as glyph sequence, a trace along the line, then its stations; starts it. */
+void anim_line_label(anim_timeline_t *tl, uint32_t line_nr, uint32_t on_ms, uint32_t off_ms, uint32_t hold_ms, int64_t now_ms);
+
+int64_t anim_now_ms(void);
+
+#endif //__ANIM_H_
@@ -0,0 +1,73 @@
+#ifndef __API_BACKEND_H_
+#define __API_BACKEND_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * The hafas-rest-api instances the fetcher can ask, in order of preference:
+ * CONFIG_BVG_API_BASE_URL first, then CONFIG_BVG_API_FALLBACK_URLS, e.g.
+ * the vbb instance of transport.rest or a self-hosted one. The fetcher picks
+ * one with api_backend_pick() before the list request of a pass and sends
+ * the trip requests of that list to the same one, trip ids need not be
+ * valid on another instance. Urls are built for the picked backend and
+ * every result comes back with api_backend_report().
+ *
+ * A backend is scored by the moving average of its latency, a failure
+ * counting as API_BACKEND_FAIL_US. Requests go to the current backend until
+ * another is clearly faster. API_BACKEND_DOWN_AFTER failures in a row take a
+ * backend out; it gets a single request again after API_BACKEND_RETRY_S,
+ * doubling up to API_BACKEND_RETRY_MAX_S while it keeps failing. A backend
+ * that is up but unused gets one request every API_BACKEND_PROBE_S, so its
+ * score stays current. Both are probes: a list request between two passes,
+ * its answer only scores the backend.
+ */
+
+#define API_BACKENDS_MAX          4
+#define API_BACKEND_FAIL_US       5000000
+#define API_BACKEND_DOWN_AFTER    3
+#define API_BACKEND_RETRY_S       30
+#define API_BACKEND_RETRY_MAX_S   600
+#define API_BACKEND_PROBE_S       300
+#define API_BACKEND_SWITCH_PCT    80       // another backend takes over below this share of the current latency
+
+typedef struct {
+    const char *base;
+    bool     up;
+    bool     current;
+    uint32_t latency_us;        // moving average, failures included
+    uint32_t requests;
+    uint32_t failures;
+} api_backend_stats_t;
+
+/** Loads the backends of the build. Call once before the fetcher and the status server start. */
+void api_backend_init(void);
+
+/** Replaces all backends with base, false if it is too long. Call before the fetcher runs. */
+bool api_backend_set(const char *base);
+
+/** Adds a backend after the others, false if it is too long or there are API_BACKENDS_MAX. Call before the fetcher runs. */
+bool api_backend_add(const char *base);
+
+/** Chooses the backend of the next pass, the urls are built for it from now on; returns its base url. */
+const char *api_backend_pick(void);
+
+/**
+ * A backend other than the current one that is due for a probe, or NULL.
+ * The next url is built for it; send a list request and report it, then
+ * pick the backend of the pass.
+ */
+const char *api_backend_probe(void);
+
+/** Base url of the picked or probed backend, the first one before anything was picked, "" before init. */
+const char *api_backend_base(void);
+
+/** Result of the request sent to the picked or probed backend, with its duration. */
+void api_backend_report(bool ok, uint32_t latency_us);
+
+uint32_t api_backend_count(void);
+
+/** Counters of backend i for the telemetry, false if there is none. */
+bool api_backend_get(uint32_t i, api_backend_stats_t *out);
+
+#endif //__API_BACKEND_H_
@@ -0,0 +1,39 @@
+#ifndef __API_URL_H_
+#define __API_URL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Urls of the two transport.rest queries the fetcher sends, and of the line
+ * view it asks bvg_proxy for instead. Each one goes to the backend
+ * api_backend_pick() chose for the pass (api_backend.h):
+ * CONFIG_BVG_API_BASE_URL and its fallbacks, so a build can point at a
+ * mirror or at tools/mock_api.py, or CONFIG_BVG_PROXY_URL when the data
+ * comes from the proxy. They can be replaced at run time.
+ */
+
+#define API_BASE_URL_LEN 96
+
+/** Base url of the current backend without trailing slash, e.g. "https://v6.bvg.transport.rest". */
+const char *api_base_url(void);
+
+/** Replaces all backends with one base url, false if it is too long. Call before the fetcher runs. */
+bool api_set_base_url(const char *base);
+
+/** Currently running trips of one api line ("S41", not "S41S42"). */
+bool api_line_url(const char *line, const char *operator, char *buffer, int size);
+
+/** One trip with its stopovers. */
+bool api_trip_url(const char *trip_id, char *buffer, int size);
+
+/** bvg_proxy view of a map line ("S41S42"), at most max_trips trips. */
+bool api_view_url(const char *map_line, int max_trips, char *buffer, int size);
+
+/** Binary bvg_proxy view (trip_wire.h), the delta since state `since` of `epoch`; since 0 asks for a snapshot. */
+bool api_view_wire_url(const char *map_line, int max_trips, uint32_t epoch, uint32_t since, char *buffer, int size);
+
+/** WebSocket url of the stream of a map line (live_push.h), the base url with ws:// or wss://. */
+bool api_stream_url(const char *map_line, int max_trips, uint32_t epoch, uint32_t since, char *buffer, int size);
+
+#endif //__API_URL_H_
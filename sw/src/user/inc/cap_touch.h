@@ -1,9 +1,10 @@
 #ifndef __CAP_TOUCH_H_
 #define __CAP_TOUCH_H_
 
+#include <stdbool.h>
+
 void cap_touch_init(void);
 void cap_touch_run(void);
-void cap_touch_check(void);
 bool cap_touch_check_is_pressed(void);
     
 #endif //__CAP_TOUCH_H_
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef __FRAME_H_
+#define __FRAME_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// Numbers of the LED in the strip
+#define FRAME_LED_COUNT 320
+
+typedef struct {
+    uint8_t r, g, b;
+} frame_px_t;
+
+// one complete picture of the map, composed in RAM and flushed once per frame
+typedef struct {
+    frame_px_t px[FRAME_LED_COUNT];
+} frame_t;
+
+static inline void frame_clear(frame_t *f)
+{
+    memset(f, 0, sizeof(*f));
+}
+
+static inline void frame_set(frame_t *f, uint32_t i, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (i >= FRAME_LED_COUNT) return;
+    f->px[i].r = r;
+    f->px[i].g = g;
+    f->px[i].b = b;
+}
+
+#endif //__FRAME_H_
@@ -0,0 +1,81 @@
+#ifndef __FRAME_REC_H_
+#define __FRAME_REC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "frame.h"
+
+/*
+ * Frame recorder: the frames the renderer sends out, as a compact binary log
+ * that tools/render_frames.py draws onto the pcb or compares between two
+ * firmware versions. The same input gives the same bytes.
+ *
+ * Little endian. A header, then one record per frame:
+ *
+ *   header  "LEDF", u16 version, u16 led count, i64 time of the first frame (us)
+ *   record  u8 kind, u32 ms since the first frame, then by kind
+ *     'K'   key frame, led count * (r, g, b)
+ *     'D'   delta to the previous frame, u16 n, n * (u16 led, r, g, b)
+ *     'S'   same as the previous frame, nothing
+ *
+ * A key frame comes first and every FRAME_REC_KEY_INTERVAL frames, or when a
+ * delta would be larger.
+ */
+
+#define FRAME_REC_MAGIC         0x4644454C   // "LEDF"
+#define FRAME_REC_VERSION       1
+#define FRAME_REC_KEY_INTERVAL  100
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t led_count;
+    int64_t  t0_us;
+} frame_rec_hdr_t;
+
+#define FRAME_REC_RECORD_MAX  (sizeof(frame_rec_hdr_t) + 5 + FRAME_LED_COUNT * sizeof(frame_px_t))
+
+/** Gets one whole record (the first one with the header) per call. */
+typedef bool (*frame_rec_write_fn)(const void *data, uint32_t len, void *ctx);
+
+typedef struct {
+    frame_rec_write_fn write;
+    void     *ctx;
+    frame_t   prev;
+    int64_t   t0_us;
+    uint32_t  frames;
+    uint32_t  since_key;
+    uint8_t   buf[FRAME_REC_RECORD_MAX];
+} frame_rec_t;
+
+/** Starts a log that goes out through write. Nothing is written before the first frame. */
+void frame_rec_init(frame_rec_t *r, frame_rec_write_fn write, void *ctx);
+
+/**
+ * Appends f shown from t_us on. False if write failed; the frame is then
+ * not part of the log and the next one is encoded against the last good one.
+ */
+bool frame_rec_add(frame_rec_t *r, const frame_t *f, int64_t t_us);
+
+#if CONFIG_FRAME_RECORDER
+/*
+ * The firmware's log: a RAM buffer of CONFIG_FRAME_RECORDER_BUFFER_KB filled
+ * by the led task through led_out. When it is full recording stops, so the
+ * log always starts with its key frame. Read out at /frames.
+ */
+
+/** Sets up the RAM log, before the sink is added. */
+void frame_rec_log_init(void);
+
+/** led_out sink of the RAM log. Never blocks, frames that meet a reader are left out. */
+void frame_rec_log_sink(const frame_t *f, int64_t t_us, void *ctx);
+
+/** Writes the log in pieces through emit, like trace_read(). */
+bool frame_rec_log_read(bool (*emit)(const void *data, uint32_t len, void *ctx), void *ctx);
+
+/** Empties the log, the next frame starts a new one. */
+void frame_rec_log_restart(void);
+#endif
+
+#endif //__FRAME_REC_H_
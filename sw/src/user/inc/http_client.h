@@ -3,5 +3,7 @@
 
 #include <stdbool.h>
 bool fetch_data(const char *url, char * buffer, int buff_size);
+/** fetch_data() for binary bodies: the length of the body, -1 on failure. */
+int fetch_data_len(const char *url, char * buffer, int buff_size);
 
 #endif //__HTTP_CLIENT_H_
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef __LED_COMPOSE_H_
+#define __LED_COMPOSE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+#include "anim.h"
+#include "line_state.h"
+
+/*
+ * What led_stripe_run() draws per frame, apart from the led task: trains of
+ * the ring, the heartbeat pixel and the line label of the touch selection.
+ * Only depends on its arguments and the ring, so the host benchmark renders
+ * the same frames as the board for the same trips, clock and touches.
+ */
+
+typedef struct {
+    anim_timeline_t label;
+    uint8_t  active[FRAME_LED_COUNT];   // per led trains, direction and blink, see led_map.h
+    uint32_t loop_cnt;
+    uint32_t k;                         // heartbeat position
+    bool     line_name_printed;
+} led_compose_t;
+
+void led_compose_init(led_compose_t *c);
+
+/**
+ * Composes the next frame into f at now_ms (anim time) and unix_s (train
+ * positions). Takes tr_mutex itself. Returns true if a train is shown.
+ */
+bool led_compose(led_compose_t *c, frame_t *f, int64_t now_ms, int64_t unix_s, const line_state_t *ls);
+
+#endif //__LED_COMPOSE_H_
@@ -0,0 +1,28 @@
+#ifndef __LED_MAP_H_
+#define __LED_MAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Trips -> station leds -> colours. The render task calls both steps every
+ * frame, the host benchmark (sw/host) runs the same code on recorded trips.
+ *
+ * Per led one byte: bit 0..5 number of trains, bit 6 direction, bit 7 blink.
+ */
+
+#define LED_MAP_TRAINS     0x3F
+#define LED_MAP_DIRECTION  0x40   // at least one train runs east or north
+#define LED_MAP_BLINK      0x80   // a train is at the station right now
+
+/**
+ * Marks the station every trip in the ring is nearest to at now.
+ * Call with tr_mutex held. Returns true if at least one train is shown.
+ */
+bool led_map_build(uint8_t active[FRAME_LED_COUNT], int64_t now);
+
+/** Colours the marked leds into f, blinking ones are dark if blink_off. */
+void led_map_render(frame_t *f, const uint8_t active[FRAME_LED_COUNT], bool blink_off);
+
+#endif //__LED_MAP_H_
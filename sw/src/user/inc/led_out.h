@@ -0,0 +1,25 @@
+#ifndef __LED_OUT_H_
+#define __LED_OUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "frame.h"
+
+/*
+ * Output stage of the renderer. Every composed frame goes to all registered
+ * sinks: the WS2812 strip, the frame recorder (frame_rec.h), or both, see
+ * "LED Output Configuration" in menuconfig.
+ */
+
+#define LED_OUT_MAX_SINKS 2
+
+/** Takes the frame shown from t_us (esp_timer time) on. Runs in the caller's task. */
+typedef void (*led_out_fn)(const frame_t *f, int64_t t_us, void *ctx);
+
+/** Adds a sink, false if all LED_OUT_MAX_SINKS places are taken. Call during init. */
+bool led_out_add(led_out_fn fn, void *ctx);
+
+/** Hands f to every sink in the order they were added. */
+void led_out_flush(const frame_t *f, int64_t t_us);
+
+#endif //__LED_OUT_H_
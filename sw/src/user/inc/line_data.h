@@ -2,24 +2,19 @@
 #define __LINEDATA_H__
 
 #include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-typedef struct
-{
-  const char name[4];
-
-  uint8_t r,g,b;
-
-  uint8_t    led_pos_size;
-  uint16_t * led_pos;
+/*
+ * All topology tables are const and live in flash, only the render state
+ * derived from the trips is kept in RAM. tools/gen_line_data.py generates
+ * them from topology/berlin.json twice: as a built-in copy in .rodata and as
+ * an image for the "topology" partition, which line_data_init() maps in
+ * place. A new map only needs a new image, not a new firmware.
+ */
 
-  uint8_t    line_pos_size;
-  uint16_t * line_pos;
-
-  uint8_t    id_size;
-  const char     ** id;
-}line_struct_t;
-
-typedef struct {
+// station ids need 19 bits above 900000000, so they stay 32 bit
+typedef struct __attribute__((packed)) {
     uint32_t station_id;
     uint16_t line_pos;
 } station_line_t;
@@ -31,27 +26,88 @@ typedef struct
   uint16_t pos_linie;
 }line_pos_struct_t;
 
+#define LINE_ADJ_NONE 0xFFFF
+
+// leds of the previous and next stop on the same line, the label trace (anim.c) looks ahead with it
 typedef struct
 {
-  char name[9];
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-  uint32_t pos_size;
-  line_pos_struct_t *pos;
+  uint16_t prev;
+  uint16_t next;
+}line_adj_t;
+
+typedef struct
+{
+  char name[7];
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint16_t pos_first;  // index into the shared station sequence table
+  uint16_t pos_size;
 }line_data_struct_t;
 
+#define LINE_OPERATOR_LEN 32   // operator name as the api expects it, NUL terminated
+
+/*
+ * Topology image, little endian, offsets from the start of the image. The
+ * tables have exactly the layout of the structs above and are used in place.
+ *   station_line_t     [n_stations]  sorted by station id
+ *   line_pos_struct_t  [n_pos]
+ *   line_adj_t         [n_pos]
+ *   line_data_struct_t [n_lines]
+ *   char               [n_lines][LINE_OPERATOR_LEN]
+ */
+#define LINE_DATA_IMAGE_MAGIC    0x314F5054   // "TPO1"
+#define LINE_DATA_IMAGE_VERSION  1
+#define LINE_DATA_PARTITION_LABEL "topology"
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t led_count;
+    uint32_t size;            // whole image
+    uint32_t crc;             // crc32 of the image after the header
+    uint16_t n_stations;
+    uint16_t n_lines;
+    uint16_t n_pos;
+    uint16_t reserved;
+    uint32_t off_stations;
+    uint32_t off_pos;
+    uint32_t off_adj;
+    uint32_t off_lines;
+    uint32_t off_operators;
+    uint32_t reserved2;
+} line_data_image_hdr_t;
+
+_Static_assert(sizeof(line_data_image_hdr_t) == 48, "line_data_image_hdr_t is part of the image format");
+_Static_assert(sizeof(station_line_t) == 6, "station_line_t must not be padded");
+_Static_assert(sizeof(line_pos_struct_t) == 4, "line_pos_struct_t must not be padded");
+_Static_assert(sizeof(line_data_struct_t) == 14, "line_data_struct_t must not be padded");
+
+
+// line table, built-in or mapped from the topology partition
+extern const line_data_struct_t *leds;
 
-extern station_line_t stations[];
-extern uint8_t led_active[320];
-extern line_data_struct_t leds[];
+/**
+ * Maps and validates the topology partition and switches all lookups to it.
+ * Keeps the built-in tables if there is no valid image. Call once at boot
+ * before any task uses the tables.
+ */
+bool line_data_init(void);
 uint32_t line_data_number_of_stations(void);
 uint32_t line_data_number_of_lines(void);
+/** Operator of a line as the api names it, e.g. "S-Bahn Berlin GmbH". */
+const char *line_data_operator(uint32_t line);
+/** Line with exactly this name ("S41", "S41S42"), -1 if there is none. */
+int32_t line_data_find_line(const char *name);
+/** LED of a station or -1 if the station is not on the map. */
+int32_t line_data_find_station_led(uint32_t station_id);
+/** Station sequence of a line, pos_size entries. */
+const line_pos_struct_t *line_data_line_pos(const line_data_struct_t *line);
+/** Neighbours of every entry of line_data_line_pos(), same length. */
+const line_adj_t *line_data_line_adj(const line_data_struct_t *line);
 
-#include "led_strip.h"
-void line_data_draw_string(char * str, uint32_t len, led_strip_handle_t *led_strip, uint8_t r, uint8_t g, uint8_t b, uint32_t on_time, uint32_t off_time);
-void led_state_draw_all_lines(led_strip_handle_t *led_strip, uint32_t on_time, uint32_t off_time);
-void led_state_draw_line(led_strip_handle_t *led_strip, uint32_t line_nr, uint32_t on_time, uint32_t off_time);
-void draw_all_numbers(led_strip_handle_t *led_strip);
-void print_line(led_strip_handle_t *led_strip, int8_t line_nr);
+#include "frame.h"
+void line_data_draw_char(frame_t *f, char chr, uint8_t r, uint8_t g, uint8_t b);
+void print_line(frame_t *f, int8_t line_nr);
+void print_line_color(frame_t *f, int8_t line_nr, uint8_t r, uint8_t g, uint8_t b);
 #endif // __LINEDATA_H__
\ No newline at end of file
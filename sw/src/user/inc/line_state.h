@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "freertos/FreeRTOS.h"
 
 typedef struct {
     int8_t line;     // 0..N
@@ -40,12 +41,31 @@ bool line_state_try_set(const line_state_t *new_state);
 
 
 
+/**
+ * Boot modes. set_* enters a mode, release_* ends it and wakes every task
+ * blocked in wait_*. check_* returns true once the mode has been released,
+ * wait_* blocks up to timeout for that and returns the same.
+ */
 void line_state_set_init_mode(void);
 void line_state_release_init_mode(void);
 bool line_state_check_init_mode(void);
+bool line_state_wait_init_mode(TickType_t timeout);
 
 void line_state_set_reset_provisioning_mode(void);
 void line_state_release_reset_provisioning_mode(void);
 bool line_state_check_reset_provisioning_mode(void);
+bool line_state_wait_reset_provisioning_mode(TickType_t timeout);
+
+// touch baseline calibration, the reset window only starts after it
+void line_state_set_calibration_mode(void);
+void line_state_release_calibration_mode(void);
+bool line_state_check_calibration_mode(void);
+bool line_state_wait_calibration_mode(TickType_t timeout);
+
+// no ip address yet, the fetcher starts once it is released
+void line_state_set_network_mode(void);
+void line_state_release_network_mode(void);
+bool line_state_check_network_mode(void);
+bool line_state_wait_network_mode(TickType_t timeout);
 
 #endif //__LINE_STATE_H_
@@ -0,0 +1,34 @@
+#ifndef __LIVE_PUSH_H_
+#define __LIVE_PUSH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * One WebSocket subscription to the stream of a line at bvg_proxy
+ * (/v2/stream/<line>, see sw/host/proxy/push.h). Every binary message is
+ * put together from the chunks of esp_websocket_client in the caller's
+ * buffer and handed to the callback in the websocket task. The subscription
+ * ends when the connection closes or fails, when a message does not fit or
+ * when the callback returns false; it is not reconnected here, the fetcher
+ * opens the next one with the state it has then.
+ */
+
+/** Handles one message, false ends the subscription. */
+typedef bool (*live_push_cb_t)(const uint8_t *msg, size_t len, void *ctx);
+
+/** Opens a subscription to url (ws://), false if the client could not be started. */
+bool live_push_start(const char *url, uint8_t *buf, size_t size, live_push_cb_t cb, void *ctx);
+
+/** Waits at most ticks for the subscription to end, true while it runs. */
+bool live_push_wait(TickType_t ticks);
+
+/** Closes the subscription and its task, the buffer is the caller's again. */
+void live_push_stop(void);
+
+/** Messages of the current or last subscription. */
+uint32_t live_push_messages(void);
+
+#endif //__LIVE_PUSH_H_
@@ -0,0 +1,49 @@
+#ifndef __MEM_TIER_H_
+#define __MEM_TIER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+/*
+ * Placement of the large buffers. Modules take them from here once at init
+ * instead of from .bss, by how they are used:
+ *
+ *   MEM_TIER_BULK  streamed or rarely touched data: http bodies, the
+ *                  tripring heap, logs. SPIRAM if the module has it.
+ *   MEM_TIER_FAST  data read every frame and DMA buffers. Internal RAM.
+ *
+ * Whether there is SPIRAM is found out at run time, so one image runs on
+ * WROOM and WROVER modules (CONFIG_SPIRAM with CONFIG_SPIRAM_IGNORE_NOTFOUND).
+ * Sizes that depend on it are picked with mem_tier_size().
+ */
+
+typedef enum {
+    MEM_TIER_FAST = 0,
+    MEM_TIER_BULK,
+} mem_tier_t;
+
+/** Looks for SPIRAM in the heap. Call at boot before any module allocates. */
+void mem_tier_init(void);
+
+/** True if MEM_TIER_BULK allocations go to SPIRAM. */
+bool mem_tier_spiram(void);
+
+/** Free SPIRAM in bytes, 0 without. */
+size_t mem_tier_spiram_free(void);
+
+/**
+ * A zeroed buffer for the lifetime of the firmware. BULK falls back to
+ * internal RAM if SPIRAM is missing or full. Aborts if there is no memory
+ * at all, as a .bss buffer of the size would not have linked.
+ */
+void *mem_tier_alloc(size_t size, mem_tier_t tier, const char *what);
+
+/** internal on boards with internal RAM only, spiram on boards with SPIRAM. */
+static inline size_t mem_tier_size(size_t internal, size_t spiram)
+{
+    return mem_tier_spiram() ? spiram : internal;
+}
+
+#endif //__MEM_TIER_H_
@@ -0,0 +1,46 @@
+#ifndef __METRICS_H_
+#define __METRICS_H_
+
+#include <stdint.h>
+
+/*
+ * Fleet counters and gauges. Writers use relaxed atomics and never block,
+ * the status server reads them the same way, so a scrape cannot stall the
+ * fetch or render path. Durations live in the prof.h histograms.
+ */
+
+typedef enum {
+    METRIC_FETCH_OK = 0,        // counter
+    METRIC_FETCH_FAIL,          // counter
+    METRIC_DECODE_FAIL,         // counter
+    METRIC_TRIPS_PUT,           // counter
+    METRIC_TRIPS_EXPIRED,       // counter
+    METRIC_TR_SIZE,             // gauge, trips in the ring
+    METRIC_TR_HEAP_FREE,        // gauge, tripring private heap
+    METRIC_TR_HEAP_LARGEST,     // gauge
+    METRIC_TR_HEAP_MIN_FREE,    // gauge
+    METRIC_TT_TRIPS,            // counter, trips synthesised from the timetable
+    METRIC_SCHEDULED,           // gauge, 1 while the fetcher runs on the timetable
+    METRIC_PUSH_MESSAGES,       // counter, views pushed by bvg_proxy
+    METRIC_PUSH_SUBSCRIBED,     // gauge, 1 while a stream is open
+    METRIC_NUM
+} metric_id_t;
+
+extern uint32_t metrics[METRIC_NUM];
+
+static inline void metric_inc(metric_id_t id)
+{
+    __atomic_fetch_add(&metrics[id], 1, __ATOMIC_RELAXED);
+}
+
+static inline void metric_set(metric_id_t id, uint32_t value)
+{
+    __atomic_store_n(&metrics[id], value, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t metric_get(metric_id_t id)
+{
+    return __atomic_load_n(&metrics[id], __ATOMIC_RELAXED);
+}
+
+#endif //__METRICS_H_
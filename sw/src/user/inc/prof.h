@@ -0,0 +1,109 @@
+#ifndef __PROF_H_
+#define __PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Runtime profiling. Hot paths record durations into fixed log2 histograms,
+ * a low priority task samples FreeRTOS run-time stats and stack high-water
+ * marks into a ring. Everything is static, nothing is allocated after init.
+ *
+ * Every histogram has exactly one writer task, readers may see a sample
+ * being added but never a torn 32 bit word, so no lock is taken.
+ */
+
+#define PROF_HIST_BUCKETS     20       // bucket i counts durations < 2^i us, last one is open
+#define PROF_MAX_TASKS        20       // tasks per sample, the busiest ones, the rest is dropped
+#define PROF_MAX_SYSTEM_TASKS 40       // tasks that can be sampled at all, with wifi, httpd, sntp ...
+#define PROF_RING_LEN         6        // samples kept
+#define PROF_SAMPLE_PERIOD_MS 10000
+#define PROF_TASK_NAME_LEN    16
+
+typedef enum {
+    PROF_HIST_FRAME = 0,   // led_stripe_run(): trips -> leds -> flush
+    PROF_HIST_FETCH,       // BVG_run(): one fetch_data() call
+    PROF_HIST_DECODE,      // BVG_run(): json decode of a trip or trip list
+    PROF_HIST_NUM
+} prof_hist_id_t;
+
+/*
+ * Boot phases in the order they are normally reached. Each one is stamped
+ * once, by whichever task gets there, in ms since the app started (the
+ * bootloader is not included). Phases run partly in parallel, so a later
+ * phase may be stamped before an earlier one.
+ */
+typedef enum {
+    PROF_BOOT_INIT = 0,       // app_main(): drivers, tripring, timetable, snapshot, wifi driver
+    PROF_BOOT_TOUCH_READY,    // cap_touch_run(): first baseline calibrated
+    PROF_BOOT_WIFI_START,     // station started, with cached ap on one channel
+    PROF_BOOT_RESET_WINDOW,   // reset provisioning window closed
+    PROF_BOOT_WIFI_UP,        // got an ip address
+    PROF_BOOT_FIRST_FETCH,    // first successful upstream request
+    PROF_BOOT_TIME_SYNCED,    // sntp answered
+    PROF_BOOT_RENDER,         // init mode released, trains are drawn
+    PROF_BOOT_FIRST_TRAIN,    // first frame with a lit train
+    PROF_BOOT_NUM
+} prof_boot_phase_t;
+
+#define PROF_BOOT_NONE         UINT32_MAX   // phase not reached
+#define PROF_BOOT_TARGET_MS    5000         // time to first lit train worth a warning
+
+typedef struct {
+    uint32_t bucket[PROF_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t sum_us;
+} prof_hist_t;
+
+typedef struct {
+    char     name[PROF_TASK_NAME_LEN];
+    uint16_t cpu_permille;  // share of one core since the previous sample
+    uint16_t stack_free;    // high-water mark, bytes never used
+    uint8_t  prio;
+    int8_t   core;          // -1 = no affinity
+} prof_task_t;
+
+typedef struct {
+    int64_t     t_ms;
+    uint32_t    free_heap;
+    uint32_t    min_free_heap;
+    uint8_t     n_tasks;
+    prof_task_t tasks[PROF_MAX_TASKS];
+} prof_sample_t;
+
+void prof_init(void);
+
+/** Creates the sampling task. */
+void prof_start(void);
+
+/** Adds one duration, call only from the histogram's owner task. */
+void prof_hist_add(prof_hist_id_t id, uint32_t us);
+
+/** Microseconds since boot, for the start/stop pair around a measured section. */
+int64_t prof_now_us(void);
+
+const prof_hist_t *prof_hist_get(prof_hist_id_t id);
+const char *prof_hist_name(prof_hist_id_t id);
+
+/** Upper bound in us of the bucket holding the pct percentile (0 if empty). */
+uint32_t prof_hist_percentile(const prof_hist_t *h, uint8_t pct);
+
+/** Stamps a boot phase, only the first call per phase counts. Safe from any task. */
+void prof_boot_mark(prof_boot_phase_t phase);
+
+/** Same with a time taken earlier, esp_timer us. */
+void prof_boot_mark_at(prof_boot_phase_t phase, int64_t t_us);
+
+/** Milliseconds after start at which the phase was reached, PROF_BOOT_NONE if not yet. */
+uint32_t prof_boot_ms(prof_boot_phase_t phase);
+const char *prof_boot_name(prof_boot_phase_t phase);
+
+/** Copies the newest sample, false if none has been taken yet. */
+bool prof_last_sample(prof_sample_t *out);
+
+/** Asks the sampling task to log everything. Safe from any task. */
+void prof_request_dump(void);
+void prof_dump(void);
+
+#endif //__PROF_H_
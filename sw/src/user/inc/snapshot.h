@@ -0,0 +1,35 @@
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Compact copy of the tripring and the selected line, so the map can show
+ * trains right after a reboot instead of waiting for Wi-Fi, SNTP and a full
+ * fetch. The same blob lives in RTC slow memory (survives soft resets,
+ * panics and watchdog resets) and in the "snapshot" flash partition
+ * (survives power loss), where it rotates over one 4 KB sector per save.
+ *
+ * Per trip only the id, line, direction and the stops from the last passed
+ * one onwards are kept, with times as 16 bit offsets to the snapshot time.
+ */
+
+#define SNAPSHOT_MAX_SIZE          4096   // blob incl. header, also one flash sector
+#define SNAPSHOT_STOPS_PER_TRIP    12     // last passed stop + upcoming ones
+#define SNAPSHOT_FLASH_PERIOD_S    600    // flash copy at most every 10 minutes
+#define SNAPSHOT_PARTITION_LABEL   "snapshot"
+
+/**
+ * Loads the newest valid snapshot into the tripring and line state. Trips
+ * get TRIP_FLAG_RESTORED until live data replaces them. If the clock was not
+ * set yet a snapshot from RTC memory, i.e. of a reset without power loss,
+ * seeds it with the snapshot time; a flash copy does not. Call after tr_init() and
+ * line_state_init(), before the tasks start.
+ */
+bool snapshot_restore(void);
+
+/** Saves the tripring to RTC memory and, if due or forced, to flash. */
+void snapshot_save(bool force_flash);
+
+#endif //__SNAPSHOT_H_
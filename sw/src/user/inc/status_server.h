@@ -0,0 +1,17 @@
+#ifndef __STATUS_SERVER_H_
+#define __STATUS_SERVER_H_
+
+/*
+ * Always-on http server in station mode.
+ *   GET /metrics  Prometheus text format
+ *   GET /state    current line_state_t as json
+ *   GET /prof     triggers a prof_dump() on the console
+ *   GET /trace    binary trace ring, see tools/trace_decode.py
+ */
+
+#define STATUS_SERVER_PORT       80
+#define STATUS_SERVER_CTRL_PORT  32770   // 32768 provisioning, 32769 softap ota
+
+void status_server_start(void);
+
+#endif //__STATUS_SERVER_H_
@@ -0,0 +1,103 @@
+#ifndef __TIMETABLE_H_
+#define __TIMETABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tripring.h"
+
+/*
+ * Static timetable fallback. tools/gen_timetable.py builds an image from the
+ * VBB GTFS feed for the lines on the map, it is flashed into the "timetable"
+ * partition and read in place through esp_partition_mmap(). When the api is
+ * slow or down the fetcher fills the tripring with scheduled trips
+ * (TRIP_FLAG_SCHEDULED), every live trip replaces its scheduled twin.
+ *
+ * Image layout, little endian, all offsets from the start of the image:
+ *   tt_hdr_t
+ *   tt_line_t         [n_lines]          same order and names as the topology lines,
+ *                                        an image of another topology is refused
+ *   uint64_t          [n_services]       active days, bit i = first_day + i
+ *   tt_pattern_t      [n_patterns]       stop sequence with times
+ *   tt_stop_t         [n_pattern_stops]  only stations on the map
+ *   tt_trip_t         [n_trips]          per line, sorted by start
+ */
+
+#define TIMETABLE_MAGIC            0x31425454   // "TTB1"
+#define TIMETABLE_VERSION          1
+#define TIMETABLE_PARTITION_LABEL  "timetable"
+#define TIMETABLE_MAX_DAYS         64           // one service bitmap per calendar
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t n_lines;
+    uint32_t size;              // whole image
+    uint32_t crc;               // crc32 of the image after the header
+    int32_t  first_day;         // local calendar day, days since 1970-01-01
+    uint16_t n_days;
+    uint16_t reserved;
+    uint32_t n_services;
+    uint32_t n_patterns;
+    uint32_t n_pattern_stops;
+    uint32_t n_trips;
+    uint32_t off_lines;
+    uint32_t off_services;
+    uint32_t off_patterns;
+    uint32_t off_pattern_stops;
+    uint32_t off_trips;
+    uint32_t built;             // unix time of the build, for the log only
+} tt_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    char     name[8];
+    uint32_t trip_first;        // index into the trip table
+    uint32_t trip_count;
+    uint32_t max_span_s;        // longest trip, bounds the search window
+} tt_line_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t origin_station_id; // first and last stop of the gtfs trip,
+    uint32_t dest_station_id;   // also when they are not on the map
+    uint32_t stop_first;        // index into the pattern stop table
+    uint16_t n_stops;
+    uint8_t  line_code;         // index of the line name, as in the fetcher
+    int8_t   direction;         // same rule as get_direction()
+    uint32_t span_s;            // arrival at the last stop after start
+} tt_pattern_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t station_id;
+    uint16_t arr_s;             // seconds after the trip start
+    uint16_t dep_s;
+} tt_stop_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t pattern;
+    uint16_t service;
+    uint32_t start_s;           // departure at the origin, seconds after noon - 12h
+} tt_trip_t;
+
+_Static_assert(sizeof(tt_hdr_t) == 64, "tt_hdr_t is part of the image format");
+_Static_assert(sizeof(tt_line_t) == 20, "tt_line_t is part of the image format");
+_Static_assert(sizeof(tt_pattern_t) == 20, "tt_pattern_t is part of the image format");
+_Static_assert(sizeof(tt_stop_t) == 8, "tt_stop_t is part of the image format");
+_Static_assert(sizeof(tt_trip_t) == 8, "tt_trip_t is part of the image format");
+
+#define TIMETABLE_LEAD_S   60    // scheduled trips appear a minute before departure
+#define TIMETABLE_MATCH_S  600   // live and scheduled trip are the same within this
+
+/** Maps and validates the image, false if there is none or it is damaged. */
+bool timetable_init(void);
+bool timetable_valid(void);
+
+/**
+ * Puts the scheduled trips of a line that run at now into the tripring,
+ * skipping the ones a live trip already covers. Call with tr_mutex held.
+ * Returns the number of trips put.
+ */
+uint32_t timetable_fill(int line_nr, int64_t now);
+
+/** Drops the scheduled twin of a live trip. Call with tr_mutex held. */
+void timetable_replace(const Trip *live);
+
+#endif //__TIMETABLE_H_
@@ -0,0 +1,42 @@
+#ifndef __TRIP_DECODE_H_
+#define __TRIP_DECODE_H_
+
+#include <stdbool.h>
+#include "tripring.h"
+
+/*
+ * Decoding of the transport.rest /trips responses, and of the line views of
+ * bvg_proxy, into Trip records. No network and no task state in here, so the
+ * same code runs in the fetcher, the host benchmark and the proxy (sw/host).
+ */
+
+#define MAX_TRIP_ID_LEN        32
+#define TRIP_DECODE_MAX_STOPS  45   // stops[] the caller has room for, the rest is dropped
+
+/**
+ * Collects up to max_out trip ids from a /trips?lineName=... answer.
+ * Returns the number of ids collected.
+ */
+int trip_decode_list(const char *json, char (*out_ids)[MAX_TRIP_ID_LEN], int max_out);
+
+/**
+ * Decodes a /trips/:id answer into trip, which needs room for
+ * TRIP_DECODE_MAX_STOPS stops. False if a required field is missing or bad.
+ */
+bool trip_decode(const char *json, Trip *trip);
+
+/** Gets every trip of a view, trip is only valid during the call. */
+typedef void (*trip_decode_cb_t)(Trip *trip, void *ctx);
+
+/**
+ * Decodes a line view of bvg_proxy (sw/host/proxy/feed.h) trip by trip into
+ * trip, which needs room for TRIP_DECODE_MAX_STOPS stops, and hands each to
+ * cb. Trips with a missing field or a line the topology does not have are
+ * skipped. Returns the number of trips handed over, -1 if json is no view.
+ */
+int trip_decode_view(const char *json, Trip *trip, trip_decode_cb_t cb, void *ctx);
+
+/** +1 if A->B is mostly east or north, -1 if mostly west or south. */
+int get_direction(float lat1, float lon1, float lat2, float lon2);
+
+#endif //__TRIP_DECODE_H_
@@ -0,0 +1,137 @@
+#ifndef __TRIP_WIRE_H_
+#define __TRIP_WIRE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "tripring.h"
+
+/*
+ * Binary form of the trips of a line, for bvg_proxy and the boards that ask
+ * it. Only the Trip and Stopover fields the board uses are sent, a trip of
+ * 20 stops takes about 200 bytes instead of the tens of KB of a /trips/:id
+ * answer. Little endian, fixed-width records:
+ *
+ *   trip_wire_hdr_t
+ *   count records, each one of
+ *     trip_wire_put_t, trip id (id_len bytes), num_stops trip_wire_stop_t
+ *     trip_wire_del_t, trip id (id_len bytes)
+ *
+ * A snapshot has all trips of a line and replaces what the board has, a
+ * delta puts and removes single trips by id and applies only to the state
+ * base_seq of the same epoch. Times are seconds after base_ts, so they fit
+ * 16 bits; TRIP_WIRE_NO_TIME stands for the 0 of a missing time.
+ *
+ * The encoder runs in the proxy, the decoder on the board, where
+ * trip_wire_apply() writes every trip straight into the ring's heap.
+ */
+
+#define TRIP_WIRE_MAGIC     0x57505254   // "TRPW"
+#define TRIP_WIRE_VERSION   1
+#define TRIP_WIRE_NO_TIME   0xFFFF
+
+typedef enum {
+    TRIP_WIRE_SNAPSHOT = 1,
+    TRIP_WIRE_DELTA    = 2,
+} trip_wire_kind_t;
+
+typedef enum {
+    TRIP_WIRE_PUT = 'P',
+    TRIP_WIRE_DEL = 'D',
+} trip_wire_op_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  kind;          // trip_wire_kind_t
+    uint16_t count;         // records
+    uint32_t size;          // whole message
+    uint32_t epoch;         // changes when the sender restarts, seq starts over then
+    uint32_t base_seq;      // state a delta applies to, 0 for a snapshot
+    uint32_t seq;           // state after the message
+    int64_t  now;           // sender's clock, unix s
+} trip_wire_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  op;            // TRIP_WIRE_PUT
+    uint8_t  id_len;
+    char     line[7];       // api line as leds[].name, NUL padded
+    int8_t   direction;
+    uint16_t num_stops;
+    uint32_t origin_station_id;
+    uint32_t dest_station_id;
+    uint32_t base_ts;       // unix s all times count from
+    uint16_t dep;
+    uint16_t arr;
+} trip_wire_put_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t station_id;
+    uint16_t arr;
+    uint16_t dep;
+} trip_wire_stop_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  op;            // TRIP_WIRE_DEL
+    uint8_t  id_len;
+} trip_wire_del_t;
+
+_Static_assert(sizeof(trip_wire_hdr_t) == 32, "trip_wire_hdr_t is part of the wire format");
+_Static_assert(sizeof(trip_wire_put_t) == 28, "trip_wire_put_t is part of the wire format");
+_Static_assert(sizeof(trip_wire_stop_t) == 8, "trip_wire_stop_t is part of the wire format");
+
+
+// --- encoder -----------------------------------------------------------------
+
+typedef struct {
+    uint8_t *buf;
+    size_t   size;
+    size_t   len;
+    uint16_t count;
+    bool     full;
+} trip_wire_writer_t;
+
+/** Starts a message in buf, records follow with trip_wire_put() and trip_wire_del(). */
+void trip_wire_begin(trip_wire_writer_t *w, uint8_t *buf, size_t size, trip_wire_kind_t kind,
+                     uint32_t epoch, uint32_t base_seq, uint32_t seq, int64_t now);
+
+/**
+ * Adds trip t; its line is leds[t->line_code] of the sender's topology.
+ * False if it does not fit into the message or its times span more than
+ * 18 hours, nothing is added then.
+ */
+bool trip_wire_put(trip_wire_writer_t *w, const Trip *t);
+
+/** Adds the removal of a trip, false if it does not fit. */
+bool trip_wire_del(trip_wire_writer_t *w, const char *trip_id);
+
+/** Completes the header, returns the length of the message. */
+size_t trip_wire_end(trip_wire_writer_t *w);
+
+
+// --- decoder -----------------------------------------------------------------
+
+typedef struct {
+    trip_wire_kind_t kind;
+    uint32_t epoch;
+    uint32_t base_seq;
+    uint32_t seq;
+    int64_t  now;
+    uint16_t put;           // trips put into the ring
+    uint16_t del;           // trips removed from it
+    uint16_t skipped;       // trips on a line the topology does not have, or no room in the ring
+} trip_wire_info_t;
+
+/** Reads and checks the header, false if buf holds no message of this version. */
+bool trip_wire_header(const uint8_t *buf, size_t len, trip_wire_info_t *info);
+
+/**
+ * Applies a message to the tripring, under tr_take(). A snapshot replaces
+ * all trips of the ring, a delta puts and removes single ones; checking
+ * base_seq against what the ring holds is the caller's part. Every trip is
+ * decoded in place into tr_reserve() room, nothing else is allocated.
+ * False if the message is malformed, the ring is left alone then.
+ */
+bool trip_wire_apply(const uint8_t *buf, size_t len, trip_wire_info_t *info);
+
+#endif //__TRIP_WIRE_H_
@@ -21,20 +21,40 @@ typedef struct {
     int64_t  arr_ts;             // last arrival
     uint16_t line_code;          // U1=1, S7=101, etc.
     uint16_t num_stops;
+    uint16_t flags;              // TRIP_FLAG_*, fills padding before stops[]
     Stopover stops[];            // flexible array of stops
 } Trip;
 
+#define TRIP_FLAG_RESTORED  0x0001  // loaded from a snapshot, not confirmed by live data yet
+#define TRIP_FLAG_SCHEDULED 0x0002  // synthesised from the static timetable
+
 // --- API ---------------------------------------------------------------------
 
 void tr_put(Trip * t);
 void tr_free_idx(uint32_t index, bool arange);
 void tr_free_old(int64_t now);
 uint32_t tr_get_size(void);
+uint32_t tr_get_capacity(void);
 Trip * tr_get_trip(uint32_t index);
 void tr_init(void);
 void tr_take(void);
 void tr_release(void);
 void tr_clear_all(void);
+uint32_t tr_free_flagged(uint16_t flag);
+
+/**
+ * Room for a trip of num_stops stops in the ring's heap, for decoders that
+ * write a trip in place instead of handing a copy to tr_put(). NULL if the
+ * heap has no room. The trip goes into the ring with tr_commit(), which
+ * replaces a trip with the same id, or back with tr_discard(). Under
+ * tr_take() from tr_reserve() to either.
+ */
+Trip * tr_reserve(uint16_t num_stops);
+/** False if the ring is full, the trip is freed then. */
+bool tr_commit(Trip * t);
+void tr_discard(Trip * t);
+/** Removes the trip with this id, false if the ring has none. */
+bool tr_free_id(const char * trip_id);
 
 void print_trips_here(Trip * t, int64_t now);
 
@@ -0,0 +1,176 @@
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "anim.h"
+#include "line_data.h"
+
+static const char *TAG = "ANIM";
+
+int64_t anim_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+void anim_timeline_clear(anim_timeline_t *tl)
+{
+    memset(tl, 0, sizeof(*tl));
+    tl->start_ms = -1;
+}
+
+anim_layer_t *anim_timeline_add(anim_timeline_t *tl, const anim_layer_t *layer)
+{
+    if (tl->n_layers >= ANIM_MAX_LAYERS) {
+        ESP_LOGE(TAG, "timeline full (%d layers)", ANIM_MAX_LAYERS);
+        return NULL;
+    }
+    anim_layer_t *l = &tl->layers[tl->n_layers++];
+    *l = *layer;
+
+    uint32_t end = l->start_ms + l->duration_ms;
+    if (end > tl->length_ms) tl->length_ms = end;
+    return l;
+}
+
+void anim_timeline_start(anim_timeline_t *tl, int64_t now_ms)
+{
+    tl->start_ms = now_ms;
+}
+
+void anim_timeline_stop(anim_timeline_t *tl)
+{
+    tl->start_ms = -1;
+}
+
+bool anim_timeline_active(const anim_timeline_t *tl, int64_t now_ms)
+{
+    if (tl->start_ms < 0) return false;
+    return (now_ms - tl->start_ms) < (int64_t)tl->length_ms;
+}
+
+// brightness of a layer at local time t in 1/256 steps
+static uint32_t layer_level(const anim_layer_t *l, uint32_t t)
+{
+    uint32_t level = 256;
+    if (l->fade_in_ms && t < l->fade_in_ms) {
+        level = (t * 256) / l->fade_in_ms;
+    }
+    uint32_t left = l->duration_ms - t;
+    if (l->fade_out_ms && left < l->fade_out_ms) {
+        uint32_t out = (left * 256) / l->fade_out_ms;
+        if (out < level) level = out;
+    }
+    return level;
+}
+
+static void render_text(const anim_layer_t *l, uint32_t t, uint32_t level, frame_t *f)
+{
+    uint32_t slot = l->on_ms + l->off_ms;
+    if (slot == 0 || l->text == NULL) return;
+
+    uint32_t idx = t / slot;
+    if (idx >= strlen(l->text)) return;
+    // glyph is only shown during the on part of its slot
+    if ((t % slot) >= l->on_ms) return;
+
+    line_data_draw_char(f, l->text[idx],
+                        (l->r * level) >> 8, (l->g * level) >> 8, (l->b * level) >> 8);
+}
+
+// the stops behind the head stay lit dimmer, the next one on the line glows ahead of it
+static void render_trace(const anim_layer_t *l, uint32_t t, uint32_t level, frame_t *f)
+{
+    const line_data_struct_t *line = &leds[l->line_nr];
+    if (line->pos_size == 0) return;
+    const line_pos_struct_t *pos = line_data_line_pos(line);
+    const line_adj_t *adj = line_data_line_adj(line);
+
+    uint32_t head = l->on_ms ? t / l->on_ms : 0;
+    if (head >= line->pos_size) head = line->pos_size - 1;
+
+    uint8_t r = (l->r * level) >> 8, g = (l->g * level) >> 8, b = (l->b * level) >> 8;
+    for (uint32_t i = 0; i < head; i++) {
+        frame_set(f, pos[i].pos_station, r / 3, g / 3, b / 3);
+    }
+    frame_set(f, pos[head].pos_station, r, g, b);
+    if (adj[head].next != LINE_ADJ_NONE) frame_set(f, adj[head].next, r / 4, g / 4, b / 4);
+}
+
+static void render_line(const anim_layer_t *l, uint32_t t, uint32_t level, frame_t *f)
+{
+    uint32_t period = l->on_ms + l->off_ms;
+    if (l->on_ms && period && (t % period) >= l->on_ms) return;
+
+    print_line_color(f, l->line_nr,
+                     (l->r * level) >> 8, (l->g * level) >> 8, (l->b * level) >> 8);
+}
+
+bool anim_timeline_render(const anim_timeline_t *tl, int64_t now_ms, frame_t *f)
+{
+    if (!anim_timeline_active(tl, now_ms)) return false;
+
+    uint32_t elapsed = (uint32_t)(now_ms - tl->start_ms);
+
+    // layers are painted in insertion order, later layers end up on top
+    for (uint8_t i = 0; i < tl->n_layers; i++) {
+        const anim_layer_t *l = &tl->layers[i];
+        if (elapsed < l->start_ms || elapsed >= l->start_ms + l->duration_ms) continue;
+
+        uint32_t t = elapsed - l->start_ms;
+        uint32_t level = layer_level(l, t);
+
+        switch (l->type) {
+            case ANIM_LAYER_TEXT:
+                render_text(l, t, level, f);
+                break;
+            case ANIM_LAYER_LINE:
+                render_line(l, t, level, f);
+                break;
+            case ANIM_LAYER_TRACE:
+                render_trace(l, t, level, f);
+                break;
+        }
+    }
+    return true;
+}
+
+void anim_line_label(anim_timeline_t *tl, uint32_t line_nr, uint32_t on_ms, uint32_t off_ms, uint32_t hold_ms, int64_t now_ms)
+{
+    const line_data_struct_t *line = &leds[line_nr];
+    uint32_t text_ms = strlen(line->name) * (on_ms + off_ms);
+
+    anim_timeline_clear(tl);
+
+    anim_layer_t text = {
+        .type = ANIM_LAYER_TEXT,
+        .start_ms = 0,
+        .duration_ms = text_ms,
+        .on_ms = on_ms,
+        .off_ms = off_ms,
+        .r = line->r / 10, .g = line->g / 10, .b = line->b / 10,
+        .text = line->name,
+    };
+    (void)anim_timeline_add(tl, &text);
+
+    // same colour swap as the live line view
+    uint32_t trace_ms = line->pos_size * ANIM_TRACE_STOP_MS;
+    anim_layer_t trace = {
+        .type = ANIM_LAYER_TRACE,
+        .start_ms = text_ms,
+        .duration_ms = trace_ms,
+        .on_ms = ANIM_TRACE_STOP_MS,
+        .r = line->g / 10, .g = line->r / 10, .b = line->b / 10,
+        .line_nr = (uint8_t)line_nr,
+    };
+    (void)anim_timeline_add(tl, &trace);
+
+    anim_layer_t stations = {
+        .type = ANIM_LAYER_LINE,
+        .start_ms = text_ms + trace_ms,
+        .duration_ms = hold_ms,
+        .r = line->g / 10, .g = line->r / 10, .b = line->b / 10,
+        .line_nr = (uint8_t)line_nr,
+    };
+    (void)anim_timeline_add(tl, &stations);
+
+    anim_timeline_start(tl, now_ms);
+}
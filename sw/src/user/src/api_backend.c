@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "api_url.h"
+#include "api_backend.h"
+
+#ifndef CONFIG_BVG_API_BASE_URL
+#define CONFIG_BVG_API_BASE_URL "https://v6.bvg.transport.rest"
+#endif
+#ifndef CONFIG_BVG_API_FALLBACK_URLS
+#define CONFIG_BVG_API_FALLBACK_URLS ""
+#endif
+
+#define API_BACKEND_START_US  1000000   // latency assumed before the first answer, ties go to the first backend
+
+static const char *TAG = "API_BACKEND";
+
+typedef struct {
+    char     base[API_BASE_URL_LEN];
+    uint32_t latency_us;
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t streak;            // failures in a row
+    int64_t  retry_us;          // uptime of the next request while down
+    int64_t  used_us;           // uptime of the last request
+} backend_t;
+
+// filled before the tasks start; then only the fetcher picks and reports,
+// the telemetry reads without a lock
+static backend_t backends[API_BACKENDS_MAX];
+static uint32_t n_backends;
+static uint32_t current;
+static uint32_t last;           // the one urls are built for and results reported to
+
+
+static bool add(const char *base, size_t len)
+{
+    while (len && base[len - 1] == '/') len--;
+    if (len == 0 || len >= API_BASE_URL_LEN || n_backends == API_BACKENDS_MAX) return false;
+    backend_t *b = &backends[n_backends++];
+    memset(b, 0, sizeof(*b));
+    memcpy(b->base, base, len);
+    b->latency_us = API_BACKEND_START_US;
+    return true;
+}
+
+void api_backend_init(void)
+{
+    n_backends = current = last = 0;
+#if CONFIG_BVG_DATA_SOURCE_PROXY
+    add(CONFIG_BVG_PROXY_URL, strlen(CONFIG_BVG_PROXY_URL));
+#else
+    add(CONFIG_BVG_API_BASE_URL, strlen(CONFIG_BVG_API_BASE_URL));
+    for (const char *p = CONFIG_BVG_API_FALLBACK_URLS; *p;) {
+        size_t len = strcspn(p, ", ");
+        if (len && !add(p, len)) ESP_LOGW(TAG, "fallback %.*s left out", (int)len, p);
+        p += len;
+        while (*p == ',' || *p == ' ') p++;
+    }
+#endif
+}
+
+bool api_backend_set(const char *base)
+{
+    n_backends = current = last = 0;
+    return add(base, strlen(base));
+}
+
+bool api_backend_add(const char *base)
+{
+    return add(base, strlen(base));
+}
+
+static bool is_up(const backend_t *b)
+{
+    return b->streak < API_BACKEND_DOWN_AFTER;
+}
+
+// due for a single request: down and its retry time came, or up and unused for long
+static bool probe_due(const backend_t *b, int64_t now)
+{
+    if (!is_up(b)) return now >= b->retry_us;
+    return now - b->used_us >= API_BACKEND_PROBE_S * 1000000LL;
+}
+
+static uint32_t choose(void)
+{
+    int32_t best = is_up(&backends[current]) ? (int32_t)current : -1;
+    for (uint32_t i = 0; i < n_backends; i++) {
+        if (!is_up(&backends[i]) || (int32_t)i == best) continue;
+        uint64_t limit = best == (int32_t)current ? (uint64_t)backends[best].latency_us * API_BACKEND_SWITCH_PCT / 100
+                       : best >= 0 ? backends[best].latency_us : UINT64_MAX;
+        if (backends[i].latency_us < limit) best = (int32_t)i;
+    }
+    if (best >= 0) {
+        if ((uint32_t)best != current) {
+            ESP_LOGW(TAG, "requests go to %s now, %u ms against %u ms", backends[best].base,
+                     (unsigned)(backends[best].latency_us / 1000), (unsigned)(backends[current].latency_us / 1000));
+            current = (uint32_t)best;
+        }
+        return current;
+    }
+
+    // all are down, the one to be retried first
+    uint32_t soonest = 0;
+    for (uint32_t i = 1; i < n_backends; i++) {
+        if (backends[i].retry_us < backends[soonest].retry_us) soonest = i;
+    }
+    return soonest;
+}
+
+const char *api_backend_pick(void)
+{
+    if (n_backends == 0) return "";
+    last = choose();
+    backends[last].used_us = esp_timer_get_time();
+    return backends[last].base;
+}
+
+const char *api_backend_probe(void)
+{
+    int64_t now = esp_timer_get_time();
+    for (uint32_t i = 0; i < n_backends; i++) {
+        if (i != current && probe_due(&backends[i], now)) {
+            last = i;
+            backends[i].used_us = now;
+            return backends[i].base;
+        }
+    }
+    return NULL;
+}
+
+const char *api_backend_base(void)
+{
+    return last < n_backends ? backends[last].base : "";
+}
+
+void api_backend_report(bool ok, uint32_t latency_us)
+{
+    if (last >= n_backends) return;
+    backend_t *b = &backends[last];
+    b->requests++;
+    if (ok) {
+        // one that comes back starts over from its first answer
+        b->latency_us = is_up(b) ? b->latency_us - b->latency_us / 4 + latency_us / 4 : latency_us;
+        if (!is_up(b)) ESP_LOGI(TAG, "%s answers again", b->base);
+        b->streak = 0;
+        return;
+    }
+    if (latency_us < API_BACKEND_FAIL_US) latency_us = API_BACKEND_FAIL_US;
+    b->latency_us = b->latency_us - b->latency_us / 4 + latency_us / 4;
+    b->failures++;
+    b->streak++;
+    if (b->streak >= API_BACKEND_DOWN_AFTER) {
+        uint32_t shift = b->streak - API_BACKEND_DOWN_AFTER;
+        uint32_t retry_s = shift < 5 ? API_BACKEND_RETRY_S << shift : API_BACKEND_RETRY_MAX_S;
+        if (retry_s > API_BACKEND_RETRY_MAX_S) retry_s = API_BACKEND_RETRY_MAX_S;
+        b->retry_us = esp_timer_get_time() + retry_s * 1000000LL;
+        if (b->streak == API_BACKEND_DOWN_AFTER) ESP_LOGW(TAG, "%s is down, retried in %u s", b->base, (unsigned)retry_s);
+    }
+}
+
+uint32_t api_backend_count(void)
+{
+    return n_backends;
+}
+
+bool api_backend_get(uint32_t i, api_backend_stats_t *out)
+{
+    if (i >= n_backends) return false;
+    const backend_t *b = &backends[i];
+    *out = (api_backend_stats_t){
+        .base = b->base, .up = is_up(b), .current = i == current,
+        .latency_us = b->latency_us, .requests = b->requests, .failures = b->failures,
+    };
+    return true;
+}
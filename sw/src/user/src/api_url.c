@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "sdkconfig.h"
+#include "line_data.h"
+#include "api_url.h"
+#include "api_backend.h"
+
+
+// percent-encodes everything but letters and digits, the topology stores plain names
+static void url_escape(const char * in, char * out, size_t size)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t o = 0;
+    for(; *in && o + 4 <= size; in ++)
+    {
+        unsigned char c = (unsigned char)*in;
+        if(isalnum(c) || c == '-' || c == '.' || c == '_')
+        {
+            out[o ++] = c;
+        }
+        else
+        {
+            out[o ++] = '%';
+            out[o ++] = hex[c >> 4];
+            out[o ++] = hex[c & 0xF];
+        }
+    }
+    out[o] = 0;
+}
+
+
+const char *api_base_url(void)
+{
+    api_backend_stats_t b;
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        if (b.current) return b.base;
+    }
+    return "";
+}
+
+bool api_set_base_url(const char *base)
+{
+    return api_backend_set(base);
+}
+
+
+// https://v6.bvg.transport.rest/trips?lineName=S3&operatorNames=S-Bahn%20Berlin%20GmbH&onlyCurrentlyRunning=true&stopovers=false&remarks=false&subStops=false&entrances=false&suburban=true&subway=false&tram=false&bus=false&ferry=false&express=false&regional=false&pretty=false
+bool api_line_url(const char * line, const char * operator, char * buffer, int size)
+{
+    const char * base_url = api_backend_base();
+    char op[LINE_OPERATOR_LEN * 3];
+    url_escape(operator, op, sizeof(op));
+
+    // Fetch currently running trips for a given line (e.g., "U1")
+    int n = snprintf(
+        buffer, size,
+        "%s/trips?"
+        "lineName=%s&operatorNames=%s&onlyCurrentlyRunning=true&"
+        "stopovers=false&remarks=false&subStops=false&entrances=false&"
+        "subway=true&suburban=true&tram=false&bus=false&ferry=false&express=false&regional=false&"
+        "pretty=false",
+        base_url, line, op
+    );
+    return (n >= 0 && n < size);
+}
+
+
+bool api_trip_url(const char * trip, char * buffer, int size)
+{
+    const char * base_url = api_backend_base();
+    // Fetch a specific trip by id (include stopovers if you want positions/times)
+    int n = snprintf(
+        buffer, size,
+        "%s/trips/%s?"
+        "stopovers=true&remarks=false&pretty=false",
+        base_url, trip
+    );
+    return (n >= 0 && n < size);
+}
+
+
+// http://192.168.1.10:8090/v1/lines/S41S42?max=32
+bool api_view_url(const char * map_line, int max_trips, char * buffer, int size)
+{
+    const char * base_url = api_backend_base();
+    char line[32];
+    url_escape(map_line, line, sizeof(line));
+    int n = snprintf(buffer, size, "%s/v1/lines/%s?max=%d", base_url, line, max_trips);
+    return (n >= 0 && n < size);
+}
+
+// http://192.168.1.10:8090/v2/lines/S41S42?max=32&epoch=1792405800&since=17
+bool api_view_wire_url(const char * map_line, int max_trips, uint32_t epoch, uint32_t since, char * buffer, int size)
+{
+    const char * base_url = api_backend_base();
+    char line[32];
+    url_escape(map_line, line, sizeof(line));
+    int n = snprintf(buffer, size, "%s/v2/lines/%s?max=%d&epoch=%u&since=%u", base_url, line, max_trips,
+                     (unsigned)epoch, (unsigned)since);
+    return (n >= 0 && n < size);
+}
+
+// ws://192.168.1.10:8090/v2/stream/S41S42?max=32&epoch=1792405800&since=17
+bool api_stream_url(const char * map_line, int max_trips, uint32_t epoch, uint32_t since, char * buffer, int size)
+{
+    const char * base_url = api_backend_base();
+    char line[32];
+    url_escape(map_line, line, sizeof(line));
+    // http://host -> ws://host, https://host -> wss://host
+    bool tls = strncmp(base_url, "https://", 8) == 0;
+    if(!tls && strncmp(base_url, "http://", 7) != 0) return false;
+    int n = snprintf(buffer, size, "%s://%s/v2/stream/%s?max=%d&epoch=%u&since=%u", tls ? "wss" : "ws",
+                     base_url + (tls ? 8 : 7), line, max_trips, (unsigned)epoch, (unsigned)since);
+    return (n >= 0 && n < size);
+}
@@ -2,11 +2,13 @@
 #include <inttypes.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "driver/touch_sens.h"
 #include "line_state.h"
 #include "line_data.h"
+#include "prof.h"
 
 typedef enum {
     TSTATE_RELEASED = 0,
@@ -15,19 +17,37 @@ typedef enum {
     TSTATE_PENDING_RELEASE
 } tstate_t;
 
+typedef enum {
+    TEDGE_NONE = 0,
+    TEDGE_PRESS,
+    TEDGE_RELEASE
+} tedge_t;
+
 typedef struct {
     touch_channel_handle_t ch;
     uint32_t               baseline;
+    uint32_t               baseline_q;       // baseline << TOUCH_BASELINE_SHIFT, keeps drift below one count
     uint32_t               thresh_abs;       // V1 uses absolute threshold (baseline * (1 - ratio))
+    bool                   below;            // last raw state reported by the controller
     tstate_t               st;
     int64_t                dwell_start_us;
 } tdebounce_t;
 
+// posted by the touch controller isr, consumed by cap_touch_run()
+typedef struct {
+    uint8_t idx;                             // index into s_db
+    bool    active;
+} tevent_t;
+
 #define TOUCH_NUM_CHANNELS       3
 #define TOUCH_THRESH_RATIO       0.20f   // trigger when value drops 20% from baseline
 #define TOUCH_ACTIVE_DWELL_MS    60      // must stay below threshold this long to count as "touched"
 #define TOUCH_RELEASE_DWELL_MS   60      // must stay above threshold this long to count as "released"
-#define TOUCH_POLL_PERIOD_MS     10      // sampling period of the poll task
+#define TOUCH_CALIB_SCANS        16      // oneshot scans for the first baseline (per phase)
+#define TOUCH_BASELINE_PERIOD_MS 1000    // baseline tracking interval while idle
+#define TOUCH_BASELINE_SHIFT     4       // iir weight 1/16 per tracking step
+#define TOUCH_THRESH_HYST        8       // reprogram the controller only if the threshold moved this much
+#define TOUCH_EVENT_QUEUE_LEN    16
 
 /*
    T0=GPIO4,  T1=GPIO0,  T2=GPIO2,  T3=GPIO15, T4=GPIO13,
@@ -36,6 +56,7 @@ static const int s_touch_chan_ids[TOUCH_NUM_CHANNELS] = { 0, 3, 6};
 
 static touch_sensor_handle_t s_touch = NULL;
 static tdebounce_t s_db[TOUCH_NUM_CHANNELS] = {0};
+static QueueHandle_t s_events = NULL;
 
 // pressed is used to indicate if some button has been pressed and released during the initalization phase
 // and to check weather or not delete previously saved wifi credentials
@@ -44,6 +65,10 @@ uint32_t check_pressed = 0;
 static const char *TAG = "CAPACITIVE_TOUCH";
 
 void on_touch(int chan_id) {
+    // while the reset window is open a touch only counts for the reset check
+    if (line_state_check_reset_provisioning_mode() == false) {
+        return;
+    }
     if (chan_id == 3) {
         (void)line_state_add_wrap(+1, 0, line_data_number_of_lines()-1);
     } else if (chan_id == 0) {
@@ -56,17 +81,181 @@ void on_touch(int chan_id) {
 }
 
 void on_release(int chan_id) {
+    if (line_state_check_reset_provisioning_mode() == false) {
+        check_pressed = 1;
+        ESP_LOGI(TAG, "reset provisioning requested, channel = %d", chan_id);
+        return;
+    }
     line_state_set_pressed(false);
     line_state_t s;
     line_state_get(&s);
     ESP_LOGI(TAG, "line = %d, pressed = %d, channel = %d", s.line, s.pressed, chan_id);
 }
 
+
+static int chan_index(int chan_id)
+{
+    for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
+        if (s_touch_chan_ids[i] == chan_id) return i;
+    }
+    return -1;
+}
+
+static bool touch_on_active(touch_sensor_handle_t sens, const touch_active_event_data_t *event, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    int idx = chan_index(event->chan_id);
+    if (idx >= 0) {
+        tevent_t ev = { .idx = (uint8_t)idx, .active = true };
+        xQueueSendFromISR(s_events, &ev, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+static bool touch_on_inactive(touch_sensor_handle_t sens, const touch_inactive_event_data_t *event, void *ctx)
+{
+    BaseType_t woken = pdFALSE;
+    int idx = chan_index(event->chan_id);
+    if (idx >= 0) {
+        tevent_t ev = { .idx = (uint8_t)idx, .active = false };
+        xQueueSendFromISR(s_events, &ev, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+
+// one step of the debounce state machine, shared by all channels
+static tedge_t debounce_update(tdebounce_t *d, int64_t now)
+{
+    const int64_t ACTIVE_DWELL_US  = TOUCH_ACTIVE_DWELL_MS  * 1000LL;
+    const int64_t RELEASE_DWELL_US = TOUCH_RELEASE_DWELL_MS * 1000LL;
+
+    switch (d->st) {
+        case TSTATE_RELEASED:
+            if (d->below) {
+                d->st = TSTATE_PENDING_ACTIVE;
+                d->dwell_start_us = now;
+            }
+            break;
+
+        case TSTATE_PENDING_ACTIVE:
+            if (!d->below) {
+                d->st = TSTATE_RELEASED; // bounce ended early
+            } else if (now - d->dwell_start_us >= ACTIVE_DWELL_US) {
+                d->st = TSTATE_ACTIVE;
+                return TEDGE_PRESS;
+            }
+            break;
+
+        case TSTATE_ACTIVE:
+            if (!d->below) {
+                d->st = TSTATE_PENDING_RELEASE;
+                d->dwell_start_us = now;
+            }
+            break;
+
+        case TSTATE_PENDING_RELEASE:
+            if (d->below) {
+                d->st = TSTATE_ACTIVE; // bounce back into active
+            } else if (now - d->dwell_start_us >= RELEASE_DWELL_US) {
+                d->st = TSTATE_RELEASED;
+                return TEDGE_RELEASE;
+            }
+            break;
+    }
+    return TEDGE_NONE;
+}
+
+// time until the next dwell expires, or the baseline interval if nothing is pending
+static TickType_t next_timeout(int64_t now)
+{
+    int64_t wait_us = TOUCH_BASELINE_PERIOD_MS * 1000LL;
+    for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
+        const tdebounce_t *d = &s_db[i];
+        int64_t dwell_us;
+        if (d->st == TSTATE_PENDING_ACTIVE) {
+            dwell_us = TOUCH_ACTIVE_DWELL_MS * 1000LL;
+        } else if (d->st == TSTATE_PENDING_RELEASE) {
+            dwell_us = TOUCH_RELEASE_DWELL_MS * 1000LL;
+        } else {
+            continue;
+        }
+        int64_t left = d->dwell_start_us + dwell_us - now;
+        if (left < wait_us) wait_us = left;
+    }
+    if (wait_us <= 0) return 0;
+    // round up, a wake up one tick early would just sleep again
+    return (TickType_t)((wait_us + portTICK_PERIOD_MS * 1000LL - 1) / (portTICK_PERIOD_MS * 1000LL));
+}
+
+static uint32_t thresh_from_baseline(uint32_t baseline)
+{
+    return (uint32_t)(baseline * (1.0f - TOUCH_THRESH_RATIO));
+}
+
+static void program_thresholds(void)
+{
+    for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
+        touch_channel_config_t cfg = {
+            .abs_active_thresh = {s_db[i].thresh_abs},
+            .charge_speed      = TOUCH_CHARGE_SPEED_3,
+            .init_charge_volt  = TOUCH_INIT_CHARGE_VOLT_DEFAULT,
+            .group             = TOUCH_CHAN_TRIG_GROUP_BOTH,
+        };
+        ESP_ERROR_CHECK(touch_sensor_reconfig_channel(s_db[i].ch, &cfg));
+    }
+}
+
+/*
+ * Slowly follow temperature and humidity drift. Only channels that are idle
+ * contribute, a finger resting on a pad must not become the new baseline.
+ * The controller is reprogrammed only when a threshold actually moved.
+ */
+static void track_baselines(void)
+{
+    bool changed = false;
+    for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
+        tdebounce_t *d = &s_db[i];
+        if (d->st != TSTATE_RELEASED || d->below) continue;
+
+        uint32_t val = 0;
+        if (touch_channel_read_data(d->ch, TOUCH_CHAN_DATA_TYPE_SMOOTH, &val) != ESP_OK) continue;
+
+        // baseline += (val - baseline) / 16, in fixed point so small drift adds up
+        d->baseline_q = d->baseline_q - (d->baseline_q >> TOUCH_BASELINE_SHIFT) + val;
+        d->baseline = d->baseline_q >> TOUCH_BASELINE_SHIFT;
+
+        uint32_t thresh = thresh_from_baseline(d->baseline);
+        uint32_t delta = thresh > d->thresh_abs ? thresh - d->thresh_abs : d->thresh_abs - thresh;
+        if (delta >= TOUCH_THRESH_HYST) {
+            ESP_LOGD(TAG, "T%d baseline = %"PRIu32", threshold %"PRIu32" -> %"PRIu32,
+                     s_touch_chan_ids[i], d->baseline, d->thresh_abs, thresh);
+            d->thresh_abs = thresh;
+            changed = true;
+        }
+    }
+    if (!changed) return;
+
+    ESP_ERROR_CHECK(touch_sensor_stop_continuous_scanning(s_touch));
+    ESP_ERROR_CHECK(touch_sensor_disable(s_touch));
+    program_thresholds();
+    ESP_ERROR_CHECK(touch_sensor_enable(s_touch));
+    ESP_ERROR_CHECK(touch_sensor_start_continuous_scanning(s_touch));
+}
+
+
+/*
+ * Creates the controller and the channels, cheap enough for app_main().
+ * The baseline calibration and the scanning start in cap_touch_run().
+ */
 void cap_touch_init(void)
 {
     ESP_LOGI(TAG, "INIT");
     ESP_LOGI(TAG, "Channels = T%d, T%d, T%d", s_touch_chan_ids[0], s_touch_chan_ids[1], s_touch_chan_ids[2]);
 
+    s_events = xQueueCreate(TOUCH_EVENT_QUEUE_LEN, sizeof(tevent_t));
+    configASSERT(s_events != NULL);
+
     touch_sensor_sample_config_t sample_cfg[] = {
         TOUCH_SENSOR_V1_DEFAULT_SAMPLE_CONFIG(5.0, TOUCH_VOLT_LIM_L_0V5, TOUCH_VOLT_LIM_H_1V7),
     };
@@ -76,8 +265,9 @@ void cap_touch_init(void)
     touch_sensor_filter_config_t filter_cfg = TOUCH_SENSOR_DEFAULT_FILTER_CONFIG();
     ESP_ERROR_CHECK(touch_sensor_config_filter(s_touch, &filter_cfg));
 
+    // threshold 0 keeps the channels silent until the baseline is known
     touch_channel_config_t ch_base_cfg = {
-        .abs_active_thresh = {1000},
+        .abs_active_thresh = {0},
         .charge_speed      = TOUCH_CHARGE_SPEED_3,
         .init_charge_volt  = TOUCH_INIT_CHARGE_VOLT_DEFAULT,
         .group             = TOUCH_CHAN_TRIG_GROUP_BOTH,
@@ -87,112 +277,93 @@ void cap_touch_init(void)
     for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
         ESP_ERROR_CHECK(touch_sensor_new_channel(s_touch, s_touch_chan_ids[i], &ch_base_cfg, &s_db[i].ch));
         s_db[i].st = TSTATE_RELEASED;
+        s_db[i].below = false;
         s_db[i].dwell_start_us = 0;
     }
+}
 
+// first baseline: let the filter settle, then average. the tracking in
+// cap_touch_run() refines it, so a short calibration is enough
+static void calibrate(void)
+{
+    int64_t t0 = esp_timer_get_time();
     uint32_t vals[TOUCH_NUM_CHANNELS] = {0};
-    uint32_t scans = 100;
-
-    // start touch sensor
     ESP_ERROR_CHECK(touch_sensor_enable(s_touch));
-    // make a few readings for sensor to settle
-    for (int i = 0; i < scans; i++) {
+    for (int i = 0; i < 2 * TOUCH_CALIB_SCANS; i++) {
         ESP_ERROR_CHECK(touch_sensor_trigger_oneshot_scanning(s_touch, 2000));
         for (int j = 0; j < TOUCH_NUM_CHANNELS; j++) {
             uint32_t val = 0;
             ESP_ERROR_CHECK(touch_channel_read_data(s_db[j].ch, TOUCH_CHAN_DATA_TYPE_SMOOTH, &val));
-        }
-    }
-    ESP_ERROR_CHECK(touch_sensor_disable(s_touch));
-
-    // start touch sensor
-    ESP_ERROR_CHECK(touch_sensor_enable(s_touch));
-    // scan to get the mean value
-    for (int i = 0; i < scans; i++) {
-        ESP_ERROR_CHECK(touch_sensor_trigger_oneshot_scanning(s_touch, 2000));
-        for (int j = 0; j < TOUCH_NUM_CHANNELS; j++) {
-            uint32_t val = 0;
-            ESP_ERROR_CHECK(touch_channel_read_data(s_db[j].ch, TOUCH_CHAN_DATA_TYPE_SMOOTH, &val));
-            vals[j] += val;
+            if (i >= TOUCH_CALIB_SCANS) vals[j] += val;
         }
     }
     ESP_ERROR_CHECK(touch_sensor_disable(s_touch));
 
     // compute mean and threshold for the sensor
     for(int i = 0; i < TOUCH_NUM_CHANNELS; i ++) {
-        vals[i] /= scans;
-        s_db[i].baseline  = vals[i];
-        s_db[i].thresh_abs = (uint32_t)(vals[i] * (1.0f - TOUCH_THRESH_RATIO));
-        //ch_base_cfg.abs_active_thresh[i] = s_db[i].thresh_abs;
-        // do i need to do this ??? lets test
-        //ESP_ERROR_CHECK(touch_sensor_reconfig_channel(s_db[i].ch, &ch_base_cfg));
-        ESP_LOGI(TAG, "T%d mean reading = %d, threshold = %d", s_touch_chan_ids[0], s_db[i].baseline, s_db[i].thresh_abs);
+        s_db[i].baseline   = vals[i] / TOUCH_CALIB_SCANS;
+        s_db[i].baseline_q = s_db[i].baseline << TOUCH_BASELINE_SHIFT;
+        s_db[i].thresh_abs = thresh_from_baseline(s_db[i].baseline);
+        ESP_LOGI(TAG, "T%d mean reading = %"PRIu32", threshold = %"PRIu32, s_touch_chan_ids[i], s_db[i].baseline, s_db[i].thresh_abs);
     }
+    program_thresholds();
+
+    touch_event_callbacks_t cbs = {
+        .on_active   = touch_on_active,
+        .on_inactive = touch_on_inactive,
+    };
+    ESP_ERROR_CHECK(touch_sensor_register_callbacks(s_touch, &cbs, NULL));
 
     // Start continuous scanning
     ESP_ERROR_CHECK(touch_sensor_enable(s_touch));
     ESP_ERROR_CHECK(touch_sensor_start_continuous_scanning(s_touch));
+    ESP_LOGI(TAG, "calibrated in %" PRId64 " ms", (esp_timer_get_time() - t0) / 1000);
 }
 
 
+/*
+ * Sleeps on the isr event queue. Wakes up for controller events, for the end
+ * of a pending dwell and once per baseline interval, nothing is polled.
+ * During the reset provisioning window on_touch()/on_release() only record
+ * the press for cap_touch_check_is_pressed().
+ */
 void cap_touch_run(void)
 {
-    const int64_t ACTIVE_DWELL_US  = TOUCH_ACTIVE_DWELL_MS  * 1000LL;
-    const int64_t RELEASE_DWELL_US = TOUCH_RELEASE_DWELL_MS * 1000LL;
-
+    // calibrating here instead of in cap_touch_init() overlaps it with the
+    // rest of the boot, the reset window waits for it
+    calibrate();
+    prof_boot_mark(PROF_BOOT_TOUCH_READY);
+    line_state_release_calibration_mode();
     ESP_LOGI(TAG, "started");
 
-    while (1) {
-        for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
-            tdebounce_t *d = &s_db[i];
-
-            uint32_t val = 0;
-            // Runtime we read smoothed value
-            if (touch_channel_read_data(d->ch, TOUCH_CHAN_DATA_TYPE_SMOOTH, &val) != ESP_OK) {
-                vTaskDelay(pdMS_TO_TICKS(TOUCH_POLL_PERIOD_MS));
-                continue;
-            }
+    int64_t next_baseline_us = esp_timer_get_time() + TOUCH_BASELINE_PERIOD_MS * 1000LL;
 
-            //ESP_LOGI(TAG, "channel %d reading = %d", i, val);
-
-            bool below = (val < d->thresh_abs);
-            int64_t now = esp_timer_get_time();
+    while (1) {
+        tevent_t ev;
+        bool got = xQueueReceive(s_events, &ev, next_timeout(esp_timer_get_time())) == pdTRUE;
+        int64_t now = esp_timer_get_time();
 
-            switch (d->st) {
-                case TSTATE_RELEASED:
-                    if (below) {
-                        d->st = TSTATE_PENDING_ACTIVE;
-                        d->dwell_start_us = now;
-                    }
-                    break;
+        if (got) {
+            s_db[ev.idx].below = ev.active;
+        }
 
-                case TSTATE_PENDING_ACTIVE:
-                    if (!below) {
-                        d->st = TSTATE_RELEASED; // bounce ended early
-                    } else if (now - d->dwell_start_us >= ACTIVE_DWELL_US) {
-                        d->st = TSTATE_ACTIVE;
-                        on_touch(s_touch_chan_ids[i]);     // debounced PRESS
-                    }
+        for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
+            switch (debounce_update(&s_db[i], now)) {
+                case TEDGE_PRESS:
+                    on_touch(s_touch_chan_ids[i]);     // debounced PRESS
                     break;
-
-                case TSTATE_ACTIVE:
-                    if (!below) {
-                        d->st = TSTATE_PENDING_RELEASE;
-                        d->dwell_start_us = now;
-                    }
+                case TEDGE_RELEASE:
+                    on_release(s_touch_chan_ids[i]);   // debounced RELEASE
                     break;
-
-                case TSTATE_PENDING_RELEASE:
-                    if (below) {
-                        d->st = TSTATE_ACTIVE; // bounce back into active
-                    } else if (now - d->dwell_start_us >= RELEASE_DWELL_US) {
-                        d->st = TSTATE_RELEASED;
-                        on_release(s_touch_chan_ids[i]);   // debounced RELEASE
-                    }
+                case TEDGE_NONE:
                     break;
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(TOUCH_POLL_PERIOD_MS));
+
+        if (now >= next_baseline_us) {
+            track_baselines();
+            next_baseline_us = now + TOUCH_BASELINE_PERIOD_MS * 1000LL;
+        }
     }
 }
 
@@ -201,67 +372,3 @@ bool cap_touch_check_is_pressed(void)
 {
     return check_pressed ? true : false;
 }
-
-
-void cap_touch_check(void)
-{
-    const int64_t ACTIVE_DWELL_US  = TOUCH_ACTIVE_DWELL_MS  * 1000LL;
-    const int64_t RELEASE_DWELL_US = TOUCH_RELEASE_DWELL_MS * 1000LL;
-
-    ESP_LOGI(TAG, "started");
-
-    while (1) {
-        for (int i = 0; i < TOUCH_NUM_CHANNELS; i++) {
-            tdebounce_t *d = &s_db[i];
-
-            uint32_t val = 0;
-            // Runtime we read smoothed value
-            if (touch_channel_read_data(d->ch, TOUCH_CHAN_DATA_TYPE_SMOOTH, &val) != ESP_OK) {
-                vTaskDelay(pdMS_TO_TICKS(TOUCH_POLL_PERIOD_MS));
-                continue;
-            }
-
-            //ESP_LOGI(TAG, "channel %d reading = %d", i, val);
-
-            bool below = (val < d->thresh_abs);
-            int64_t now = esp_timer_get_time();
-
-            switch (d->st) {
-                case TSTATE_RELEASED:
-                    if (below) {
-                        d->st = TSTATE_PENDING_ACTIVE;
-                        d->dwell_start_us = now;
-                    }
-                    break;
-
-                case TSTATE_PENDING_ACTIVE:
-                    if (!below) {
-                        d->st = TSTATE_RELEASED; // bounce ended early
-                    } else if (now - d->dwell_start_us >= ACTIVE_DWELL_US) {
-                        d->st = TSTATE_ACTIVE;
-                    }
-                    break;
-
-                case TSTATE_ACTIVE:
-                    if (!below) {
-                        d->st = TSTATE_PENDING_RELEASE;
-                        d->dwell_start_us = now;
-                    }
-                    break;
-
-                case TSTATE_PENDING_RELEASE:
-                    if (below) {
-                        d->st = TSTATE_ACTIVE; // bounce back into active
-                    } else if (now - d->dwell_start_us >= RELEASE_DWELL_US) {
-                        d->st = TSTATE_RELEASED;
-                        check_pressed = 1;
-                    }
-                    break;
-            }
-        }
-        if (line_state_check_reset_provisioning_mode() == true) {
-            return;
-        }
-        vTaskDelay(pdMS_TO_TICKS(TOUCH_POLL_PERIOD_MS));
-    }
-}
@@ -0,0 +1,147 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "frame_rec.h"
+#include "mem_tier.h"
+
+_Static_assert(sizeof(frame_px_t) == 3, "frame_px_t is part of the log format");
+_Static_assert(sizeof(frame_rec_hdr_t) == 16, "frame_rec_hdr_t is part of the log format");
+
+
+void frame_rec_init(frame_rec_t *r, frame_rec_write_fn write, void *ctx)
+{
+    memset(r, 0, sizeof(*r));
+    r->write = write;
+    r->ctx = ctx;
+}
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v)
+{
+    p = put_u16(p, v & 0xFFFF);
+    return put_u16(p, v >> 16);
+}
+
+bool frame_rec_add(frame_rec_t *r, const frame_t *f, int64_t t_us)
+{
+    uint8_t *p = r->buf;
+    int64_t t0_us = r->frames ? r->t0_us : t_us;
+
+    if (r->frames == 0) {
+        frame_rec_hdr_t hdr = {
+            .magic = FRAME_REC_MAGIC,
+            .version = FRAME_REC_VERSION,
+            .led_count = FRAME_LED_COUNT,
+            .t0_us = t_us,
+        };
+        memcpy(p, &hdr, sizeof(hdr));
+        p += sizeof(hdr);
+    }
+
+    uint32_t changed = 0;
+    if (r->frames) {
+        for (uint32_t i = 0; i < FRAME_LED_COUNT; i++) {
+            if (memcmp(&f->px[i], &r->prev.px[i], sizeof(frame_px_t)) != 0) changed++;
+        }
+    }
+    bool key = r->frames == 0 || r->since_key + 1 >= FRAME_REC_KEY_INTERVAL ||
+               2 + changed * 5 >= sizeof(f->px);
+
+    uint8_t *kind = p++;
+    p = put_u32(p, (uint32_t)((t_us - t0_us) / 1000));
+    if (key) {
+        *kind = 'K';
+        memcpy(p, f->px, sizeof(f->px));
+        p += sizeof(f->px);
+    } else if (changed) {
+        *kind = 'D';
+        p = put_u16(p, changed);
+        for (uint32_t i = 0; i < FRAME_LED_COUNT; i++) {
+            if (memcmp(&f->px[i], &r->prev.px[i], sizeof(frame_px_t)) == 0) continue;
+            p = put_u16(p, i);
+            *p++ = f->px[i].r;
+            *p++ = f->px[i].g;
+            *p++ = f->px[i].b;
+        }
+    } else {
+        *kind = 'S';
+    }
+
+    if (!r->write(r->buf, (uint32_t)(p - r->buf), r->ctx)) return false;
+    r->t0_us = t0_us;
+    r->prev = *f;
+    r->frames++;
+    r->since_key = key ? 0 : r->since_key + 1;
+    return true;
+}
+
+
+#if CONFIG_FRAME_RECORDER
+
+static const char *TAG = "FRAME_REC";
+
+#define LOG_SIZE (CONFIG_FRAME_RECORDER_BUFFER_KB * 1024)
+
+static uint8_t *log_buf;   // MEM_TIER_BULK, only appended to
+static uint32_t log_len;
+static bool log_full;
+static frame_rec_t log_rec;
+static SemaphoreHandle_t log_mutex;
+
+static bool log_write(const void *data, uint32_t len, void *ctx)
+{
+    if (log_len + len > LOG_SIZE) {
+        if (!log_full) ESP_LOGW(TAG, "log full after %u frames, recording stops", (unsigned)log_rec.frames);
+        log_full = true;
+        return false;
+    }
+    memcpy(log_buf + log_len, data, len);
+    log_len += len;
+    return true;
+}
+
+void frame_rec_log_init(void)
+{
+    if (log_mutex == NULL) log_mutex = xSemaphoreCreateMutex();
+    configASSERT(log_mutex != NULL);
+    if (log_buf == NULL) log_buf = mem_tier_alloc(LOG_SIZE, MEM_TIER_BULK, "frame log");
+    frame_rec_init(&log_rec, log_write, NULL);
+}
+
+void frame_rec_log_sink(const frame_t *f, int64_t t_us, void *ctx)
+{
+    // the led task never waits for a reader, a left out frame is a gap in time
+    if (log_full || xSemaphoreTake(log_mutex, 0) != pdTRUE) return;
+    (void)frame_rec_add(&log_rec, f, t_us);
+    xSemaphoreGive(log_mutex);
+}
+
+bool frame_rec_log_read(bool (*emit)(const void *data, uint32_t len, void *ctx), void *ctx)
+{
+    bool ok = true;
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    for (uint32_t off = 0; off < log_len && ok; off += 1024) {
+        uint32_t n = log_len - off < 1024 ? log_len - off : 1024;
+        ok = emit(log_buf + off, n, ctx);
+    }
+    xSemaphoreGive(log_mutex);
+    return ok;
+}
+
+void frame_rec_log_restart(void)
+{
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    frame_rec_init(&log_rec, log_write, NULL);
+    log_len = 0;
+    log_full = false;
+    xSemaphoreGive(log_mutex);
+}
+
+#endif
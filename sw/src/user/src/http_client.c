@@ -1,5 +1,6 @@
 #include "http_client.h"
 #include <string.h>
+#include <strings.h>
 #include <sys/param.h>
 #include <stdlib.h>
 #include <ctype.h>
@@ -15,12 +16,23 @@
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_http_client.h"
+#include "time_server.h"
 
 
 static const char *TAG = "HTTP_CLIENT ";
 
 
-bool fetch_data(const char *url, char * buffer, int buff_size)
+// every api answer carries the server time, it sets the clock before sntp does
+static esp_err_t http_event(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Date") == 0) {
+        time_server_http_date(evt->header_value);
+    }
+    return ESP_OK;
+}
+
+
+int fetch_data_len(const char *url, char * buffer, int buff_size)
 {
     
     //ESP_LOGI(TAG, "fetch url:\n%s", url);
@@ -31,12 +43,13 @@ bool fetch_data(const char *url, char * buffer, int buff_size)
         .crt_bundle_attach = esp_crt_bundle_attach,
         #endif
         .timeout_ms = 15000,
+        .event_handler = http_event,
     };
 
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (!client) {
         ESP_LOGE(TAG, "init failed");
-        return false;
+        return -1;
     }
 
     esp_http_client_set_header(client, "Accept", "application/json");
@@ -46,42 +59,64 @@ bool fetch_data(const char *url, char * buffer, int buff_size)
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "open failed: %s", esp_err_to_name(err));
         esp_http_client_cleanup(client);
-        return false;
+        return -1;
     }
 
+    // from here on every way out closes and frees the client
+    bool ok = false;
+    int total = 0;
     int content_length = esp_http_client_fetch_headers(client);
     //ESP_LOGI(TAG, "content_length = %d", content_length);
     if(content_length > buff_size) {
         ESP_LOGE(TAG, "fetching buffer too small content_length = %d", content_length);
-        return false;
+        goto done;
     }
     if(content_length < 0) {
         ESP_LOGE(TAG, "content length error content_length = %d", content_length);
-        return false;
+        goto done;
     }
 
-    int total = 0;
     while (1) {
         int to_read = buff_size - total;
         if (to_read <= 0) { 
-            ESP_LOGE(TAG, "fetching buffer still too small"); return false; 
+            ESP_LOGE(TAG, "fetching buffer still too small");
+            goto done;
         }
         int r = esp_http_client_read(client, buffer + total, to_read);
-        if (r <= 0) break;
+        if (r < 0) {
+            // a reset after part of the body, what came is not the answer
+            ESP_LOGE(TAG, "read failed after %d bytes", total);
+            goto done;
+        }
+        if (r == 0) break;
         total += r;
     }
+    if (!esp_http_client_is_complete_data_received(client)) {
+        ESP_LOGE(TAG, "body cut off after %d bytes", total);
+        goto done;
+    }
     buffer[total] = '\0';
+    ok = true;
+
+done:;
     int status = esp_http_client_get_status_code(client);
 
     esp_http_client_close(client);
     esp_http_client_cleanup(client);
 
+    if (!ok) return -1;
     if (status != 200) {
         ESP_LOGE(TAG, "error with status %d, for url = %s", status, url);
-        return false;
+        return -1;
     }
 
-    ESP_LOGD(TAG, "payload:\n%s",buffer);
+    ESP_LOGD(TAG, "payload of %d bytes", total);
+
+    return total;
+}
 
-    return true;
+
+bool fetch_data(const char *url, char * buffer, int buff_size)
+{
+    return fetch_data_len(url, buffer, buff_size) >= 0;
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "driver/rmt_tx.h"
 #include "line_data.h"
 #include "tripring.h"
@@ -16,22 +17,46 @@
 #include "led_strip.h"
 #include "cap_touch.h"
 #include "line_state.h"
+#include "frame.h"
+#include "led_compose.h"
+#include "led_out.h"
+#include "frame_rec.h"
+#include "prof.h"
+#include "trace.h"
 
 // GPIO assignment
 #define LED_STRIP_GPIO_PIN  27
 // Numbers of the LED in the strip
-#define LED_STRIP_LED_COUNT 320
+#define LED_STRIP_LED_COUNT FRAME_LED_COUNT
 
-static led_strip_handle_t led_strip = NULL;
+static frame_t frame;
+static led_compose_t compose;
 
 static const char *TAG = "LED";
 
-static bool parse_trips_into_leds(void);
 
+#if !CONFIG_FRAME_RECORDER_ONLY
+static led_strip_handle_t led_strip = NULL;
+
+// led_out sink of the WS2812 strip: copy the frame into the strip and push it out
+static void strip_flush(const frame_t *f, int64_t t_us, void *ctx)
+{
+    for (uint32_t i = 0; i < LED_STRIP_LED_COUNT; i++) {
+        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, f->px[i].r, f->px[i].g, f->px[i].b));
+    }
+    ESP_ERROR_CHECK(led_strip_refresh(led_strip));
+}
+#endif
+
+static void frame_flush(const frame_t *f)
+{
+    led_out_flush(f, esp_timer_get_time());
+}
 
 
 void led_stripe_init(void)
 {
+#if !CONFIG_FRAME_RECORDER_ONLY
     // LED strip general initialization, according to your led board design
     led_strip_config_t strip_config = {
         .strip_gpio_num = LED_STRIP_GPIO_PIN, // The GPIO that connected to the LED strip's data line
@@ -63,55 +88,26 @@ void led_stripe_init(void)
     // LED Strip object handle
     ESP_ERROR_CHECK(led_strip_new_spi_device(&strip_config, &spi_config, &led_strip));
     ESP_LOGI(TAG, "Created LED strip object with SPI backend");
-
+    led_out_add(strip_flush, NULL);
+#endif
+#if CONFIG_FRAME_RECORDER
+    frame_rec_log_init();
+    led_out_add(frame_rec_log_sink, NULL);
+    ESP_LOGI(TAG, "Frames are recorded, %d KB", CONFIG_FRAME_RECORDER_BUFFER_KB);
+#endif
+
+    frame_clear(&frame);
     for (int i = 0; i < LED_STRIP_LED_COUNT; i++) {
-        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 1, 0));
+        frame_set(&frame, i, 0, 1, 0);
     }
-    ESP_ERROR_CHECK(led_strip_refresh(led_strip));
+    frame_flush(&frame);
 
-    // while(1)
-    // {
-    //     draw_all_numbers(&led_strip);
-    // }
-
-    //led_state_draw_all_lines(&led_strip, 1000, 100);
+    led_compose_init(&compose);
 }
 
 
 
 
-static void decide_led(uint8_t led_encoded, uint32_t i, uint32_t loop_cnt)
-{
-
-    uint8_t nr_of_trains = led_encoded & 0b00111111;
-    uint8_t direction = led_encoded & 0b01000000;
-    uint8_t blink = led_encoded & 0b10000000;
-
-    if(nr_of_trains != 0)
-    {
-        ESP_LOGD(TAG, "nr of trains = %d, direction = %d", nr_of_trains, direction ? 1 : -1);
-    }
-
-    if(nr_of_trains == 1)
-    {
-        // green when direction is positive
-        if(direction != 0) ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 1, 0, 0));
-        // else red
-        else ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 1, 0));
-    }
-    // blue for more than one train at a station
-    else if(nr_of_trains >= 2)
-    {
-        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, 1));
-    }
-
-    // set to 0 if blink and loopcount
-    if(blink && loop_cnt)
-    {
-        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, 0));
-    }
-}
-
 // Simple color wheel: pos 0..255 -> r,g,b
 static inline void color_wheel(uint8_t pos, uint8_t *r, uint8_t *g, uint8_t *b)
 {
@@ -139,35 +135,34 @@ void display_chance_to_reset_provisioning_pattern(void)
     uint8_t on = 1;
 
     while (1) {
-        // Clear strip
-        for (uint32_t i = 0; i < LED_STRIP_LED_COUNT; i++) {
-            ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, 0));
-        }
+        frame_clear(&frame);
         for (uint32_t i = 0; i < 8; i++) {
-            ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, on));
+            frame_set(&frame, i, 0, 0, on);
         }
-        ESP_ERROR_CHECK(led_strip_refresh(led_strip));
-        if (line_state_check_reset_provisioning_mode() == true) {
+        frame_flush(&frame);
+        on = on ? 0 : 1;
+        // blink period, returns early as soon as the window is closed
+        if (line_state_wait_reset_provisioning_mode(pdMS_TO_TICKS(100)) == true) {
             return;
         }
-        on = on ? 0 : 1;
-        // Small pause to make it visible & feed watchdog
-        vTaskDelay(pdMS_TO_TICKS(100));
     }
 }
 
 
+// frame time of the boot animation (2 ticks at 100 Hz)
+#define INIT_FRAME_PERIOD pdMS_TO_TICKS(20)
+
 void fiddle_as_lon_as_init(void)
 {
     uint32_t k = 0;          // moving pixel index
     uint8_t hue = 0;         // 0..255 color wheel
     uint8_t r,g,b;
 
+    frame_clear(&frame);
+
     while (1) {
-        // Clear strip
-        for (uint32_t i = 0; i < LED_STRIP_LED_COUNT; i++) {
-            ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, 0));
-        }
+        // only the previous pixel has to go dark
+        frame_set(&frame, k, 0, 0, 0);
 
         // Advance pixel and color
         k   = (k + 1) % LED_STRIP_LED_COUNT;   // use LED_STRIP_LED_COUNT, not a hard 320
@@ -175,16 +170,13 @@ void fiddle_as_lon_as_init(void)
 
         color_wheel(hue, &r, &g, &b);
 
-        // If your strip expects GRB order, swap here: led_strip_set_pixel(..., g, r, b);
-        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, k, r, g, b));
-        ESP_ERROR_CHECK(led_strip_refresh(led_strip));
+        frame_set(&frame, k, r, g, b);
+        frame_flush(&frame);
 
-        if (line_state_check_init_mode() == true) {
+        // one frame, wakes up immediately when init is released
+        if (line_state_wait_init_mode(INIT_FRAME_PERIOD) == true) {
             return;
         }
-
-        // Small pause to make it visible & feed watchdog
-        vTaskDelay(pdMS_TO_TICKS(1));
     }
 }
 
@@ -196,138 +188,20 @@ void led_stripe_run(void)
 {
     const TickType_t period = pdMS_TO_TICKS(100); // 100 ms
     TickType_t last_wake = xTaskGetTickCount();   // initialize BEFORE the loop
-    int line_name_printed = 0;
-    int k = 0;
 
-    static uint32_t loop_cnt = 0;
     while(1)
     {
-        tr_take();
-        parse_trips_into_leds();
-        tr_release();
-
-        
-
-        for (uint32_t i = 0; i < LED_STRIP_LED_COUNT; i++) {
-            ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, i, 0, 0, 0));
-        }
-
-        k = (k+1)%64;
-        //k = (k+1)%319;
-        ESP_ERROR_CHECK(led_strip_set_pixel(led_strip, k>>3, 0, 0, 1));
+        int64_t t0 = prof_now_us();
 
         line_state_get(&line_state);
-        if (line_state.pressed) {
-                if(line_name_printed == 0)
-                {
-                    line_name_printed = 1;
-
-                    // ESP_LOGI(TAG, " ");
-                    // ESP_LOGI(TAG, " ");
-                    // ESP_LOGI(TAG, "line number = %d", line_state.line);
-
-                    led_state_draw_line(&led_strip, line_state.line, 600, 50);
-                    last_wake = xTaskGetTickCount();   // initialize BEFORE the loop
-                }
-                else
-                {
-                    print_line(&led_strip, line_state.line);
-                }
-        }
-        else {
-            for(int i = 0; i < 320; i ++) {
-                decide_led(led_active[i], i, loop_cnt%2);
-            }
-            line_name_printed = 0;
-        }
-
-        // Flush RGB values to LEDs
-        ESP_ERROR_CHECK(led_strip_refresh(led_strip));
-        
-        vTaskDelayUntil(&last_wake, period);
-        loop_cnt ++;
-    }
-}
-
-
-
-static bool parse_trips_into_leds(void)
-{
-    Trip *t;
-    int64_t now = get_unix_seconds();
-    // remove trips that are arrivd since 60 seconds
-    // tr_free_old(now + 60);
-
-    // reset active leds
-    memset(led_active, 0, sizeof(led_active));
-    // iterate over all trips
-    ESP_LOGD(TAG, "check trip size: %d", tr_get_size());
-    ESP_LOGD(TAG, "number of trips = %d", tr_get_size());
-    for(int x = 0; x < tr_get_size(); x++)
-    {
-        t = tr_get_trip(x);
-        ESP_LOGD(TAG, "trip number %d id = %s", x, t->trip_id);
-        // interate over all stops
-        int64_t dt = INT64_MAX;
-        uint32_t index = 0;
-        for(int i = 0; i < t->num_stops; i ++)
-        {
-            // take arrival time or departure time
-            int64_t st = t->stops[i].arr_ts; 
-            if(st == 0) st = t->stops[i].dep_ts;
-
-            ESP_LOGD(TAG, "timestamp of stop = %lld, now = %lld", st, now);
-            
-            // check station with nearest arrival or departure
-            int64_t delta = st - now;
-            if(delta < 0) delta = -delta;
-
-            // if delta is smallest then safe index
-            if(delta < dt)
-            {
-                dt = delta;
-                index = t->stops[i].station_id;
-            }
-            
-        }
-        
-        // check if something valid as been found
-        if(index == 0)
-        {
-            ESP_LOGE(TAG, "no fastest station found for trip: %s", t->trip_id);
-            print_trips_here(t, now);
-            continue;
+        if (led_compose(&compose, &frame, anim_now_ms(), get_unix_seconds(), &line_state)) {
+            prof_boot_mark(PROF_BOOT_FIRST_TRAIN);
         }
 
-        // now select the led to light up
-        int found = -1;
-        for(int j = 0; j < line_data_number_of_stations(); j ++)
-        {
-            if(index == stations[j].station_id)
-            {
-                found = stations[j].line_pos;
-            }
-        }
+        // to the strip and/or the recorder
+        frame_flush(&frame);
+        prof_hist_add(PROF_HIST_FRAME, (uint32_t)(prof_now_us() - t0));
 
-        if(found == -1)
-        {
-            ESP_LOGE(TAG, "no matching id found for trip: %s, selected id = %d", t->trip_id, index);
-            print_trips_here(t, now);
-            continue;           
-        }
-        led_active[found] ++;
-        
-        if(dt < 2)
-        {
-            led_active[found] = led_active[found] | 0x80; 
-        }
-
-        if(t->direction == 1)
-        {
-            led_active[found] = led_active[found] | (0x80 >> 1); 
-        }
-        ESP_LOGD(TAG, "active led = %d with direction %d", led_active[found], t->direction);
-        ESP_LOGD(TAG, "station id %d at led pos %d is the next one", index, found);
+        vTaskDelayUntil(&last_wake, period);
     }
-    return true;
 }
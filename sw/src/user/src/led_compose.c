@@ -0,0 +1,47 @@
+#include <string.h>
+#include "tripring.h"
+#include "line_data.h"
+#include "led_map.h"
+#include "led_compose.h"
+
+
+void led_compose_init(led_compose_t *c)
+{
+    memset(c, 0, sizeof(*c));
+    anim_timeline_clear(&c->label);
+}
+
+bool led_compose(led_compose_t *c, frame_t *f, int64_t now_ms, int64_t unix_s, const line_state_t *ls)
+{
+    tr_take();
+    bool lit = led_map_build(c->active, unix_s);
+    tr_release();
+
+    frame_clear(f);
+
+    c->k = (c->k + 1) % 64;
+    frame_set(f, c->k >> 3, 0, 0, 1);
+
+    if (ls->pressed && !c->line_name_printed) {
+        // new selection: restart the label, the running one is dropped
+        c->line_name_printed = true;
+        anim_line_label(&c->label, ls->line, 600, 50, 1000, now_ms);
+    }
+    if (!ls->pressed) {
+        c->line_name_printed = false;
+    }
+
+    // trains keep running under the label, its layers only paint their own
+    // segment and station leds; it runs to its end even if the touch is released
+    bool overlay = anim_timeline_active(&c->label, now_ms);
+    if (!overlay && ls->pressed) {
+        print_line(f, ls->line);
+    }
+    else {
+        led_map_render(f, c->active, c->loop_cnt % 2);
+        anim_timeline_render(&c->label, now_ms, f);
+    }
+
+    c->loop_cnt++;
+    return lit;
+}
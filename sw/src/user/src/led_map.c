@@ -0,0 +1,121 @@
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "line_data.h"
+#include "tripring.h"
+#include "trace.h"
+#include "led_map.h"
+
+static const char *TAG = "LED_MAP";
+
+
+static void decide_led(frame_t *f, uint8_t led_encoded, uint32_t i, bool blink_off)
+{
+
+    uint8_t nr_of_trains = led_encoded & LED_MAP_TRAINS;
+    uint8_t direction = led_encoded & LED_MAP_DIRECTION;
+    uint8_t blink = led_encoded & LED_MAP_BLINK;
+
+    if(nr_of_trains != 0)
+    {
+        ESP_LOGD(TAG, "nr of trains = %d, direction = %d", nr_of_trains, direction ? 1 : -1);
+    }
+
+    if(nr_of_trains == 1)
+    {
+        // green when direction is positive
+        if(direction != 0) frame_set(f, i, 1, 0, 0);
+        // else red
+        else frame_set(f, i, 0, 1, 0);
+    }
+    // blue for more than one train at a station
+    else if(nr_of_trains >= 2)
+    {
+        frame_set(f, i, 0, 0, 1);
+    }
+
+    // set to 0 if blink and loopcount
+    if(blink && blink_off)
+    {
+        frame_set(f, i, 0, 0, 0);
+    }
+}
+
+void led_map_render(frame_t *f, const uint8_t active[FRAME_LED_COUNT], bool blink_off)
+{
+    for(uint32_t i = 0; i < FRAME_LED_COUNT; i ++) {
+        decide_led(f, active[i], i, blink_off);
+    }
+}
+
+
+bool led_map_build(uint8_t active[FRAME_LED_COUNT], int64_t now)
+{
+    Trip *t;
+    bool lit = false;
+
+    // reset active leds
+    memset(active, 0, FRAME_LED_COUNT);
+    // iterate over all trips
+    ESP_LOGD(TAG, "number of trips = %d", tr_get_size());
+    for(int x = 0; x < tr_get_size(); x++)
+    {
+        t = tr_get_trip(x);
+        ESP_LOGD(TAG, "trip number %d id = %s", x, t->trip_id);
+        // interate over all stops
+        int64_t dt = INT64_MAX;
+        uint32_t index = 0;
+        for(int i = 0; i < t->num_stops; i ++)
+        {
+            // take arrival time or departure time
+            int64_t st = t->stops[i].arr_ts;
+            if(st == 0) st = t->stops[i].dep_ts;
+
+            ESP_LOGD(TAG, "timestamp of stop = %" PRId64 ", now = %" PRId64, st, now);
+
+            // check station with nearest arrival or departure
+            int64_t delta = st - now;
+            if(delta < 0) delta = -delta;
+
+            // if delta is smallest then safe index
+            if(delta < dt)
+            {
+                dt = delta;
+                index = t->stops[i].station_id;
+            }
+
+        }
+
+        // check if something valid as been found
+        if(index == 0)
+        {
+            // runs under tr_mutex every frame, so no console output here
+            TRACE_LED(LED_NO_STATION, t->line_code, t->num_stops, t->origin_station_id);
+            continue;
+        }
+
+        // now select the led to light up
+        int32_t found = line_data_find_station_led(index);
+
+        if(found == -1)
+        {
+            TRACE_LED(LED_NO_LED, t->line_code, index, 0);
+            continue;
+        }
+        active[found] ++;
+
+        if(dt < 2)
+        {
+            active[found] = active[found] | LED_MAP_BLINK;
+        }
+
+        if(t->direction == 1)
+        {
+            active[found] = active[found] | LED_MAP_DIRECTION;
+        }
+        ESP_LOGD(TAG, "active led = %d with direction %d", active[found], t->direction);
+        ESP_LOGD(TAG, "station id %d at led pos %d is the next one", index, found);
+        lit = true;
+    }
+    return lit;
+}
@@ -0,0 +1,22 @@
+#include "led_out.h"
+
+static struct {
+    led_out_fn fn;
+    void      *ctx;
+} sinks[LED_OUT_MAX_SINKS];
+static uint32_t n_sinks;
+
+
+bool led_out_add(led_out_fn fn, void *ctx)
+{
+    if (n_sinks == LED_OUT_MAX_SINKS) return false;
+    sinks[n_sinks].fn = fn;
+    sinks[n_sinks].ctx = ctx;
+    n_sinks++;
+    return true;
+}
+
+void led_out_flush(const frame_t *f, int64_t t_us)
+{
+    for (uint32_t i = 0; i < n_sinks; i++) sinks[i].fn(f, t_us, sinks[i].ctx);
+}
@@ -1,12 +1,18 @@
 #include "line_state.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include <string.h>
 
+// a set bit means the mode is over, tasks block on it instead of polling
+#define MODE_INIT_DONE                 BIT0
+#define MODE_RESET_PROVISIONING_DONE   BIT1
+#define MODE_CALIBRATION_DONE          BIT2
+#define MODE_NETWORK_DONE              BIT3
+
 static line_state_t        s_state = {0};
 static SemaphoreHandle_t   s_mutex = NULL;
-static SemaphoreHandle_t   init_mutex = NULL;
-static SemaphoreHandle_t   reset_provisioning_mutex = NULL;
+static EventGroupHandle_t  s_modes = NULL;
 
 static inline int8_t wrap_into(int8_t v, int8_t min, int8_t max)
 {
@@ -23,64 +29,104 @@ void line_state_init(void)
     if (!s_mutex) {
         s_mutex = xSemaphoreCreateMutex();
     }
-    if (!init_mutex) {
-        init_mutex = xSemaphoreCreateMutex();
+    if (!s_modes) {
+        s_modes = xEventGroupCreate();
     }
-    if (!reset_provisioning_mutex) {
-        reset_provisioning_mutex = xSemaphoreCreateMutex();
-    }    
     configASSERT(s_mutex != NULL);
-    configASSERT(init_mutex != NULL);
-    configASSERT(reset_provisioning_mutex != NULL);
+    configASSERT(s_modes != NULL);
     xSemaphoreTake(s_mutex, portMAX_DELAY);
     s_state.line = 0;
     s_state.pressed = false;
     xSemaphoreGive(s_mutex);
 }
 
+static bool mode_wait_done(EventBits_t bit, TickType_t timeout)
+{
+    EventBits_t bits = xEventGroupWaitBits(s_modes, bit, pdFALSE, pdTRUE, timeout);
+    return (bits & bit) != 0;
+}
+
 void line_state_set_init_mode(void)
 {
-    xSemaphoreTake(init_mutex, portMAX_DELAY);
+    xEventGroupClearBits(s_modes, MODE_INIT_DONE);
 }
 
 void line_state_release_init_mode(void)
 {
-    xSemaphoreGive(init_mutex);
+    xEventGroupSetBits(s_modes, MODE_INIT_DONE);
 }
 
 bool line_state_check_init_mode(void)
 {
-    if(xSemaphoreTake( init_mutex, pdMS_TO_TICKS(1)) != pdTRUE ){
-        return false;
-    }
-    else {
-        vTaskDelay(pdMS_TO_TICKS(1));
-        xSemaphoreGive(init_mutex);
-        return true;
-    }
+    return (xEventGroupGetBits(s_modes) & MODE_INIT_DONE) != 0;
+}
+
+bool line_state_wait_init_mode(TickType_t timeout)
+{
+    return mode_wait_done(MODE_INIT_DONE, timeout);
 }
 
 
 void line_state_set_reset_provisioning_mode(void)
 {
-    xSemaphoreTake(reset_provisioning_mutex, portMAX_DELAY);
+    xEventGroupClearBits(s_modes, MODE_RESET_PROVISIONING_DONE);
 }
 
 void line_state_release_reset_provisioning_mode(void)
 {
-    xSemaphoreGive(reset_provisioning_mutex);
+    xEventGroupSetBits(s_modes, MODE_RESET_PROVISIONING_DONE);
 }
 
 bool line_state_check_reset_provisioning_mode(void)
 {
-    if(xSemaphoreTake( reset_provisioning_mutex, pdMS_TO_TICKS(1)) != pdTRUE ){
-        return false;
-    }
-    else {
-        vTaskDelay(pdMS_TO_TICKS(1));
-        xSemaphoreGive(reset_provisioning_mutex);
-        return true;
-    }
+    return (xEventGroupGetBits(s_modes) & MODE_RESET_PROVISIONING_DONE) != 0;
+}
+
+bool line_state_wait_reset_provisioning_mode(TickType_t timeout)
+{
+    return mode_wait_done(MODE_RESET_PROVISIONING_DONE, timeout);
+}
+
+
+void line_state_set_calibration_mode(void)
+{
+    xEventGroupClearBits(s_modes, MODE_CALIBRATION_DONE);
+}
+
+void line_state_release_calibration_mode(void)
+{
+    xEventGroupSetBits(s_modes, MODE_CALIBRATION_DONE);
+}
+
+bool line_state_check_calibration_mode(void)
+{
+    return (xEventGroupGetBits(s_modes) & MODE_CALIBRATION_DONE) != 0;
+}
+
+bool line_state_wait_calibration_mode(TickType_t timeout)
+{
+    return mode_wait_done(MODE_CALIBRATION_DONE, timeout);
+}
+
+
+void line_state_set_network_mode(void)
+{
+    xEventGroupClearBits(s_modes, MODE_NETWORK_DONE);
+}
+
+void line_state_release_network_mode(void)
+{
+    xEventGroupSetBits(s_modes, MODE_NETWORK_DONE);
+}
+
+bool line_state_check_network_mode(void)
+{
+    return (xEventGroupGetBits(s_modes) & MODE_NETWORK_DONE) != 0;
+}
+
+bool line_state_wait_network_mode(TickType_t timeout)
+{
+    return mode_wait_done(MODE_NETWORK_DONE, timeout);
 }
 
 
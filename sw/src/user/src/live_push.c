@@ -0,0 +1,119 @@
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "esp_websocket_client.h"
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+#include "live_push.h"
+
+#define LIVE_PUSH_ENDED           BIT0
+#define LIVE_PUSH_OP_BINARY       0x02
+#define LIVE_PUSH_TIMEOUT_MS      10000
+#define LIVE_PUSH_PING_S          20     // the proxy sends nothing while the line stays the same
+#define LIVE_PUSH_CHUNK           2048   // receive buffer of the client, messages come in chunks of it
+
+static const char *TAG = "LIVE_PUSH";
+
+static esp_websocket_client_handle_t client;
+static EventGroupHandle_t events;
+static uint8_t *msg_buf;
+static size_t msg_size;
+static bool msg_overflow;
+static live_push_cb_t msg_cb;
+static void *msg_ctx;
+static uint32_t messages;
+
+
+static void on_event(void *arg, esp_event_base_t base, int32_t id, void *event_data)
+{
+    const esp_websocket_event_data_t *d = event_data;
+    switch (id) {
+    case WEBSOCKET_EVENT_CONNECTED:
+        ESP_LOGI(TAG, "subscribed");
+        break;
+    case WEBSOCKET_EVENT_DATA:
+        // pongs and close frames come here as well, views are binary
+        if (d->op_code != LIVE_PUSH_OP_BINARY || d->data_len <= 0) break;
+        if (d->payload_offset == 0) msg_overflow = (size_t)d->payload_len > msg_size;
+        if (msg_overflow) {
+            ESP_LOGE(TAG, "message of %d bytes does not fit into %u", d->payload_len, (unsigned)msg_size);
+            xEventGroupSetBits(events, LIVE_PUSH_ENDED);
+            break;
+        }
+        memcpy(msg_buf + d->payload_offset, d->data_ptr, d->data_len);
+        if (d->payload_offset + d->data_len < d->payload_len) break;
+        __atomic_fetch_add(&messages, 1, __ATOMIC_RELAXED);
+        if (!msg_cb(msg_buf, d->payload_len, msg_ctx)) xEventGroupSetBits(events, LIVE_PUSH_ENDED);
+        break;
+    case WEBSOCKET_EVENT_DISCONNECTED:
+    case WEBSOCKET_EVENT_CLOSED:
+    case WEBSOCKET_EVENT_ERROR:
+        ESP_LOGI(TAG, "subscription ends, event %d", (int)id);
+        xEventGroupSetBits(events, LIVE_PUSH_ENDED);
+        break;
+    default:
+        break;
+    }
+}
+
+bool live_push_start(const char *url, uint8_t *buf, size_t size, live_push_cb_t cb, void *ctx)
+{
+    if (client) live_push_stop();
+    if (events == NULL) events = xEventGroupCreate();
+    xEventGroupClearBits(events, LIVE_PUSH_ENDED);
+    msg_buf = buf;
+    msg_size = size;
+    msg_overflow = false;
+    msg_cb = cb;
+    msg_ctx = ctx;
+    __atomic_store_n(&messages, 0, __ATOMIC_RELAXED);
+
+    esp_websocket_client_config_t config = {
+        .uri = url,
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+        .crt_bundle_attach = esp_crt_bundle_attach,
+#endif
+        .buffer_size = LIVE_PUSH_CHUNK,
+        .network_timeout_ms = LIVE_PUSH_TIMEOUT_MS,
+        .ping_interval_sec = LIVE_PUSH_PING_S,
+        // the fetcher reconnects, with the state the ring has by then
+        .disable_auto_reconnect = true,
+    };
+    client = esp_websocket_client_init(&config);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "init failed");
+        return false;
+    }
+    esp_websocket_register_events(client, WEBSOCKET_EVENT_ANY, on_event, NULL);
+    esp_err_t err = esp_websocket_client_start(client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "start failed: %s", esp_err_to_name(err));
+        esp_websocket_client_destroy(client);
+        client = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool live_push_wait(TickType_t ticks)
+{
+    if (client == NULL) return false;
+    EventBits_t bits = xEventGroupWaitBits(events, LIVE_PUSH_ENDED, pdFALSE, pdFALSE, ticks);
+    return (bits & LIVE_PUSH_ENDED) == 0;
+}
+
+void live_push_stop(void)
+{
+    if (client == NULL) return;
+    // stop waits for the websocket task, no event comes after it
+    esp_websocket_client_stop(client);
+    esp_websocket_client_destroy(client);
+    client = NULL;
+}
+
+uint32_t live_push_messages(void)
+{
+    return __atomic_load_n(&messages, __ATOMIC_RELAXED);
+}
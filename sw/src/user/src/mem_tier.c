@@ -0,0 +1,50 @@
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "mem_tier.h"
+
+static const char *TAG = "MEM_TIER";
+
+static bool has_spiram;
+
+
+void mem_tier_init(void)
+{
+#if CONFIG_SPIRAM
+    // with SPIRAM_IGNORE_NOTFOUND the image also boots without the chip
+    has_spiram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#endif
+    ESP_LOGI(TAG, "internal RAM %u bytes free, SPIRAM %u bytes free",
+             (unsigned)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT),
+             (unsigned)mem_tier_spiram_free());
+}
+
+bool mem_tier_spiram(void)
+{
+    return has_spiram;
+}
+
+size_t mem_tier_spiram_free(void)
+{
+    return has_spiram ? heap_caps_get_free_size(MALLOC_CAP_SPIRAM) : 0;
+}
+
+void *mem_tier_alloc(size_t size, mem_tier_t tier, const char *what)
+{
+    void *p = NULL;
+    bool spiram = false;
+    if (tier == MEM_TIER_BULK && has_spiram) {
+        p = heap_caps_calloc(1, size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        spiram = p != NULL;
+        if (p == NULL) ESP_LOGW(TAG, "%s: no %u bytes of SPIRAM, taking internal RAM", what, (unsigned)size);
+    }
+    if (p == NULL) {
+        p = heap_caps_calloc(1, size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (p == NULL) {
+        ESP_LOGE(TAG, "%s: no %u bytes left", what, (unsigned)size);
+        abort();
+    }
+    ESP_LOGI(TAG, "%s: %u bytes in %s", what, (unsigned)size, spiram ? "SPIRAM" : "internal RAM");
+    return p;
+}
@@ -0,0 +1,282 @@
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "prof.h"
+
+static const char *TAG = "PROF";
+
+static const char *const hist_names[PROF_HIST_NUM] = {
+    [PROF_HIST_FRAME]  = "frame",
+    [PROF_HIST_FETCH]  = "fetch",
+    [PROF_HIST_DECODE] = "decode",
+};
+
+static const char *const boot_names[PROF_BOOT_NUM] = {
+    [PROF_BOOT_INIT]         = "init",
+    [PROF_BOOT_TOUCH_READY]  = "touch_ready",
+    [PROF_BOOT_WIFI_START]   = "wifi_start",
+    [PROF_BOOT_RESET_WINDOW] = "reset_window",
+    [PROF_BOOT_WIFI_UP]      = "wifi_up",
+    [PROF_BOOT_FIRST_FETCH]  = "first_fetch",
+    [PROF_BOOT_TIME_SYNCED]  = "time_synced",
+    [PROF_BOOT_RENDER]       = "render",
+    [PROF_BOOT_FIRST_TRAIN]  = "first_train",
+};
+
+static prof_hist_t hists[PROF_HIST_NUM];
+
+// written once per phase from different tasks, first writer wins
+static uint32_t boot_ms[PROF_BOOT_NUM];
+
+// ring of samples, written only by the sampling task
+static prof_sample_t ring[PROF_RING_LEN];
+static uint32_t ring_head = 0;    // next slot to write
+static uint32_t ring_count = 0;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY && CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define PROF_HAVE_RUNTIME 1
+// previous run time counters to turn totals into per period shares
+_Static_assert(PROF_MAX_SYSTEM_TASKS <= 64, "take_sample() marks the picked tasks in 64 bits");
+static TaskStatus_t status[PROF_MAX_SYSTEM_TASKS];
+static uint16_t status_permille[PROF_MAX_SYSTEM_TASKS];
+static struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} prev[PROF_MAX_SYSTEM_TASKS];
+static uint32_t n_prev = 0;
+static configRUN_TIME_COUNTER_TYPE prev_total = 0;
+#else
+#define PROF_HAVE_RUNTIME 0
+#endif
+
+static TaskHandle_t prof_task_handle = NULL;
+
+
+int64_t prof_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+void prof_init(void)
+{
+    memset(hists, 0, sizeof(hists));
+    memset(ring, 0, sizeof(ring));
+    ring_head = 0;
+    ring_count = 0;
+    for (int i = 0; i < PROF_BOOT_NUM; i++) {
+        boot_ms[i] = PROF_BOOT_NONE;
+    }
+#if !PROF_HAVE_RUNTIME
+    ESP_LOGW(TAG, "run time stats disabled in sdkconfig, only histograms are collected");
+#endif
+}
+
+void prof_hist_add(prof_hist_id_t id, uint32_t us)
+{
+    if (id >= PROF_HIST_NUM) return;
+    prof_hist_t *h = &hists[id];
+
+    // index of the highest set bit + 1, so bucket i holds [2^(i-1), 2^i)
+    uint32_t b = us ? 32 - __builtin_clz(us) : 0;
+    if (b >= PROF_HIST_BUCKETS) b = PROF_HIST_BUCKETS - 1;
+
+    h->bucket[b]++;
+    h->sum_us += us;
+    if (us > h->max_us) h->max_us = us;
+    h->count++;
+}
+
+static void boot_log(void)
+{
+    for (int i = 0; i < PROF_BOOT_NUM; i++) {
+        uint32_t ms = prof_boot_ms(i);
+        if (ms == PROF_BOOT_NONE) ESP_LOGI(TAG, "  boot %-14s        -", boot_names[i]);
+        else ESP_LOGI(TAG, "  boot %-14s %8" PRIu32 " ms", boot_names[i], ms);
+    }
+}
+
+void prof_boot_mark(prof_boot_phase_t phase)
+{
+    prof_boot_mark_at(phase, esp_timer_get_time());
+}
+
+void prof_boot_mark_at(prof_boot_phase_t phase, int64_t t_us)
+{
+    if (phase >= PROF_BOOT_NUM) return;
+    uint32_t none = PROF_BOOT_NONE;
+    uint32_t ms = (uint32_t)(t_us / 1000);
+    if (!__atomic_compare_exchange_n(&boot_ms[phase], &none, ms, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) return;
+
+    if (phase == PROF_BOOT_FIRST_TRAIN) {
+        if (ms > PROF_BOOT_TARGET_MS) ESP_LOGW(TAG, "first train lit after %" PRIu32 " ms, target %d ms", ms, PROF_BOOT_TARGET_MS);
+        else ESP_LOGI(TAG, "first train lit after %" PRIu32 " ms", ms);
+        boot_log();
+    }
+}
+
+uint32_t prof_boot_ms(prof_boot_phase_t phase)
+{
+    return phase < PROF_BOOT_NUM ? __atomic_load_n(&boot_ms[phase], __ATOMIC_RELAXED) : PROF_BOOT_NONE;
+}
+
+const char *prof_boot_name(prof_boot_phase_t phase)
+{
+    return phase < PROF_BOOT_NUM ? boot_names[phase] : "?";
+}
+
+const prof_hist_t *prof_hist_get(prof_hist_id_t id)
+{
+    return id < PROF_HIST_NUM ? &hists[id] : NULL;
+}
+
+const char *prof_hist_name(prof_hist_id_t id)
+{
+    return id < PROF_HIST_NUM ? hist_names[id] : "?";
+}
+
+uint32_t prof_hist_percentile(const prof_hist_t *h, uint8_t pct)
+{
+    uint32_t count = h->count;
+    if (count == 0) return 0;
+
+    uint64_t want = ((uint64_t)count * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < PROF_HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= want) {
+            // the open last bucket is reported by the largest value seen
+            return i == PROF_HIST_BUCKETS - 1 ? h->max_us : (1u << i);
+        }
+    }
+    return h->max_us;
+}
+
+bool prof_last_sample(prof_sample_t *out)
+{
+    if (ring_count == 0) return false;
+    *out = ring[(ring_head + PROF_RING_LEN - 1) % PROF_RING_LEN];
+    return true;
+}
+
+
+#if PROF_HAVE_RUNTIME
+static configRUN_TIME_COUNTER_TYPE prev_runtime(TaskHandle_t handle)
+{
+    for (uint32_t i = 0; i < n_prev; i++) {
+        if (prev[i].handle == handle) return prev[i].runtime;
+    }
+    // task created since the last sample
+    return 0;
+}
+#endif
+
+static void take_sample(void)
+{
+    prof_sample_t *s = &ring[ring_head];
+    memset(s, 0, sizeof(*s));
+    s->t_ms = esp_timer_get_time() / 1000;
+    s->free_heap = esp_get_free_heap_size();
+    s->min_free_heap = esp_get_minimum_free_heap_size();
+
+#if PROF_HAVE_RUNTIME
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, PROF_MAX_SYSTEM_TASKS, &total);
+    if (n == 0) {
+        ESP_LOGW(TAG, "more than %d tasks, sample skipped", PROF_MAX_SYSTEM_TASKS);
+        return;
+    }
+    // the run time total is the wall time of the timer, the time one core has;
+    // a task runs on one core at a time
+    configRUN_TIME_COUNTER_TYPE period = total - prev_total;
+    for (UBaseType_t i = 0; i < n; i++) {
+        configRUN_TIME_COUNTER_TYPE used = status[i].ulRunTimeCounter - prev_runtime(status[i].xHandle);
+        status_permille[i] = period ? (uint16_t)(((uint64_t)used * 1000) / period) : 0;
+    }
+
+    // the busiest PROF_MAX_TASKS, picked one by one, are kept
+    uint64_t picked = 0;
+    while (s->n_tasks < PROF_MAX_TASKS && s->n_tasks < n) {
+        UBaseType_t best = 0;
+        while (picked >> best & 1) best++;
+        for (UBaseType_t i = best + 1; i < n; i++) {
+            if (!(picked >> i & 1) && status_permille[i] > status_permille[best]) best = i;
+        }
+        picked |= 1ULL << best;
+
+        const TaskStatus_t *ts = &status[best];
+        prof_task_t *pt = &s->tasks[s->n_tasks++];
+        strncpy(pt->name, ts->pcTaskName, PROF_TASK_NAME_LEN - 1);
+        pt->prio = (uint8_t)ts->uxCurrentPriority;
+        pt->stack_free = (uint16_t)(ts->usStackHighWaterMark * sizeof(StackType_t));
+        pt->core = ts->xCoreID == tskNO_AFFINITY ? -1 : (int8_t)ts->xCoreID;
+        pt->cpu_permille = status_permille[best];
+    }
+
+    for (UBaseType_t i = 0; i < n; i++) {
+        prev[i].handle = status[i].xHandle;
+        prev[i].runtime = status[i].ulRunTimeCounter;
+    }
+    n_prev = n;
+    prev_total = total;
+#endif
+
+    ring_head = (ring_head + 1) % PROF_RING_LEN;
+    if (ring_count < PROF_RING_LEN) ring_count++;
+}
+
+
+void prof_dump(void)
+{
+    ESP_LOGI(TAG, "histograms (us)    count      p50      p90      p99      max     mean");
+    for (int i = 0; i < PROF_HIST_NUM; i++) {
+        const prof_hist_t *h = &hists[i];
+        uint32_t mean = h->count ? (uint32_t)(h->sum_us / h->count) : 0;
+        ESP_LOGI(TAG, "  %-14s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32,
+                 hist_names[i], h->count,
+                 prof_hist_percentile(h, 50), prof_hist_percentile(h, 90), prof_hist_percentile(h, 99),
+                 h->max_us, mean);
+    }
+
+    boot_log();
+
+    // oldest first
+    for (uint32_t k = 0; k < ring_count; k++) {
+        const prof_sample_t *s = &ring[(ring_head + PROF_RING_LEN - ring_count + k) % PROF_RING_LEN];
+        ESP_LOGI(TAG, "sample t=%" PRId64 " ms, free heap %" PRIu32 ", min free heap %" PRIu32,
+                 s->t_ms, s->free_heap, s->min_free_heap);
+        for (uint8_t i = 0; i < s->n_tasks; i++) {
+            const prof_task_t *t = &s->tasks[i];
+            ESP_LOGI(TAG, "  %-16s core %2d prio %2u cpu %3u.%u %% stack free %5u",
+                     t->name, t->core, t->prio,
+                     t->cpu_permille / 10, t->cpu_permille % 10, t->stack_free);
+        }
+    }
+}
+
+void prof_request_dump(void)
+{
+    if (prof_task_handle) xTaskNotifyGive(prof_task_handle);
+}
+
+static void prof_task(void *pvParameters)
+{
+    while (1) {
+        // a dump request wakes the task early, the sample interval restarts
+        if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PROF_SAMPLE_PERIOD_MS)) > 0) {
+            take_sample();
+            prof_dump();
+        } else {
+            take_sample();
+        }
+    }
+}
+
+void prof_start(void)
+{
+    // lowest application priority, sampling must not disturb what it measures
+    xTaskCreate(prof_task, "prof_task", 3072, NULL, 1, &prof_task_handle);
+}
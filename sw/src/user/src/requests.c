@@ -14,7 +14,6 @@
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_http_client.h"
-#include "json_parser.h"   // add this include
 
 
 #include "requests.h"
@@ -24,606 +23,322 @@
 #include "line_data.h"
 #include "led.h"
 #include "line_state.h"
+#include "prof.h"
+#include "metrics.h"
+#include "trace.h"
+#include "snapshot.h"
+#include "timetable.h"
+#include "trip_decode.h"
+#include "api_url.h"
+#include "api_backend.h"
+#include "mem_tier.h"
+#if CONFIG_BVG_PROXY_BINARY
+#include "trip_wire.h"
+#endif
+#if CONFIG_BVG_PROXY_PUSH
+#include "live_push.h"
+#endif
 
+// internal RAM only; with SPIRAM both move there and grow, see mem_tier.h
 #define HTTP_RESPONSE_BUFFER_SIZE (32768+16384)
-static char response_buffer[HTTP_RESPONSE_BUFFER_SIZE + 1];
+#define MAX_NR_TRIP_IDS 32
+#if CONFIG_SPIRAM
+#define SPIRAM_HTTP_RESPONSE_BUFFER_SIZE (CONFIG_FETCH_SPIRAM_RESPONSE_KB * 1024)
+#define SPIRAM_MAX_NR_TRIP_IDS           CONFIG_FETCH_SPIRAM_TRIP_IDS
+#else
+#define SPIRAM_HTTP_RESPONSE_BUFFER_SIZE HTTP_RESPONSE_BUFFER_SIZE
+#define SPIRAM_MAX_NR_TRIP_IDS           MAX_NR_TRIP_IDS
+#endif
+static char *response_buffer;
+static int response_size;
+static char (*trip_ids)[MAX_TRIP_ID_LEN];
+static int max_trip_ids;
 #define HTTP_URL_BUFFER_SIZE 399
 static char url_buffer[HTTP_URL_BUFFER_SIZE + 1];
-#define MAX_TRIP_ID_LEN 32
-#define MAX_NR_TRIP_IDS 32
-static char trip_ids[MAX_NR_TRIP_IDS][MAX_TRIP_ID_LEN];
-#define MAX_LINES 26
-static const char line_names_data [MAX_LINES][4] = {
-{"U1"},
-{"U2"},
-{"U3"},
-{"U4"},
-{"U5"},
-{"U6"},
-{"U7"},
-{"U8"},
-{"U9"},
-{"S1"},
-{"S2"},
-{"S25"},
-{"S26"},
-{"S3"},
-{"S5"},
-{"S7"},
-{"S75"},
-{"S8"},
-{"S85"},
-{"S9"},
-{"S41"},
-{"S42"},
-{"S45"},
-{"S46"},
-{"S47"},
-{"SXX"}
-};
-
-static const char line_operator_names [MAX_LINES][40] = {
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"Berliner%20Verkehrsbetriebe"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"},
-{"S-Bahn%20Berlin%20GmbH"}
-};
 
 static const char * TAG = "BVG_FETCHER";
-size_t trip_array[sizeof(Trip) + 45 * sizeof(Stopover)] = {0};
-
-static int collect_trip_ids_from_list(const char *json, char (*out_ids)[MAX_TRIP_ID_LEN], int max_out);
-static bool build_trip_url(const char * trip, char * buffer, int size);
-static bool decode_and_print_trip(const char *json, Trip *trip);
+static size_t trip_array[(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
 
 
-
-
-// Parse trips list JSON, print brief info, collect up to max_out trip IDs.
-// Returns number of collected IDs.
-static int collect_trip_ids_from_list(const char *json,
-                                      char (*out_ids)[MAX_TRIP_ID_LEN],
-                                      int max_out)
+// fetch_data_len() with its duration recorded
+static int fetch_timed_len(const char *url, char *buffer, int size)
 {
-    if (!json || !out_ids || max_out <= 0) return 0;
-
-    jparse_ctx_t jctx;
-    int ret = json_parse_start(&jctx, json, strlen(json));
-    if (ret != 0) {
-        ESP_LOGE(TAG, "JSON parse start failed: %d", ret);
-        return 0;
-    }
-
-    int trip_count = 0;
-    int num_trips = 0;
-
-    // trips[]
-    ret = json_obj_get_array(&jctx, "trips", &num_trips);
-    if (ret != 0 || num_trips <= 0) {
-        ESP_LOGE(TAG, "`trips` missing or empty (ret=%d, n=%d)", ret, num_trips);
-        json_parse_end(&jctx);
-        return 0;
-    }
-
-    for (int i = 0; i < num_trips; ++i) {
-        if (trip_count >= max_out) break;
-
-        // trips[i] -> object
-        if (json_arr_get_object(&jctx, i) != 0) {
-            ESP_LOGE(TAG, "trips[%d] not an object", i);
-            continue;
-        }
-
-        // read fields we care about from trip object
-        char trip_id[MAX_TRIP_ID_LEN] = {0};
-        char dep[40] = {0};
-        char arr[40] = {0};
-
-        // prefer realtime, fall back to planned
-        if (json_obj_get_string(&jctx, "departure", dep, sizeof(dep)) != 0) {
-            (void)json_obj_get_string(&jctx, "plannedDeparture", dep, sizeof(dep));
-        }
-        if (json_obj_get_string(&jctx, "arrival", arr, sizeof(arr)) != 0) {
-            (void)json_obj_get_string(&jctx, "plannedArrival", arr, sizeof(arr));
-        }
-        (void)json_obj_get_string(&jctx, "id", trip_id, sizeof(trip_id));
-
-        // origin/destination (for debug log only)
-        char o_name[64] = {0}, o_id[16] = {0};
-        char d_name[64] = {0}, d_id[16] = {0};
-
-        if (json_obj_get_object(&jctx, "origin") == 0) {
-            (void)json_obj_get_string(&jctx, "name", o_name, sizeof(o_name));
-            (void)json_obj_get_string(&jctx, "id",   o_id,   sizeof(o_id));
-            json_obj_leave_object(&jctx);
-        }
-        if (json_obj_get_object(&jctx, "destination") == 0) {
-            (void)json_obj_get_string(&jctx, "name", d_name, sizeof(d_name));
-            (void)json_obj_get_string(&jctx, "id",   d_id,   sizeof(d_id));
-            json_obj_leave_object(&jctx);
-        }
-
-        ESP_LOGD(TAG, "#%d  %s (id=%s) -> %s (id=%s)  dep=%s  arr=%s  tripId=%s",
-                 i,
-                 o_name[0] ? o_name : "(?)", o_id[0] ? o_id : "(?)",
-                 d_name[0] ? d_name : "(?)", d_id[0] ? d_id : "(?)",
-                 dep[0] ? dep : "-", arr[0] ? arr : "-", trip_id[0] ? trip_id : "-");
-
-        if (trip_id[0]) {
-            // copy out, ensure NUL
-            strncpy(out_ids[trip_count], trip_id, MAX_TRIP_ID_LEN - 1);
-            out_ids[trip_count][MAX_TRIP_ID_LEN - 1] = '\0';
-            trip_count++;
-        }
-
-        // leave trips[i] object
-        json_arr_leave_object(&jctx);
-    }
-
-    // leave trips[]
-    json_obj_leave_array(&jctx);
-
-    json_parse_end(&jctx);
-    return trip_count;
+    int64_t t0 = prof_now_us();
+    int len = fetch_data_len(url, buffer, size);
+    uint32_t us = (uint32_t)(prof_now_us() - t0);
+    prof_hist_add(PROF_HIST_FETCH, us);
+    api_backend_report(len >= 0, us);
+    metric_inc(len >= 0 ? METRIC_FETCH_OK : METRIC_FETCH_FAIL);
+    if (len >= 0) prof_boot_mark(PROF_BOOT_FIRST_FETCH);
+    return len;
 }
 
-static bool fill_stop_array(Trip * trip, 
-                            const char * station_id,
-                            const char * dep_ts,
-                            const char * arr_ts)
+static bool fetch_timed(const char *url, char *buffer, int size)
 {
+    return fetch_timed_len(url, buffer, size) >= 0;
+}
 
-    Stopover * pStop = &trip->stops[trip->num_stops];
 
-    // convert origin station id
-    if(station_id == NULL)
-    {
-        ESP_LOGE(TAG,"trip without origin station id");
-        return false;
-    }
 
-    int len = strnlen(station_id, 32);
-    if(len > 9)
-    {
-        ESP_LOGE(TAG,"origin station id wrong length: length = %d", len);
-        return false;
-    }
-    pStop->station_id = atoi(station_id);
 
-    if(dep_ts == NULL)
-    {
-        //ESP_LOGE(TAG,"trip without departure timestamp");
-        //return false;
-        pStop->dep_ts = 0;
-    }
-    else
-    {
-        uint64_t timee = parse_iso8601_to_unix(dep_ts); 
-        if(timee == 0)
-        {
-            ESP_LOGE(TAG,"wrong departure timestamp");
-            return false;       
-        }
-        pStop->dep_ts = timee;
-    }
+static void heap_info(void)
+{
     
-    if(arr_ts == NULL)
-    {
-        //ESP_LOGE(TAG,"trip without arrival timestamp");
-        //return false;
-        pStop->arr_ts = 0;
-    }
-    else
-    {
-        uint64_t timee = parse_iso8601_to_unix(arr_ts); 
-        if(timee == 0)
-        {
-            ESP_LOGE(TAG,"wrong departure timestamp");
-            return false;       
-        }
-        pStop->arr_ts = timee;
-    }
-
-    trip->num_stops++;
-    return true;
+    size_t free_heap = esp_get_free_heap_size();
+    size_t min_free_heap = esp_get_minimum_free_heap_size();
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT);
+    TRACE_FETCHER(HEAP, min_free_heap / 1024, free_heap, largest);
+    ESP_LOGD(TAG, "Free heap:          %u bytes", (unsigned int)free_heap);
+    ESP_LOGD(TAG, "Minimum free heap:  %u bytes", (unsigned int)min_free_heap);
+    ESP_LOGD(TAG, "Largest free block: %u bytes", (unsigned int)largest);
 
 }
 
 
-static bool fill_trip_array(Trip * trip, 
-                            const char * trip_id,
-                            const char * origin_station_id,
-                            const char * dest_station_id,
-                            const char * dep_ts,
-                            const char * arr_ts,
-                            const char * line_name)
+#if !CONFIG_BVG_DATA_SOURCE_PROXY
+// a map line can stand for several api lines ("S41S42"), they are fetched in turn
+static void fetching_line_name(const char * in_line, char * out_line)
 {
-    int x = 0;
-    trip->num_stops = 0;
-    //trip->stops = (Stopover *)(trip + sizeof(Trip));
-
-    // convert trip id
-    if(trip_id == NULL) 
-    {
-        ESP_LOGE(TAG,"trip without trip id");
-        return false;
-    }
-    for(x = 0; x < strnlen(trip_id, 32); x ++)
-    {
-        trip->trip_id[x] = trip_id[x];
-    }
-    for(x = x; x < 32; x ++)
-    {
-        trip->trip_id[x] = 0;
-    }
-
-    // convert origin station id
-    if(origin_station_id == NULL)
+    const char * tok[4];
+    int len[4];
+    int n = 0;
+    for(const char * p = in_line; *p && n < 4; n ++)
     {
-        ESP_LOGE(TAG,"trip without origin station id");
-        return false;
+        tok[n] = p ++;
+        while(isdigit((unsigned char)*p)) p ++;
+        len[n] = (int)(p - tok[n]);
     }
-
-    int len = strnlen(origin_station_id, 32);
-    if(len > 9)
+    if(n == 0)
     {
-        ESP_LOGE(TAG,"origin station id wrong length: length = %d", len);
-        return false;
+        out_line[0] = 0;
+        return;
     }
-    trip->origin_station_id = atoi(origin_station_id);
 
-    // convert dest station id
-    if(dest_station_id == NULL)
+    int next = 0;
+    for(int i = 0; i < n; i ++)
     {
-        ESP_LOGE(TAG,"trip without destination station id");
-        return false;
-    }
-    len = strnlen(dest_station_id, 32);
-    if(len > 9)
-    {
-        ESP_LOGE(TAG,"destination station id wrong length: length = %d", len);
-        return false;
-    }
-    trip->dest_station_id = atoi(dest_station_id);
-
-    if(dep_ts == NULL)
-    {
-        //ESP_LOGE(TAG,"trip without departure timestamp");
-        //return false;
-        trip->dep_ts = 0;
-    }
-    else
-    {
-        uint64_t timee = parse_iso8601_to_unix(dep_ts); 
-        if(timee == 0)
+        if((int)strlen(out_line) == len[i] && strncmp(out_line, tok[i], len[i]) == 0)
         {
-            ESP_LOGE(TAG,"wrong departure timestamp");
-            return false;       
-        }
-        trip->dep_ts = timee;
-    }
-    
-    if(arr_ts == NULL)
-    {
-        //ESP_LOGE(TAG,"trip without arrival timestamp");
-        //return false;
-        trip->arr_ts = 0;
-    }
-    else
-    {
-        uint64_t timee = parse_iso8601_to_unix(arr_ts); 
-        if(timee == 0)
-        {
-            ESP_LOGE(TAG,"wrong arrival timestamp");
-            return false;       
-        }
-        trip->arr_ts = timee;
-    }
-
-    if(line_name == NULL)
-    {
-        ESP_LOGE(TAG,"no line name found error");
-        return false;
-    }
-    bool found = false;
-    int index = 0;
-    // check all line names ! so the s41 s42 is ok
-    for(int x = 0; x < MAX_LINES; x ++)
-    {
-        if(strncmp(line_name, line_names_data[x], 4) == 0)
-        {
-            found = true;
-            index = x;
+            next = (i + 1) % n;
             break;
         }
     }
-    if(found == false)
-    {
-        ESP_LOGE(TAG,"no machting line found error");
-        return false;       
-    }
-    trip->line_code = index;
-
-
-    return true;
-
+    sprintf(out_line, "%.*s", len[next], tok[next]);
 }
+#endif
 
-#include <math.h>
 
-// Returns +1 if A→B is positive (east or north), -1 if negative (west or south)
-int get_direction(float lat1, float lon1, float lat2, float lon2) {
-    float dlat = lat2 - lat1;
-    float dlon = lon2 - lon1;
+static line_state_t last = { .line = -128, .pressed = false };
 
-    // Compare absolute differences
-    if (fabsf(dlon) > fabsf(dlat)) {
-        // East-West dominant
-        return (dlon > 0.0f) ? +1 : -1;  // east = +, west = -
-    } else {
-        // North-South dominant
-        return (dlat > 0.0f) ? +1 : -1;  // north = +, south = -
-    }
-}
+// with the timetable as fallback the api is polled less
+#define TIMETABLE_PASS_PERIOD_S 30   // at most one full pass per period
+#define TIMETABLE_BACKOFF_MAX_S 60   // retry delay while the api is down
 
 
-static bool decode_and_print_trip(const char *json, Trip *trip_data)
+// sleeps, but returns early when another line is selected
+static void wait_unless_line_changes(TickType_t ticks)
 {
-    if (!json || !trip_data) return false;
-
-    jparse_ctx_t jctx;
-    int ret = json_parse_start(&jctx, (char *)json, strlen(json));
-    if (ret != 0) {
-        ESP_LOGE(TAG, "JSON parse error near: %.64s", json);
-        return false;
-    }
-
-    bool entered_trip_obj = false;
-
-    // Some responses are { "trip": { ... } }, others are a plain { ... }
-    if (json_obj_get_object(&jctx, "trip") == 0) {
-        entered_trip_obj = true; // we're now inside trip{}
+    TickType_t start = xTaskGetTickCount();
+    line_state_t cur;
+    while (xTaskGetTickCount() - start < ticks) {
+        line_state_get(&cur);
+        if (cur.line != last.line) return;
+        vTaskDelay(pdMS_TO_TICKS(200));
     }
+}
 
-    // ------ top-level trip fields ------
-    char trip_id[MAX_TRIP_ID_LEN] = {0};
-    char dep_time[40] = {0};
-    char arr_time[40] = {0};
-    char line_name[16] = {0};  // S3, U5, etc.
+static void fill_scheduled(int line_nr)
+{
+    // the timetable needs the day, it waits for the api or sntp to set the clock
+    if(get_unix_seconds() < TIME_VALID_AFTER) return;
+    tr_take();
+    timetable_fill(line_nr, get_unix_seconds());
+    tr_release();
+    metric_set(METRIC_SCHEDULED, timetable_valid());
+}
 
-    // Prefer realtime, fall back to planned
-    if (json_obj_get_string(&jctx, "departure", dep_time, sizeof(dep_time)) != 0) {
-        (void)json_obj_get_string(&jctx, "plannedDeparture", dep_time, sizeof(dep_time));
-    }
-    if (json_obj_get_string(&jctx, "arrival", arr_time, sizeof(arr_time)) != 0) {
-        (void)json_obj_get_string(&jctx, "plannedArrival", arr_time, sizeof(arr_time));
-    }
-    (void)json_obj_get_string(&jctx, "id", trip_id, sizeof(trip_id));
+// 1, 2, 4 ... s after failed fetches in a row, at most TIMETABLE_BACKOFF_MAX_S
+static void fail_backoff(uint32_t *fail_streak)
+{
+    uint32_t backoff_s = *fail_streak < 6 ? 1u << *fail_streak : TIMETABLE_BACKOFF_MAX_S;
+    if(backoff_s > TIMETABLE_BACKOFF_MAX_S) backoff_s = TIMETABLE_BACKOFF_MAX_S;
+    (*fail_streak)++;
+    wait_unless_line_changes(pdMS_TO_TICKS(backoff_s * 1000));
+}
 
-    // line.name
-    if (json_obj_get_object(&jctx, "line") == 0) {
-        (void)json_obj_get_string(&jctx, "name", line_name, sizeof(line_name));
-        json_obj_leave_object(&jctx);
-    }
 
-    // origin / destination
-    char from_id[32] = {0}, to_id[32] = {0};
-    char from_name[64] = {0}, to_name[64] = {0};
-    float origin_lat = 0;
-    float origin_lon = 0;
-    float destination_lat = 0;
-    float destination_lon = 0;
-
-    if (json_obj_get_object(&jctx, "origin") == 0) {
-        (void)json_obj_get_string(&jctx, "id",   from_id, sizeof(from_id));
-        (void)json_obj_get_string(&jctx, "name", from_name, sizeof(from_name));
-
-        // add location here
-        if (json_obj_get_object(&jctx, "location") == 0) {
-            (void)json_obj_get_float(&jctx, "latitude",  &origin_lat);
-            (void)json_obj_get_float(&jctx, "longitude", &origin_lon);
-            json_obj_leave_object(&jctx);
-        }
+#if CONFIG_BVG_PROXY_BINARY
+// state of the ring in the proxy's numbering, 0 asks for a snapshot
+static int wire_line = -1;
+static uint32_t wire_epoch;
+static uint32_t wire_seq;
 
-        json_obj_leave_object(&jctx);
-    }
-    if (json_obj_get_object(&jctx, "destination") == 0) {
-        (void)json_obj_get_string(&jctx, "id",   to_id, sizeof(to_id));
-        (void)json_obj_get_string(&jctx, "name", to_name, sizeof(to_name));
-
-        // add location here 
-        if (json_obj_get_object(&jctx, "location") == 0) {
-            (void)json_obj_get_float(&jctx, "latitude",  &destination_lat);
-            (void)json_obj_get_float(&jctx, "longitude", &destination_lon);
-            json_obj_leave_object(&jctx);
-        }
-
-        json_obj_leave_object(&jctx);
-    }
-
-    ESP_LOGI(TAG,
-        "from %s, %s, lat %f, lon %f, at %s ,\n                       to   %s, %s, lat %f, lon %f, at %s\n                       direction = %d",
-        from_name[0] ? from_name : "(unknown)", from_id[0] ? from_id : "(?)",
-        origin_lat, origin_lon, 
-        dep_time[0] ? dep_time : "-",
-        to_name[0] ? to_name : "(unknown)", to_id[0] ? to_id : "(?)",
-        destination_lat, destination_lon, 
-        arr_time[0] ? arr_time : "-",
-        get_direction(origin_lat, origin_lon, destination_lat, destination_lon));
-
-    if (!fill_trip_array(trip_data,
-                         trip_id[0] ? trip_id : NULL,
-                         from_id[0] ? from_id : NULL,
-                         to_id[0]   ? to_id   : NULL,
-                         dep_time[0] ? dep_time : NULL,
-                         arr_time[0] ? arr_time : NULL,
-                         line_name[0] ? line_name : NULL)) {
-        if (entered_trip_obj) json_obj_leave_object(&jctx);
-        json_parse_end(&jctx);
+// a view into the ring, a delta only onto the state the ring has; false when
+// it was not applied, wire_seq is 0 then and the next view is a snapshot
+static bool apply_wire(const uint8_t * msg, int len)
+{
+    trip_wire_info_t info;
+    if(!trip_wire_header(msg, len, &info) ||
+       (info.kind == TRIP_WIRE_DELTA && (info.epoch != wire_epoch || info.base_seq != wire_seq))) {
+        // not what was asked for, or a pushed delta was missed
+        metric_inc(METRIC_DECODE_FAIL);
+        wire_seq = 0;
         return false;
     }
-
-    trip_data->direction = get_direction(origin_lat, origin_lon, destination_lat, destination_lon); 
-
-    // ------ stopovers[] ------
-    int n_stopovers = 0;
-    if (json_obj_get_array(&jctx, "stopovers", &n_stopovers) == 0 && n_stopovers > 0) {
-        for (int i = 0; i < n_stopovers; ++i) {
-            if (json_arr_get_object(&jctx, i) != 0) {
-                // skip malformed element
-                continue;
-            }
-
-            char dep[40] = {0}, arr[40] = {0};
-            char sid[32] = {0};
-            char sname[64] = {0};
-
-            // prefer realtime, fall back to planned
-            if (json_obj_get_string(&jctx, "departure", dep, sizeof(dep)) != 0) {
-                (void)json_obj_get_string(&jctx, "plannedDeparture", dep, sizeof(dep));
-            }
-            if (json_obj_get_string(&jctx, "arrival", arr, sizeof(arr)) != 0) {
-                (void)json_obj_get_string(&jctx, "plannedArrival", arr, sizeof(arr));
-            }
-
-            // stop{id,name}
-            if (json_obj_get_object(&jctx, "stop") == 0) {
-                (void)json_obj_get_string(&jctx, "id", sid, sizeof(sid));
-                (void)json_obj_get_string(&jctx, "name", sname, sizeof(sname));
-                json_obj_leave_object(&jctx);
-            }
-
-            static int idx = 0;
-            ESP_LOGD(TAG, "%02d) %s, %s  arr=%s  dep=%s",
-                     idx++,
-                     sname[0] ? sname : "(unknown)",
-                     sid[0]   ? sid   : "(?)",
-                     arr[0] ? arr : "-",
-                     dep[0] ? dep : "-");
-
-            if (!fill_stop_array(trip_data,
-                                 sid[0] ? sid : NULL,
-                                 dep[0] ? dep : NULL,
-                                 arr[0] ? arr : NULL)) {
-                json_arr_leave_object(&jctx);
-                json_obj_leave_array(&jctx);
-                if (entered_trip_obj) json_obj_leave_object(&jctx);
-                json_parse_end(&jctx);
-                return false;
-            }
-
-            json_arr_leave_object(&jctx); // leave stopovers[i]
-        }
-        json_obj_leave_array(&jctx); // leave stopovers[]
-    } else {
-        ESP_LOGW(TAG, "No stopovers[] in trip");
+    int64_t t0 = prof_now_us();
+    tr_take();
+    bool ok = trip_wire_apply(msg, len, &info);
+    if(ok) tr_free_old(get_unix_seconds());
+    tr_release();
+    prof_hist_add(PROF_HIST_DECODE, (uint32_t)(prof_now_us() - t0));
+    if(!ok) {
+        metric_inc(METRIC_DECODE_FAIL);
+        wire_seq = 0;
+        return false;
     }
-
-    if (entered_trip_obj) json_obj_leave_object(&jctx); // leave trip{}
-    json_parse_end(&jctx);
+    // a trip left out means the ring is not the proxy's state any more
+    wire_epoch = info.epoch;
+    wire_seq = info.skipped ? 0 : info.seq;
+    ESP_LOGD(TAG, "%s %u of %.*s, %d bytes: %u put, %u removed", info.kind == TRIP_WIRE_SNAPSHOT ? "snapshot" : "delta",
+             (unsigned)info.seq, (int)sizeof(leds[0].name), leds[wire_line].name, len, info.put, info.del);
     return true;
 }
 
-
-// https://v6.bvg.transport.rest/trips?lineName=S3&operatorNames=S-Bahn%20Berlin%20GmbH&onlyCurrentlyRunning=true&stopovers=false&remarks=false&subStops=false&entrances=false&suburban=true&subway=false&tram=false&bus=false&ferry=false&express=false&regional=false&pretty=false
-// https://v6.bvg.transport.rest/trips?lineName=S3&onlyCurrentlyRunning=true&stopovers=false&remarks=false&subStops=false&entrances=false&subway=true&suburban=true&tram=false&bus=false&ferry=false&express=false&regional=false&pretty=false
-static bool build_line_url(const char * line, char * buffer, const char * operator, int size)
+static void view_line_name(int line_nr, char * name, size_t size)
 {
-    // Fetch currently running trips for a given line (e.g., "U1")
-    int n = snprintf(
-        buffer, size,
-        "https://v6.bvg.transport.rest/trips?"
-        "lineName=%s&operatorNames=%s&onlyCurrentlyRunning=true&"
-        "stopovers=false&remarks=false&subStops=false&entrances=false&"
-        "subway=true&suburban=true&tram=false&bus=false&ferry=false&express=false&regional=false&"
-        "pretty=false",
-        line,operator
-    );
-    return (n >= 0 && n < size);
+    snprintf(name, size, "%.*s", (int)sizeof(leds[0].name), leds[line_nr].name);
 }
 
-
-static bool build_trip_url(const char * trip, char * buffer, int size)
+// a snapshot or the delta since the last view
+static bool fetch_view(int line_nr)
 {
-    // Fetch a specific trip by id (include stopovers if you want positions/times)
-    int n = snprintf(
-        buffer, size,
-        "https://v6.bvg.transport.rest/trips/%s?"
-        "stopovers=true&remarks=false&pretty=false",
-        trip
-    );
-    return (n >= 0 && n < size);
+    char name[sizeof(leds[0].name) + 1];
+    view_line_name(line_nr, name, sizeof(name));
+    if(line_nr != wire_line) {
+        wire_line = line_nr;
+        wire_seq = 0;
+    }
+    api_view_wire_url(name, max_trip_ids, wire_epoch, wire_seq, url_buffer, HTTP_URL_BUFFER_SIZE);
+    int len = fetch_timed_len(url_buffer, response_buffer, response_size);
+    if(len < 0) {
+        wire_seq = 0;
+        return false;
+    }
+    return apply_wire((const uint8_t *)response_buffer, len);
 }
+#endif
 
+#if CONFIG_BVG_PROXY_PUSH
+static uint32_t push_streak;
 
-static void heap_info(void)
+// in the websocket task, while BVG_run waits in follow_stream()
+static bool apply_pushed(const uint8_t * msg, size_t len, void * ctx)
 {
-    
-    size_t free_heap = esp_get_free_heap_size();
-    size_t min_free_heap = esp_get_minimum_free_heap_size();
-    ESP_LOGI(TAG, "Free heap:          %u bytes", (unsigned int)free_heap);
-    ESP_LOGI(TAG, "Minimum free heap:  %u bytes", (unsigned int)min_free_heap);
-    ESP_LOGI(TAG, "Largest free block: %u bytes", (unsigned int)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
-
+    metric_inc(METRIC_PUSH_MESSAGES);
+    // a gap or a trip left out ends the stream, the next view is a snapshot
+    return apply_wire(msg, (int)len) && wire_seq != 0;
 }
 
-
-static void fetching_line_name(const char * in_line, char * out_line)
+// the stream of the line from the state the last view left, until it ends
+// or the line changes; streams that end early back off like failed fetches
+static void follow_stream(int line_nr)
 {
-    if(strncmp(in_line, "SXX", 4) == 0) // matches
-    {
-        if(strncmp(out_line, "S41", 4) == 0)
-        {
-            sprintf(out_line, "S42");
-        }
-        else
-        {
-            sprintf(out_line, "S41");
+    TickType_t period = pdMS_TO_TICKS(CONFIG_BVG_PROXY_PERIOD_S * 1000);
+    if(wire_seq == 0) {
+        // the view was cut at max_trip_ids, there is no state to follow
+        wait_unless_line_changes(period);
+        return;
+    }
+    char name[sizeof(leds[0].name) + 1];
+    view_line_name(line_nr, name, sizeof(name));
+    api_stream_url(name, max_trip_ids, wire_epoch, wire_seq, url_buffer, HTTP_URL_BUFFER_SIZE);
+    TickType_t start = xTaskGetTickCount();
+    if(!live_push_start(url_buffer, (uint8_t *)response_buffer, response_size, apply_pushed, NULL)) {
+        fail_backoff(&push_streak);
+        return;
+    }
+    metric_set(METRIC_PUSH_SUBSCRIBED, 1);
+    TickType_t saved = start;
+    line_state_t cur;
+    while(live_push_wait(pdMS_TO_TICKS(200))) {
+        line_state_get(&cur);
+        if(cur.line != last.line) break;
+        if(xTaskGetTickCount() - saved >= period) {
+            snapshot_save(false);
+            saved = xTaskGetTickCount();
         }
     }
-    else
-    {
-        sprintf(out_line, "%s", in_line);
-    }
+    live_push_stop();
+    metric_set(METRIC_PUSH_SUBSCRIBED, 0);
+    ESP_LOGI(TAG, "stream of %s ends after %u messages", name, (unsigned)live_push_messages());
+    if(xTaskGetTickCount() - start < period) fail_backoff(&push_streak);
+    else push_streak = 0;
 }
+#endif
 
+#if CONFIG_BVG_DATA_SOURCE_PROXY && !CONFIG_BVG_PROXY_BINARY
+// the ring is replaced with the first trip of a view, so it is never empty in between
+static void put_view_trip(Trip * t, void * ctx)
+{
+    bool * cleared = ctx;
+    tr_take();
+    if(!*cleared) tr_clear_all();
+    *cleared = true;
+    tr_put(t);
+    tr_release();
+}
 
-static line_state_t last = { .line = -128, .pressed = false }; // force first change
+// one bvg_proxy view has all trips of the line, it stands for the list and the trips
+static bool fetch_view(int line_nr)
+{
+    char name[sizeof(leds[0].name) + 1];
+    snprintf(name, sizeof(name), "%.*s", (int)sizeof(leds[0].name), leds[line_nr].name);
+    api_view_url(name, max_trip_ids, url_buffer, HTTP_URL_BUFFER_SIZE);
+    if(fetch_timed(url_buffer, response_buffer, response_size) == false) return false;
+
+    bool cleared = false;
+    int64_t t0 = prof_now_us();
+    int n = trip_decode_view(response_buffer, (Trip *)trip_array, put_view_trip, &cleared);
+    prof_hist_add(PROF_HIST_DECODE, (uint32_t)(prof_now_us() - t0));
+    if(n < 0) {
+        metric_inc(METRIC_DECODE_FAIL);
+        return false;
+    }
+    ESP_LOGD(TAG, "%d trips in the view of %s", n, name);
+    tr_take();
+    if(!cleared) tr_clear_all();
+    tr_free_old(get_unix_seconds());
+    tr_release();
+    return true;
+}
+#endif
 
 
 void BVG_run(void)
 {
     static int line_nr = 0;
+#if !CONFIG_BVG_DATA_SOURCE_PROXY
     Trip * trip = (Trip *)trip_array; // use preallocated memory  
     char line_name[8] = {0};
+#endif
 
-    // wait for the init sequence to be completed
-    while(line_state_check_init_mode() == false)
-    {
-        vTaskDelay(pdMS_TO_TICKS(100)); 
-    }
+    // http bodies are written once and parsed once, they go to SPIRAM if there is some
+    response_size = mem_tier_size(HTTP_RESPONSE_BUFFER_SIZE, SPIRAM_HTTP_RESPONSE_BUFFER_SIZE);
+    response_buffer = mem_tier_alloc(response_size + 1, MEM_TIER_BULK, "http response");
+    max_trip_ids = mem_tier_size(MAX_NR_TRIP_IDS, SPIRAM_MAX_NR_TRIP_IDS);
+    trip_ids = mem_tier_alloc(max_trip_ids * sizeof(trip_ids[0]), MEM_TIER_BULK, "trip ids");
+
+    // start as soon as there is an ip, the first fetch overlaps with sntp
+    line_state_wait_network_mode(portMAX_DELAY);
+
+    // start on the current line without clearing, trips restored from a
+    // snapshot stay visible until the first full pass has replaced them
+    line_state_get(&last);
+    line_nr = last.line;
+    bool drop_restored = true;
+    // scheduled trips fill the map until a full live pass has completed
+    bool scheduled = true;
+    uint32_t fail_streak = 0;
 
     while(1)
     {
@@ -634,27 +349,68 @@ void BVG_run(void)
             tr_take();
             tr_clear_all();
             tr_release();           
+            scheduled = true;
         }
 
+#if !CONFIG_BVG_PROXY_PUSH
+        TickType_t pass_start = xTaskGetTickCount();
+#endif
+        if(scheduled) fill_scheduled(line_nr);
+
+#if CONFIG_BVG_DATA_SOURCE_PROXY
+        vTaskDelay(pdMS_TO_TICKS(100));
+        if(fetch_view(line_nr) == false) {
+            // the proxy is local, a failure means it is down or has not listed the line yet
+            scheduled = true;
+            fail_backoff(&fail_streak);
+            continue;
+        }
+        fail_streak = 0;
+        bool complete = true;
+        bool confirmed = true;
+#else
         
         // compute line name
-        fetching_line_name(line_names_data[line_nr], line_name);
+        fetching_line_name(leds[line_nr].name, line_name);
         
-        ESP_LOGI(TAG, "fetch trips on the line %s", line_name);
+        TRACE_FETCHER(FETCH_LINE, line_nr, 0, 0);
+        ESP_LOGD(TAG, "fetch trips on the line %s", line_name);
+
+        // a due probe only lists the line, its ids stay with the backend that listed them
+        if(api_backend_probe()) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+            api_line_url(line_name, line_data_operator(line_nr), url_buffer, HTTP_URL_BUFFER_SIZE);
+            fetch_timed(url_buffer, response_buffer, response_size);
+        }
+        // the list and all of its trips go to one backend
+        api_backend_pick();
 
         // wait a bit to reduce stress on api, has been more stable
         vTaskDelay(pdMS_TO_TICKS(100)); 
         // build url and fetch trip ids on line xy
-        build_line_url(line_name, url_buffer, line_operator_names[line_nr], HTTP_URL_BUFFER_SIZE);
-        if(fetch_data(url_buffer, response_buffer, HTTP_RESPONSE_BUFFER_SIZE) == false) continue;
+        api_line_url(line_name, line_data_operator(line_nr), url_buffer, HTTP_URL_BUFFER_SIZE);
+        if(fetch_timed(url_buffer, response_buffer, response_size) == false) {
+            scheduled = true;
+            if(timetable_valid()) {
+                // the map runs on the timetable, no need to hammer the api
+                fail_backoff(&fail_streak);
+            }
+            continue;
+        }
 
         // check if trips are on the line
-        int trip_id_nrs = collect_trip_ids_from_list(response_buffer, trip_ids, MAX_NR_TRIP_IDS);
+        int64_t t0 = prof_now_us();
+        int trip_id_nrs = trip_decode_list(response_buffer, trip_ids, max_trip_ids);
+        prof_hist_add(PROF_HIST_DECODE, (uint32_t)(prof_now_us() - t0));
         if(trip_id_nrs == 0)
         {
+            // no trips or a cut-off list, paced like a failed request
+            scheduled = true;
+            fail_backoff(&fail_streak);
             continue;
         }
         else {
+            fail_streak = 0;
             for(int x = 0; x < trip_id_nrs; x ++) {
                 ESP_LOGD(TAG, "got trip with id = %s", trip_ids[x]);
             }
@@ -662,6 +418,8 @@ void BVG_run(void)
 
 
         // now o through all trip ids
+        bool complete = true;       // the pass went through the whole list
+        int applied = 0;
         for(int y = 0; y < trip_id_nrs; y ++) {
             
             if (line_state_changed_since(&last)) {
@@ -669,23 +427,69 @@ void BVG_run(void)
                 tr_take();
                 tr_clear_all();
                 tr_release();  
+                complete = false;
+                scheduled = true;
                 break;         
             }
 
             vTaskDelay(pdMS_TO_TICKS(100));
             // build url and fetch trip from id
-            build_trip_url(trip_ids[y], url_buffer, HTTP_URL_BUFFER_SIZE);
-            if(fetch_data(url_buffer, response_buffer, HTTP_RESPONSE_BUFFER_SIZE) == false) continue;
+            api_trip_url(trip_ids[y], url_buffer, HTTP_URL_BUFFER_SIZE);
+            if(fetch_timed(url_buffer, response_buffer, response_size) == false) continue;
             // decode trip
-            if(decode_and_print_trip(response_buffer, trip) == false) continue;
+            t0 = prof_now_us();
+            bool decoded = trip_decode(response_buffer, trip);
+            prof_hist_add(PROF_HIST_DECODE, (uint32_t)(prof_now_us() - t0));
+            if(decoded == false) {
+                metric_inc(METRIC_DECODE_FAIL);
+                continue;
+            }
 
             // if decoding was successful safe trip in tripring
             tr_take();
             tr_put(trip);
+            timetable_replace(trip);
             int64_t now = get_unix_seconds();
             tr_free_old(now);
             tr_release();
+            applied++;
         }  
+        // a trip that failed keeps the scheduled and restored ones until a pass gets them all
+        bool confirmed = applied == trip_id_nrs;
+#endif
+
+        if(complete) {
+            if(confirmed) {
+                // restored and scheduled trips not confirmed by a full live pass
+                // have ended, were cancelled or run too far off the timetable
+                uint16_t drop = scheduled ? TRIP_FLAG_SCHEDULED : 0;
+                if(drop_restored) drop |= TRIP_FLAG_RESTORED;
+                if(drop) {
+                    tr_take();
+                    tr_free_flagged(drop);
+                    tr_release();
+                }
+                drop_restored = false;
+                scheduled = false;
+                metric_set(METRIC_SCHEDULED, 0);
+            }
+            snapshot_save(false);
+
+#if CONFIG_BVG_PROXY_PUSH
+            // the next view picks up where the stream ended, a snapshot after a gap
+            follow_stream(line_nr);
+#elif CONFIG_BVG_DATA_SOURCE_PROXY
+            TickType_t period = pdMS_TO_TICKS(CONFIG_BVG_PROXY_PERIOD_S * 1000);
+            TickType_t spent = xTaskGetTickCount() - pass_start;
+            if(spent < period) wait_unless_line_changes(period - spent);
+#else
+            if(timetable_valid()) {
+                TickType_t period = pdMS_TO_TICKS(TIMETABLE_PASS_PERIOD_S * 1000);
+                TickType_t spent = xTaskGetTickCount() - pass_start;
+                if(spent < period) wait_unless_line_changes(period - spent);
+            }
+#endif
+        }
     }
 }
 
@@ -0,0 +1,290 @@
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "tripring.h"
+#include "line_state.h"
+#include "line_data.h"
+#include "time_server.h"
+#include "snapshot.h"
+
+static const char *TAG = "SNAPSHOT";
+
+#define SNAPSHOT_MAGIC       0x31504E53   // "SNP1"
+#define SNAPSHOT_VERSION     1
+#define SNAPSHOT_NO_TIME     INT16_MIN    // stop without arrival and departure
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t n_trips;
+    uint32_t len;        // payload bytes after the header
+    uint32_t crc;        // crc32 of the payload
+    uint32_t seq;        // increases with every save, the newest flash slot wins
+    int64_t  base_ts;    // unix time of the save, stop times are relative to it
+    int8_t   line;
+    uint8_t  reserved[3];
+} snap_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t station_id;
+    int16_t  dt;         // stop time - base_ts in seconds
+} snap_stop_t;
+
+// per trip: u8 id_len, id, u8 line_code, i8 direction, u8 n_stops, n_stops * snap_stop_t
+#define SNAP_TRIP_FIXED 4
+
+_Static_assert(sizeof(snap_hdr_t) == 32, "snapshot header is part of the flash format");
+
+// survives every reset except power loss, validated by magic and crc
+static RTC_NOINIT_ATTR uint8_t rtc_blob[SNAPSHOT_MAX_SIZE];
+
+// one restored trip at a time
+static size_t trip_buf[(sizeof(Trip) + SNAPSHOT_STOPS_PER_TRIP * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+
+static uint32_t seq = 0;
+static uint32_t next_slot = 0;
+static int64_t  last_flash_ts = 0;
+
+
+static const esp_partition_t *snapshot_partition(void)
+{
+    static const esp_partition_t *part = NULL;
+    if (part == NULL) {
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SNAPSHOT_PARTITION_LABEL);
+    }
+    return part;
+}
+
+static int64_t stop_ts(const Stopover *s)
+{
+    // same choice as the renderer: arrival, departure if there is none
+    return s->arr_ts ? s->arr_ts : s->dep_ts;
+}
+
+static bool blob_valid(const uint8_t *blob)
+{
+    const snap_hdr_t *hdr = (const snap_hdr_t *)blob;
+    if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION) return false;
+    if (hdr->len > SNAPSHOT_MAX_SIZE - sizeof(snap_hdr_t)) return false;
+    return esp_rom_crc32_le(0, blob + sizeof(snap_hdr_t), hdr->len) == hdr->crc;
+}
+
+
+// called with tr_mutex held
+static uint32_t encode(uint8_t *blob, int64_t now, int8_t line)
+{
+    snap_hdr_t *hdr = (snap_hdr_t *)blob;
+    // invalid while the payload is rewritten, a reset in between falls back to flash
+    hdr->magic = 0;
+
+    uint32_t off = sizeof(snap_hdr_t);
+    uint16_t n_trips = 0;
+
+    for (uint32_t i = 0; i < tr_get_size(); i++) {
+        const Trip *t = tr_get_trip(i);
+        // scheduled trips are synthesised again from the timetable
+        if (t == NULL || t->num_stops == 0 || (t->flags & TRIP_FLAG_SCHEDULED)) continue;
+        if (t->arr_ts && t->arr_ts < now) continue;
+
+        // keep the last passed stop, the renderer needs it between stations
+        uint16_t first = 0;
+        for (uint16_t k = 0; k < t->num_stops; k++) {
+            int64_t st = stop_ts(&t->stops[k]);
+            if (st && st <= now) first = k;
+        }
+        uint16_t n = t->num_stops - first;
+        if (n > SNAPSHOT_STOPS_PER_TRIP) n = SNAPSHOT_STOPS_PER_TRIP;
+
+        uint8_t id_len = (uint8_t)strnlen(t->trip_id, sizeof(t->trip_id));
+        uint32_t need = 1 + id_len + SNAP_TRIP_FIXED - 1 + n * sizeof(snap_stop_t);
+        if (off + need > SNAPSHOT_MAX_SIZE) {
+            ESP_LOGD(TAG, "snapshot full, %" PRIu32 " trips left out", tr_get_size() - i);
+            break;
+        }
+
+        blob[off++] = id_len;
+        memcpy(&blob[off], t->trip_id, id_len);
+        off += id_len;
+        blob[off++] = (uint8_t)t->line_code;
+        blob[off++] = (uint8_t)(int8_t)t->direction;
+        blob[off++] = (uint8_t)n;
+
+        for (uint16_t k = first; k < first + n; k++) {
+            snap_stop_t s = { .station_id = t->stops[k].station_id, .dt = SNAPSHOT_NO_TIME };
+            int64_t st = stop_ts(&t->stops[k]);
+            if (st) {
+                int64_t dt = st - now;
+                if (dt < INT16_MIN + 1) dt = INT16_MIN + 1;
+                if (dt > INT16_MAX) dt = INT16_MAX;
+                s.dt = (int16_t)dt;
+            }
+            memcpy(&blob[off], &s, sizeof(s));
+            off += sizeof(s);
+        }
+        n_trips++;
+    }
+
+    uint32_t len = off - sizeof(snap_hdr_t);
+    hdr->version = SNAPSHOT_VERSION;
+    hdr->n_trips = n_trips;
+    hdr->len = len;
+    hdr->crc = esp_rom_crc32_le(0, blob + sizeof(snap_hdr_t), len);
+    hdr->seq = ++seq;
+    hdr->base_ts = now;
+    hdr->line = line;
+    memset(hdr->reserved, 0, sizeof(hdr->reserved));
+    hdr->magic = SNAPSHOT_MAGIC;
+    return off;
+}
+
+// called with tr_mutex held, blob must be valid
+static uint16_t decode(const uint8_t *blob)
+{
+    const snap_hdr_t *hdr = (const snap_hdr_t *)blob;
+    const uint8_t *p = blob + sizeof(snap_hdr_t);
+    const uint8_t *end = p + hdr->len;
+    Trip *trip = (Trip *)trip_buf;
+    uint16_t restored = 0;
+
+    for (uint16_t i = 0; i < hdr->n_trips; i++) {
+        if (p >= end) break;
+        uint8_t id_len = *p++;
+        if (id_len >= sizeof(trip->trip_id) || p + id_len + SNAP_TRIP_FIXED - 1 > end) break;
+
+        memset(trip, 0, sizeof(Trip));
+        memcpy(trip->trip_id, p, id_len);
+        p += id_len;
+        trip->line_code = *p++;
+        trip->direction = (int8_t)*p++;
+        uint8_t n = *p++;
+        if (n > SNAPSHOT_STOPS_PER_TRIP || p + n * sizeof(snap_stop_t) > end) break;
+
+        for (uint8_t k = 0; k < n; k++) {
+            snap_stop_t s;
+            memcpy(&s, p, sizeof(s));
+            p += sizeof(s);
+            int64_t ts = s.dt == SNAPSHOT_NO_TIME ? 0 : hdr->base_ts + s.dt;
+            trip->stops[k].station_id = s.station_id;
+            trip->stops[k].arr_ts = ts;
+            trip->stops[k].dep_ts = ts;
+        }
+        trip->num_stops = n;
+        if (n) {
+            trip->origin_station_id = trip->stops[0].station_id;
+            trip->dest_station_id = trip->stops[n - 1].station_id;
+            trip->dep_ts = trip->stops[0].dep_ts;
+            trip->arr_ts = trip->stops[n - 1].arr_ts;
+        }
+        trip->flags = TRIP_FLAG_RESTORED;
+        tr_put(trip);
+        restored++;
+    }
+    return restored;
+}
+
+
+// newest valid slot header in flash, also sets up seq and next_slot
+static int32_t flash_find_newest(void)
+{
+    const esp_partition_t *part = snapshot_partition();
+    if (part == NULL) {
+        ESP_LOGW(TAG, "no '%s' partition, flash copy disabled", SNAPSHOT_PARTITION_LABEL);
+        return -1;
+    }
+
+    int32_t best = -1;
+    uint32_t best_seq = 0;
+    uint32_t n_slots = part->size / SNAPSHOT_MAX_SIZE;
+    for (uint32_t slot = 0; slot < n_slots; slot++) {
+        snap_hdr_t hdr;
+        if (esp_partition_read(part, slot * SNAPSHOT_MAX_SIZE, &hdr, sizeof(hdr)) != ESP_OK) continue;
+        if (hdr.magic != SNAPSHOT_MAGIC || hdr.version != SNAPSHOT_VERSION) continue;
+        if (best < 0 || hdr.seq > best_seq) {
+            best = (int32_t)slot;
+            best_seq = hdr.seq;
+        }
+    }
+    if (best >= 0) {
+        if (best_seq > seq) seq = best_seq;
+        next_slot = ((uint32_t)best + 1) % n_slots;
+    }
+    return best;
+}
+
+static void flash_write(uint32_t len)
+{
+    const esp_partition_t *part = snapshot_partition();
+    if (part == NULL) return;
+
+    // one sector per save, rotating over the partition for wear levelling
+    uint32_t addr = next_slot * SNAPSHOT_MAX_SIZE;
+    esp_err_t err = esp_partition_erase_range(part, addr, SNAPSHOT_MAX_SIZE);
+    if (err == ESP_OK) err = esp_partition_write(part, addr, rtc_blob, len);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "flash write of slot %" PRIu32 " failed: %s", next_slot, esp_err_to_name(err));
+        return;
+    }
+    ESP_LOGD(TAG, "saved %" PRIu32 " bytes to flash slot %" PRIu32, len, next_slot);
+    next_slot = (next_slot + 1) % (part->size / SNAPSHOT_MAX_SIZE);
+}
+
+
+bool snapshot_restore(void)
+{
+    int32_t slot = flash_find_newest();
+    bool cold = false;
+
+    if (!blob_valid(rtc_blob)) {
+        // cold boot: rtc memory is random, load the flash copy into it
+        if (slot < 0 || esp_partition_read(snapshot_partition(), slot * SNAPSHOT_MAX_SIZE, rtc_blob, SNAPSHOT_MAX_SIZE) != ESP_OK
+            || !blob_valid(rtc_blob)) {
+            ESP_LOGI(TAG, "no snapshot to restore");
+            memset(rtc_blob, 0, sizeof(snap_hdr_t));
+            return false;
+        }
+        cold = true;
+    }
+
+    const snap_hdr_t *hdr = (const snap_hdr_t *)rtc_blob;
+    if (hdr->seq > seq) seq = hdr->seq;
+
+    // without a clock nothing would be drawn, show the map as it was saved
+    // until the api or sntp corrects the time; a flash copy may be days old
+    // after a power loss, its trips wait for a real clock instead
+    if (!cold) time_server_seed(hdr->base_ts, TIME_SOURCE_SNAPSHOT);
+
+    if (hdr->line >= 0 && hdr->line < line_data_number_of_lines()) {
+        line_state_t s = { .line = hdr->line, .pressed = false };
+        line_state_set(&s);
+    }
+
+    tr_take();
+    uint16_t n = decode(rtc_blob);
+    tr_free_old(get_unix_seconds());
+    tr_release();
+
+    ESP_LOGI(TAG, "restored %u of %u trips of line %d from %s (seq %" PRIu32 ")",
+             n, hdr->n_trips, hdr->line, cold ? "flash" : "rtc", hdr->seq);
+    return n > 0;
+}
+
+void snapshot_save(bool force_flash)
+{
+    int64_t now = get_unix_seconds();
+    if (now < TIME_VALID_AFTER) return;
+
+    line_state_t s;
+    line_state_get(&s);
+
+    tr_take();
+    uint32_t len = encode(rtc_blob, now, s.line);
+    tr_release();
+
+    if (force_flash || now - last_flash_ts >= SNAPSHOT_FLASH_PERIOD_S) {
+        flash_write(len);
+        last_flash_ts = now;
+    }
+}
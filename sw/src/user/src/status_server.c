@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_http_server.h"
+#include "status_server.h"
+#include "metrics.h"
+#include "prof.h"
+#include "trace.h"
+#include "tripring.h"
+#include "mem_tier.h"
+#include "frame_rec.h"
+#include "line_state.h"
+#include "line_data.h"
+#include "api_backend.h"
+#include "time_server.h"
+#include "provisioning.h"
+
+static const char *TAG = "STATUS";
+
+uint32_t metrics[METRIC_NUM] = {0};
+
+// /metrics is rendered into one buffer, only the httpd task touches it
+#define METRICS_BUFFER_SIZE 6144   // room for API_BACKENDS_MAX backends
+static char metrics_buffer[METRICS_BUFFER_SIZE];
+
+static httpd_handle_t server = NULL;
+
+typedef struct {
+    size_t len;
+    bool   truncated;
+} out_t;
+
+static void out(out_t *o, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void out(out_t *o, const char *fmt, ...)
+{
+    if (o->truncated) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(metrics_buffer + o->len, METRICS_BUFFER_SIZE - o->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= METRICS_BUFFER_SIZE - o->len) {
+        o->truncated = true;
+        return;
+    }
+    o->len += n;
+}
+
+static void out_metric(out_t *o, const char *name, const char *type, const char *help, uint32_t value)
+{
+    out(o, "# HELP %s %s\n# TYPE %s %s\n%s %" PRIu32 "\n", name, help, name, type, name, value);
+}
+
+static void out_summary(out_t *o, const char *name, const char *help, prof_hist_id_t id)
+{
+    const prof_hist_t *h = prof_hist_get(id);
+    out(o, "# HELP %s %s\n# TYPE %s summary\n", name, help, name);
+    // percentiles are bucket upper bounds of the log2 histogram
+    static const uint8_t q[] = {50, 90, 99};
+    for (int i = 0; i < sizeof(q); i++) {
+        out(o, "%s{quantile=\"0.%02u\"} %" PRIu32 "\n", name, q[i], prof_hist_percentile(h, q[i]));
+    }
+    out(o, "%s_sum %" PRIu64 "\n%s_count %" PRIu32 "\n", name, h->sum_us, name, h->count);
+}
+
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    out_t o = {0};
+
+    out(&o, "# HELP bvg_fetch_total Upstream requests by result.\n# TYPE bvg_fetch_total counter\n");
+    out(&o, "bvg_fetch_total{result=\"ok\"} %" PRIu32 "\n", metric_get(METRIC_FETCH_OK));
+    out(&o, "bvg_fetch_total{result=\"fail\"} %" PRIu32 "\n", metric_get(METRIC_FETCH_FAIL));
+    out_metric(&o, "bvg_decode_fail_total", "counter", "Responses that could not be decoded.", metric_get(METRIC_DECODE_FAIL));
+    out_summary(&o, "bvg_fetch_latency_us", "Duration of one upstream request.", PROF_HIST_FETCH);
+    out(&o, "# HELP bvg_backend_latency_us Moving average of a backend's requests, failures counted as %u us.\n"
+            "# TYPE bvg_backend_latency_us gauge\n", API_BACKEND_FAIL_US);
+    api_backend_stats_t b;
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        out(&o, "bvg_backend_latency_us{backend=\"%s\"} %" PRIu32 "\n", b.base, b.latency_us);
+    }
+    out(&o, "# HELP bvg_backend_requests_total Requests by backend and result.\n# TYPE bvg_backend_requests_total counter\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        out(&o, "bvg_backend_requests_total{backend=\"%s\",result=\"ok\"} %" PRIu32 "\n", b.base, b.requests - b.failures);
+        out(&o, "bvg_backend_requests_total{backend=\"%s\",result=\"fail\"} %" PRIu32 "\n", b.base, b.failures);
+    }
+    out(&o, "# HELP bvg_backend_up 1 while a backend takes requests.\n# TYPE bvg_backend_up gauge\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        out(&o, "bvg_backend_up{backend=\"%s\"} %d\n", b.base, b.up);
+    }
+    out(&o, "# HELP bvg_backend_current 1 for the backend requests go to.\n# TYPE bvg_backend_current gauge\n");
+    for (uint32_t i = 0; api_backend_get(i, &b); i++) {
+        out(&o, "bvg_backend_current{backend=\"%s\"} %d\n", b.base, b.current);
+    }
+    out_summary(&o, "bvg_decode_latency_us", "Duration of one json decode.", PROF_HIST_DECODE);
+
+    out_metric(&o, "tripring_trips", "gauge", "Trips held in the ring.", metric_get(METRIC_TR_SIZE));
+    out_metric(&o, "tripring_capacity_trips", "gauge", "Trips the ring can hold, more with SPIRAM.", tr_get_capacity());
+    out_metric(&o, "tripring_put_total", "counter", "Trips stored.", metric_get(METRIC_TRIPS_PUT));
+    out_metric(&o, "tripring_expired_total", "counter", "Trips dropped after their arrival.", metric_get(METRIC_TRIPS_EXPIRED));
+    out_metric(&o, "timetable_trips_total", "counter", "Scheduled trips synthesised from the static timetable.", metric_get(METRIC_TT_TRIPS));
+    out_metric(&o, "timetable_scheduled_mode", "gauge", "1 while trips come from the timetable instead of the api.", metric_get(METRIC_SCHEDULED));
+    out_metric(&o, "bvg_push_messages_total", "counter", "Views pushed on the bvg_proxy stream.", metric_get(METRIC_PUSH_MESSAGES));
+    out_metric(&o, "bvg_push_subscribed", "gauge", "1 while the stream of bvg_proxy is open.", metric_get(METRIC_PUSH_SUBSCRIBED));
+
+    uint32_t tr_free = metric_get(METRIC_TR_HEAP_FREE);
+    uint32_t tr_largest = metric_get(METRIC_TR_HEAP_LARGEST);
+    out_metric(&o, "tripring_heap_free_bytes", "gauge", "Free bytes in the tripring private heap.", tr_free);
+    out_metric(&o, "tripring_heap_largest_free_block_bytes", "gauge", "Largest free block in the tripring private heap.", tr_largest);
+    out_metric(&o, "tripring_heap_min_free_bytes", "gauge", "Low-water mark of the tripring private heap.", metric_get(METRIC_TR_HEAP_MIN_FREE));
+    // 0 = one contiguous free block, towards 1 = free space only in small pieces
+    uint32_t frag = tr_free ? 1000 - (uint32_t)(((uint64_t)tr_largest * 1000) / tr_free) : 0;
+    out(&o, "# HELP tripring_heap_fragmentation 1 - largest free block / free bytes.\n"
+            "# TYPE tripring_heap_fragmentation gauge\ntripring_heap_fragmentation %" PRIu32 ".%03" PRIu32 "\n",
+        frag / 1000, frag % 1000);
+
+    out_summary(&o, "led_frame_time_us", "Time to compute and flush one led frame.", PROF_HIST_FRAME);
+
+    out_metric(&o, "heap_free_bytes", "gauge", "Free bytes in the system heap.", esp_get_free_heap_size());
+    out_metric(&o, "heap_min_free_bytes", "gauge", "Low-water mark of the system heap.", esp_get_minimum_free_heap_size());
+    if (mem_tier_spiram()) {
+        out_metric(&o, "heap_spiram_free_bytes", "gauge", "Free bytes of SPIRAM in the system heap.", mem_tier_spiram_free());
+    }
+    out_metric(&o, "uptime_seconds", "counter", "Seconds since boot.", (uint32_t)(esp_timer_get_time() / 1000000));
+
+    out(&o, "# HELP time_offset_ms Reference minus local clock at the last correction.\n# TYPE time_offset_ms gauge\n"
+            "time_offset_ms %" PRId32 "\n", time_server_offset_ms());
+    out(&o, "# HELP time_slew_remaining_ms Part of the last correction still being slewed.\n# TYPE time_slew_remaining_ms gauge\n"
+            "time_slew_remaining_ms %" PRId32 "\n", time_server_slew_remaining_ms());
+    out(&o, "# HELP time_source Source of the last clock correction.\n# TYPE time_source gauge\n"
+            "time_source{source=\"%s\"} 1\n", time_server_source_name(time_server_source()));
+    out_metric(&o, "time_corrections_total", "counter", "Clock corrections from http or sntp.", time_server_corrections());
+    int64_t last_sync = time_server_last_sync();
+    if (last_sync) {
+        out_metric(&o, "time_since_sync_seconds", "gauge", "Seconds since the last clock correction.", (uint32_t)(get_unix_seconds() - last_sync));
+    }
+
+    out_metric(&o, "wifi_connect_ms", "gauge", "Duration of the last connect until an ip was assigned.", provisioning_connect_ms());
+    out_metric(&o, "wifi_fast_connect", "gauge", "1 if the last connect used the cached access point.", provisioning_fast_connect());
+
+    // phases not reached yet are left out
+    out(&o, "# HELP boot_phase_ms Milliseconds after start at which a boot phase was reached.\n# TYPE boot_phase_ms gauge\n");
+    for (int i = 0; i < PROF_BOOT_NUM; i++) {
+        uint32_t ms = prof_boot_ms(i);
+        if (ms != PROF_BOOT_NONE) out(&o, "boot_phase_ms{phase=\"%s\"} %" PRIu32 "\n", prof_boot_name(i), ms);
+    }
+    uint32_t first_train = prof_boot_ms(PROF_BOOT_FIRST_TRAIN);
+    if (first_train != PROF_BOOT_NONE) {
+        out_metric(&o, "boot_time_to_first_train_ms", "gauge", "Milliseconds from start to the first lit train.", first_train);
+    }
+
+    if (o.truncated) {
+        ESP_LOGW(TAG, "/metrics truncated at %u bytes", (unsigned)o.len);
+    }
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    return httpd_resp_send(req, metrics_buffer, o.len);
+}
+
+static esp_err_t state_get_handler(httpd_req_t *req)
+{
+    char buf[128];
+    line_state_t s;
+    line_state_get(&s);
+
+    const char *name = (s.line >= 0 && s.line < line_data_number_of_lines()) ? leds[s.line].name : "";
+    snprintf(buf, sizeof(buf), "{\"line\":%d,\"line_name\":\"%s\",\"pressed\":%s,\"trips\":%" PRIu32 ",\"mode\":\"%s\"}",
+             s.line, name, s.pressed ? "true" : "false", metric_get(METRIC_TR_SIZE),
+             metric_get(METRIC_SCHEDULED) ? "scheduled" : "realtime");
+
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, buf);
+}
+
+static esp_err_t prof_get_handler(httpd_req_t *req)
+{
+    prof_request_dump();
+    return httpd_resp_sendstr(req, "profile dump requested, see console\n");
+}
+
+static bool trace_emit(const void *data, uint32_t len, void *ctx)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len) == ESP_OK;
+}
+
+// raw trace ring, decode with tools/trace_decode.py
+static esp_err_t trace_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "application/octet-stream");
+    if (!trace_read(trace_emit, req)) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+#if CONFIG_FRAME_RECORDER
+// frame log of the renderer, draw with tools/render_frames.py; ?restart empties it
+static esp_err_t frames_get_handler(httpd_req_t *req)
+{
+    char query[16];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK && strcmp(query, "restart") == 0) {
+        frame_rec_log_restart();
+        return httpd_resp_sendstr(req, "frame log restarted\n");
+    }
+    httpd_resp_set_type(req, "application/octet-stream");
+    if (!frame_rec_log_read(trace_emit, req)) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static const httpd_uri_t frames_uri = {
+    .uri      = "/frames",
+    .method   = HTTP_GET,
+    .handler  = frames_get_handler,
+    .user_ctx = NULL
+};
+#endif
+
+static const httpd_uri_t metrics_get = {
+    .uri      = "/metrics",
+    .method   = HTTP_GET,
+    .handler  = metrics_get_handler,
+    .user_ctx = NULL
+};
+
+static const httpd_uri_t state_get = {
+    .uri      = "/state",
+    .method   = HTTP_GET,
+    .handler  = state_get_handler,
+    .user_ctx = NULL
+};
+
+static const httpd_uri_t prof_get = {
+    .uri      = "/prof",
+    .method   = HTTP_GET,
+    .handler  = prof_get_handler,
+    .user_ctx = NULL
+};
+
+static const httpd_uri_t trace_uri = {
+    .uri      = "/trace",
+    .method   = HTTP_GET,
+    .handler  = trace_get_handler,
+    .user_ctx = NULL
+};
+
+void status_server_start(void)
+{
+    if (server) return;
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = STATUS_SERVER_PORT;
+    config.ctrl_port = STATUS_SERVER_CTRL_PORT;
+    config.lru_purge_enable = true;
+    // lowest priority, a scrape waits for the render and fetch tasks
+    config.task_priority = 1;
+
+    esp_err_t err = httpd_start(&server, &config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "httpd_start on port %d failed: %s", STATUS_SERVER_PORT, esp_err_to_name(err));
+        server = NULL;
+        return;
+    }
+    httpd_register_uri_handler(server, &metrics_get);
+    httpd_register_uri_handler(server, &state_get);
+    httpd_register_uri_handler(server, &prof_get);
+    httpd_register_uri_handler(server, &trace_uri);
+#if CONFIG_FRAME_RECORDER
+    httpd_register_uri_handler(server, &frames_uri);
+#endif
+    ESP_LOGI(TAG, "status server on port %d", STATUS_SERVER_PORT);
+}
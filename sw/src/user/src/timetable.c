@@ -0,0 +1,273 @@
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "tripring.h"
+#include "metrics.h"
+#include "line_data.h"
+#include "timetable.h"
+
+static const char *TAG = "TIMETABLE";
+
+#define TIMETABLE_MAX_STOPS 45   // same as the fetcher's trip buffer
+
+static const tt_hdr_t     *tt = NULL;
+static const tt_line_t    *tt_lines;
+static const uint64_t     *tt_services;
+static const tt_pattern_t *tt_patterns;
+static const tt_stop_t    *tt_stops;
+static const tt_trip_t    *tt_trips;
+static esp_partition_mmap_handle_t tt_map;
+
+// one synthesised trip at a time, tr_put copies it
+static size_t trip_buf[(sizeof(Trip) + TIMETABLE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+
+
+// days since 1970-01-01 of a civil date and back, proleptic gregorian
+static int32_t days_from_civil(int32_t y, uint32_t m, uint32_t d)
+{
+    y -= m <= 2;
+    int32_t era = (y >= 0 ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - era * 400);
+    uint32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+static void civil_from_days(int32_t z, struct tm *tm)
+{
+    z += 719468;
+    int32_t era = (z >= 0 ? z : z - 146096) / 146097;
+    uint32_t doe = (uint32_t)(z - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t m = mp + (mp < 10 ? 3 : -9);
+    tm->tm_year = (int)yoe + era * 400 + (m <= 2) - 1900;
+    tm->tm_mon = (int)m - 1;
+    tm->tm_mday = (int)(doy - (153 * mp + 2) / 5 + 1);
+}
+
+static int32_t local_day(int64_t now)
+{
+    time_t t = (time_t)now;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+// gtfs times count from noon - 12h, which is midnight except on dst change days
+static int64_t service_day_start(int32_t day)
+{
+    struct tm tm = {0};
+    civil_from_days(day, &tm);
+    tm.tm_hour = 12;
+    tm.tm_isdst = -1;
+    return (int64_t)mktime(&tm) - 12 * 3600;
+}
+
+static bool table_ok(uint32_t off, uint32_t n, uint32_t elem, uint32_t size)
+{
+    return (off & 3) == 0 && (uint64_t)off + (uint64_t)n * elem <= size;
+}
+
+
+bool timetable_init(void)
+{
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, TIMETABLE_PARTITION_LABEL);
+    if (part == NULL) {
+        ESP_LOGW(TAG, "no '%s' partition, scheduled mode disabled", TIMETABLE_PARTITION_LABEL);
+        return false;
+    }
+
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &ptr, &tt_map);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "mmap of '%s' failed: %s", TIMETABLE_PARTITION_LABEL, esp_err_to_name(err));
+        return false;
+    }
+
+    const tt_hdr_t *hdr = (const tt_hdr_t *)ptr;
+    const char *why = NULL;
+    if (hdr->magic != TIMETABLE_MAGIC) {
+        why = "no image";
+    } else if (hdr->version != TIMETABLE_VERSION) {
+        why = "unsupported version";
+    } else if (hdr->size < sizeof(tt_hdr_t) || hdr->size > part->size || hdr->n_days > TIMETABLE_MAX_DAYS) {
+        why = "bad header";
+    } else if (!table_ok(hdr->off_lines, hdr->n_lines, sizeof(tt_line_t), hdr->size)
+            || !table_ok(hdr->off_services, hdr->n_services, sizeof(uint64_t), hdr->size)
+            || !table_ok(hdr->off_patterns, hdr->n_patterns, sizeof(tt_pattern_t), hdr->size)
+            || !table_ok(hdr->off_pattern_stops, hdr->n_pattern_stops, sizeof(tt_stop_t), hdr->size)
+            || !table_ok(hdr->off_trips, hdr->n_trips, sizeof(tt_trip_t), hdr->size)) {
+        why = "table out of range";
+    } else if (esp_rom_crc32_le(0, (const uint8_t *)ptr + sizeof(tt_hdr_t), hdr->size - sizeof(tt_hdr_t)) != hdr->crc) {
+        why = "checksum mismatch";
+    }
+    if (why) {
+        ESP_LOGW(TAG, "'%s' partition not usable: %s", TIMETABLE_PARTITION_LABEL, why);
+        esp_partition_munmap(tt_map);
+        return false;
+    }
+
+    const uint8_t *base = (const uint8_t *)ptr;
+    tt_lines    = (const tt_line_t *)(base + hdr->off_lines);
+    tt_services = (const uint64_t *)(base + hdr->off_services);
+    tt_patterns = (const tt_pattern_t *)(base + hdr->off_patterns);
+    tt_stops    = (const tt_stop_t *)(base + hdr->off_pattern_stops);
+    tt_trips    = (const tt_trip_t *)(base + hdr->off_trips);
+
+    // patterns carry map line numbers, they only hold for the topology the image was built for
+    if (hdr->n_lines != line_data_number_of_lines()) {
+        ESP_LOGW(TAG, "image has %u lines, the topology %u, scheduled mode disabled",
+                 hdr->n_lines, (unsigned)line_data_number_of_lines());
+        esp_partition_munmap(tt_map);
+        return false;
+    }
+    for (uint16_t i = 0; i < hdr->n_lines; i++) {
+        if ((uint64_t)tt_lines[i].trip_first + tt_lines[i].trip_count > hdr->n_trips) {
+            ESP_LOGW(TAG, "line %u points past the trip table", i);
+            esp_partition_munmap(tt_map);
+            return false;
+        }
+        if (strncmp(tt_lines[i].name, leds[i].name, sizeof(leds[i].name)) != 0) {
+            ESP_LOGW(TAG, "line %u is %.8s in the image, %.*s in the topology, scheduled mode disabled",
+                     i, tt_lines[i].name, (int)sizeof(leds[i].name), leds[i].name);
+            esp_partition_munmap(tt_map);
+            return false;
+        }
+    }
+
+    tt = hdr;
+    ESP_LOGI(TAG, "%" PRIu32 " trips, %" PRIu32 " patterns, %u days from day %" PRId32 ", %" PRIu32 " bytes",
+             hdr->n_trips, hdr->n_patterns, hdr->n_days, hdr->first_day, hdr->size);
+    return true;
+}
+
+bool timetable_valid(void)
+{
+    return tt != NULL;
+}
+
+
+static bool same_run(const Trip *a, const Trip *b)
+{
+    if (a->line_code != b->line_code || a->direction != b->direction) return false;
+    if (a->dest_station_id != b->dest_station_id) return false;
+    int64_t d = a->dep_ts - b->dep_ts;
+    return d >= -TIMETABLE_MATCH_S && d <= TIMETABLE_MATCH_S;
+}
+
+// already in the ring, as the same scheduled trip or as live data
+static bool in_ring(const Trip *sched)
+{
+    for (uint32_t i = 0; i < tr_get_size(); i++) {
+        const Trip *t = tr_get_trip(i);
+        if (t == NULL) continue;
+        if (t->flags & TRIP_FLAG_SCHEDULED) {
+            if (strncmp(t->trip_id, sched->trip_id, sizeof(t->trip_id)) == 0) return true;
+        } else if (same_run(t, sched)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool build_trip(Trip *trip, uint32_t idx, int32_t day, int64_t base, int64_t now)
+{
+    const tt_trip_t *tp = &tt_trips[idx];
+    const tt_pattern_t *p = &tt_patterns[tp->pattern];
+    if ((uint64_t)p->stop_first + p->n_stops > tt->n_pattern_stops || p->n_stops == 0) return false;
+
+    int64_t start = base + tp->start_s;
+    memset(trip, 0, sizeof(Trip));
+    snprintf(trip->trip_id, sizeof(trip->trip_id), "tt|%" PRIu32 "|%" PRId32, idx, day);
+    trip->origin_station_id = p->origin_station_id;
+    trip->dest_station_id = p->dest_station_id;
+    trip->direction = p->direction;
+    trip->line_code = p->line_code;
+    trip->dep_ts = start;
+    trip->arr_ts = start + p->span_s;
+    trip->flags = TRIP_FLAG_SCHEDULED;
+
+    // the renderer only needs the last passed stop and the ones ahead
+    const tt_stop_t *s = &tt_stops[p->stop_first];
+    uint16_t first = 0;
+    for (uint16_t k = 0; k < p->n_stops; k++) {
+        if (start + s[k].arr_s <= now) first = k;
+    }
+    uint16_t n = p->n_stops - first;
+    if (n > TIMETABLE_MAX_STOPS) n = TIMETABLE_MAX_STOPS;
+    for (uint16_t k = 0; k < n; k++) {
+        trip->stops[k].station_id = s[first + k].station_id;
+        trip->stops[k].arr_ts = start + s[first + k].arr_s;
+        trip->stops[k].dep_ts = start + s[first + k].dep_s;
+    }
+    trip->num_stops = n;
+    return true;
+}
+
+uint32_t timetable_fill(int line_nr, int64_t now)
+{
+    if (tt == NULL || line_nr < 0 || line_nr >= tt->n_lines) return 0;
+
+    const tt_line_t *line = &tt_lines[line_nr];
+    const tt_trip_t *trips = &tt_trips[line->trip_first];
+    Trip *trip = (Trip *)trip_buf;
+    int32_t today = local_day(now);
+    uint32_t put = 0;
+
+    // trips after midnight belong to yesterday's service day
+    for (int32_t day = today - 1; day <= today; day++) {
+        int32_t bit = day - tt->first_day;
+        if (bit < 0 || bit >= tt->n_days) continue;
+        int64_t base = service_day_start(day);
+        int64_t t = now - base;
+
+        // first trip that starts after the lead window, trips are sorted by start
+        uint32_t lo = 0, hi = line->trip_count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if ((int64_t)trips[mid].start_s <= t + TIMETABLE_LEAD_S) lo = mid + 1;
+            else hi = mid;
+        }
+
+        // walk back until no trip of the line can still be running
+        for (uint32_t k = lo; k-- > 0;) {
+            const tt_trip_t *tp = &trips[k];
+            if ((int64_t)tp->start_s + line->max_span_s < t) break;
+            if (tp->pattern >= tt->n_patterns || tp->service >= tt->n_services) continue;
+            if (((tt_services[tp->service] >> bit) & 1) == 0) continue;
+            if ((int64_t)tp->start_s + tt_patterns[tp->pattern].span_s < t) continue;
+
+            if (!build_trip(trip, line->trip_first + k, day, base, now)) continue;
+            if (in_ring(trip)) continue;
+            tr_put(trip);
+            metric_inc(METRIC_TT_TRIPS);
+            put++;
+        }
+    }
+    ESP_LOGD(TAG, "line %d: %" PRIu32 " scheduled trips", line_nr, put);
+    return put;
+}
+
+void timetable_replace(const Trip *live)
+{
+    if (tt == NULL || live == NULL) return;
+
+    int32_t best = -1;
+    int64_t best_d = INT64_MAX;
+    for (uint32_t i = 0; i < tr_get_size(); i++) {
+        const Trip *t = tr_get_trip(i);
+        if (t == NULL || (t->flags & TRIP_FLAG_SCHEDULED) == 0 || !same_run(t, live)) continue;
+        int64_t d = t->dep_ts > live->dep_ts ? t->dep_ts - live->dep_ts : live->dep_ts - t->dep_ts;
+        if (d < best_d) {
+            best_d = d;
+            best = (int32_t)i;
+        }
+    }
+    if (best >= 0) tr_free_idx((uint32_t)best, true);
+}
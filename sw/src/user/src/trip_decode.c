@@ -0,0 +1,542 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esp_log.h"
+#include "json_parser.h"
+#include "tripring.h"
+#include "time_server.h"
+#include "line_data.h"
+#include "trace.h"
+#include "trip_decode.h"
+
+static const char * TAG = "TRIP_DECODE";
+
+int trip_decode_list(const char *json,
+                     char (*out_ids)[MAX_TRIP_ID_LEN],
+                     int max_out)
+{
+    if (!json || !out_ids || max_out <= 0) return 0;
+
+    jparse_ctx_t jctx;
+    int ret = json_parse_start(&jctx, json, strlen(json));
+    if (ret != 0) {
+        ESP_LOGE(TAG, "JSON parse start failed: %d", ret);
+        return 0;
+    }
+
+    int trip_count = 0;
+    int num_trips = 0;
+
+    // trips[]
+    ret = json_obj_get_array(&jctx, "trips", &num_trips);
+    if (ret != 0 || num_trips <= 0) {
+        ESP_LOGE(TAG, "`trips` missing or empty (ret=%d, n=%d)", ret, num_trips);
+        json_parse_end(&jctx);
+        return 0;
+    }
+
+    for (int i = 0; i < num_trips; ++i) {
+        if (trip_count >= max_out) break;
+
+        // trips[i] -> object
+        if (json_arr_get_object(&jctx, i) != 0) {
+            ESP_LOGE(TAG, "trips[%d] not an object", i);
+            continue;
+        }
+
+        // read fields we care about from trip object
+        char trip_id[MAX_TRIP_ID_LEN] = {0};
+        char dep[40] = {0};
+        char arr[40] = {0};
+
+        // prefer realtime, fall back to planned
+        if (json_obj_get_string(&jctx, "departure", dep, sizeof(dep)) != 0) {
+            (void)json_obj_get_string(&jctx, "plannedDeparture", dep, sizeof(dep));
+        }
+        if (json_obj_get_string(&jctx, "arrival", arr, sizeof(arr)) != 0) {
+            (void)json_obj_get_string(&jctx, "plannedArrival", arr, sizeof(arr));
+        }
+        (void)json_obj_get_string(&jctx, "id", trip_id, sizeof(trip_id));
+
+        // origin/destination (for debug log only)
+        char o_name[64] = {0}, o_id[16] = {0};
+        char d_name[64] = {0}, d_id[16] = {0};
+
+        if (json_obj_get_object(&jctx, "origin") == 0) {
+            (void)json_obj_get_string(&jctx, "name", o_name, sizeof(o_name));
+            (void)json_obj_get_string(&jctx, "id",   o_id,   sizeof(o_id));
+            json_obj_leave_object(&jctx);
+        }
+        if (json_obj_get_object(&jctx, "destination") == 0) {
+            (void)json_obj_get_string(&jctx, "name", d_name, sizeof(d_name));
+            (void)json_obj_get_string(&jctx, "id",   d_id,   sizeof(d_id));
+            json_obj_leave_object(&jctx);
+        }
+
+        ESP_LOGD(TAG, "#%d  %s (id=%s) -> %s (id=%s)  dep=%s  arr=%s  tripId=%s",
+                 i,
+                 o_name[0] ? o_name : "(?)", o_id[0] ? o_id : "(?)",
+                 d_name[0] ? d_name : "(?)", d_id[0] ? d_id : "(?)",
+                 dep[0] ? dep : "-", arr[0] ? arr : "-", trip_id[0] ? trip_id : "-");
+
+        if (trip_id[0]) {
+            // copy out, cut to MAX_TRIP_ID_LEN - 1 with NUL
+            snprintf(out_ids[trip_count], MAX_TRIP_ID_LEN, "%s", trip_id);
+            trip_count++;
+        }
+
+        // leave trips[i] object
+        json_arr_leave_object(&jctx);
+    }
+
+    // leave trips[]
+    json_obj_leave_array(&jctx);
+
+    json_parse_end(&jctx);
+    return trip_count;
+}
+
+static bool fill_stop_array(Trip * trip, 
+                            const char * station_id,
+                            const char * dep_ts,
+                            const char * arr_ts)
+{
+
+    Stopover * pStop = &trip->stops[trip->num_stops];
+
+    // convert origin station id
+    if(station_id == NULL)
+    {
+        ESP_LOGE(TAG,"trip without origin station id");
+        return false;
+    }
+
+    int len = strnlen(station_id, 32);
+    if(len > 9)
+    {
+        ESP_LOGE(TAG,"origin station id wrong length: length = %d", len);
+        return false;
+    }
+    pStop->station_id = atoi(station_id);
+
+    if(dep_ts == NULL)
+    {
+        //ESP_LOGE(TAG,"trip without departure timestamp");
+        //return false;
+        pStop->dep_ts = 0;
+    }
+    else
+    {
+        uint64_t timee = parse_iso8601_to_unix(dep_ts); 
+        if(timee == 0)
+        {
+            ESP_LOGE(TAG,"wrong departure timestamp");
+            return false;       
+        }
+        pStop->dep_ts = timee;
+    }
+    
+    if(arr_ts == NULL)
+    {
+        //ESP_LOGE(TAG,"trip without arrival timestamp");
+        //return false;
+        pStop->arr_ts = 0;
+    }
+    else
+    {
+        uint64_t timee = parse_iso8601_to_unix(arr_ts); 
+        if(timee == 0)
+        {
+            ESP_LOGE(TAG,"wrong departure timestamp");
+            return false;       
+        }
+        pStop->arr_ts = timee;
+    }
+
+    trip->num_stops++;
+    return true;
+
+}
+
+
+static bool fill_trip_array(Trip * trip, 
+                            const char * trip_id,
+                            const char * origin_station_id,
+                            const char * dest_station_id,
+                            const char * dep_ts,
+                            const char * arr_ts,
+                            const char * line_name)
+{
+    int x = 0;
+    trip->num_stops = 0;
+    trip->flags = 0;
+    //trip->stops = (Stopover *)(trip + sizeof(Trip));
+
+    // convert trip id
+    if(trip_id == NULL) 
+    {
+        ESP_LOGE(TAG,"trip without trip id");
+        return false;
+    }
+    for(x = 0; x < strnlen(trip_id, 32); x ++)
+    {
+        trip->trip_id[x] = trip_id[x];
+    }
+    for(x = x; x < 32; x ++)
+    {
+        trip->trip_id[x] = 0;
+    }
+
+    // convert origin station id
+    if(origin_station_id == NULL)
+    {
+        ESP_LOGE(TAG,"trip without origin station id");
+        return false;
+    }
+
+    int len = strnlen(origin_station_id, 32);
+    if(len > 9)
+    {
+        ESP_LOGE(TAG,"origin station id wrong length: length = %d", len);
+        return false;
+    }
+    trip->origin_station_id = atoi(origin_station_id);
+
+    // convert dest station id
+    if(dest_station_id == NULL)
+    {
+        ESP_LOGE(TAG,"trip without destination station id");
+        return false;
+    }
+    len = strnlen(dest_station_id, 32);
+    if(len > 9)
+    {
+        ESP_LOGE(TAG,"destination station id wrong length: length = %d", len);
+        return false;
+    }
+    trip->dest_station_id = atoi(dest_station_id);
+
+    if(dep_ts == NULL)
+    {
+        //ESP_LOGE(TAG,"trip without departure timestamp");
+        //return false;
+        trip->dep_ts = 0;
+    }
+    else
+    {
+        uint64_t timee = parse_iso8601_to_unix(dep_ts); 
+        if(timee == 0)
+        {
+            ESP_LOGE(TAG,"wrong departure timestamp");
+            return false;       
+        }
+        trip->dep_ts = timee;
+    }
+    
+    if(arr_ts == NULL)
+    {
+        //ESP_LOGE(TAG,"trip without arrival timestamp");
+        //return false;
+        trip->arr_ts = 0;
+    }
+    else
+    {
+        uint64_t timee = parse_iso8601_to_unix(arr_ts); 
+        if(timee == 0)
+        {
+            ESP_LOGE(TAG,"wrong arrival timestamp");
+            return false;       
+        }
+        trip->arr_ts = timee;
+    }
+
+    if(line_name == NULL)
+    {
+        ESP_LOGE(TAG,"no line name found error");
+        return false;
+    }
+    int index = line_data_find_line(line_name);
+    if(index < 0)
+    {
+        ESP_LOGE(TAG,"no machting line found error");
+        return false;       
+    }
+    trip->line_code = index;
+
+
+    return true;
+
+}
+
+// Returns +1 if A→B is positive (east or north), -1 if negative (west or south)
+int get_direction(float lat1, float lon1, float lat2, float lon2) {
+    float dlat = lat2 - lat1;
+    float dlon = lon2 - lon1;
+
+    // Compare absolute differences
+    if (fabsf(dlon) > fabsf(dlat)) {
+        // East-West dominant
+        return (dlon > 0.0f) ? +1 : -1;  // east = +, west = -
+    } else {
+        // North-South dominant
+        return (dlat > 0.0f) ? +1 : -1;  // north = +, south = -
+    }
+}
+
+
+bool trip_decode(const char *json, Trip *trip_data)
+{
+    if (!json || !trip_data) return false;
+
+    jparse_ctx_t jctx;
+    int ret = json_parse_start(&jctx, (char *)json, strlen(json));
+    if (ret != 0) {
+        ESP_LOGE(TAG, "JSON parse error near: %.64s", json);
+        return false;
+    }
+
+    bool entered_trip_obj = false;
+
+    // Some responses are { "trip": { ... } }, others are a plain { ... }
+    if (json_obj_get_object(&jctx, "trip") == 0) {
+        entered_trip_obj = true; // we're now inside trip{}
+    }
+
+    // ------ top-level trip fields ------
+    char trip_id[MAX_TRIP_ID_LEN] = {0};
+    char dep_time[40] = {0};
+    char arr_time[40] = {0};
+    char line_name[16] = {0};  // S3, U5, etc.
+
+    // Prefer realtime, fall back to planned
+    if (json_obj_get_string(&jctx, "departure", dep_time, sizeof(dep_time)) != 0) {
+        (void)json_obj_get_string(&jctx, "plannedDeparture", dep_time, sizeof(dep_time));
+    }
+    if (json_obj_get_string(&jctx, "arrival", arr_time, sizeof(arr_time)) != 0) {
+        (void)json_obj_get_string(&jctx, "plannedArrival", arr_time, sizeof(arr_time));
+    }
+    (void)json_obj_get_string(&jctx, "id", trip_id, sizeof(trip_id));
+
+    // line.name
+    if (json_obj_get_object(&jctx, "line") == 0) {
+        (void)json_obj_get_string(&jctx, "name", line_name, sizeof(line_name));
+        json_obj_leave_object(&jctx);
+    }
+
+    // origin / destination
+    char from_id[32] = {0}, to_id[32] = {0};
+    char from_name[64] = {0}, to_name[64] = {0};
+    float origin_lat = 0;
+    float origin_lon = 0;
+    float destination_lat = 0;
+    float destination_lon = 0;
+
+    if (json_obj_get_object(&jctx, "origin") == 0) {
+        (void)json_obj_get_string(&jctx, "id",   from_id, sizeof(from_id));
+        (void)json_obj_get_string(&jctx, "name", from_name, sizeof(from_name));
+
+        // add location here
+        if (json_obj_get_object(&jctx, "location") == 0) {
+            (void)json_obj_get_float(&jctx, "latitude",  &origin_lat);
+            (void)json_obj_get_float(&jctx, "longitude", &origin_lon);
+            json_obj_leave_object(&jctx);
+        }
+
+        json_obj_leave_object(&jctx);
+    }
+    if (json_obj_get_object(&jctx, "destination") == 0) {
+        (void)json_obj_get_string(&jctx, "id",   to_id, sizeof(to_id));
+        (void)json_obj_get_string(&jctx, "name", to_name, sizeof(to_name));
+
+        // add location here 
+        if (json_obj_get_object(&jctx, "location") == 0) {
+            (void)json_obj_get_float(&jctx, "latitude",  &destination_lat);
+            (void)json_obj_get_float(&jctx, "longitude", &destination_lon);
+            json_obj_leave_object(&jctx);
+        }
+
+        json_obj_leave_object(&jctx);
+    }
+
+    ESP_LOGD(TAG,
+        "from %s, %s, lat %f, lon %f, at %s ,\n                       to   %s, %s, lat %f, lon %f, at %s\n                       direction = %d",
+        from_name[0] ? from_name : "(unknown)", from_id[0] ? from_id : "(?)",
+        origin_lat, origin_lon, 
+        dep_time[0] ? dep_time : "-",
+        to_name[0] ? to_name : "(unknown)", to_id[0] ? to_id : "(?)",
+        destination_lat, destination_lon, 
+        arr_time[0] ? arr_time : "-",
+        get_direction(origin_lat, origin_lon, destination_lat, destination_lon));
+
+    if (!fill_trip_array(trip_data,
+                         trip_id[0] ? trip_id : NULL,
+                         from_id[0] ? from_id : NULL,
+                         to_id[0]   ? to_id   : NULL,
+                         dep_time[0] ? dep_time : NULL,
+                         arr_time[0] ? arr_time : NULL,
+                         line_name[0] ? line_name : NULL)) {
+        if (entered_trip_obj) json_obj_leave_object(&jctx);
+        json_parse_end(&jctx);
+        return false;
+    }
+
+    trip_data->direction = get_direction(origin_lat, origin_lon, destination_lat, destination_lon); 
+    TRACE_FETCHER(TRIP_DECODED, trip_data->line_code, trip_data->origin_station_id, trip_data->dest_station_id);
+
+    // ------ stopovers[] ------
+    int n_stopovers = 0;
+    if (json_obj_get_array(&jctx, "stopovers", &n_stopovers) == 0 && n_stopovers > 0) {
+        for (int i = 0; i < n_stopovers; ++i) {
+            if (json_arr_get_object(&jctx, i) != 0) {
+                // skip malformed element
+                continue;
+            }
+
+            char dep[40] = {0}, arr[40] = {0};
+            char sid[32] = {0};
+            char sname[64] = {0};
+
+            // prefer realtime, fall back to planned
+            if (json_obj_get_string(&jctx, "departure", dep, sizeof(dep)) != 0) {
+                (void)json_obj_get_string(&jctx, "plannedDeparture", dep, sizeof(dep));
+            }
+            if (json_obj_get_string(&jctx, "arrival", arr, sizeof(arr)) != 0) {
+                (void)json_obj_get_string(&jctx, "plannedArrival", arr, sizeof(arr));
+            }
+
+            // stop{id,name}
+            if (json_obj_get_object(&jctx, "stop") == 0) {
+                (void)json_obj_get_string(&jctx, "id", sid, sizeof(sid));
+                (void)json_obj_get_string(&jctx, "name", sname, sizeof(sname));
+                json_obj_leave_object(&jctx);
+            }
+
+            static int idx = 0;
+            ESP_LOGD(TAG, "%02d) %s, %s  arr=%s  dep=%s",
+                     idx++,
+                     sname[0] ? sname : "(unknown)",
+                     sid[0]   ? sid   : "(?)",
+                     arr[0] ? arr : "-",
+                     dep[0] ? dep : "-");
+
+            if (trip_data->num_stops >= TRIP_DECODE_MAX_STOPS) {
+                // long regional runs, the map only has room for the first ones
+                ESP_LOGW(TAG, "trip %s has more than %d stops", trip_data->trip_id, TRIP_DECODE_MAX_STOPS);
+                json_arr_leave_object(&jctx);
+                break;
+            }
+
+            if (!fill_stop_array(trip_data,
+                                 sid[0] ? sid : NULL,
+                                 dep[0] ? dep : NULL,
+                                 arr[0] ? arr : NULL)) {
+                json_arr_leave_object(&jctx);
+                json_obj_leave_array(&jctx);
+                if (entered_trip_obj) json_obj_leave_object(&jctx);
+                json_parse_end(&jctx);
+                return false;
+            }
+
+            json_arr_leave_object(&jctx); // leave stopovers[i]
+        }
+        json_obj_leave_array(&jctx); // leave stopovers[]
+    } else {
+        ESP_LOGW(TAG, "No stopovers[] in trip");
+    }
+
+    TRACE_FETCHER(TRIP_STOPS, trip_data->direction, trip_data->num_stops, trip_data->dep_ts);
+
+    if (entered_trip_obj) json_obj_leave_object(&jctx); // leave trip{}
+    json_parse_end(&jctx);
+    return true;
+}
+
+
+// one trips[i] of a view, the parser is inside the object
+static bool decode_view_trip(jparse_ctx_t *jctx, Trip *trip)
+{
+    char line_name[16] = {0};
+    int dir = 0;
+    int64_t from = 0, to = 0;
+
+    memset(trip->trip_id, 0, sizeof(trip->trip_id));
+    if (json_obj_get_string(jctx, "id", trip->trip_id, sizeof(trip->trip_id)) != 0 || trip->trip_id[0] == 0) return false;
+    if (json_obj_get_string(jctx, "line", line_name, sizeof(line_name)) != 0) return false;
+    int index = line_data_find_line(line_name);
+    if (index < 0) {
+        ESP_LOGW(TAG, "view trip %s on unknown line %s", trip->trip_id, line_name);
+        return false;
+    }
+    if (json_obj_get_int(jctx, "dir", &dir) != 0 ||
+        json_obj_get_int64(jctx, "from", &from) != 0 ||
+        json_obj_get_int64(jctx, "to", &to) != 0 ||
+        json_obj_get_int64(jctx, "dep", &trip->dep_ts) != 0 ||
+        json_obj_get_int64(jctx, "arr", &trip->arr_ts) != 0) {
+        return false;
+    }
+    trip->line_code = index;
+    trip->direction = dir;
+    trip->origin_station_id = (uint32_t)from;
+    trip->dest_station_id = (uint32_t)to;
+    trip->flags = 0;
+    trip->num_stops = 0;
+
+    // stops[] of [station, arrival, departure]
+    int n_stops = 0;
+    if (json_obj_get_array(jctx, "stops", &n_stops) != 0) return false;
+    bool ok = true;
+    for (int i = 0; i < n_stops && trip->num_stops < TRIP_DECODE_MAX_STOPS; i++) {
+        int n = 0;
+        if (json_arr_get_array(jctx, i, &n) != 0) {
+            ok = false;
+            break;
+        }
+        Stopover *s = &trip->stops[trip->num_stops];
+        int64_t sid = 0;
+        if (n < 3 || json_arr_get_int64(jctx, 0, &sid) != 0 ||
+            json_arr_get_int64(jctx, 1, &s->arr_ts) != 0 ||
+            json_arr_get_int64(jctx, 2, &s->dep_ts) != 0) {
+            ok = false;
+        }
+        s->station_id = (uint32_t)sid;
+        json_arr_leave_array(jctx);
+        if (!ok) break;
+        trip->num_stops++;
+    }
+    json_obj_leave_array(jctx);
+    return ok;
+}
+
+int trip_decode_view(const char *json, Trip *trip, trip_decode_cb_t cb, void *ctx)
+{
+    if (!json || !trip || !cb) return -1;
+
+    jparse_ctx_t jctx;
+    if (json_parse_start(&jctx, json, strlen(json)) != 0) {
+        ESP_LOGE(TAG, "view parse error near: %.64s", json);
+        return -1;
+    }
+    int n_trips = 0;
+    if (json_obj_get_array(&jctx, "trips", &n_trips) != 0) {
+        ESP_LOGE(TAG, "view without trips[]");
+        json_parse_end(&jctx);
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < n_trips; i++) {
+        if (json_arr_get_object(&jctx, i) != 0) continue;
+        bool ok = decode_view_trip(&jctx, trip);
+        json_arr_leave_object(&jctx);
+        if (!ok) {
+            ESP_LOGW(TAG, "view trips[%d] skipped", i);
+            continue;
+        }
+        TRACE_FETCHER(TRIP_DECODED, trip->line_code, trip->origin_station_id, trip->dest_station_id);
+        cb(trip, ctx);
+        count++;
+    }
+    json_obj_leave_array(&jctx);
+    json_parse_end(&jctx);
+    return count;
+}
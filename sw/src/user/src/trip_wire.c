@@ -0,0 +1,240 @@
+#include <string.h>
+#include "esp_log.h"
+#include "tripring.h"
+#include "line_data.h"
+#include "trip_wire.h"
+
+static const char * TAG = "TRIP_WIRE";
+
+#define TRIP_WIRE_ID_MAX  (sizeof(((Trip *)0)->trip_id) - 1)
+
+
+void trip_wire_begin(trip_wire_writer_t *w, uint8_t *buf, size_t size, trip_wire_kind_t kind,
+                     uint32_t epoch, uint32_t base_seq, uint32_t seq, int64_t now)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    if (size < sizeof(trip_wire_hdr_t)) {
+        w->full = true;
+        return;
+    }
+    trip_wire_hdr_t h = {
+        .magic = TRIP_WIRE_MAGIC, .version = TRIP_WIRE_VERSION, .kind = kind,
+        .epoch = epoch, .base_seq = base_seq, .seq = seq, .now = now,
+    };
+    memcpy(buf, &h, sizeof(h));
+    w->len = sizeof(h);
+}
+
+static bool room(trip_wire_writer_t *w, size_t n)
+{
+    if (w->full || w->count == UINT16_MAX || w->size - w->len < n) {
+        w->full = true;
+        return false;
+    }
+    return true;
+}
+
+// seconds after base, false if they do not fit
+static bool wire_time(int64_t ts, int64_t base, uint16_t *out)
+{
+    if (ts == 0) {
+        *out = TRIP_WIRE_NO_TIME;
+        return true;
+    }
+    int64_t d = ts - base;
+    if (d < 0 || d >= TRIP_WIRE_NO_TIME) return false;
+    *out = (uint16_t)d;
+    return true;
+}
+
+bool trip_wire_put(trip_wire_writer_t *w, const Trip *t)
+{
+    size_t id_len = strnlen(t->trip_id, TRIP_WIRE_ID_MAX);
+    if (id_len == 0 || t->line_code >= line_data_number_of_lines()) return false;
+    if (!room(w, sizeof(trip_wire_put_t) + id_len + (size_t)t->num_stops * sizeof(trip_wire_stop_t))) return false;
+
+    // the earliest time there is, the others count from it
+    int64_t base = t->dep_ts;
+    if (t->arr_ts && (base == 0 || t->arr_ts < base)) base = t->arr_ts;
+    for (uint16_t i = 0; i < t->num_stops; i++) {
+        if (t->stops[i].arr_ts && (base == 0 || t->stops[i].arr_ts < base)) base = t->stops[i].arr_ts;
+        if (t->stops[i].dep_ts && (base == 0 || t->stops[i].dep_ts < base)) base = t->stops[i].dep_ts;
+    }
+    if (base < 0 || base > UINT32_MAX) return false;
+
+    trip_wire_put_t r = {
+        .op = TRIP_WIRE_PUT,
+        .id_len = (uint8_t)id_len,
+        .direction = (int8_t)t->direction,
+        .num_stops = t->num_stops,
+        .origin_station_id = t->origin_station_id,
+        .dest_station_id = t->dest_station_id,
+        .base_ts = (uint32_t)base,
+    };
+    memcpy(r.line, leds[t->line_code].name, strnlen(leds[t->line_code].name, sizeof(r.line)));
+    uint16_t dep, arr;
+    if (!wire_time(t->dep_ts, base, &dep) || !wire_time(t->arr_ts, base, &arr)) return false;
+    r.dep = dep;
+    r.arr = arr;
+
+    uint8_t *p = w->buf + w->len;
+    for (uint16_t i = 0; i < t->num_stops; i++) {
+        if (!wire_time(t->stops[i].arr_ts, base, &arr) || !wire_time(t->stops[i].dep_ts, base, &dep)) {
+            ESP_LOGW(TAG, "trip %s spans more than %u s", t->trip_id, TRIP_WIRE_NO_TIME - 1);
+            return false;
+        }
+        trip_wire_stop_t s = { .station_id = t->stops[i].station_id, .arr = arr, .dep = dep };
+        memcpy(p + sizeof(r) + id_len + i * sizeof(s), &s, sizeof(s));
+    }
+    memcpy(p, &r, sizeof(r));
+    memcpy(p + sizeof(r), t->trip_id, id_len);
+    w->len += sizeof(r) + id_len + (size_t)t->num_stops * sizeof(trip_wire_stop_t);
+    w->count++;
+    return true;
+}
+
+bool trip_wire_del(trip_wire_writer_t *w, const char *trip_id)
+{
+    size_t id_len = strnlen(trip_id, TRIP_WIRE_ID_MAX);
+    if (id_len == 0 || !room(w, sizeof(trip_wire_del_t) + id_len)) return false;
+    trip_wire_del_t r = { .op = TRIP_WIRE_DEL, .id_len = (uint8_t)id_len };
+    memcpy(w->buf + w->len, &r, sizeof(r));
+    memcpy(w->buf + w->len + sizeof(r), trip_id, id_len);
+    w->len += sizeof(r) + id_len;
+    w->count++;
+    return true;
+}
+
+size_t trip_wire_end(trip_wire_writer_t *w)
+{
+    if (w->size < sizeof(trip_wire_hdr_t)) return 0;
+    trip_wire_hdr_t h;
+    memcpy(&h, w->buf, sizeof(h));
+    h.count = w->count;
+    h.size = (uint32_t)w->len;
+    memcpy(w->buf, &h, sizeof(h));
+    return w->len;
+}
+
+
+bool trip_wire_header(const uint8_t *buf, size_t len, trip_wire_info_t *info)
+{
+    trip_wire_hdr_t h;
+    if (buf == NULL || len < sizeof(h)) return false;
+    memcpy(&h, buf, sizeof(h));
+    if (h.magic != TRIP_WIRE_MAGIC || h.version != TRIP_WIRE_VERSION) {
+        ESP_LOGE(TAG, "no trip message of version %d", TRIP_WIRE_VERSION);
+        return false;
+    }
+    if ((h.kind != TRIP_WIRE_SNAPSHOT && h.kind != TRIP_WIRE_DELTA) || h.size < sizeof(h) || h.size > len) {
+        ESP_LOGE(TAG, "bad header: kind %d, size %u of %u", h.kind, (unsigned)h.size, (unsigned)len);
+        return false;
+    }
+    memset(info, 0, sizeof(*info));
+    info->kind = h.kind;
+    info->epoch = h.epoch;
+    info->base_seq = h.base_seq;
+    info->seq = h.seq;
+    info->now = h.now;
+    return true;
+}
+
+// every record within the message and nothing after the last one
+static bool check_records(const uint8_t *buf, size_t size, uint16_t count)
+{
+    size_t off = sizeof(trip_wire_hdr_t);
+    for (uint16_t i = 0; i < count; i++) {
+        if (off + 2 > size) return false;
+        uint8_t op = buf[off];
+        uint8_t id_len = buf[off + 1];
+        if (id_len == 0 || id_len > TRIP_WIRE_ID_MAX) return false;
+        if (op == TRIP_WIRE_PUT) {
+            trip_wire_put_t r;
+            if (size - off < sizeof(r)) return false;
+            memcpy(&r, buf + off, sizeof(r));
+            off += sizeof(r) + id_len + (size_t)r.num_stops * sizeof(trip_wire_stop_t);
+        } else if (op == TRIP_WIRE_DEL) {
+            off += sizeof(trip_wire_del_t) + id_len;
+        } else {
+            return false;
+        }
+        if (off > size) return false;
+    }
+    return off == size;
+}
+
+static int64_t unix_time(uint32_t base, uint16_t t)
+{
+    return t == TRIP_WIRE_NO_TIME ? 0 : (int64_t)base + t;
+}
+
+// one put record into the ring, the size was checked before
+static bool apply_put(const uint8_t *p)
+{
+    trip_wire_put_t r;
+    memcpy(&r, p, sizeof(r));
+    char line[sizeof(r.line) + 1] = {0};
+    memcpy(line, r.line, sizeof(r.line));
+    int32_t line_code = line_data_find_line(line);
+    if (line_code < 0) {
+        ESP_LOGW(TAG, "trip on unknown line %s", line);
+        return false;
+    }
+
+    Trip *t = tr_reserve(r.num_stops);
+    if (t == NULL) return false;
+    memset(t->trip_id, 0, sizeof(t->trip_id));
+    memcpy(t->trip_id, p + sizeof(r), r.id_len);
+    t->origin_station_id = r.origin_station_id;
+    t->dest_station_id = r.dest_station_id;
+    t->direction = r.direction;
+    t->dep_ts = unix_time(r.base_ts, r.dep);
+    t->arr_ts = unix_time(r.base_ts, r.arr);
+    t->line_code = (uint16_t)line_code;
+    t->num_stops = r.num_stops;
+    t->flags = 0;
+    const uint8_t *sp = p + sizeof(r) + r.id_len;
+    for (uint16_t i = 0; i < r.num_stops; i++) {
+        trip_wire_stop_t s;
+        memcpy(&s, sp + i * sizeof(s), sizeof(s));
+        t->stops[i].station_id = s.station_id;
+        t->stops[i].arr_ts = unix_time(r.base_ts, s.arr);
+        t->stops[i].dep_ts = unix_time(r.base_ts, s.dep);
+    }
+    return tr_commit(t);
+}
+
+bool trip_wire_apply(const uint8_t *buf, size_t len, trip_wire_info_t *info)
+{
+    if (!trip_wire_header(buf, len, info)) return false;
+    trip_wire_hdr_t h;
+    memcpy(&h, buf, sizeof(h));
+    if (!check_records(buf, h.size, h.count)) {
+        ESP_LOGE(TAG, "malformed records, message of %u bytes dropped", (unsigned)h.size);
+        return false;
+    }
+
+    if (h.kind == TRIP_WIRE_SNAPSHOT) tr_clear_all();
+    size_t off = sizeof(h);
+    for (uint16_t i = 0; i < h.count; i++) {
+        const uint8_t *p = buf + off;
+        uint8_t id_len = p[1];
+        if (p[0] == TRIP_WIRE_PUT) {
+            trip_wire_put_t r;
+            memcpy(&r, p, sizeof(r));
+            if (apply_put(p)) info->put++;
+            else info->skipped++;
+            off += sizeof(r) + id_len + (size_t)r.num_stops * sizeof(trip_wire_stop_t);
+        } else {
+            char id[TRIP_WIRE_ID_MAX + 1] = {0};
+            memcpy(id, p + sizeof(trip_wire_del_t), id_len);
+            if (tr_free_id(id)) info->del++;
+            off += sizeof(trip_wire_del_t) + id_len;
+        }
+    }
+    ESP_LOGD(TAG, "%s %u: %u put, %u removed, %u skipped", h.kind == TRIP_WIRE_SNAPSHOT ? "snapshot" : "delta",
+             (unsigned)h.seq, info->put, info->del, info->skipped);
+    return true;
+}
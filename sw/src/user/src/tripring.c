@@ -2,33 +2,36 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include <inttypes.h>
 #include <assert.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "multi_heap.h"
+#include "mem_tier.h"
 #include "tripring.h"
 #include "time_server.h"
+#include "metrics.h"
+#include "trace.h"
 
 static const char * TAG = "TRIPRING";
 
 void print_trips_here(Trip * t, int64_t now)
 {
     char buf[32];
-    ESP_LOGI("",""); 
-    ESP_LOGI(TAG, "");
+    ESP_LOGI(TAG, " ");
     ESP_LOGI("    ", "trip:");
-    ESP_LOGI("    ", "unix time now:  %lld = %s", now, unix_time_to_string(now, buf, 32));
-    ESP_LOGI("    ", "departure time: %lld = %s", t->dep_ts, unix_time_to_string(t->dep_ts, buf, 32));
-    ESP_LOGI("    ", "arrival time:   %lld = %s", t->arr_ts, unix_time_to_string(t->arr_ts, buf, 32));
+    ESP_LOGI("    ", "unix time now:  %" PRId64 " = %s", now, unix_time_to_string(now, buf, 32));
+    ESP_LOGI("    ", "departure time: %" PRId64 " = %s", t->dep_ts, unix_time_to_string(t->dep_ts, buf, 32));
+    ESP_LOGI("    ", "arrival time:   %" PRId64 " = %s", t->arr_ts, unix_time_to_string(t->arr_ts, buf, 32));
     ESP_LOGI("    ", "stations:");
     for(int i = 0; i < t->num_stops; i ++)
     {
-        ESP_LOGI("    ", "departure time: %lld = %s", t->stops[i].dep_ts, unix_time_to_string(t->stops[i].dep_ts, buf, 32));
-        ESP_LOGI("    ", "arrival time:   %lld = %s", t->stops[i].arr_ts, unix_time_to_string(t->stops[i].arr_ts, buf, 32));
+        ESP_LOGI("    ", "departure time: %" PRId64 " = %s", t->stops[i].dep_ts, unix_time_to_string(t->stops[i].dep_ts, buf, 32));
+        ESP_LOGI("    ", "arrival time:   %" PRId64 " = %s", t->stops[i].arr_ts, unix_time_to_string(t->stops[i].arr_ts, buf, 32));
     }
-    ESP_LOGI("","");
+    ESP_LOGI(TAG, " ");
 }
 
 
@@ -78,17 +81,26 @@ void tripring_print_complete_trip(Trip * trip)
 
 
 
+// internal RAM only; with SPIRAM the heap moves there and both grow
 #define MAX_TRIPS 150
 #define PRIVATE_HEAP_SIZE (32768)
+#if CONFIG_SPIRAM
+#define SPIRAM_MAX_TRIPS         CONFIG_TRIPRING_SPIRAM_TRIPS
+#define SPIRAM_PRIVATE_HEAP_SIZE (CONFIG_TRIPRING_SPIRAM_HEAP_KB * 1024)
+#else
+#define SPIRAM_MAX_TRIPS         MAX_TRIPS
+#define SPIRAM_PRIVATE_HEAP_SIZE PRIVATE_HEAP_SIZE
+#endif
 typedef struct {
     Trip   **tr;
     uint32_t index;
     uint32_t size;
 }tr_struct_t;
 
-static Trip * tr[MAX_TRIPS] = {NULL};
+static uint32_t max_trips;               // capacity, set on init
 static tr_struct_t tr_state = {0};
-static uint8_t heap_buff[PRIVATE_HEAP_SIZE] __attribute__((aligned(8)));
+static uint8_t *heap_buff;               // MEM_TIER_BULK
+static size_t heap_size;
 static multi_heap_handle_t heap_handle;  // registered on init
 static SemaphoreHandle_t tr_mutex = NULL;
 
@@ -98,18 +110,25 @@ static void tr_arange_trp_pointer(tr_struct_t * state);
 static uint32_t tr_size(Trip *t);
 static void *tr_malloc(uint32_t len);
 static void tr_free(Trip *t);
+static multi_heap_info_t tr_publish_stats(void);
 
 void tr_init(void)
 {
+    // the pointers are walked every frame and stay internal, the trips may not
+    if (tr_state.tr == NULL) {
+        max_trips = mem_tier_size(MAX_TRIPS, SPIRAM_MAX_TRIPS);
+        heap_size = mem_tier_size(PRIVATE_HEAP_SIZE, SPIRAM_PRIVATE_HEAP_SIZE);
+        tr_state.tr = mem_tier_alloc(max_trips * sizeof(Trip *), MEM_TIER_FAST, "tripring pointers");
+        heap_buff = mem_tier_alloc(heap_size, MEM_TIER_BULK, "tripring heap");
+    }
     // set all pointer to NULL
-    for(int i = 0; i < MAX_TRIPS; i ++) tr[i] = NULL;
-    tr_state.tr = tr;
+    for(uint32_t i = 0; i < max_trips; i ++) tr_state.tr[i] = NULL;
     tr_state.index = 0;
     tr_state.size = 0;
     
     // init private heap
-    heap_handle = multi_heap_register(heap_buff, sizeof(heap_buff));
-    ESP_LOGI(TAG, "Tripring heap created: trip capacity=%d, heap bytes =%d",MAX_TRIPS, PRIVATE_HEAP_SIZE);
+    heap_handle = multi_heap_register(heap_buff, heap_size);
+    ESP_LOGI(TAG, "Tripring heap created: trip capacity=%u, heap bytes =%u", (unsigned)max_trips, (unsigned)heap_size);
 
     // create mutex to lock access
     tr_mutex = xSemaphoreCreateMutex();
@@ -184,14 +203,14 @@ static void tr_arange_trp_pointer(tr_struct_t *state)
         return;
     }
 
-    ESP_LOGD(TAG, "tr_arange_trp_pointer: start (size=%u, index=%u, MAX_TRIPS=%u)",
-             state->size, state->index, (unsigned)MAX_TRIPS);
+    ESP_LOGD(TAG, "tr_arange_trp_pointer: start (size=%u, index=%u, max_trips=%u)",
+             state->size, state->index, (unsigned)max_trips);
 
     uint32_t head = 0;
     uint32_t moves = 0;
 
     // Compact in-place: move non-NULL entries down to eliminate gaps.
-    for (uint32_t i = 0; i < (uint32_t)MAX_TRIPS; i++) {
+    for (uint32_t i = 0; i < max_trips; i++) {
         Trip *p = state->tr[i];
         if (p != NULL) {
             if (head != i) {
@@ -209,7 +228,7 @@ static void tr_arange_trp_pointer(tr_struct_t *state)
     }
 
     // Ensure the tail is clean (protects against pre-existing garbage past 'head')
-    for (uint32_t j = head; j < (uint32_t)MAX_TRIPS; j++) {
+    for (uint32_t j = head; j < max_trips; j++) {
         if (state->tr[j] != NULL) {
             ESP_LOGD(TAG, "tr_arange_trp_pointer: clearing stale pointer at [%u]", j);
             state->tr[j] = NULL;
@@ -243,6 +262,19 @@ static void tr_free(Trip *t) {
     multi_heap_free(heap_handle, t); 
 }
 
+// ring and heap figures for the status server, called with tr_mutex held;
+// returns the heap figures it published
+static multi_heap_info_t tr_publish_stats(void)
+{
+    multi_heap_info_t info = {0};
+    multi_heap_get_info(heap_handle, &info);
+    metric_set(METRIC_TR_SIZE, tr_state.size);
+    metric_set(METRIC_TR_HEAP_FREE, info.total_free_bytes);
+    metric_set(METRIC_TR_HEAP_LARGEST, info.largest_free_block);
+    metric_set(METRIC_TR_HEAP_MIN_FREE, info.minimum_free_bytes);
+    return info;
+}
+
 void tr_put(Trip *t)
 {
     if (t == NULL) {
@@ -256,8 +288,8 @@ void tr_put(Trip *t)
     //     return;
     // }
 
-    ESP_LOGD(TAG, "tr_put: begin for trip_id=%s (size=%u, index=%u, MAX_TRIPS=%u)",
-             t->trip_id, tr_state.size, tr_state.index, (unsigned)MAX_TRIPS);
+    ESP_LOGD(TAG, "tr_put: begin for trip_id=%s (size=%u, index=%u, max_trips=%u)",
+             t->trip_id, tr_state.size, tr_state.index, (unsigned)max_trips);
 
     // If trip is already in ring then free old one and copy new one in case data changes
     int32_t idx = tr_is_in_ring(t, &tr_state);
@@ -268,14 +300,15 @@ void tr_put(Trip *t)
     }
 
     // Capacity check (avoid overflow)
-    if (tr_state.size >= MAX_TRIPS) {
-        ESP_LOGE(TAG, "tr_put: ring full (size=%u >= MAX_TRIPS=%u) — cannot insert trip_id=%s",
-                 tr_state.size, (unsigned)MAX_TRIPS, t->trip_id);
+    if (tr_state.size >= max_trips) {
+        TRACE_TRIPRING(TR_PUT_FULL, tr_state.size, 0, 0);
+        ESP_LOGD(TAG, "tr_put: ring full (size=%u >= max_trips=%u) — cannot insert trip_id=%s",
+                 tr_state.size, (unsigned)max_trips, t->trip_id);
         return;
     }
-    if (tr_state.index >= MAX_TRIPS) {
-        ESP_LOGE(TAG, "tr_put: index out of range (index=%u, MAX_TRIPS=%u)",
-                 tr_state.index, (unsigned)MAX_TRIPS);
+    if (tr_state.index >= max_trips) {
+        ESP_LOGE(TAG, "tr_put: index out of range (index=%u, max_trips=%u)",
+                 tr_state.index, (unsigned)max_trips);
         return;
     }
 
@@ -286,14 +319,6 @@ void tr_put(Trip *t)
     //          (unsigned)info_before.total_free_bytes,
     //          (unsigned)info_before.largest_free_block,
     //          (unsigned)info_before.minimum_free_bytes);
-    multi_heap_info_t info_before = {0};
-    multi_heap_get_info(heap_handle, &info_before);
-    ESP_LOGI(TAG, "private heap BEFORE: free=%u, largest=%u, min_free_ever=%u",
-            (unsigned)info_before.total_free_bytes,
-            (unsigned)info_before.largest_free_block,
-            (unsigned)info_before.minimum_free_bytes);
-
-
     // Compute size and allocate
     uint32_t sz = tr_size(t);
     ESP_LOGD(TAG, "tr_put: tr_size=%u", (unsigned)sz);
@@ -303,7 +328,8 @@ void tr_put(Trip *t)
         multi_heap_info_t info_fail = {0};
         //heap_caps_get_info(&info_fail, MALLOC_CAP_8BIT);
         multi_heap_get_info(heap_handle, &info_fail);
-        ESP_LOGE(TAG, "tr_malloc(%u) failed! free=%u, largest=%u, min_free_ever=%u",
+        TRACE_TRIPRING(TR_PUT_FAIL, sz, info_fail.total_free_bytes, info_fail.largest_free_block);
+        ESP_LOGD(TAG, "tr_malloc(%u) failed! free=%u, largest=%u, min_free_ever=%u",
                  (unsigned)sz,
                  (unsigned)info_fail.total_free_bytes,
                  (unsigned)info_fail.largest_free_block,
@@ -319,6 +345,7 @@ void tr_put(Trip *t)
     tr_state.tr[tr_state.index] = dst;
     tr_state.index++;
     tr_state.size++;
+    metric_inc(METRIC_TRIPS_PUT);
 
     // // Measure heap after alloc — use heap_caps_get_info()
     // multi_heap_info_t info_after = {0};
@@ -330,32 +357,75 @@ void tr_put(Trip *t)
     //          (unsigned)info_after.largest_free_block,
     //          (unsigned)info_after.minimum_free_bytes,
     //          delta,
-    //          (unsigned)MAX_TRIPS,
-    //          (int)((int)MAX_TRIPS - (int)tr_state.size));
-
-    multi_heap_info_t info_after = {0};
-    multi_heap_get_info(heap_handle, &info_after);
-    int delta = (int)info_after.total_free_bytes - (int)info_before.total_free_bytes;
+    //          (unsigned)max_trips,
+    //          (int)((int)max_trips - (int)tr_state.size));
 
-    ESP_LOGI(TAG,
-            "private heap AFTER:  free=%u, largest=%u, min_free_ever=%u, delta=%d",
-            (unsigned)info_after.total_free_bytes,
-            (unsigned)info_after.largest_free_block,
-            (unsigned)info_after.minimum_free_bytes,
-            delta);
+    multi_heap_info_t info_after = tr_publish_stats();
+    TRACE_TRIPRING(TR_PUT, tr_state.size, info_after.total_free_bytes, info_after.largest_free_block);
+    (void)info_after;   // read by the trace only
 
     ESP_LOGD(TAG, "tr_put: end (size=%u, index=%u)", tr_state.size, tr_state.index);
 }
 
 
+// a trip written in place by a decoder, see trip_wire.c; no copy as in tr_put()
+Trip *tr_reserve(uint16_t num_stops)
+{
+    uint32_t sz = sizeof(Trip) + (uint32_t)num_stops * sizeof(Stopover);
+    Trip *t = tr_malloc(sz);
+    if (t == NULL) {
+        multi_heap_info_t info_fail = {0};
+        multi_heap_get_info(heap_handle, &info_fail);
+        TRACE_TRIPRING(TR_PUT_FAIL, sz, info_fail.total_free_bytes, info_fail.largest_free_block);
+    }
+    return t;
+}
+
+bool tr_commit(Trip *t)
+{
+    int32_t idx = tr_is_in_ring(t, &tr_state);
+    if (idx != -1) tr_free_idx((uint32_t)idx, true);
+
+    if (tr_state.size >= max_trips || tr_state.index >= max_trips) {
+        TRACE_TRIPRING(TR_PUT_FULL, tr_state.size, 0, 0);
+        tr_free(t);
+        return false;
+    }
+    tr_state.tr[tr_state.index] = t;
+    tr_state.index++;
+    tr_state.size++;
+    metric_inc(METRIC_TRIPS_PUT);
+    tr_publish_stats();
+    return true;
+}
+
+void tr_discard(Trip *t)
+{
+    if (t) tr_free(t);
+}
+
+bool tr_free_id(const char *trip_id)
+{
+    for (uint32_t i = 0; i < tr_state.size; i++) {
+        Trip *tp = tr_state.tr[i];
+        if (tp && strncmp(tp->trip_id, trip_id, sizeof(tp->trip_id)) == 0) {
+            tr_free_idx(i, true);
+            tr_publish_stats();
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void tr_free_idx(uint32_t index, bool arange)
 {
     ESP_LOGD(TAG, "tr_free_idx: begin (index=%u, arange=%s, size=%u, cur_index=%u)",
              index, arange ? "true" : "false", tr_state.size, tr_state.index);
 
-    if (index >= (uint32_t)MAX_TRIPS) {
-        ESP_LOGE(TAG, "tr_free_idx: index out of range (index=%u, MAX_TRIPS=%u)",
-                 index, (unsigned)MAX_TRIPS);
+    if (index >= max_trips) {
+        ESP_LOGE(TAG, "tr_free_idx: index out of range (index=%u, max_trips=%u)",
+                 index, (unsigned)max_trips);
         return;
     }
 
@@ -404,22 +474,25 @@ void tr_free_old(int64_t now)
 
     // Iterate over full range because there may be NULL gaps; compaction
     // inside the loop changes indices, so handle carefully.
-    for (uint32_t i = 0; i < (uint32_t)MAX_TRIPS; i++) {
+    for (uint32_t i = 0; i < max_trips; i++) {
         Trip *tp = tr_state.tr[i];
         if(tp == NULL) {
             continue;
         }
 
         if (tp->arr_ts < now) {
-            ESP_LOGI(TAG, "tr_free_old: removing expired trip id=%s arr_ts=%lld now=%lld at index=%u",
+            TRACE_TRIPRING(TR_EXPIRE, i, tp->arr_ts, now);
+            ESP_LOGD(TAG, "tr_free_old: removing expired trip id=%s arr_ts=%lld now=%lld at index=%u",
                      tp->trip_id, (long long)tp->arr_ts, (long long)now, i);
             tr_free_idx(i, true);  // compacts array and updates size/index
+            metric_inc(METRIC_TRIPS_EXPIRED);
 
             removed++;
             // After compaction, items shift left — re-check the same index
             if (i > 0) { i--; }
         }
     }
+    if (removed) tr_publish_stats();
     ESP_LOGD(TAG, "tr_free_old: end (removed=%u, size=%u, index=%u)", removed, tr_state.size, tr_state.index);
 }
 
@@ -430,7 +503,7 @@ void tr_clear_all(void)
     multi_heap_get_info(heap_handle, &info_before);
 
     uint32_t removed = 0;
-    for (uint32_t i = 0; i < (uint32_t)MAX_TRIPS; i++) {
+    for (uint32_t i = 0; i < max_trips; i++) {
         Trip *t = tr_state.tr[i];
         if (t) {
             // (Optional) wipe the struct before freeing
@@ -449,6 +522,8 @@ void tr_clear_all(void)
 
     multi_heap_info_t info_after = {0};
     multi_heap_get_info(heap_handle, &info_after);
+    tr_publish_stats();
+    TRACE_TRIPRING(TR_CLEAR, removed, info_after.total_free_bytes, info_after.largest_free_block);
 
     int delta = (int)info_after.total_free_bytes - (int)info_before.total_free_bytes;
     ESP_LOGI(TAG,
@@ -461,11 +536,35 @@ void tr_clear_all(void)
 }
 
 
+// drops every trip that still carries flag, e.g. restored trips the live data did not confirm
+uint32_t tr_free_flagged(uint16_t flag)
+{
+    uint32_t removed = 0;
+    for (uint32_t i = 0; i < max_trips; i++) {
+        Trip *tp = tr_state.tr[i];
+        if (tp == NULL || (tp->flags & flag) == 0) continue;
+        tr_free_idx(i, false);
+        removed++;
+    }
+    if (removed) {
+        tr_arange_trp_pointer(&tr_state);
+        tr_publish_stats();
+    }
+    return removed;
+}
+
+
 uint32_t tr_get_size(void)
 {
     return tr_state.size;
 }
 
+// fixed after tr_init(), no lock needed
+uint32_t tr_get_capacity(void)
+{
+    return max_trips;
+}
+
 Trip * tr_get_trip(uint32_t index)
 {
     return tr_state.tr[index];
@@ -0,0 +1,29 @@
+#ifndef __PERF_BUDGETS_H_
+#define __PERF_BUDGETS_H_
+
+/*
+ * Cycle budgets of the hot paths, median of PERF_RUNS runs at 240 MHz with
+ * the sdkconfig.defaults of this test app. A case fails when it needs more.
+ *
+ * Under QEMU the cycle counter follows the virtual clock. Run it with
+ * instruction counting (-icount 3) so the numbers repeat between runs. Then
+ * they stand for instructions, not for the target's real timing.
+ *
+ * The budgets are the measured medians plus PERF_MARGIN_PCT, written by
+ *
+ *     PERF_CALIBRATE=1 pytest sw/test/perf
+ *
+ * Recalibrate when a change makes a path faster, so that the next slowdown is
+ * caught, and put the measured numbers in the commit message.
+ */
+
+#define PERF_RUNS 15
+#define PERF_MARGIN_PCT 25
+
+// not calibrated yet, the budgets are estimates
+#define BUDGET_TRIP_DECODE       900000   // trip_decode(), one U8 trip of 24 stops
+#define BUDGET_TR_PUT_FREE_OLD    40000   // tr_put() + tr_free_old(), ring of 6 trips
+#define BUDGET_PARSE_ISO8601      40000   // parse_iso8601_to_unix(), one timestamp
+#define BUDGET_LED_MAP_BUILD      60000   // led_map_build(), ring of 6 trips
+
+#endif //__PERF_BUDGETS_H_
@@ -0,0 +1,166 @@
+/*
+ * Cycle counts of the fetcher's and the renderer's hot paths on the target,
+ * on the U8 fixture of host/fixtures, against perf_budgets.h:
+ *
+ *   trip_decode()               one /trips/:id answer
+ *   tr_put() + tr_free_old()    as BVG_run() stores a trip
+ *   parse_iso8601_to_unix()     once per stop and direction in trip_decode()
+ *   led_map_build()             every frame of led_stripe_run()
+ *
+ * Every case prints "PERF <name> <cycles> <budget>", pytest_perf.py collects
+ * them next to the Unity results.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "unity.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "tripring.h"
+#include "mem_tier.h"
+#include "time_server.h"
+#include "line_data.h"
+#include "trip_decode.h"
+#include "led_map.h"
+#include "metrics.h"
+#include "perf_budgets.h"
+
+#define FIXTURE_TRIPS 6
+#define FIXTURE_NOW   1792405800   // meta.json of host/fixtures/U8
+
+// what status_server.c defines in the firmware
+uint32_t metrics[METRIC_NUM];
+
+extern const char trip_00_start[] asm("_binary_trip_00_json_start");
+extern const char trip_01_start[] asm("_binary_trip_01_json_start");
+extern const char trip_02_start[] asm("_binary_trip_02_json_start");
+extern const char trip_03_start[] asm("_binary_trip_03_json_start");
+extern const char trip_04_start[] asm("_binary_trip_04_json_start");
+extern const char trip_05_start[] asm("_binary_trip_05_json_start");
+
+static const char *const fixture[FIXTURE_TRIPS] = {
+    trip_00_start, trip_01_start, trip_02_start, trip_03_start, trip_04_start, trip_05_start,
+};
+
+static size_t trip_buf[FIXTURE_TRIPS][(sizeof(Trip) + TRIP_DECODE_MAX_STOPS * sizeof(Stopover) + sizeof(size_t) - 1) / sizeof(size_t)];
+static uint8_t led_active[FRAME_LED_COUNT];
+static uint32_t runs[PERF_RUNS];
+
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t median(void)
+{
+    qsort(runs, PERF_RUNS, sizeof(runs[0]), cmp_u32);
+    return runs[PERF_RUNS / 2];
+}
+
+static void report(const char *name, uint32_t cycles, uint32_t budget)
+{
+    printf("PERF %s %lu %lu\n", name, (unsigned long)cycles, (unsigned long)budget);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(budget, cycles, name);
+}
+
+static Trip *decoded(int i)
+{
+    return (Trip *)trip_buf[i];
+}
+
+// the ring holds the fixture, the clock is at its recording time
+static void fill_ring(void)
+{
+    tr_take();
+    tr_clear_all();
+    for (int i = 0; i < FIXTURE_TRIPS; i++) tr_put(decoded(i));
+    tr_release();
+}
+
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+
+TEST_CASE("trip_decode of one trip", "[perf]")
+{
+    for (int r = 0; r < PERF_RUNS; r++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        bool ok = trip_decode(fixture[0], decoded(0));
+        runs[r] = esp_cpu_get_cycle_count() - t0;
+        TEST_ASSERT_TRUE(ok);
+    }
+    report("trip_decode", median(), BUDGET_TRIP_DECODE);
+}
+
+TEST_CASE("tr_put and tr_free_old of one trip", "[perf]")
+{
+    fill_ring();
+    for (int r = 0; r < PERF_RUNS; r++) {
+        Trip *t = decoded(r % FIXTURE_TRIPS);
+        tr_take();
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        tr_put(t);
+        tr_free_old(FIXTURE_NOW);
+        runs[r] = esp_cpu_get_cycle_count() - t0;
+        tr_release();
+    }
+    TEST_ASSERT_EQUAL_UINT32(FIXTURE_TRIPS, tr_get_size());
+    report("tr_put_free_old", median(), BUDGET_TR_PUT_FREE_OLD);
+}
+
+TEST_CASE("parse_iso8601_to_unix of one timestamp", "[perf]")
+{
+    int64_t ts = 0;
+    for (int r = 0; r < PERF_RUNS; r++) {
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        ts = parse_iso8601_to_unix("2026-10-19T12:31:57+02:00");
+        runs[r] = esp_cpu_get_cycle_count() - t0;
+    }
+    TEST_ASSERT_EQUAL_INT64(1792405917, ts);
+    report("parse_iso8601_to_unix", median(), BUDGET_PARSE_ISO8601);
+}
+
+TEST_CASE("led_map_build of the ring", "[perf]")
+{
+    fill_ring();
+    bool lit = false;
+    for (int r = 0; r < PERF_RUNS; r++) {
+        tr_take();
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        lit = led_map_build(led_active, FIXTURE_NOW);
+        runs[r] = esp_cpu_get_cycle_count() - t0;
+        tr_release();
+    }
+    TEST_ASSERT_TRUE(lit);
+    report("led_map_build", median(), BUDGET_LED_MAP_BUILD);
+}
+
+
+void app_main(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    mem_tier_init();
+    time_server_init();
+    line_data_init();
+    tr_init();
+
+    // trips are only kept while they run, so the clock goes to the recording
+    struct timeval tv = { .tv_sec = FIXTURE_NOW };
+    settimeofday(&tv, NULL);
+    for (int i = 0; i < FIXTURE_TRIPS; i++) {
+        if (!trip_decode(fixture[i], decoded(i))) printf("fixture trip %d does not decode\n", i);
+    }
+
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
@@ -0,0 +1,62 @@
+"""
+Runs the perf test app under QEMU (or on a board) and fails if a case is
+over its budget in main/perf_budgets.h.
+
+    idf.py -C sw/test/perf build
+    pytest sw/test/perf
+
+pytest.ini starts QEMU with -icount 3, so the cycle counts repeat between
+runs. Needs pytest-embedded with the idf and qemu services.
+
+With PERF_CALIBRATE=1 the budgets are not checked. Each one is rewritten in
+main/perf_budgets.h as the measured cycles plus PERF_MARGIN_PCT; rebuild and
+run again to check the new budgets.
+"""
+import logging
+import os
+import re
+
+import pytest
+from pytest_embedded import Dut
+
+CASES = ["trip_decode", "tr_put_free_old", "parse_iso8601_to_unix", "led_map_build"]
+
+BUDGETS_H = os.path.join(os.path.dirname(__file__), "main", "perf_budgets.h")
+BUDGET_DEFINES = {
+    "trip_decode": "BUDGET_TRIP_DECODE",
+    "tr_put_free_old": "BUDGET_TR_PUT_FREE_OLD",
+    "parse_iso8601_to_unix": "BUDGET_PARSE_ISO8601",
+    "led_map_build": "BUDGET_LED_MAP_BUILD",
+}
+
+
+def calibrate(measured: dict) -> None:
+    with open(BUDGETS_H) as f:
+        text = f.read()
+    margin = int(re.search(r"#define PERF_MARGIN_PCT (\d+)", text).group(1))
+    text = text.replace("// not calibrated yet, the budgets are estimates\n", "")
+    for case, cycles in measured.items():
+        name, budget = BUDGET_DEFINES[case], cycles * (100 + margin) // 100
+        # keep the numbers right-aligned in their column
+        text = re.sub(rf"#define {name}\s+\d+", f"#define {name}{budget:>{31 - len(name)}}", text)
+        logging.info("%-22s %9d cycles -> budget %9d (+%d %%)", case, cycles, budget, margin)
+    with open(BUDGETS_H, "w") as f:
+        f.write(text)
+
+
+@pytest.mark.esp32
+@pytest.mark.qemu
+def test_perf(dut: Dut) -> None:
+    calibrating = os.environ.get("PERF_CALIBRATE") == "1"
+    measured = {}
+    for name in CASES:
+        m = dut.expect(re.compile(rb"PERF (\S+) (\d+) (\d+)"), timeout=120)
+        case, cycles, budget = m.group(1).decode(), int(m.group(2)), int(m.group(3))
+        assert case == name, f"expected {name}, got {case}"
+        measured[case] = cycles
+        logging.info("%-22s %9d cycles, budget %9d (%3d %%)", case, cycles, budget, cycles * 100 // budget)
+    m = dut.expect(re.compile(rb"(\d+) Tests (\d+) Failures (\d+) Ignored"), timeout=60)
+    if calibrating:
+        calibrate(measured)
+        return
+    assert int(m.group(2)) == 0, "a hot path is over its budget or a case failed"
@@ -0,0 +1,296 @@
+"""
+Generate the const topology tables of the firmware from topology/berlin.json.
+
+The json file is the single source for the station -> LED mapping, the stop
+order and the operator of every line. LED numbers are strip indices, i.e. pcb
+designator - 1 (U240 -> 239). The generator validates the description and
+writes
+
+    line_data_tables.h   counts, line enum, table declarations
+    line_data_tables.c   built-in copy of the tables, used without an image
+    topology.bin         (--image) the same tables for the "topology" partition,
+                         layout in line_data_image_hdr_t in line_data.h
+
+It runs as part of the firmware build (see src/CMakeLists.txt) and can be
+called by hand, e.g. to flash another map without rebuilding the firmware:
+
+    python tools/gen_line_data.py topology/berlin.json -o build/gen \
+        --positions ../hw/production/positions.csv --image build/topology.bin
+    parttool.py write_partition --partition-name topology --input build/topology.bin
+"""
+import argparse
+import csv
+import json
+import os
+import struct
+import sys
+import zlib
+from typing import Dict, List, Tuple
+
+VBB_ID_MIN = 900000000
+VBB_ID_MAX = 900999999
+LINE_NAME_MAX = 6        # char name[7] in line_data_struct_t
+LINE_OPERATOR_LEN = 32   # char[LINE_OPERATOR_LEN] per line, NUL terminated
+LINE_ADJ_NONE = 0xFFFF
+
+IMAGE_MAGIC = 0x314F5054  # "TPO1"
+IMAGE_VERSION = 1
+IMAGE_HDR = struct.Struct("<IHHIIHHHH6I")
+STATION = struct.Struct("<IH")
+POS = struct.Struct("<HH")
+LINE = struct.Struct("<7sBBBHH")
+
+
+class TopologyError(Exception):
+    pass
+
+
+def load_positions(path: str) -> set:
+    """Designators placed on the pcb, from the JLCPCB position file."""
+    with open(path, newline="", encoding="utf-8-sig") as f:
+        return {row["Designator"] for row in csv.DictReader(f)}
+
+
+def resolve_lines(topo: dict) -> List[dict]:
+    by_name = {l["name"]: l for l in topo["lines"]}
+    lines = []
+    for l in topo["lines"]:
+        line = dict(l)
+        if "same_as" in line:
+            if line["same_as"] not in by_name or "stops" not in by_name[line["same_as"]]:
+                raise TopologyError(f"line {line['name']}: same_as {line['same_as']} is not a line with stops")
+            line["stops"] = by_name[line["same_as"]]["stops"]
+        if "operator" not in line:
+            line["operator"] = topo.get("operators", {}).get(line["name"][:1], "")
+        lines.append(line)
+    return lines
+
+
+def validate(topo: dict, lines: List[dict], designators: set = None) -> List[str]:
+    errors = []
+    warnings = []
+    led_count = topo["led_count"]
+
+    ids = set()
+    station_leds: Dict[int, List[int]] = {}
+    for s in topo["stations"]:
+        sid, led = s["id"], s["led"]
+        if sid in ids:
+            errors.append(f"station {sid}: listed twice")
+        ids.add(sid)
+        if not VBB_ID_MIN <= sid <= VBB_ID_MAX:
+            errors.append(f"station {sid}: not a VBB station id")
+        if not 0 <= led < led_count:
+            errors.append(f"station {sid}: led {led} outside 0..{led_count - 1}")
+        elif designators is not None and f"U{led + 1}" not in designators:
+            errors.append(f"station {sid}: led {led} has no designator U{led + 1} on the pcb")
+        station_leds.setdefault(led, []).append(sid)
+
+    names = set()
+    used_leds = set()
+    for l in lines:
+        name = l["name"]
+        if name in names:
+            errors.append(f"line {name}: listed twice")
+        names.add(name)
+        if not 0 < len(name) <= LINE_NAME_MAX:
+            errors.append(f"line {name}: name longer than {LINE_NAME_MAX} characters")
+        if not 0 < len(l["operator"].encode()) < LINE_OPERATOR_LEN:
+            errors.append(f"line {name}: operator missing or longer than {LINE_OPERATOR_LEN - 1} bytes")
+        if len(l["color"]) != 3 or any(not 0 <= c <= 255 for c in l["color"]):
+            errors.append(f"line {name}: color must be three values 0..255")
+        stops = l.get("stops", [])
+        if not stops:
+            errors.append(f"line {name}: no stops")
+        seen = set()
+        for led in stops:
+            if led in seen:
+                errors.append(f"line {name}: led {led} appears twice")
+            seen.add(led)
+            if led not in station_leds:
+                errors.append(f"line {name}: led {led} is not assigned to any station")
+        used_leds |= seen
+
+    for led, sids in sorted(station_leds.items()):
+        if led not in used_leds:
+            warnings.append(f"led {led} (stations {sids}) is not on any line")
+
+    for w in warnings:
+        print(f"gen_line_data: warning: {w}", file=sys.stderr)
+    return errors
+
+
+def layout(topo: dict, lines: List[dict]) -> Tuple[List[Tuple[int, int]], List[tuple], List[Tuple[int, int]], Dict[str, int]]:
+    """stations sorted by id, (led, position) and (prev, next) per line stop, first row per line."""
+    stations = sorted(((s["id"], s["led"]) for s in topo["stations"]))
+    # lines sharing their stops (same_as) also share the table slice
+    first: Dict[str, int] = {}
+    pos = []
+    adj = []
+    for l in lines:
+        key = l.get("same_as", l["name"])
+        if key in first:
+            continue
+        first[key] = len(pos)
+        stops = l["stops"]
+        for i, led in enumerate(stops):
+            pos.append((led, i + 1, l["name"] if i == 0 else None))
+            adj.append((stops[i - 1] if i > 0 else LINE_ADJ_NONE,
+                        stops[i + 1] if i + 1 < len(stops) else LINE_ADJ_NONE))
+    return stations, pos, adj, first
+
+
+def emit_header(topo: dict, lines: List[dict], n_pos: int) -> str:
+    out = []
+    out.append("// generated by tools/gen_line_data.py from topology/berlin.json, do not edit")
+    out.append("#ifndef __LINE_DATA_TABLES_H_")
+    out.append("#define __LINE_DATA_TABLES_H_")
+    out.append("")
+    out.append('#include "line_data.h"')
+    out.append("")
+    out.append(f"#define LINE_DATA_LED_COUNT    {topo['led_count']}")
+    out.append(f"#define LINE_DATA_NUM_STATIONS {len(topo['stations'])}")
+    out.append(f"#define LINE_DATA_NUM_LINES    {len(lines)}")
+    out.append(f"#define LINE_DATA_NUM_POS      {n_pos}")
+    out.append("")
+    out.append("typedef enum")
+    out.append("{")
+    for i, l in enumerate(lines):
+        out.append(f"LINE_{l['name']} = {i},")
+    out.append("}line_enum_t;")
+    out.append("")
+    out.append("// built-in tables, line_data_init() replaces them with the topology partition")
+    out.append("extern const station_line_t line_data_builtin_stations[LINE_DATA_NUM_STATIONS];")
+    out.append("extern const line_pos_struct_t line_data_builtin_pos[LINE_DATA_NUM_POS];")
+    out.append("extern const line_adj_t line_data_builtin_adj[LINE_DATA_NUM_POS];")
+    out.append("extern const line_data_struct_t line_data_builtin_lines[LINE_DATA_NUM_LINES];")
+    out.append("extern const char line_data_builtin_operators[LINE_DATA_NUM_LINES][LINE_OPERATOR_LEN];")
+    out.append("")
+    out.append("#endif //__LINE_DATA_TABLES_H_")
+    return "\n".join(out) + "\n"
+
+
+def emit_source(topo: dict, lines: List[dict]) -> (str, int):
+    stations, pos, adj, first = layout(topo, lines)
+    out = []
+    out.append("// generated by tools/gen_line_data.py from topology/berlin.json, do not edit")
+    out.append('#include "line_data_tables.h"')
+    out.append("")
+
+    out.append("// sorted by station id for line_data_find_station_led()")
+    out.append("const station_line_t line_data_builtin_stations[LINE_DATA_NUM_STATIONS] = {")
+    for sid, led in stations:
+        out.append(f"    {{{sid}, {led}}},")
+    out.append("};")
+    out.append("")
+
+    out.append("// stations of all lines in stop order, the line table holds offset and length")
+    out.append("const line_pos_struct_t line_data_builtin_pos[LINE_DATA_NUM_POS] = ")
+    out.append("{")
+    for led, i, name in pos:
+        if name:
+            out.append(f"// {name}")
+        out.append(f"{{{led},{i}}},")
+    out.append("};")
+    out.append("")
+    out.append("// neighbouring leds of line_pos[i] on the same line, LINE_ADJ_NONE at the ends")
+    out.append("const line_adj_t line_data_builtin_adj[LINE_DATA_NUM_POS] = ")
+    out.append("{")
+    for (prev, nxt), (_, _, name) in zip(adj, pos):
+        if name:
+            out.append(f"// {name}")
+        prev = "LINE_ADJ_NONE" if prev == LINE_ADJ_NONE else prev
+        nxt = "LINE_ADJ_NONE" if nxt == LINE_ADJ_NONE else nxt
+        out.append(f"{{{prev},{nxt}}},")
+    out.append("};")
+    out.append("")
+
+    out.append("const line_data_struct_t line_data_builtin_lines[LINE_DATA_NUM_LINES] = ")
+    out.append("{")
+    for l in lines:
+        r, g, b = l["color"]
+        key = l.get("same_as", l["name"])
+        out.append(f"{{\"{l['name']}\",{r},{g},{b},{first[key]},{len(l['stops'])}}},")
+    out.append("};")
+    out.append("")
+
+    out.append("const char line_data_builtin_operators[LINE_DATA_NUM_LINES][LINE_OPERATOR_LEN] = ")
+    out.append("{")
+    for l in lines:
+        out.append(f"{{\"{l['operator']}\"}},")
+    out.append("};")
+    return "\n".join(out) + "\n", len(pos)
+
+
+def emit_image(topo: dict, lines: List[dict]) -> bytes:
+    stations, pos, adj, first = layout(topo, lines)
+    out = bytearray(IMAGE_HDR.size)
+
+    def table(data: bytes) -> int:
+        while len(out) % 4:
+            out.append(0)
+        off = len(out)
+        out.extend(data)
+        return off
+
+    off_stations = table(b"".join(STATION.pack(sid, led) for sid, led in stations))
+    off_pos = table(b"".join(POS.pack(led, i) for led, i, _ in pos))
+    off_adj = table(b"".join(POS.pack(prev, nxt) for prev, nxt in adj))
+    off_lines = table(b"".join(
+        LINE.pack(l["name"].encode(), *l["color"], first[l.get("same_as", l["name"])], len(l["stops"]))
+        for l in lines))
+    off_operators = table(b"".join(l["operator"].encode().ljust(LINE_OPERATOR_LEN, b"\0") for l in lines))
+    while len(out) % 4:
+        out.append(0)
+
+    crc = zlib.crc32(bytes(out[IMAGE_HDR.size:])) & 0xFFFFFFFF
+    IMAGE_HDR.pack_into(out, 0, IMAGE_MAGIC, IMAGE_VERSION, topo["led_count"], len(out), crc,
+                        len(stations), len(lines), len(pos), 0,
+                        off_stations, off_pos, off_adj, off_lines, off_operators, 0)
+    return bytes(out)
+
+
+def write_if_changed(path: str, data: bytes):
+    # keeps timestamps stable so the build does not recompile needlessly
+    if os.path.exists(path):
+        with open(path, "rb") as f:
+            if f.read() == data:
+                return
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="generate line_data tables from the topology description")
+    parser.add_argument("topology", help="topology json")
+    parser.add_argument("-o", "--out", required=True, help="output directory")
+    parser.add_argument("--positions", help="pcb position file to check the led designators against")
+    parser.add_argument("--image", help="also write the binary image for the topology partition")
+    args = parser.parse_args()
+
+    with open(args.topology, "r", encoding="utf-8") as f:
+        topo = json.load(f)
+
+    try:
+        lines = resolve_lines(topo)
+        designators = load_positions(args.positions) if args.positions else None
+        errors = validate(topo, lines, designators)
+    except TopologyError as e:
+        errors = [str(e)]
+    if errors:
+        for e in errors:
+            print(f"gen_line_data: error: {e}", file=sys.stderr)
+        return 1
+
+    source, n_pos = emit_source(topo, lines)
+    os.makedirs(args.out, exist_ok=True)
+    write_if_changed(os.path.join(args.out, "line_data_tables.c"), source.encode())
+    write_if_changed(os.path.join(args.out, "line_data_tables.h"), emit_header(topo, lines, n_pos).encode())
+    if args.image:
+        os.makedirs(os.path.dirname(os.path.abspath(args.image)), exist_ok=True)
+        write_if_changed(args.image, emit_image(topo, lines))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,289 @@
+"""
+Build the static timetable image for the "timetable" partition from a GTFS feed.
+
+Only the lines of the topology are kept, only stations that are on the map are
+stored per stop, identical stop sequences with identical running times are
+shared between trips and every service calendar is reduced to a bitmap over
+the days of the image. The layout is described in src/user/inc/timetable.h,
+the firmware maps the image in place, so nothing is compressed further.
+
+    python tools/gen_timetable.py GTFS.zip -o timetable/timetable.bin
+    python tools/gen_timetable.py gtfs_dir/ -o timetable/timetable.bin --from 2026-10-19 --days 28
+
+The VBB feed is published at https://www.vbb.de/vbb-services/api-open-data/datensaetze/
+"""
+import argparse
+import csv
+import datetime
+import io
+import json
+import math
+import os
+import re
+import struct
+import sys
+import time
+import zipfile
+import zlib
+from typing import Dict, Iterator, List, Optional, Tuple
+
+TIMETABLE_MAGIC = 0x31425454
+TIMETABLE_VERSION = 1
+TIMETABLE_MAX_DAYS = 64
+
+HDR = struct.Struct("<IHHIIiHH4I5II")
+LINE = struct.Struct("<8sIII")
+PATTERN = struct.Struct("<IIIHBbI")
+STOP = struct.Struct("<IHH")
+TRIP = struct.Struct("<HHI")
+
+# rail and subway route types, plain and extended
+RAIL_ROUTE_TYPES = {1, 2, 100, 101, 102, 103, 106, 109, 400, 401, 402, 403}
+
+DEFAULT_TOPOLOGY = os.path.join(os.path.dirname(__file__), "..", "topology", "berlin.json")
+
+
+class Gtfs:
+    """Reads the tables of a feed from a zip file or a directory."""
+
+    def __init__(self, path: str) -> None:
+        self.zip = zipfile.ZipFile(path) if zipfile.is_zipfile(path) else None
+        self.path = path
+
+    def rows(self, name: str, required: bool = True) -> Iterator[Dict[str, str]]:
+        if self.zip is not None:
+            if name not in self.zip.namelist():
+                if required:
+                    raise SystemExit(f"{name} missing in {self.path}")
+                return
+            with self.zip.open(name) as raw:
+                yield from csv.DictReader(io.TextIOWrapper(raw, encoding="utf-8-sig"))
+        else:
+            file = os.path.join(self.path, name)
+            if not os.path.exists(file):
+                if required:
+                    raise SystemExit(f"{name} missing in {self.path}")
+                return
+            with open(file, "r", encoding="utf-8-sig", newline="") as f:
+                yield from csv.DictReader(f)
+
+
+def parse_time(s: str) -> Optional[int]:
+    """HH:MM:SS after noon - 12h, hours may exceed 24."""
+    if not s:
+        return None
+    h, m, sec = s.strip().split(":")
+    return int(h) * 3600 + int(m) * 60 + int(sec)
+
+
+def parse_date(s: str) -> datetime.date:
+    return datetime.date(int(s[0:4]), int(s[4:6]), int(s[6:8]))
+
+
+def station_number(stop_id: str) -> Optional[int]:
+    """Numeric VBB station id as used by the api, e.g. de:11000:900100003 -> 900100003."""
+    m = re.match(r"de:\d+:(\d+)", stop_id)
+    if m:
+        return int(m.group(1))
+    if stop_id.isdigit():
+        if len(stop_id) == 12 and stop_id.startswith("9000"):
+            return int("900" + stop_id[6:])
+        if len(stop_id) == 9 and stop_id.startswith("9"):
+            return int(stop_id)
+    return None
+
+
+def get_direction(lat1: float, lon1: float, lat2: float, lon2: float) -> int:
+    """Same rule as get_direction() in trip_decode.c."""
+    dlat = lat2 - lat1
+    dlon = lon2 - lon1
+    if math.fabs(dlon) > math.fabs(dlat):
+        return 1 if dlon > 0.0 else -1
+    return 1 if dlat > 0.0 else -1
+
+
+def load_topology(path: str) -> Tuple[List[str], set]:
+    with open(path, "r", encoding="utf-8") as f:
+        topo = json.load(f)
+    return [line["name"] for line in topo["lines"]], {s["id"] for s in topo["stations"]}
+
+
+def service_bitmaps(gtfs: Gtfs, first: datetime.date, days: int) -> Dict[str, int]:
+    bitmaps: Dict[str, int] = {}
+    for row in gtfs.rows("calendar.txt", required=False):
+        start, end = parse_date(row["start_date"]), parse_date(row["end_date"])
+        weekdays = [row[d] == "1" for d in
+                    ("monday", "tuesday", "wednesday", "thursday", "friday", "saturday", "sunday")]
+        bits = 0
+        for i in range(days):
+            day = first + datetime.timedelta(days=i)
+            if start <= day <= end and weekdays[day.weekday()]:
+                bits |= 1 << i
+        bitmaps[row["service_id"]] = bits
+    for row in gtfs.rows("calendar_dates.txt", required=False):
+        i = (parse_date(row["date"]) - first).days
+        if not 0 <= i < days:
+            bitmaps.setdefault(row["service_id"], 0)
+            continue
+        bits = bitmaps.get(row["service_id"], 0)
+        if row["exception_type"] == "1":
+            bits |= 1 << i
+        else:
+            bits &= ~(1 << i)
+        bitmaps[row["service_id"]] = bits
+    return bitmaps
+
+
+def build(gtfs: Gtfs, names: List[str], on_map: set, first: datetime.date, days: int) -> bytes:
+    route_names = {n for n in names if re.fullmatch(r"[SU]\d+", n)}
+    line_code = {n: i for i, n in enumerate(names)}
+
+    routes = {}
+    for row in gtfs.rows("routes.txt"):
+        name = row["route_short_name"].strip()
+        if name in route_names and int(row["route_type"]) in RAIL_ROUTE_TYPES:
+            routes[row["route_id"]] = name
+
+    bitmaps = service_bitmaps(gtfs, first, days)
+    trips = {}
+    for row in gtfs.rows("trips.txt"):
+        if row["route_id"] in routes and bitmaps.get(row["service_id"], 0):
+            trips[row["trip_id"]] = (routes[row["route_id"]], row["service_id"])
+    if not trips:
+        raise SystemExit("no trip of the topology lines runs in the requested window")
+
+    stops = {}
+    for row in gtfs.rows("stops.txt"):
+        stops[row["stop_id"]] = (row.get("parent_station", ""), float(row["stop_lat"]), float(row["stop_lon"]))
+
+    def station_of(stop_id: str) -> Tuple[Optional[int], float, float]:
+        parent, lat, lon = stops[stop_id]
+        if parent and parent in stops:
+            _, lat, lon = stops[parent]
+            return station_number(parent) or station_number(stop_id), lat, lon
+        return station_number(stop_id), lat, lon
+
+    times: Dict[str, List[Tuple[int, str, Optional[int], Optional[int]]]] = {}
+    for row in gtfs.rows("stop_times.txt"):
+        if row["trip_id"] in trips:
+            times.setdefault(row["trip_id"], []).append(
+                (int(row["stop_sequence"]), row["stop_id"],
+                 parse_time(row["arrival_time"]), parse_time(row["departure_time"])))
+
+    services: Dict[int, int] = {}
+    patterns: Dict[tuple, int] = {}
+    pattern_rows: List[tuple] = []
+    pattern_stops: List[Tuple[int, int, int]] = []
+    per_line: List[List[Tuple[int, int, int, int]]] = [[] for _ in names]
+    dropped = 0
+
+    for trip_id, seq in times.items():
+        name, service_id = trips[trip_id]
+        seq.sort()
+        first_stop, last_stop = station_of(seq[0][1]), station_of(seq[-1][1])
+        start = seq[0][3] if seq[0][3] is not None else seq[0][2]
+        end = seq[-1][2] if seq[-1][2] is not None else seq[-1][3]
+        if start is None or end is None or first_stop[0] is None or last_stop[0] is None:
+            dropped += 1
+            continue
+
+        kept = []
+        for _, stop_id, arr, dep in seq:
+            sid = station_of(stop_id)[0]
+            if sid not in on_map or (arr is None and dep is None):
+                continue
+            arr = arr if arr is not None else dep
+            dep = dep if dep is not None else arr
+            kept.append((sid, arr - start, dep - start))
+        span = end - start
+        if not kept or span < 0 or any(not 0 <= t <= 0xFFFF for _, a, d in kept for t in (a, d)):
+            dropped += 1
+            continue
+
+        direction = get_direction(first_stop[1], first_stop[2], last_stop[1], last_stop[2])
+        key = (line_code[name], direction, first_stop[0], last_stop[0], span, tuple(kept))
+        if key not in patterns:
+            patterns[key] = len(pattern_rows)
+            pattern_rows.append((first_stop[0], last_stop[0], len(pattern_stops), len(kept),
+                                 line_code[name], direction, span))
+            pattern_stops.extend(kept)
+        bits = bitmaps[service_id]
+        service = services.setdefault(bits, len(services))
+        entry = (start, patterns[key], service, span)
+
+        # the alternating ring line of the fetcher shows both directions
+        for i, n in enumerate(names):
+            if n == name or (n not in route_names and name in re.findall(r"[SU]\d+", n)):
+                per_line[i].append(entry)
+
+    if len(pattern_rows) > 0xFFFF or len(services) > 0xFFFF:
+        raise SystemExit("too many patterns or calendars for 16 bit indices, reduce --days")
+
+    out = bytearray(HDR.size)
+
+    def table(data: bytes) -> int:
+        while len(out) % 8:
+            out.append(0)
+        off = len(out)
+        out.extend(data)
+        return off
+
+    line_rows = bytearray()
+    trip_rows = bytearray()
+    n_trips = 0
+    for i, name in enumerate(names):
+        entries = sorted(per_line[i])
+        max_span = max((e[3] for e in entries), default=0)
+        line_rows += LINE.pack(name.encode()[:8], n_trips, len(entries), max_span)
+        for start, pattern, service, _ in entries:
+            trip_rows += TRIP.pack(pattern, service, start)
+        n_trips += len(entries)
+
+    off_lines = table(bytes(line_rows))
+    off_services = table(b"".join(struct.pack("<Q", bits) for bits in sorted(services, key=services.get)))
+    off_patterns = table(b"".join(PATTERN.pack(*p) for p in pattern_rows))
+    off_stops = table(b"".join(STOP.pack(*s) for s in pattern_stops))
+    off_trips = table(bytes(trip_rows))
+    while len(out) % 4:
+        out.append(0)
+
+    first_day = (first - datetime.date(1970, 1, 1)).days
+    crc = zlib.crc32(bytes(out[HDR.size:])) & 0xFFFFFFFF
+    HDR.pack_into(out, 0, TIMETABLE_MAGIC, TIMETABLE_VERSION, len(names), len(out), crc,
+                  first_day, days, 0, len(services), len(pattern_rows), len(pattern_stops), n_trips,
+                  off_lines, off_services, off_patterns, off_stops, off_trips, int(time.time()))
+
+    print(f"{len(trips) - dropped} trips in {len(pattern_rows)} patterns, {len(services)} calendars, "
+          f"{n_trips} line entries, {dropped} dropped, {len(out)} bytes")
+    return bytes(out)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="build the static timetable partition image")
+    parser.add_argument("gtfs", help="GTFS zip file or directory")
+    parser.add_argument("-o", "--output", required=True, help="image file to write")
+    parser.add_argument("--topology", default=DEFAULT_TOPOLOGY, help="topology json with lines and stations")
+    parser.add_argument("--from", dest="first", default=datetime.date.today().isoformat(),
+                        help="first day of the image, YYYY-MM-DD (default today)")
+    parser.add_argument("--days", type=int, default=56, help=f"days covered, at most {TIMETABLE_MAX_DAYS}")
+    parser.add_argument("--max-size", type=lambda s: int(s, 0), default=0xC0000,
+                        help="size of the timetable partition")
+    args = parser.parse_args()
+
+    if not 1 <= args.days <= TIMETABLE_MAX_DAYS:
+        parser.error(f"--days must be 1..{TIMETABLE_MAX_DAYS}")
+    names, on_map = load_topology(args.topology)
+    image = build(Gtfs(args.gtfs), names, on_map, datetime.date.fromisoformat(args.first), args.days)
+    if len(image) > args.max_size:
+        print(f"gen_timetable: image of {len(image)} bytes does not fit {args.max_size}, reduce --days",
+              file=sys.stderr)
+        return 1
+
+    os.makedirs(os.path.dirname(os.path.abspath(args.output)), exist_ok=True)
+    with open(args.output, "wb") as f:
+        f.write(image)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
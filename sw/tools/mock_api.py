@@ -0,0 +1,415 @@
+"""
+Local stand-in for v6.bvg.transport.rest: answers the two queries of the
+fetcher (api_line_url() and api_trip_url() in src/user/src/api_url.c) from
+recorded fixtures, and injects the faults the real service shows now and
+then, so the firmware and the host build can be tested without it.
+
+    python tools/mock_api.py --port 8080
+    python tools/mock_api.py --latency 800:400 --error-rate 0.1 --reset-rate 0.05
+    python tools/mock_api.py --chunked --oversize 70000 --oversize-rate 0.2
+
+Lines with a recording under --fixtures (the layout tools/record_trips.py
+writes, one directory per line) are served from it. Every other line of
+topology/berlin.json gets trips synthesised from its stop order, so all map
+lines have traffic. Timestamps are moved to the present when the server
+starts and again every --loop seconds; with --freeze they stay as recorded
+and the Date header carries the recording time, which is what the replay
+benchmark does.
+
+Point the firmware at it with CONFIG_BVG_API_BASE_URL, the host build with
+bvg_bench -u http://127.0.0.1:8080. A QEMU image with user networking
+reaches the host as 10.0.2.2.
+
+GET /_mock/stats returns request and fault counters as json. With --exec the
+mock serves only while one command runs, "{url}" in it is replaced by the base
+url, and exits with its status; the host tests use that:
+
+    python tools/mock_api.py --port 0 --error-rate 0.1 --exec bvg_bench -u {url} U8
+"""
+import argparse
+import csv
+import datetime
+import email.utils
+import json
+import os
+import random
+import re
+import socket
+import subprocess
+import struct
+import sys
+import threading
+import time
+import urllib.parse
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from typing import Dict, List, Optional, Tuple
+from zoneinfo import ZoneInfo
+
+SW_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+DEFAULT_FIXTURES = os.path.join(SW_DIR, "host", "fixtures")
+DEFAULT_TOPOLOGY = os.path.join(SW_DIR, "topology", "berlin.json")
+DEFAULT_POSITIONS = os.path.join(SW_DIR, "..", "hw", "production", "positions.csv")
+
+TZ = ZoneInfo("Europe/Berlin")
+ISO_RE = re.compile(rb'"(\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d(?:\.\d+)?(?:[+-]\d\d:\d\d|Z))"')
+UPDATED_RE = re.compile(rb'"realtimeDataUpdatedAt":(\d+)')
+SPLIT_RE = re.compile(r"[A-Z]\d+")
+
+OPERATORS = {"U": ("berliner-verkehrsbetriebe", "Berliner Verkehrsbetriebe"),
+             "S": ("s-bahn-berlin-gmbh", "S-Bahn Berlin GmbH")}
+
+# map centre and scale of the pcb, to turn led positions into coordinates
+MAP_LAT, MAP_LON = 52.52, 13.405
+DEG_PER_MM_LAT, DEG_PER_MM_LON = 0.0012, 0.002
+
+
+class Recording:
+    """The answers of one api line, as recorded at time now."""
+
+    def __init__(self, line: str, now: int, source: str) -> None:
+        self.line = line
+        self.now = now
+        self.source = source
+        self.list_body = b""
+        self.trips: Dict[str, bytes] = {}
+
+
+def load_recording(path: str) -> Optional[Recording]:
+    try:
+        with open(os.path.join(path, "meta.json"), encoding="utf-8") as f:
+            meta = json.load(f)
+        with open(os.path.join(path, "list.json"), "rb") as f:
+            list_body = f.read()
+    except (OSError, ValueError):
+        return None
+    rec = Recording(meta["line"], int(meta["now"]), meta.get("source", path))
+    rec.list_body = list_body
+    # record_trips.py numbers the trip files in list order
+    ids = [t.get("id") for t in json.loads(list_body).get("trips", [])]
+    for i, trip_id in enumerate(ids):
+        name = os.path.join(path, f"trip_{i:02d}.json")
+        if trip_id and os.path.exists(name):
+            with open(name, "rb") as f:
+                rec.trips[trip_id] = f.read()
+    return rec
+
+
+def load_led_coordinates(path: str) -> Dict[int, Tuple[float, float]]:
+    """led index -> (lat, lon), from the pcb designators U1.. of the position file."""
+    coords: Dict[int, Tuple[float, float]] = {}
+    if not os.path.exists(path):
+        return coords
+    with open(path, encoding="utf-8-sig", newline="") as f:
+        rows = [r for r in csv.DictReader(f) if re.fullmatch(r"U\d+", r["Designator"])]
+    if not rows:
+        return coords
+    xs = [float(r["Mid X"]) for r in rows]
+    ys = [float(r["Mid Y"]) for r in rows]
+    cx, cy = (min(xs) + max(xs)) / 2, (min(ys) + max(ys)) / 2
+    for r in rows:
+        led = int(r["Designator"][1:]) - 1
+        coords[led] = (MAP_LAT + (float(r["Mid Y"]) - cy) * DEG_PER_MM_LAT,
+                       MAP_LON + (float(r["Mid X"]) - cx) * DEG_PER_MM_LON)
+    return coords
+
+
+def stop_obj(sid: int, lat: float, lon: float) -> dict:
+    return {"type": "stop", "id": str(sid), "name": f"Station {sid % 100000}",
+            "location": {"type": "location", "id": str(sid), "latitude": round(lat, 6), "longitude": round(lon, 6)}}
+
+
+def synthesise(line: str, leds: List[int], stations: Dict[int, int], coords: Dict[int, Tuple[float, float]],
+               n_trips: int, now: int, rng: random.Random) -> Recording:
+    """Trips along the stop order of a map line, spread over its whole length, both directions."""
+    stops = [(stations[led], coords.get(led, (MAP_LAT, MAP_LON))) for led in leds if led in stations]
+    rec = Recording(line, now, "synthetic")
+    kind = line[0]
+    op = OPERATORS.get(kind, OPERATORS["U"])
+    t_now = datetime.datetime.fromtimestamp(now, TZ)
+    summaries = []
+    for k in range(n_trips if len(stops) > 1 else 0):
+        order = stops[::-1] if k % 2 else stops
+        hop = rng.choice([90, 105, 120])
+        delay = rng.choice([0, 0, 60, 120, -30])
+        start = t_now - datetime.timedelta(seconds=rng.randint(0, hop * (len(order) - 1)))
+        trip_id = f"1|{rng.randint(10000, 99999)}|{rng.randint(0, 40)}|86|{t_now:%d%m%Y}"
+        stopovers = []
+        for j, (sid, (lat, lon)) in enumerate(order):
+            planned = start + datetime.timedelta(seconds=hop * j)
+            real = planned + datetime.timedelta(seconds=delay)
+            first, last = j == 0, j == len(order) - 1
+            stopovers.append({
+                "stop": stop_obj(sid, lat, lon),
+                "arrival": None if first else real.isoformat(),
+                "plannedArrival": None if first else planned.isoformat(),
+                "arrivalDelay": None if first else delay,
+                "departure": None if last else (real + datetime.timedelta(seconds=20)).isoformat(),
+                "plannedDeparture": None if last else (planned + datetime.timedelta(seconds=20)).isoformat(),
+                "departureDelay": None if last else delay,
+            })
+        trip = {
+            "origin": stopovers[0]["stop"], "destination": stopovers[-1]["stop"],
+            "departure": stopovers[0]["departure"], "plannedDeparture": stopovers[0]["plannedDeparture"],
+            "arrival": stopovers[-1]["arrival"], "plannedArrival": stopovers[-1]["plannedArrival"],
+            "id": trip_id,
+            "line": {"type": "line", "id": line.lower(), "fahrtNr": str(rng.randint(10000, 99999)), "name": line,
+                     "public": True, "mode": "train", "product": "subway" if kind == "U" else "suburban",
+                     "operator": {"type": "operator", "id": op[0], "name": op[1]}},
+            "direction": stopovers[-1]["stop"]["name"],
+            "stopovers": stopovers,
+        }
+        summaries.append({key: v for key, v in trip.items() if key != "stopovers"})
+        rec.trips[trip_id] = json.dumps({"trip": trip, "realtimeDataUpdatedAt": now}, separators=(",", ":")).encode()
+    rec.list_body = json.dumps({"trips": summaries, "realtimeDataUpdatedAt": now}, separators=(",", ":")).encode()
+    return rec
+
+
+def shift_times(body: bytes, shift: int) -> bytes:
+    """Moves every timestamp of an answer by shift seconds, keeping the Berlin offset right."""
+    if shift == 0:
+        return body
+
+    def iso(m: "re.Match[bytes]") -> bytes:
+        t = datetime.datetime.fromisoformat(m.group(1).decode().replace("Z", "+00:00"))
+        t = (t + datetime.timedelta(seconds=shift)).astimezone(TZ)
+        return b'"' + t.isoformat().encode() + b'"'
+
+    body = ISO_RE.sub(iso, body)
+    return UPDATED_RE.sub(lambda m: b'"realtimeDataUpdatedAt":' + str(int(m.group(1)) + shift).encode(), body)
+
+
+class Mock:
+    """Answers and fault settings, shared by the handler threads."""
+
+    def __init__(self, args: argparse.Namespace) -> None:
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.lock = threading.Lock()
+        self.started = int(time.time())
+        self.lines: Dict[str, Recording] = {}
+        self.trips: Dict[str, Recording] = {}
+        self.stats: Dict[str, int] = {}
+
+    def load(self) -> None:
+        if os.path.isdir(self.args.fixtures):
+            for name in sorted(os.listdir(self.args.fixtures)):
+                rec = load_recording(os.path.join(self.args.fixtures, name))
+                if rec:
+                    self.add(rec)
+        with open(self.args.topology, encoding="utf-8") as f:
+            topo = json.load(f)
+        stations: Dict[int, int] = {}
+        for s in topo["stations"]:
+            stations.setdefault(s["led"], s["id"])
+        coords = load_led_coordinates(self.args.positions)
+        recorded = ", ".join(sorted(self.lines)) or "none"
+        synthetic = []
+        for line in topo["lines"]:
+            # a map line like S41S42 is fetched as S41 and S42
+            for api_line in SPLIT_RE.findall(line["name"]):
+                if api_line not in self.lines:
+                    self.add(synthesise(api_line, line["stops"], stations, coords,
+                                        self.args.trips, self.started, self.rng))
+                    synthetic.append(api_line)
+        print(f"mock_api: recorded {recorded}; synthesised {', '.join(synthetic) or 'none'}", file=sys.stderr)
+
+    def add(self, rec: Recording) -> None:
+        self.lines[rec.line] = rec
+        for trip_id in rec.trips:
+            self.trips[trip_id] = rec
+
+    def shift(self, rec: Recording) -> int:
+        """Seconds to add to the recording: to the present at start, then every loop seconds again."""
+        if self.args.freeze:
+            return 0
+        now = int(time.time())
+        loop = self.args.loop
+        anchor = self.started + ((now - self.started) // loop) * loop if loop > 0 else self.started
+        return anchor - rec.now
+
+    def count(self, key: str) -> None:
+        with self.lock:
+            self.stats[key] = self.stats.get(key, 0) + 1
+
+    def roll(self, rate: float) -> bool:
+        with self.lock:
+            return rate > 0 and self.rng.random() < rate
+
+    def latency(self) -> float:
+        with self.lock:
+            return max(0.0, self.args.latency + self.rng.uniform(-self.args.jitter, self.args.jitter)) / 1000
+
+    def error_code(self) -> int:
+        with self.lock:
+            return self.rng.choice(self.args.error_codes)
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    server_version = "mock_api/1"
+    mock: Mock
+
+    def log_message(self, fmt: str, *args) -> None:
+        if not self.mock.args.quiet:
+            super().log_message(fmt, *args)
+
+    def do_GET(self) -> None:
+        mock = self.mock
+        url = urllib.parse.urlsplit(self.path)
+        path = urllib.parse.unquote(url.path)
+
+        if path == "/_mock/stats":
+            with mock.lock:
+                body = json.dumps(mock.stats, indent=2, sort_keys=True).encode()
+            self.answer(200, body, faults=False)
+            return
+
+        mock.count("requests")
+        if mock.args.latency or mock.args.jitter:
+            time.sleep(mock.latency())
+
+        if mock.roll(mock.args.error_rate):
+            code = mock.error_code()
+            mock.count(f"fault_{code}")
+            extra = {"Retry-After": str(mock.args.retry_after)} if code == 429 else {}
+            self.answer(code, json.dumps({"message": f"mock fault {code}"}).encode(), headers=extra, faults=False)
+            return
+
+        if path == "/trips":
+            line = urllib.parse.parse_qs(url.query).get("lineName", [""])[0]
+            rec = mock.lines.get(line)
+            mock.count("list")
+            if rec is None:
+                self.answer(200, b'{"trips":[]}')
+                return
+            self.answer(200, shift_times(rec.list_body, mock.shift(rec)), rec)
+            return
+
+        if path.startswith("/trips/"):
+            trip_id = path[len("/trips/"):]
+            rec = mock.trips.get(trip_id)
+            mock.count("trip")
+            if rec is None:
+                mock.count("trip_unknown")
+                self.answer(404, json.dumps({"message": "trip not found", "isHafasError": True}).encode())
+                return
+            self.answer(200, shift_times(rec.trips[trip_id], mock.shift(rec)), rec)
+            return
+
+        mock.count("not_found")
+        self.answer(404, b'{"message":"not found"}')
+
+    def answer(self, code: int, body: bytes, rec: Optional[Recording] = None,
+               headers: Optional[Dict[str, str]] = None, faults: bool = True) -> None:
+        mock = self.mock
+        args = mock.args
+        if faults and code == 200 and args.oversize and mock.roll(args.oversize_rate):
+            # still valid json, only too large for the fetch buffer
+            mock.count("fault_oversize")
+            body = body + b" " * max(0, args.oversize - len(body))
+        reset = faults and mock.roll(args.reset_rate)
+
+        self.send_response(code)
+        if rec is not None:
+            self.send_header("X-Mock-Source", rec.source)
+        self.send_header("Content-Type", "application/json; charset=utf-8")
+        self.send_header("Connection", "close")
+        for k, v in (headers or {}).items():
+            self.send_header(k, v)
+        chunked = args.chunked and code == 200
+        if chunked:
+            self.send_header("Transfer-Encoding", "chunked")
+        else:
+            self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.close_connection = True
+
+        if reset:
+            # half the body, then a RST instead of a FIN
+            mock.count("fault_reset")
+            self.wfile.write(body[:len(body) // 2])
+            self.connection.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack("ii", 1, 0))
+            self.connection.close()
+            return
+        if chunked:
+            for i in range(0, len(body), args.chunk_size):
+                part = body[i:i + args.chunk_size]
+                self.wfile.write(f"{len(part):x}\r\n".encode() + part + b"\r\n")
+            self.wfile.write(b"0\r\n\r\n")
+        else:
+            self.wfile.write(body)
+
+    def date_time_string(self, timestamp: Optional[float] = None) -> str:
+        # the Date header the firmware sets its clock from, frozen: the one of the recording
+        if self.mock.args.freeze:
+            url = urllib.parse.urlsplit(self.path)
+            line = urllib.parse.parse_qs(url.query).get("lineName", [""])[0]
+            trip = urllib.parse.unquote(url.path)[len("/trips/"):]
+            rec = self.mock.lines.get(line) or self.mock.trips.get(trip)
+            if rec is not None:
+                return email.utils.formatdate(rec.now, usegmt=True)
+        return super().date_time_string(timestamp)
+
+
+def parse_latency(text: str) -> Tuple[float, float]:
+    """"ms" or "ms:jitter"."""
+    base, _, jitter = text.partition(":")
+    return float(base), float(jitter or 0)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="local transport.rest stand-in with fault injection")
+    parser.add_argument("--host", default="0.0.0.0", help="address to listen on")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--fixtures", default=DEFAULT_FIXTURES, help="directory of recorded lines")
+    parser.add_argument("--topology", default=DEFAULT_TOPOLOGY, help="map description for the synthesised lines")
+    parser.add_argument("--positions", default=DEFAULT_POSITIONS, help="pcb position file, led coordinates")
+    parser.add_argument("--trips", type=int, default=6, help="synthesised trips per line")
+    parser.add_argument("--freeze", action="store_true", help="serve the recording time instead of the present")
+    parser.add_argument("--loop", type=int, default=1800, help="seconds until the timestamps are moved again, 0 never")
+    parser.add_argument("--latency", type=parse_latency, default=(0.0, 0.0), metavar="MS[:JITTER]",
+                        help="delay before every answer")
+    parser.add_argument("--chunked", action="store_true", help="send bodies with chunked transfer encoding")
+    parser.add_argument("--chunk-size", type=int, default=1024)
+    parser.add_argument("--oversize", type=int, default=0, metavar="BYTES", help="pad answers to this size")
+    parser.add_argument("--oversize-rate", type=float, default=1.0, help="share of answers padded")
+    parser.add_argument("--error-rate", type=float, default=0.0, help="share of requests answered with an error")
+    parser.add_argument("--error-codes", default="429,500,502,503", help="status codes to pick the errors from")
+    parser.add_argument("--retry-after", type=int, default=10, help="Retry-After of a 429 in seconds")
+    parser.add_argument("--reset-rate", type=float, default=0.0, help="share of answers cut off by a reset")
+    parser.add_argument("--seed", type=int, default=None, help="seed of the fault and trip generator")
+    parser.add_argument("-q", "--quiet", action="store_true", help="no request log")
+    parser.add_argument("--exec", nargs=argparse.REMAINDER, dest="command", metavar="CMD",
+                        help="run CMD against the mock, then exit with its status")
+    args = parser.parse_args()
+    args.latency, args.jitter = args.latency
+    args.error_codes = [int(c) for c in args.error_codes.split(",") if c]
+    if args.chunk_size <= 0 or not args.error_codes:
+        parser.error("chunk size and error codes must not be empty")
+
+    mock = Mock(args)
+    mock.load()
+    Handler.mock = mock
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.daemon_threads = True
+    host = "127.0.0.1" if args.host in ("0.0.0.0", "") else args.host
+    base = f"http://{host}:{server.server_address[1]}"
+    print(f"mock_api: {len(mock.lines)} lines, {len(mock.trips)} trips on {base}", file=sys.stderr)
+
+    if args.command:
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+        status = subprocess.call([a.replace("{url}", base) for a in args.command])
+        server.shutdown()
+        with mock.lock:
+            print(f"mock_api: {json.dumps(mock.stats, sort_keys=True)}", file=sys.stderr)
+        return status
+
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
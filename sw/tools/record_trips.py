@@ -0,0 +1,86 @@
+"""
+Record the answers the fetcher gets for one line as a fixture for the host
+benchmark (host/bench): the trip list, every trip with its stopovers and the
+time of the recording, taken from the server's Date header.
+
+    python tools/record_trips.py U8 -o host/fixtures/U8
+    python tools/record_trips.py S41 --operator "S-Bahn Berlin GmbH" -o host/fixtures/S41
+
+The queries are the ones build_line_url() and build_trip_url() in
+src/user/src/requests.c send, so the recorded bodies have the same shape.
+"""
+import argparse
+import email.utils
+import json
+import os
+import sys
+import time
+import urllib.parse
+import urllib.request
+from typing import Tuple
+
+DEFAULT_BASE = "https://v6.bvg.transport.rest"
+
+OPERATORS = {"U": "Berliner Verkehrsbetriebe", "S": "S-Bahn Berlin GmbH"}
+
+
+def get(url: str) -> Tuple[bytes, int]:
+    """Body and the server time of one request."""
+    with urllib.request.urlopen(url, timeout=30) as r:
+        body = r.read()
+        date = r.headers.get("Date")
+    now = int(email.utils.parsedate_to_datetime(date).timestamp()) if date else int(time.time())
+    return body, now
+
+
+def line_url(base: str, line: str, operator: str) -> str:
+    return (f"{base}/trips?lineName={urllib.parse.quote(line, safe='')}"
+            f"&operatorNames={urllib.parse.quote(operator, safe='')}&onlyCurrentlyRunning=true"
+            "&stopovers=false&remarks=false&subStops=false&entrances=false"
+            "&subway=true&suburban=true&tram=false&bus=false&ferry=false&express=false&regional=false"
+            "&pretty=false")
+
+
+def trip_url(base: str, trip_id: str) -> str:
+    return f"{base}/trips/{urllib.parse.quote(trip_id, safe='')}?stopovers=true&remarks=false&pretty=false"
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="record /trips answers of one line as a benchmark fixture")
+    parser.add_argument("line", help="api line name, e.g. U8 or S41")
+    parser.add_argument("-o", "--output", required=True, help="fixture directory to write")
+    parser.add_argument("--operator", help="operator name as the api expects it (default by U/S prefix)")
+    parser.add_argument("--base", default=DEFAULT_BASE, help="api base url")
+    parser.add_argument("--max-trips", type=int, default=32, help="trips to record, the fetcher takes 32")
+    parser.add_argument("--delay", type=float, default=0.1, help="pause between requests in seconds")
+    args = parser.parse_args()
+
+    operator = args.operator or OPERATORS.get(args.line[:1].upper())
+    if operator is None:
+        parser.error("no default operator for this line, give --operator")
+
+    os.makedirs(args.output, exist_ok=True)
+    body, now = get(line_url(args.base, args.line, operator))
+    with open(os.path.join(args.output, "list.json"), "wb") as f:
+        f.write(body)
+
+    ids = [t["id"] for t in json.loads(body).get("trips", []) if t.get("id")][:args.max_trips]
+    if not ids:
+        print(f"record_trips: no trips running on {args.line}", file=sys.stderr)
+        return 1
+
+    for i, trip_id in enumerate(ids):
+        time.sleep(args.delay)
+        trip, _ = get(trip_url(args.base, trip_id))
+        with open(os.path.join(args.output, f"trip_{i:02d}.json"), "wb") as f:
+            f.write(trip)
+
+    with open(os.path.join(args.output, "meta.json"), "w", encoding="utf-8") as f:
+        json.dump({"line": args.line, "now": now, "source": args.base}, f, indent=2)
+        f.write("\n")
+    print(f"{len(ids)} trips of {args.line} recorded at {now} into {args.output}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,296 @@
+"""
+Draw a frame log of the renderer (frame_rec.h) onto the leds of the pcb, and
+compare two logs. Logs come from the firmware (CONFIG_FRAME_RECORDER,
+http://<ip>/frames) or from the host replay (bvg_bench -r frames.bin).
+
+    python tools/render_frames.py frames.bin                      # summary
+    python tools/render_frames.py frames.bin --png out --every 10
+    python tools/render_frames.py frames.bin --video frames.mp4   # needs ffmpeg
+    python tools/render_frames.py new.bin --diff old.bin          # exit 1 if they differ
+
+Led i sits at designator U<i+1> of hw/production/positions.csv, as in
+tools/gen_line_data.py. The strip runs at low values, so colours are scaled
+up to the brightest value in the log unless --gain is given.
+"""
+import argparse
+import csv
+import os
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import zlib
+from typing import Dict, List, Optional, Tuple
+
+SW_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+DEFAULT_POSITIONS = os.path.join(SW_DIR, "..", "hw", "production", "positions.csv")
+
+HEADER = struct.Struct("<IHHq")
+RECORD = struct.Struct("<BI")
+DELTA = struct.Struct("<HBBB")
+MAGIC = 0x4644454C        # "LEDF"
+VERSION = 1
+
+BACKGROUND = (16, 16, 20)
+UNLIT = (48, 48, 56)      # outline colour of a dark led
+MARGIN_MM = 4.0
+LED_MM = 1.6              # drawn led radius
+
+
+class LogError(Exception):
+    pass
+
+
+class FrameLog:
+    def __init__(self, led_count: int, t0_us: int):
+        self.led_count = led_count
+        self.t0_us = t0_us
+        self.times: List[int] = []         # ms since the first frame
+        self.frames: List[bytes] = []      # led_count * (r, g, b)
+        self.kinds: Dict[str, int] = {"K": 0, "D": 0, "S": 0}
+        self.size = 0
+        self.truncated = False
+
+
+def parse(path: str) -> FrameLog:
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        raise LogError(f"{path}: no header")
+    magic, version, led_count, t0_us = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise LogError(f"{path}: not a frame log")
+    if version != VERSION:
+        raise LogError(f"{path}: version {version}, this tool reads {VERSION}")
+
+    log = FrameLog(led_count, t0_us)
+    log.size = len(data)
+    frame = bytearray(led_count * 3)
+    pos = HEADER.size
+    while pos < len(data):
+        if pos + RECORD.size > len(data):
+            log.truncated = True
+            break
+        kind, ms = RECORD.unpack_from(data, pos)
+        body = pos + RECORD.size
+        kind = chr(kind)
+        if kind == "K":
+            end = body + len(frame)
+            if end > len(data):
+                log.truncated = True
+                break
+            frame[:] = data[body:end]
+        elif kind == "D":
+            if body + 2 > len(data):
+                log.truncated = True
+                break
+            (n,) = struct.unpack_from("<H", data, body)
+            end = body + 2 + n * DELTA.size
+            if end > len(data):
+                log.truncated = True
+                break
+            for off in range(body + 2, end, DELTA.size):
+                led, r, g, b = DELTA.unpack_from(data, off)
+                if led >= led_count:
+                    raise LogError(f"{path}: led {led} at offset {off}")
+                frame[led * 3:led * 3 + 3] = bytes((r, g, b))
+        elif kind == "S":
+            end = body
+        else:
+            raise LogError(f"{path}: unknown record {kind!r} at offset {pos}")
+        if not log.frames and kind != "K":
+            raise LogError(f"{path}: does not start with a key frame")
+        log.kinds[kind] += 1
+        log.times.append(ms)
+        log.frames.append(bytes(frame))
+        pos = end
+    return log
+
+
+def load_positions(path: str) -> Dict[int, Tuple[float, float]]:
+    """led index -> pcb position in mm, y pointing down."""
+    with open(path, encoding="utf-8-sig", newline="") as f:
+        rows = [r for r in csv.DictReader(f) if re.fullmatch(r"U\d+", r["Designator"])]
+    return {int(r["Designator"][1:]) - 1: (float(r["Mid X"]), -float(r["Mid Y"])) for r in rows}
+
+
+class Canvas:
+    """The pcb at scale px per mm, with the pixel offsets of every led."""
+
+    def __init__(self, positions: Dict[int, Tuple[float, float]], led_count: int, scale: float):
+        missing = [i for i in range(led_count) if i not in positions]
+        if missing:
+            raise LogError(f"no pcb position for led {missing[0]} (U{missing[0] + 1})")
+        xs = [positions[i][0] for i in range(led_count)]
+        ys = [positions[i][1] for i in range(led_count)]
+        x0, y0 = min(xs) - MARGIN_MM, min(ys) - MARGIN_MM
+        self.width = int((max(xs) + MARGIN_MM - x0) * scale) + 1
+        self.height = int((max(ys) + MARGIN_MM - y0) * scale) + 1
+        self.background = bytearray(bytes(BACKGROUND) * (self.width * self.height))
+        self.dots: List[List[int]] = []
+        radius = max(1.0, LED_MM * scale)
+        for i in range(led_count):
+            cx, cy = (positions[i][0] - x0) * scale, (positions[i][1] - y0) * scale
+            dot = []
+            for y in range(int(cy - radius), int(cy + radius) + 1):
+                for x in range(int(cx - radius), int(cx + radius) + 1):
+                    d2 = (x - cx) ** 2 + (y - cy) ** 2
+                    if d2 > radius * radius or not (0 <= x < self.width and 0 <= y < self.height):
+                        continue
+                    off = (y * self.width + x) * 3
+                    dot.append(off)
+                    if d2 > (radius - 1) ** 2:
+                        self.background[off:off + 3] = bytes(UNLIT)
+            self.dots.append(dot)
+
+    def draw(self, frame: bytes, gain: float) -> bytearray:
+        img = bytearray(self.background)
+        for i, dot in enumerate(self.dots):
+            r, g, b = frame[i * 3:i * 3 + 3]
+            if r == g == b == 0:
+                continue
+            px = bytes(min(255, int(c * gain)) for c in (r, g, b))
+            for off in dot:
+                img[off:off + 3] = px
+        return img
+
+
+def write_png(path: str, width: int, height: int, rgb: bytes) -> None:
+    def chunk(kind: bytes, body: bytes) -> bytes:
+        return struct.pack(">I", len(body)) + kind + body + struct.pack(">I", zlib.crc32(kind + body))
+
+    stride = width * 3
+    raw = b"".join(b"\0" + rgb[y * stride:(y + 1) * stride] for y in range(height))
+    with open(path, "wb") as f:
+        f.write(b"\x89PNG\r\n\x1a\n")
+        f.write(chunk(b"IHDR", struct.pack(">IIBBBBB", width, height, 8, 2, 0, 0, 0)))
+        f.write(chunk(b"IDAT", zlib.compress(raw, 6)))
+        f.write(chunk(b"IEND", b""))
+
+
+def auto_gain(log: FrameLog) -> float:
+    peak = max((max(f) for f in log.frames), default=0)
+    return 255.0 / peak if peak else 1.0
+
+
+def summary(path: str, log: FrameLog) -> None:
+    duration = log.times[-1] / 1000 if log.times else 0
+    lit = [sum(1 for i in range(log.led_count) if any(f[i * 3:i * 3 + 3])) for f in log.frames]
+    print(f"{path}: {len(log.frames)} frames over {duration:.1f} s, {log.led_count} leds, {log.size} bytes")
+    print(f"  records: {log.kinds['K']} key, {log.kinds['D']} delta, {log.kinds['S']} same")
+    if log.frames:
+        print(f"  bytes per frame: {log.size / len(log.frames):.1f}, leds lit: {min(lit)}..{max(lit)}, "
+              f"mean {sum(lit) / len(lit):.1f}")
+        gaps = [b - a for a, b in zip(log.times, log.times[1:])]
+        if gaps:
+            print(f"  frame interval: {min(gaps)}..{max(gaps)} ms")
+    if log.truncated:
+        print("  the last record is cut off")
+
+
+def diff(a: FrameLog, b: FrameLog, path_b: str, limit: int) -> int:
+    """Prints the frames that differ, returns their number."""
+    if a.led_count != b.led_count:
+        print(f"led count {a.led_count} vs {b.led_count} in {path_b}")
+        return max(len(a.frames), len(b.frames)) or 1
+    differing = 0
+    for n in range(max(len(a.frames), len(b.frames))):
+        if n >= len(a.frames) or n >= len(b.frames):
+            differing += 1
+            continue
+        leds = [i for i in range(a.led_count) if a.frames[n][i * 3:i * 3 + 3] != b.frames[n][i * 3:i * 3 + 3]]
+        if not leds and a.times[n] == b.times[n]:
+            continue
+        differing += 1
+        if differing <= limit:
+            shown = ", ".join(str(i) for i in leds[:8]) + (" ..." if len(leds) > 8 else "")
+            timing = "" if a.times[n] == b.times[n] else f", at {a.times[n]} vs {b.times[n]} ms"
+            print(f"frame {n}: {len(leds)} leds differ{timing}" + (f" ({shown})" if leds else ""))
+    if len(a.frames) != len(b.frames):
+        print(f"{len(a.frames)} vs {len(b.frames)} frames in {path_b}")
+    return differing
+
+
+def frames_at(log: FrameLog, fps: float) -> List[int]:
+    """Index of the frame shown at every video frame, from the timestamps."""
+    out: List[int] = []
+    if not log.frames:
+        return out
+    n = 0
+    for k in range(int(log.times[-1] * fps / 1000) + 1):
+        t = k * 1000 / fps
+        while n + 1 < len(log.times) and log.times[n + 1] <= t:
+            n += 1
+        out.append(n)
+    return out
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="draw or compare frame logs of the led renderer")
+    parser.add_argument("log", help="frame log, from /frames or bvg_bench -r")
+    parser.add_argument("--positions", default=DEFAULT_POSITIONS, help="pcb position file, led coordinates")
+    parser.add_argument("--png", metavar="DIR", help="write frame_NNNNN.png into DIR")
+    parser.add_argument("--every", type=int, default=1, help="every n-th frame only, for --png")
+    parser.add_argument("--video", metavar="FILE", help="encode the log in real time with ffmpeg")
+    parser.add_argument("--fps", type=float, default=10.0, help="video frame rate (default: the renderer's 10)")
+    parser.add_argument("--scale", type=float, default=4.0, help="pixels per mm of the pcb")
+    parser.add_argument("--gain", type=float, help="colour factor (default: brightest value to 255)")
+    parser.add_argument("--diff", metavar="OTHER", help="compare with another log, exit 1 on a difference")
+    parser.add_argument("--limit", type=int, default=20, help="differing frames listed by --diff")
+    args = parser.parse_args()
+
+    try:
+        log = parse(args.log)
+        summary(args.log, log)
+
+        if args.diff:
+            other = parse(args.diff)
+            differing = diff(log, other, args.diff, args.limit)
+            if differing:
+                print(f"{differing} frames differ")
+                return 1
+            print("no difference")
+
+        if not (args.png or args.video):
+            return 0
+        canvas = Canvas(load_positions(args.positions), log.led_count, args.scale)
+    except (OSError, LogError, KeyError, ValueError) as e:
+        print(f"render_frames: {e}", file=sys.stderr)
+        return 1
+    gain = args.gain if args.gain else auto_gain(log)
+
+    if args.png:
+        os.makedirs(args.png, exist_ok=True)
+        written = 0
+        for n in range(0, len(log.frames), max(1, args.every)):
+            write_png(os.path.join(args.png, f"frame_{n:05d}.png"), canvas.width, canvas.height,
+                      canvas.draw(log.frames[n], gain))
+            written += 1
+        print(f"{written} images in {args.png}")
+
+    if args.video:
+        ffmpeg: Optional[str] = shutil.which("ffmpeg")
+        if ffmpeg is None:
+            print("render_frames: no ffmpeg on the path, use --png", file=sys.stderr)
+            return 1
+        cmd = [ffmpeg, "-loglevel", "error", "-y", "-f", "rawvideo", "-pix_fmt", "rgb24",
+               "-s", f"{canvas.width}x{canvas.height}", "-r", str(args.fps), "-i", "-",
+               "-vf", "pad=ceil(iw/2)*2:ceil(ih/2)*2", "-pix_fmt", "yuv420p", args.video]
+        proc = subprocess.Popen(cmd, stdin=subprocess.PIPE)
+        images: Dict[int, bytes] = {}
+        shown = frames_at(log, args.fps)
+        for n in shown:
+            if n not in images:
+                images = {n: bytes(canvas.draw(log.frames[n], gain))}
+            proc.stdin.write(images[n])
+        proc.stdin.close()
+        if proc.wait() != 0:
+            print("render_frames: ffmpeg failed", file=sys.stderr)
+            return 1
+        print(f"{len(shown)} video frames in {args.video}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
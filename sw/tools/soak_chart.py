@@ -0,0 +1,88 @@
+"""
+Draw the samples of a soak run (host/soak, bvg_soak -o samples.csv) as an
+svg: system heap in use, free bytes and largest free block of the tripring
+heap, and trips in the ring, over virtual hours.
+
+    python tools/soak_chart.py soak.csv -o soak.svg
+"""
+import argparse
+import csv
+import sys
+from typing import Dict, List, Tuple
+
+WIDTH = 900
+PANEL_H = 180
+MARGIN_L, MARGIN_R, MARGIN_T, GAP = 80, 20, 30, 40
+
+# panel title, columns with their colours
+PANELS: List[Tuple[str, List[Tuple[str, str]]]] = [
+    ("system heap in use [bytes]", [("sys_in_use", "#c0392b")]),
+    ("tripring heap [bytes]", [("tr_free", "#2471a3"), ("tr_largest", "#17a589")]),
+    ("trips in the ring", [("tr_trips", "#7d3c98")]),
+]
+
+
+def load(path: str) -> Dict[str, List[float]]:
+    with open(path, newline="", encoding="utf-8") as f:
+        rows = list(csv.DictReader(f))
+    if not rows:
+        raise ValueError(f"{path}: no samples")
+    return {k: [float(r[k]) for r in rows] for k in rows[0]}
+
+
+def panel(cols: Dict[str, List[float]], title: str, series: List[Tuple[str, str]], top: int) -> List[str]:
+    t = [x / 3600 for x in cols["t_s"]]
+    t_max = max(t[-1], 1e-9)
+    values = [v for name, _ in series for v in cols[name]]
+    lo, hi = min(values), max(values)
+    if hi == lo:
+        lo, hi = lo - 1, hi + 1
+    plot_w = WIDTH - MARGIN_L - MARGIN_R
+
+    def xy(x: float, y: float) -> str:
+        return f"{MARGIN_L + x / t_max * plot_w:.1f},{top + PANEL_H - (y - lo) / (hi - lo) * PANEL_H:.1f}"
+
+    out = [f'<text x="{MARGIN_L}" y="{top - 8}" font-size="13">{title}</text>',
+           f'<rect x="{MARGIN_L}" y="{top}" width="{plot_w}" height="{PANEL_H}" fill="none" stroke="#999"/>',
+           f'<text x="{MARGIN_L - 6}" y="{top + 10}" font-size="11" text-anchor="end">{hi:.0f}</text>',
+           f'<text x="{MARGIN_L - 6}" y="{top + PANEL_H}" font-size="11" text-anchor="end">{lo:.0f}</text>']
+    for h in range(0, int(t_max) + 1, max(1, int(t_max) // 12)):
+        x = MARGIN_L + h / t_max * plot_w
+        out.append(f'<line x1="{x:.1f}" y1="{top}" x2="{x:.1f}" y2="{top + PANEL_H}" stroke="#eee"/>')
+        out.append(f'<text x="{x:.1f}" y="{top + PANEL_H + 14}" font-size="11" text-anchor="middle">{h} h</text>')
+    for i, (name, colour) in enumerate(series):
+        points = " ".join(xy(x, y) for x, y in zip(t, cols[name]))
+        out.append(f'<polyline points="{points}" fill="none" stroke="{colour}" stroke-width="1.2"/>')
+        out.append(f'<text x="{WIDTH - MARGIN_R}" y="{top - 8 - 14 * i}" font-size="11" fill="{colour}" '
+                   f'text-anchor="end">{name}</text>')
+    return out
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="chart the samples of a bvg_soak run")
+    parser.add_argument("csv", help="samples written by bvg_soak -o")
+    parser.add_argument("-o", "--output", help="svg to write (default: csv name with .svg)")
+    args = parser.parse_args()
+
+    try:
+        cols = load(args.csv)
+    except (OSError, ValueError, KeyError) as e:
+        print(f"soak_chart: {e}", file=sys.stderr)
+        return 1
+
+    height = MARGIN_T + len(PANELS) * (PANEL_H + GAP)
+    body = [f'<svg xmlns="http://www.w3.org/2000/svg" width="{WIDTH}" height="{height}" font-family="sans-serif">',
+            f'<rect width="{WIDTH}" height="{height}" fill="white"/>']
+    for i, (title, series) in enumerate(PANELS):
+        body += panel(cols, title, series, MARGIN_T + i * (PANEL_H + GAP))
+    body.append("</svg>")
+
+    out = args.output or args.csv.rsplit(".", 1)[0] + ".svg"
+    with open(out, "w", encoding="utf-8") as f:
+        f.write("\n".join(body) + "\n")
+    print(f"{len(cols['t_s'])} samples drawn into {out}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
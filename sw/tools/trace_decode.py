@@ -0,0 +1,111 @@
+"""
+Decode a dump of the firmware's binary event trace (components/trace).
+
+A dump is either the raw body of GET /trace from the status server or a
+console log that contains the "TRC <hex>" lines printed by trace_dump().
+Event names and formats are read from components/trace/trace_events.h, so
+the tool always matches the firmware it was checked out with.
+
+    curl -s http://<map>/trace -o trace.bin
+    python tools/trace_decode.py trace.bin
+    python tools/trace_decode.py monitor.log --events components/trace/trace_events.h
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+from typing import List, Tuple
+
+TRACE_MAGIC = 0x31435254
+HDR = struct.Struct("<IIHHI")      # magic, count, rec_size, n_recs, first
+REC = struct.Struct("<IHHII")      # ts_us, id, a, b, c
+
+DEFAULT_EVENTS = os.path.join(os.path.dirname(__file__), "..", "components", "trace", "trace_events.h")
+EVENT = re.compile(r'^\s*TRACE_EVENT\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+
+
+def load_events(path: str) -> List[Tuple[str, str]]:
+    """[(name, format)] in id order."""
+    events = []
+    with open(path, "r", encoding="utf-8") as f:
+        for line in f:
+            m = EVENT.match(line)
+            if m:
+                events.append((m.group(1), m.group(2)))
+    if not events:
+        raise SystemExit(f"no TRACE_EVENT lines in {path}")
+    return events
+
+
+def read_dump(path: str) -> bytes:
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) >= 4 and struct.unpack_from("<I", data)[0] == TRACE_MAGIC:
+        return data
+    # console log, collect the hex payload of the TRC lines, anything else is ignored
+    out = bytearray()
+    for line in data.decode("utf-8", errors="replace").splitlines():
+        m = re.search(r"TRC ([0-9a-fA-F]+)\s*$", line)
+        if m:
+            out += bytes.fromhex(m.group(1))
+    return bytes(out)
+
+
+def to_signed(v: int, bits: int) -> int:
+    return v - (1 << bits) if v & (1 << (bits - 1)) else v
+
+
+def render(fmt: str, a: int, b: int, c: int) -> str:
+    values = {
+        "a": str(a), "b": str(b), "c": str(c),
+        "A": str(to_signed(a, 16)), "B": str(to_signed(b, 32)), "C": str(to_signed(c, 32)),
+    }
+    return re.sub(r"%([abcABC])", lambda m: values[m.group(1)], fmt)
+
+
+def decode(data: bytes, events: List[Tuple[str, str]]) -> int:
+    if len(data) < HDR.size:
+        print("trace_decode: no trace data found", file=sys.stderr)
+        return 1
+    magic, count, rec_size, n_recs, first = HDR.unpack_from(data)
+    if magic != TRACE_MAGIC or rec_size != REC.size:
+        print(f"trace_decode: bad header (magic=0x{magic:08x}, rec_size={rec_size})", file=sys.stderr)
+        return 1
+
+    print(f"# {count} events since boot, {n_recs} in the dump starting at #{first}")
+    off = HDR.size
+    t_base = 0
+    last_ts = None
+    lost = 0
+    for i in range(n_recs):
+        if off + REC.size > len(data):
+            print(f"trace_decode: dump truncated after {i} records", file=sys.stderr)
+            break
+        ts, ev, a, b, c = REC.unpack_from(data, off)
+        off += REC.size
+        if ev == 0:
+            lost += 1
+            continue
+        # 32 bit microsecond stamps wrap after ~71 minutes
+        if last_ts is not None and ts < last_ts:
+            t_base += 1 << 32
+        last_ts = ts
+        t = (t_base + ts) / 1e6
+        name, fmt = events[ev] if ev < len(events) else (f"EVENT_{ev}", "a=%a b=%b c=%c")
+        print(f"#{first + i:<8d} {t:12.6f}  {name:<16} {render(fmt, a, b, c)}")
+    if lost:
+        print(f"# {lost} records were overwritten while reading")
+    return 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="decode a binary trace dump")
+    parser.add_argument("dump", help="raw /trace body or console log with TRC lines")
+    parser.add_argument("--events", default=DEFAULT_EVENTS, help="trace_events.h of the firmware")
+    args = parser.parse_args()
+    return decode(read_dump(args.dump), load_events(args.events))
+
+
+if __name__ == "__main__":
+    sys.exit(main())